@@ -36,6 +36,8 @@ struct _SwClientItemViewPrivate {
     DBusGConnection *connection;
     DBusGProxy *proxy;
     GHashTable *uuid_to_items;
+    /* Whether the service sends us ItemsChangedDelta */
+    gboolean change_deltas;
 };
 
 enum
@@ -174,12 +176,27 @@ _proxy_items_added_cb (DBusGProxy *proxy,
   SwClientItemView *view = SW_CLIENT_ITEM_VIEW (userdata);
   SwClientItemViewPrivate *priv = GET_PRIVATE (view);
   gint i = 0;
-  GList *items_list = NULL;
+  GList *items_list = NULL, *changed_list = NULL;
 
   for (i = 0; i < items->len; i++)
   {
     GValueArray *varray = (GValueArray *)g_ptr_array_index (items, i);
     SwItem *item;
+    const gchar *uid;
+
+    /*
+     * Views can be shared between clients, and everything is sent again when
+     * another client starts one. Treat items we already have as changed.
+     */
+    uid = g_value_get_string (g_value_array_get_nth (varray, 1));
+    item = g_hash_table_lookup (priv->uuid_to_items, uid);
+
+    if (item)
+    {
+      _sw_item_update_from_value_array (item, varray);
+      changed_list = g_list_append (changed_list, sw_item_ref (item));
+      continue;
+    }
 
     /* First reference dropped when list freed */
     item = _sw_item_from_value_array (varray);
@@ -192,10 +209,16 @@ _proxy_items_added_cb (DBusGProxy *proxy,
   }
 
   /* If handler wants a ref then it should ref it up */
-  g_signal_emit (view, signals[ITEMS_ADDED_SIGNAL], 0, items_list);
+  if (items_list)
+    g_signal_emit (view, signals[ITEMS_ADDED_SIGNAL], 0, items_list);
+
+  if (changed_list)
+    g_signal_emit (view, signals[ITEMS_CHANGED_SIGNAL], 0, changed_list);
 
   g_list_foreach (items_list, (GFunc)sw_item_unref, NULL);
   g_list_free (items_list);
+  g_list_foreach (changed_list, (GFunc)sw_item_unref, NULL);
+  g_list_free (changed_list);
 }
 
 static void
@@ -208,6 +231,13 @@ _proxy_items_changed_cb (DBusGProxy *proxy,
   gint i = 0;
   GList *items_list = NULL;
 
+  /*
+   * The view may be shared with clients that want whole items, in which case
+   * we get both signals
+   */
+  if (priv->change_deltas)
+    return;
+
   for (i = 0; i < items->len; i++)
   {
     GValueArray *varray = (GValueArray *)g_ptr_array_index (items, i);
@@ -235,6 +265,63 @@ _proxy_items_changed_cb (DBusGProxy *proxy,
   g_list_free (items_list);
 }
 
+static void
+_proxy_items_changed_delta_cb (DBusGProxy *proxy,
+                               GPtrArray  *items,
+                               gpointer    userdata)
+{
+  SwClientItemView *view = SW_CLIENT_ITEM_VIEW (userdata);
+  SwClientItemViewPrivate *priv = GET_PRIVATE (view);
+  gint i = 0;
+  GList *items_list = NULL;
+
+  for (i = 0; i < items->len; i++)
+  {
+    GValueArray *varray = (GValueArray *)g_ptr_array_index (items, i);
+    GHashTable *set_keys;
+    GHashTableIter iter;
+    gpointer key, value;
+    gchar **removed_keys;
+    SwItem *item;
+    const gchar *uid;
+
+    uid = g_value_get_string (g_value_array_get_nth (varray, 1));
+
+    item = g_hash_table_lookup (priv->uuid_to_items,
+                                uid);
+
+    if (!item)
+    {
+      g_critical (G_STRLOC ": Item changed before added: %s", uid);
+      continue;
+    }
+
+    /* Apply the keys that changed to what we already have */
+    item->date.tv_sec = g_value_get_int64 (g_value_array_get_nth (varray, 2));
+
+    set_keys = g_value_get_boxed (g_value_array_get_nth (varray, 3));
+    g_hash_table_iter_init (&iter, set_keys);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+      g_hash_table_replace (item->props, g_strdup (key), g_strdup (value));
+
+    removed_keys = g_value_get_boxed (g_value_array_get_nth (varray, 4));
+    for (; removed_keys && *removed_keys; removed_keys++)
+      g_hash_table_remove (item->props, *removed_keys);
+
+    items_list = g_list_append (items_list, sw_item_ref (item));
+  }
+
+  /* Nothing to tell anyone if none of them were ours */
+  if (items_list == NULL)
+    return;
+
+  /* If handler wants a ref then it should ref it up */
+  g_signal_emit (view, signals[ITEMS_CHANGED_SIGNAL], 0, items_list);
+
+  g_list_foreach (items_list, (GFunc)sw_item_unref, NULL);
+  g_list_free (items_list);
+}
+
 static void
 _proxy_items_removed_cb (DBusGProxy *proxy,
                          GPtrArray  *items,
@@ -291,6 +378,21 @@ _sw_items_get_container_type (void)
                                     _sw_item_get_struct_type ());
 }
 
+static GType
+_sw_items_delta_get_container_type (void)
+{
+  return dbus_g_type_get_collection ("GPtrArray",
+                                     dbus_g_type_get_struct ("GValueArray",
+                                                             G_TYPE_STRING,
+                                                             G_TYPE_STRING,
+                                                             G_TYPE_INT64,
+                                                             dbus_g_type_get_map ("GHashTable",
+                                                                                  G_TYPE_STRING,
+                                                                                  G_TYPE_STRING),
+                                                             G_TYPE_STRV,
+                                                             G_TYPE_INVALID));
+}
+
 static GType
 _sw_items_removed_get_container_type (void)
 {
@@ -354,6 +456,16 @@ sw_client_item_view_constructed (GObject *object)
                                object,
                                NULL);
 
+  dbus_g_proxy_add_signal (priv->proxy,
+                           "ItemsChangedDelta",
+                           _sw_items_delta_get_container_type (),
+                           NULL);
+  dbus_g_proxy_connect_signal (priv->proxy,
+                               "ItemsChangedDelta",
+                               (GCallback)_proxy_items_changed_delta_cb,
+                               object,
+                               NULL);
+
   dbus_g_proxy_add_signal (priv->proxy,
                            "ItemsRemoved",
                            _sw_items_removed_get_container_type (),
@@ -474,11 +586,43 @@ _sw_client_item_view_generic_cb (DBusGProxy *proxy,
   }
 }
 
+static void
+_sw_client_item_view_set_change_deltas_cb (DBusGProxy *proxy,
+                                           GError     *error,
+                                           gpointer    userdata)
+{
+  SwClientItemView *item_view = SW_CLIENT_ITEM_VIEW (userdata);
+  SwClientItemViewPrivate *priv = GET_PRIVATE (item_view);
+
+  if (error)
+  {
+    /* Older daemons don't have it, and just send ItemsChanged */
+    if (!g_error_matches (error, DBUS_GERROR, DBUS_GERROR_UNKNOWN_METHOD))
+      g_warning (G_STRLOC ": Error when enabling change deltas: %s",
+                 error->message);
+    g_error_free (error);
+  } else {
+    /* Signals sent after the reply come after it */
+    priv->change_deltas = TRUE;
+  }
+
+  g_object_unref (item_view);
+}
+
 void
 sw_client_item_view_start (SwClientItemView *item_view)
 {
   SwClientItemViewPrivate *priv = GET_PRIVATE (item_view);
 
+  /*
+   * We keep every item, so only the keys that changed need to be sent. This
+   * is transparent to users of the library.
+   */
+  com_meego_libsocialweb_ItemView_set_change_deltas_async (priv->proxy,
+                                                           TRUE,
+                                                           _sw_client_item_view_set_change_deltas_cb,
+                                                           g_object_ref (item_view));
+
   com_meego_libsocialweb_ItemView_start_async (priv->proxy,
                                                _sw_client_item_view_generic_cb,
                                                (gpointer)G_STRFUNC);
@@ -513,3 +657,22 @@ sw_client_item_view_close (SwClientItemView *item_view)
                                               _sw_client_item_view_generic_cb,
                                               (gpointer)G_STRFUNC);
 }
+
+/*
+ * Only follow @count items from @offset in the view, newest first. Items
+ * moving in and out of the window arrive as items-added and items-removed.
+ * A @count of 0 means everything from @offset on.
+ */
+void
+sw_client_item_view_set_window (SwClientItemView *item_view,
+                                guint             offset,
+                                guint             count)
+{
+  SwClientItemViewPrivate *priv = GET_PRIVATE (item_view);
+
+  com_meego_libsocialweb_ItemView_set_window_async (priv->proxy,
+                                                    offset,
+                                                    count,
+                                                    _sw_client_item_view_generic_cb,
+                                                    (gpointer)G_STRFUNC);
+}
@@ -60,6 +60,9 @@ void sw_client_item_view_start (SwClientItemView *item_view);
 void sw_client_item_view_refresh (SwClientItemView *item_view);
 void sw_client_item_view_stop (SwClientItemView *item_view);
 void sw_client_item_view_close (SwClientItemView *item_view);
+void sw_client_item_view_set_window (SwClientItemView *item_view,
+                                     guint             offset,
+                                     guint             count);
 
 G_END_DECLS
 
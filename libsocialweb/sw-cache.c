@@ -18,6 +18,11 @@
  */
 
 #include <config.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <glib/gstdio.h>
 
 #include "sw-cache.h"
@@ -25,33 +30,43 @@
 #include "sw-item.h"
 #include "sw-contact.h"
 #include "sw-utils.h"
+#include "sw-thumbnails.h"
 
 /*
- * Get the file name of the cache file for this service.  As a side-effect it
- * creates the parent directory if required.
+ * Get the directory the cache files live in.  The first time this is called
+ * it creates the directory if required.
+ */
+static const char *
+get_cache_dir (void)
+{
+  static char *path = NULL;
+
+  if (path == NULL) {
+    /* TODO: use GIO */
+    path = g_build_filename (g_get_user_cache_dir (),
+                             PACKAGE,
+                             "cache",
+                             NULL);
+
+    if (g_mkdir_with_parents (path, 0777) != 0)
+      g_message ("Cannot create cache directory: %s", g_strerror (errno));
+  }
+
+  return path;
+}
+
+/*
+ * Get the file name of the cache file for this service.
  */
 static char *
 get_cache_filename (SwService   *service,
                     const gchar *query,
                     GHashTable  *params)
 {
-  char *path, *param_hash, *filename, *full_filename;
+  char *param_hash, *filename, *full_filename;
 
   g_assert (service);
 
-  /* TODO: use GIO */
-
-  path = g_build_filename (g_get_user_cache_dir (),
-                           PACKAGE,
-                           "cache",
-                           NULL);
-  if (!g_file_test (path, G_FILE_TEST_IS_DIR)) {
-    int err;
-    err = g_mkdir_with_parents (path, 0777);
-    if (err)
-      g_message ("Cannot create cache directory: %s", g_strerror (err));
-  }
-
   param_hash = sw_hash_string_dict (params);
   filename = g_strconcat (sw_service_get_name (service),
                           "-", 
@@ -60,9 +75,8 @@ get_cache_filename (SwService   *service,
                           param_hash, NULL);
   g_free (param_hash);
 
-  full_filename = g_build_filename (path, filename, NULL);
+  full_filename = g_build_filename (get_cache_dir (), filename, NULL);
 
-  g_free (path);
   g_free (filename);
 
   return full_filename;
@@ -95,9 +109,12 @@ static char *
 make_absolute_path (const char *key, const char *value)
 {
   if (g_str_equal (key, "authoricon") || g_str_equal (key, "thumbnail")) {
-    return g_build_filename (g_get_user_cache_dir (),
-                             PACKAGE, "thumbnails", value,
-                             NULL);
+    char *path;
+
+    path = g_build_filename (sw_thumbnails_get_dir (), value, NULL);
+    sw_thumbnails_touch (path);
+
+    return path;
 
   } else {
     return NULL;
@@ -105,15 +122,1181 @@ make_absolute_path (const char *key, const char *value)
 }
 
 /*
- * Create a new group in the keyfile based on the SwCacheable.
+ * On-disk binary cache format.
+ *
+ * The file is a fixed header followed by an array of fixed-size records (one
+ * per cached item or contact), an array of key/value fields and finally a
+ * table of nul-terminated strings.  Everything apart from the strings is a
+ * guint32 in host byte order, and fields/strings are referenced by index and
+ * offset so that the file can be mapped and walked without any parsing.
+ *
+ * Files that don't start with the magic are assumed to be the old GKeyFile
+ * caches and are read with the fallback reader; the next save will then
+ * rewrite them in the binary format.
+ */
+
+#define CACHE_MAGIC "SWCACHE"
+#define CACHE_VERSION 1
+#define CACHE_BYTE_ORDER 0x01020304
+
+typedef enum {
+  CACHE_RECORD_ITEM = 0,
+  CACHE_RECORD_CONTACT = 1
+} CacheRecordType;
+
+typedef struct {
+  gchar magic[8];
+  guint32 byte_order;
+  guint32 version;
+  guint32 n_records;
+  guint32 n_fields;
+  guint32 strings_size;
+} CacheHeader;
+
+typedef struct {
+  guint32 type;
+  /* Offset of the id in the string table */
+  guint32 id;
+  /* Index of the first field of this record, and how many there are */
+  guint32 first_field;
+  guint32 n_fields;
+} CacheRecord;
+
+typedef struct {
+  guint32 key;
+  guint32 value;
+} CacheField;
+
+/*
+ * Journal.
+ *
+ * A binary cache file may be followed by a journal: a sequence of entries
+ * that each add, change or remove one record by id.  Once a file has been
+ * written or loaded we remember a digest of every record in it, so later
+ * saves only need to append entries for the records that differ.  When the
+ * journal grows bigger than the snapshot it follows, the next save compacts
+ * the file by rewriting the snapshot.
+ *
+ * Each entry is a JournalEntry followed by @length bytes of payload: the id
+ * and then @n_fields key/value pairs, all as nul-terminated strings.
+ */
+
+typedef enum {
+  JOURNAL_ADD = 1,
+  JOURNAL_CHANGE = 2,
+  JOURNAL_REMOVE = 3
+} JournalOp;
+
+typedef struct {
+  guint32 op;
+  guint32 type;
+  guint32 n_fields;
+  guint32 length;
+} JournalEntry;
+
+typedef struct {
+  /* id => digest of the record as it is on disk */
+  GHashTable *digests;
+  /* Size of the snapshot and of the journal following it */
+  gsize base_size;
+  gsize journal_size;
+} CacheState;
+
+/* Hash of cache filename to CacheState, for files we know the contents of */
+static GHashTable *cache_states = NULL;
+
+static void
+cache_state_free (CacheState *state)
+{
+  g_hash_table_unref (state->digests);
+  g_slice_free (CacheState, state);
+}
+
+static GHashTable *
+digests_new (void)
+{
+  return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+static void
+digests_insert (GHashTable *digests, const char *id, guint64 digest)
+{
+  guint64 *value;
+
+  value = g_new (guint64, 1);
+  *value = digest;
+  g_hash_table_replace (digests, g_strdup (id), value);
+}
+
+static void
+set_cache_state (const char *filename, CacheState *state)
+{
+  if (cache_states == NULL)
+    cache_states = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                          (GDestroyNotify)cache_state_free);
+
+  if (state)
+    g_hash_table_replace (cache_states, g_strdup (filename), state);
+  else
+    g_hash_table_remove (cache_states, filename);
+}
+
+static CacheState *
+get_cache_state (const char *filename)
+{
+  if (cache_states == NULL)
+    return NULL;
+
+  return g_hash_table_lookup (cache_states, filename);
+}
+
+typedef struct {
+  SwCacheableFieldFunc func;
+  gpointer user_data;
+} CacheFieldClosure;
+
+static void
+relative_field_cb (const char *key, const char *value, gpointer user_data)
+{
+  CacheFieldClosure *closure = user_data;
+  char *new_value;
+
+  /*
+   * We make relative paths when saving so that the cache files are portable
+   * between users.
+   */
+  new_value = make_relative_path (key, value);
+  if (new_value) {
+    closure->func (key, new_value, closure->user_data);
+    g_free (new_value);
+  } else {
+    closure->func (key, value, closure->user_data);
+  }
+}
+
+/*
+ * Call @func for every key/value pair of @cacheable as it should be written
+ * to the cache, setting @type to the record type.  Returns FALSE if the
+ * object shouldn't be cached.
+ */
+static gboolean
+foreach_cache_field (SwCacheable          *cacheable,
+                     guint32              *type,
+                     SwCacheableFieldFunc  func,
+                     gpointer              user_data)
+{
+  CacheFieldClosure closure = { func, user_data };
+
+  if (sw_cacheable_get_id (cacheable) == NULL)
+    return FALSE;
+
+  /* Skip items that are not ready. Their properties will not be intact */
+  if (!sw_cacheable_is_ready (cacheable))
+    return FALSE;
+
+  /* The record type says what to make of the fields on load */
+  if (SW_IS_ITEM (cacheable)) {
+    *type = CACHE_RECORD_ITEM;
+  } else if (SW_IS_CONTACT (cacheable)) {
+    *type = CACHE_RECORD_CONTACT;
+  } else {
+    g_warning (G_STRLOC ": Cannot cache object of type %s",
+               G_OBJECT_TYPE_NAME (cacheable));
+    return FALSE;
+  }
+
+  sw_cacheable_foreach_field (cacheable, relative_field_cb, &closure);
+
+  return TRUE;
+}
+
+typedef struct {
+  guint64 digest;
+  /* The key being hashed and the hash of it and its values so far */
+  const char *key;
+  guint64 hash;
+} DigestClosure;
+
+static void
+digest_field (const char *key, const char *value, gpointer user_data)
+{
+  DigestClosure *closure = user_data;
+
+  /* The values of a key arrive together, so a new key finishes the last */
+  if (closure->key == NULL || strcmp (closure->key, key) != 0) {
+    closure->digest += closure->hash;
+    closure->key = key;
+    closure->hash = sw_hash_string_64 (SW_HASH_64_INIT, key);
+  }
+
+  closure->hash = sw_hash_string_64 (closure->hash, value);
+}
+
+/*
+ * Compute a digest of the cached form of @cacheable, which is used to spot
+ * records that have changed since they were written.  Like the item and
+ * contact fingerprints, each key is hashed along with its values in order and
+ * the keys are summed so that the hash table iteration order doesn't matter.
+ */
+static gboolean
+get_digest (SwCacheable *cacheable, guint64 *digest)
+{
+  DigestClosure closure = { 0, NULL, 0 };
+  guint32 type;
+
+  if (!foreach_cache_field (cacheable, &type, digest_field, &closure))
+    return FALSE;
+
+  *digest = closure.digest + closure.hash + type;
+
+  return TRUE;
+}
+
+typedef struct {
+  GArray *records;
+  GArray *fields;
+  GByteArray *strings;
+  /* string => offset + 1, so that strings are only stored once */
+  GHashTable *offsets;
+  /* id => digest of every record written */
+  GHashTable *digests;
+} CacheWriter;
+
+static guint32
+writer_add_string (CacheWriter *writer, const char *s)
+{
+  gpointer offset;
+
+  offset = g_hash_table_lookup (writer->offsets, s);
+  if (offset == NULL) {
+    guint32 new_offset = writer->strings->len;
+
+    g_byte_array_append (writer->strings, (const guint8 *)s, strlen (s) + 1);
+    offset = GUINT_TO_POINTER (new_offset + 1);
+    g_hash_table_insert (writer->offsets, g_strdup (s), offset);
+  }
+
+  return GPOINTER_TO_UINT (offset) - 1;
+}
+
+static void
+writer_add_field (const char *key, const char *value, gpointer user_data)
+{
+  CacheWriter *writer = user_data;
+  CacheField field;
+
+  field.key = writer_add_string (writer, key);
+  field.value = writer_add_string (writer, value);
+  g_array_append_val (writer->fields, field);
+}
+
+/*
+ * Append a record for the SwCacheable to the writer.
+ */
+static void
+add_record_from_item (gpointer data, gpointer user_data)
+{
+  SwCacheable *cacheable = data;
+  CacheWriter *writer = user_data;
+  CacheRecord record;
+  guint64 digest;
+
+  record.first_field = writer->fields->len;
+
+  if (!foreach_cache_field (cacheable, &record.type,
+                            writer_add_field, writer)) {
+    /* Drop any fields that were added before we gave up */
+    g_array_set_size (writer->fields, record.first_field);
+    return;
+  }
+
+  record.id = writer_add_string (writer, sw_cacheable_get_id (cacheable));
+  record.n_fields = writer->fields->len - record.first_field;
+  g_array_append_val (writer->records, record);
+
+  if (writer->digests && get_digest (cacheable, &digest))
+    digests_insert (writer->digests, sw_cacheable_get_id (cacheable), digest);
+}
+
+/*
+ * Serialise @set into a newly allocated buffer in the binary cache format.
+ * If @digests is not NULL it is filled with the digest of every record.
  */
+static guint8 *
+write_binary_cache (SwSet *set, gsize *length, GHashTable *digests)
+{
+  CacheWriter writer;
+  CacheHeader header;
+  guint8 *data, *p;
+  gsize records_size, fields_size;
+
+  writer.records = g_array_new (FALSE, FALSE, sizeof (CacheRecord));
+  writer.fields = g_array_new (FALSE, FALSE, sizeof (CacheField));
+  writer.strings = g_byte_array_new ();
+  writer.offsets = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          g_free, NULL);
+  writer.digests = digests;
+
+  sw_set_foreach (set, add_record_from_item, &writer);
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, CACHE_MAGIC, sizeof (CACHE_MAGIC));
+  header.byte_order = CACHE_BYTE_ORDER;
+  header.version = CACHE_VERSION;
+  header.n_records = writer.records->len;
+  header.n_fields = writer.fields->len;
+  header.strings_size = writer.strings->len;
+
+  records_size = writer.records->len * sizeof (CacheRecord);
+  fields_size = writer.fields->len * sizeof (CacheField);
+
+  *length = sizeof (header) + records_size + fields_size + writer.strings->len;
+  data = p = g_malloc (*length);
+
+  memcpy (p, &header, sizeof (header));
+  p += sizeof (header);
+  memcpy (p, writer.records->data, records_size);
+  p += records_size;
+  memcpy (p, writer.fields->data, fields_size);
+  p += fields_size;
+  memcpy (p, writer.strings->data, writer.strings->len);
+
+  g_array_free (writer.records, TRUE);
+  g_array_free (writer.fields, TRUE);
+  g_byte_array_free (writer.strings, TRUE);
+  g_hash_table_unref (writer.offsets);
+
+  return data;
+}
+
+typedef struct {
+  GByteArray *journal;
+  GByteArray *payload;
+  guint32 n_fields;
+  /* id => digest of every record in the set being saved */
+  GHashTable *digests;
+  CacheState *state;
+} JournalWriter;
+
+static void
+journal_add_string (GByteArray *array, const char *s)
+{
+  g_byte_array_append (array, (const guint8 *)s, strlen (s) + 1);
+}
+
+static void
+journal_add_field (const char *key, const char *value, gpointer user_data)
+{
+  JournalWriter *writer = user_data;
+
+  journal_add_string (writer->payload, key);
+  journal_add_string (writer->payload, value);
+  writer->n_fields++;
+}
+
+static void
+journal_add_entry (JournalWriter *writer, JournalOp op, guint32 type)
+{
+  JournalEntry entry;
+
+  entry.op = op;
+  entry.type = type;
+  entry.n_fields = writer->n_fields;
+  entry.length = writer->payload->len;
+
+  g_byte_array_append (writer->journal, (const guint8 *)&entry, sizeof (entry));
+  g_byte_array_append (writer->journal, writer->payload->data,
+                       writer->payload->len);
+
+  g_byte_array_set_size (writer->payload, 0);
+  writer->n_fields = 0;
+}
+
 static void
-set_keyfile_from_item (gpointer data, gpointer user_data)
+add_journal_from_item (gpointer data, gpointer user_data)
 {
   SwCacheable *cacheable = data;
-  GKeyFile *keys = user_data;
+  JournalWriter *writer = user_data;
+  const char *id;
+  guint64 *old_digest;
+  guint64 digest;
+  guint32 type;
+  JournalOp op;
+
+  if (!get_digest (cacheable, &digest))
+    return;
+
+  id = sw_cacheable_get_id (cacheable);
+  digests_insert (writer->digests, id, digest);
+
+  old_digest = g_hash_table_lookup (writer->state->digests, id);
+  if (old_digest == NULL) {
+    op = JOURNAL_ADD;
+  } else if (*old_digest != digest) {
+    op = JOURNAL_CHANGE;
+  } else {
+    /* Unchanged */
+    return;
+  }
+
+  journal_add_string (writer->payload, id);
+  foreach_cache_field (cacheable, &type, journal_add_field, writer);
+  journal_add_entry (writer, op, type);
+}
+
+/*
+ * Serialise the difference between what is on disk, as described by @state,
+ * and @set as journal entries.  @state is updated to describe the file after
+ * the entries have been appended.  Returns NULL if nothing changed.
+ */
+static guint8 *
+write_journal (CacheState *state, SwSet *set, gsize *length)
+{
+  JournalWriter writer;
+  GHashTableIter iter;
+  const char *id;
+
+  writer.journal = g_byte_array_new ();
+  writer.payload = g_byte_array_new ();
+  writer.n_fields = 0;
+  writer.digests = digests_new ();
+  writer.state = state;
+
+  sw_set_foreach (set, add_journal_from_item, &writer);
+
+  /* Anything we had before that isn't in the set any more was removed */
+  g_hash_table_iter_init (&iter, state->digests);
+  while (g_hash_table_iter_next (&iter, (gpointer)&id, NULL)) {
+    if (!g_hash_table_lookup_extended (writer.digests, id, NULL, NULL)) {
+      journal_add_string (writer.payload, id);
+      journal_add_entry (&writer, JOURNAL_REMOVE, CACHE_RECORD_ITEM);
+    }
+  }
+
+  g_hash_table_unref (state->digests);
+  state->digests = writer.digests;
+
+  g_byte_array_free (writer.payload, TRUE);
+
+  *length = writer.journal->len;
+  state->journal_size += *length;
+
+  if (*length == 0) {
+    g_byte_array_free (writer.journal, TRUE);
+    return NULL;
+  }
+
+  return g_byte_array_free (writer.journal, FALSE);
+}
+
+/*
+ * Write-behind cache writer.
+ *
+ * Saves are not written immediately.  Instead the latest set for each cache
+ * file is held for CACHE_WRITE_DELAY seconds so that repeated saves of the
+ * same query coalesce into one write.  When the delay expires the set is
+ * serialised (items aren't thread-safe, so this happens in the main loop) and
+ * the resulting buffer is handed to a single writer thread which does the
+ * blocking write.  Using a single thread keeps writes to the same file in
+ * order.  Until the writer has finished with a file, loads of it are answered
+ * from the set that is being written rather than waiting for the disk.
+ */
+
+#define CACHE_WRITE_DELAY 5
+
+typedef struct {
+  char *filename;
+  /* The latest set saved for this file, or NULL to remove the file */
+  SwSet *set;
+} PendingWrite;
+
+typedef struct {
+  char *filename;
+  /* Serialised cache, or NULL to remove the file */
+  guint8 *data;
+  gsize length;
+  /* Whether @data is journal entries to append rather than a snapshot */
+  gboolean append;
+  /* Serial number if the job is tracked in queued_files, otherwise 0 */
+  guint serial;
+} WriteJob;
+
+typedef struct {
+  /* The set being written, or NULL if the file is being removed */
+  SwSet *set;
+  /* Serial number of the last job queued for this file */
+  guint serial;
+} QueuedFile;
+
+typedef struct {
+  char *filename;
+  guint serial;
+} WriteDone;
+
+/* Hash of cache filename to PendingWrite */
+static GHashTable *pending_writes = NULL;
+static guint pending_timeout_id = 0;
+static GThreadPool *writer_pool = NULL;
+/* Hash of cache filename to QueuedFile, for files the writer hasn't finished */
+static GHashTable *queued_files = NULL;
+static guint write_serial = 0;
+
+static void cache_index_written (const char *filename,
+                                 gsize       length,
+                                 gboolean    append);
+static void cache_index_save (void);
+static SwSet *copy_set (SwService *service, SwSet *set, SwSet *copy);
+
+static void
+pending_write_free (PendingWrite *pending)
+{
+  if (pending->set)
+    sw_set_unref (pending->set);
+  g_free (pending->filename);
+  g_slice_free (PendingWrite, pending);
+}
+
+/*
+ * Called in the main loop when a write failed, so that the next save rewrites
+ * the whole file instead of appending to something we don't know about.
+ */
+static gboolean
+write_failed_cb (gpointer user_data)
+{
+  char *filename = user_data;
+
+  set_cache_state (filename, NULL);
+  g_free (filename);
+
+  return FALSE;
+}
+
+static void
+queued_file_free (QueuedFile *queued)
+{
+  if (queued->set)
+    sw_set_unref (queued->set);
+  g_slice_free (QueuedFile, queued);
+}
+
+/*
+ * Remember that @job is going to replace the contents of its file with @set,
+ * or remove the file if @set is NULL.
+ */
+static void
+track_write_job (WriteJob *job, SwSet *set)
+{
+  QueuedFile *queued;
+
+  if (queued_files == NULL)
+    queued_files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                          (GDestroyNotify)queued_file_free);
+
+  if (++write_serial == 0)
+    write_serial = 1;
+
+  queued = g_slice_new0 (QueuedFile);
+  queued->set = set ? sw_set_ref (set) : NULL;
+  queued->serial = job->serial = write_serial;
+
+  g_hash_table_replace (queued_files, g_strdup (job->filename), queued);
+}
+
+/*
+ * Called in the main loop when the writer has finished a tracked job.  As
+ * there is only one writer, once the last job queued for a file is done the
+ * file on disk is up to date.
+ */
+static gboolean
+write_done_cb (gpointer user_data)
+{
+  WriteDone *done = user_data;
+  QueuedFile *queued = NULL;
+
+  if (queued_files)
+    queued = g_hash_table_lookup (queued_files, done->filename);
+
+  if (queued && queued->serial == done->serial)
+    g_hash_table_remove (queued_files, done->filename);
+
+  g_free (done->filename);
+  g_slice_free (WriteDone, done);
+
+  return FALSE;
+}
+
+static gboolean
+append_to_file (const char *filename, const guint8 *data, gsize length)
+{
+  FILE *f;
+  gboolean ret;
+
+  f = g_fopen (filename, "ab");
+  if (f == NULL)
+    return FALSE;
+
+  ret = (fwrite (data, 1, length, f) == length);
+
+  if (fclose (f) != 0)
+    ret = FALSE;
+
+  return ret;
+}
+
+static void
+writer_thread_func (gpointer data, gpointer user_data)
+{
+  WriteJob *job = data;
+  GError *error = NULL;
+
+  if (job->data == NULL) {
+    g_remove (job->filename);
+  } else if (job->append) {
+    if (!append_to_file (job->filename, job->data, job->length)) {
+      g_message ("Cannot append to cache %s: %s", job->filename,
+                 g_strerror (errno));
+      g_idle_add (write_failed_cb, g_strdup (job->filename));
+    }
+  } else if (!g_file_set_contents (job->filename, (const char *)job->data,
+                                   job->length, &error)) {
+    g_message ("Cannot write cache: %s", error->message);
+    g_error_free (error);
+    g_idle_add (write_failed_cb, g_strdup (job->filename));
+  }
+
+  if (job->serial) {
+    WriteDone *done;
+
+    done = g_slice_new (WriteDone);
+    done->filename = job->filename;
+    done->serial = job->serial;
+    g_idle_add (write_done_cb, done);
+  } else {
+    g_free (job->filename);
+  }
+
+  g_free (job->data);
+  g_slice_free (WriteJob, job);
+}
+
+/*
+ * Queue @job on the writer thread, taking ownership of it.
+ */
+static void
+push_write_job (WriteJob *job)
+{
+  if (writer_pool == NULL) {
+    GError *error = NULL;
+
+    writer_pool = g_thread_pool_new (writer_thread_func, NULL,
+                                     1, FALSE, &error);
+    if (writer_pool == NULL) {
+      g_message ("Cannot create cache writer: %s", error->message);
+      g_error_free (error);
+      /* Write it now instead */
+      writer_thread_func (job, NULL);
+      return;
+    }
+  }
+
+  g_thread_pool_push (writer_pool, job, NULL);
+}
+
+/*
+ * Remove @filename on the writer thread, so that it is ordered after any
+ * writes to it that are already queued.  Takes ownership of @filename.
+ */
+static void
+queue_remove_file (char *filename)
+{
+  WriteJob *job;
+
+  job = g_slice_new0 (WriteJob);
+  job->filename = filename;
+  track_write_job (job, NULL);
+  push_write_job (job);
+}
+
+/*
+ * Serialise @pending and queue it on the writer thread.  Takes ownership of
+ * @pending.
+ */
+static void
+queue_pending_write (PendingWrite *pending)
+{
+  CacheState *state;
+  WriteJob *job;
+
+  job = g_slice_new0 (WriteJob);
+  job->filename = pending->filename;
+  pending->filename = NULL;
+
+  state = get_cache_state (job->filename);
+
+  if (pending->set == NULL || sw_set_is_empty (pending->set)) {
+    set_cache_state (job->filename, NULL);
+  } else if (state && state->journal_size <= state->base_size) {
+    job->data = write_journal (state, pending->set, &job->length);
+    job->append = TRUE;
+
+    if (job->data == NULL) {
+      /* Nothing has changed since the last write */
+      pending_write_free (pending);
+      g_free (job->filename);
+      g_slice_free (WriteJob, job);
+      return;
+    }
+  } else {
+    /* No journal yet, or it has grown too big: write a new snapshot */
+    state = g_slice_new0 (CacheState);
+    state->digests = digests_new ();
+    job->data = write_binary_cache (pending->set, &job->length,
+                                    state->digests);
+    state->base_size = job->length;
+    set_cache_state (job->filename, state);
+  }
+
+  track_write_job (job, job->data ? pending->set : NULL);
+  pending_write_free (pending);
+
+  cache_index_written (job->filename, job->length, job->append);
+
+  push_write_job (job);
+}
+
+static gboolean
+queue_pending_writes_foreach (gpointer key,
+                              gpointer value,
+                              gpointer user_data)
+{
+  queue_pending_write (value);
+
+  return TRUE;
+}
+
+static gboolean
+pending_timeout_cb (gpointer user_data)
+{
+  if (pending_writes)
+    g_hash_table_foreach_steal (pending_writes,
+                                queue_pending_writes_foreach,
+                                NULL);
+
+  cache_index_save ();
+
+  pending_timeout_id = 0;
+
+  return FALSE;
+}
+
+/*
+ * Make sure that the pending writes will be written out soon.
+ */
+static void
+schedule_pending_writes (void)
+{
+  if (!pending_timeout_id)
+    pending_timeout_id = g_timeout_add_seconds (CACHE_WRITE_DELAY,
+                                                pending_timeout_cb,
+                                                NULL);
+}
+
+/*
+ * Discard the pending write for @filename, if there is one.
+ */
+static void
+cancel_pending_write (const char *filename)
+{
+  if (pending_writes)
+    g_hash_table_remove (pending_writes, filename);
+}
+
+/*
+ * Block until the writer thread has finished every queued write.
+ */
+static void
+wait_for_writes (void)
+{
+  if (writer_pool) {
+    g_thread_pool_free (writer_pool, FALSE, TRUE);
+    writer_pool = NULL;
+  }
+
+  if (queued_files)
+    g_hash_table_remove_all (queued_files);
+}
+
+/*
+ * If there is a save or removal of @filename that hasn't reached the disk
+ * yet, set @set to new items for @service made from what will be written (or
+ * NULL if the file is being removed) and return TRUE.
+ */
+static gboolean
+get_unwritten_set (SwService  *service,
+                   const char *filename,
+                   SwSet* (*set_constr)(),
+                   SwSet     **set)
+{
+  PendingWrite *pending = NULL;
+  QueuedFile *queued = NULL;
+  SwSet *latest;
+
+  if (pending_writes)
+    pending = g_hash_table_lookup (pending_writes, filename);
+  if (pending == NULL && queued_files)
+    queued = g_hash_table_lookup (queued_files, filename);
+
+  if (pending)
+    latest = pending->set;
+  else if (queued)
+    latest = queued->set;
+  else
+    return FALSE;
+
+  *set = NULL;
+  if (latest && !sw_set_is_empty (latest)) {
+    *set = copy_set (service, latest, set_constr ());
+
+    if (sw_set_is_empty (*set)) {
+      sw_set_unref (*set);
+      *set = NULL;
+    }
+  }
+
+  return TRUE;
+}
+
+/*
+ * Cache index.
+ *
+ * Every cache file has an entry in the index recording its size and when it
+ * was last used.  The index is kept in memory and written back along with the
+ * cache files.  It is used to keep the total size of the cache files under a
+ * budget by evicting the least recently used ones, and to answer loads for
+ * queries that were never cached without touching the disk.
+ *
+ * The index file is a line per cache file of "<size> <last access> <name>".
+ * When it is loaded the cache directory is scanned once for files it doesn't
+ * know about, for example because we exited before it was written, and after
+ * that the index is trusted: a miss means there is no file.  Last accesses
+ * are only recorded to the nearest CACHE_INDEX_TOUCH_INTERVAL, and are
+ * written out with the next cache save rather than on their own.
+ */
+
+#define CACHE_INDEX_NAME "index"
+#define CACHE_DEFAULT_MAX_SIZE (16 * 1024 * 1024)
+/* Seconds before a new last access is worth writing out */
+#define CACHE_INDEX_TOUCH_INTERVAL (60 * 60)
+
+typedef struct {
+  gsize size;
+  time_t last_access;
+} CacheIndexEntry;
+
+/* Hash of cache file basename to CacheIndexEntry */
+static GHashTable *cache_index = NULL;
+static gsize cache_index_total = 0;
+static gboolean cache_index_dirty = FALSE;
+static gsize cache_max_size = CACHE_DEFAULT_MAX_SIZE;
+
+static void
+cache_index_entry_free (CacheIndexEntry *entry)
+{
+  g_slice_free (CacheIndexEntry, entry);
+}
+
+static void
+cache_index_set (const char *name, gsize size, time_t last_access)
+{
+  CacheIndexEntry *entry;
+
+  entry = g_hash_table_lookup (cache_index, name);
+  if (entry) {
+    cache_index_total -= entry->size;
+  } else {
+    entry = g_slice_new0 (CacheIndexEntry);
+    g_hash_table_insert (cache_index, g_strdup (name), entry);
+  }
+
+  entry->size = size;
+  entry->last_access = last_access;
+  cache_index_total += size;
+
+  cache_index_dirty = TRUE;
+}
+
+static void
+cache_index_remove (const char *name)
+{
+  CacheIndexEntry *entry;
+
+  entry = g_hash_table_lookup (cache_index, name);
+  if (entry) {
+    cache_index_total -= entry->size;
+    g_hash_table_remove (cache_index, name);
+    cache_index_dirty = TRUE;
+  }
+}
+
+static void
+cache_index_parse (const char *contents)
+{
+  char **lines, **line;
+
+  lines = g_strsplit (contents, "\n", 0);
+
+  for (line = lines; *line; line++) {
+    char **tokens;
+
+    tokens = g_strsplit (*line, " ", 3);
+    if (g_strv_length (tokens) == 3)
+      cache_index_set (tokens[2],
+                       g_ascii_strtoull (tokens[0], NULL, 10),
+                       g_ascii_strtoull (tokens[1], NULL, 10));
+    g_strfreev (tokens);
+  }
+
+  g_strfreev (lines);
+}
+
+/*
+ * Add the files in @path that the index doesn't know about to it.
+ */
+static void
+cache_index_scan (const char *path)
+{
+  const char *name;
+  GDir *dir;
 
-  sw_cacheable_save_into_cache (cacheable, keys);
+  dir = g_dir_open (path, 0, NULL);
+  if (dir == NULL)
+    return;
+
+  while ((name = g_dir_read_name (dir)) != NULL) {
+    char *filename;
+    struct stat st;
+
+    if (g_str_equal (name, CACHE_INDEX_NAME) ||
+        g_hash_table_lookup (cache_index, name))
+      continue;
+
+    filename = g_build_filename (path, name, NULL);
+    if (g_stat (filename, &st) == 0 && S_ISREG (st.st_mode))
+      cache_index_set (name, st.st_size, st.st_atime);
+    g_free (filename);
+  }
+
+  g_dir_close (dir);
+}
+
+static void
+ensure_cache_index (void)
+{
+  char *filename, *contents;
+
+  if (cache_index)
+    return;
+
+  cache_index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                       (GDestroyNotify)cache_index_entry_free);
+
+  filename = g_build_filename (get_cache_dir (), CACHE_INDEX_NAME, NULL);
+
+  if (g_file_get_contents (filename, &contents, NULL, NULL)) {
+    cache_index_parse (contents);
+    g_free (contents);
+    cache_index_dirty = FALSE;
+  }
+
+  cache_index_scan (get_cache_dir ());
+
+  g_free (filename);
+}
+
+/*
+ * Queue the index to be written out if it has changed.
+ */
+static void
+cache_index_save (void)
+{
+  GHashTableIter iter;
+  CacheIndexEntry *entry;
+  const char *name;
+  GString *string;
+  WriteJob *job;
+
+  if (cache_index == NULL || !cache_index_dirty)
+    return;
+
+  string = g_string_new (NULL);
+
+  g_hash_table_iter_init (&iter, cache_index);
+  while (g_hash_table_iter_next (&iter, (gpointer)&name, (gpointer)&entry))
+    g_string_append_printf (string, "%" G_GSIZE_FORMAT " %lu %s\n",
+                            entry->size, (gulong)entry->last_access, name);
+
+  job = g_slice_new0 (WriteJob);
+  job->filename = g_build_filename (get_cache_dir (), CACHE_INDEX_NAME, NULL);
+  job->length = string->len;
+  job->data = (guint8 *)g_string_free (string, FALSE);
+
+  /* An empty index is still an index */
+  if (job->length == 0) {
+    g_free (job->data);
+    job->data = (guint8 *)g_strdup ("");
+  }
+
+  push_write_job (job);
+
+  cache_index_dirty = FALSE;
+}
+
+static gint
+compare_last_access (gconstpointer a, gconstpointer b)
+{
+  const CacheIndexEntry *entry_a = g_hash_table_lookup (cache_index, a);
+  const CacheIndexEntry *entry_b = g_hash_table_lookup (cache_index, b);
+
+  if (entry_a->last_access < entry_b->last_access)
+    return -1;
+  else if (entry_a->last_access > entry_b->last_access)
+    return 1;
+  else
+    return 0;
+}
+
+/*
+ * Return the names of the least recently used cache files that need to be
+ * removed to bring the total size under @max_size, oldest first.  @keep is
+ * never returned.
+ */
+static GList *
+cache_index_get_evictions (gsize max_size, const char *keep)
+{
+  GList *names, *l, *evictions = NULL;
+  gsize total = cache_index_total;
+
+  if (total <= max_size)
+    return NULL;
+
+  names = g_hash_table_get_keys (cache_index);
+  names = g_list_sort (names, compare_last_access);
+
+  for (l = names; l && total > max_size; l = l->next) {
+    CacheIndexEntry *entry;
+
+    if (keep && g_str_equal (l->data, keep))
+      continue;
+
+    entry = g_hash_table_lookup (cache_index, l->data);
+    total -= entry->size;
+    evictions = g_list_prepend (evictions, g_strdup (l->data));
+  }
+
+  g_list_free (names);
+
+  return g_list_reverse (evictions);
+}
+
+/*
+ * Remove cache files until the total size is within the budget, keeping
+ * the file called @keep.
+ */
+static void
+cache_index_enforce_budget (const char *keep)
+{
+  GList *evictions;
+
+  evictions = cache_index_get_evictions (cache_max_size, keep);
+
+  while (evictions) {
+    char *name = evictions->data;
+    char *filename;
+
+    filename = g_build_filename (get_cache_dir (), name, NULL);
+
+    if (pending_writes)
+      g_hash_table_remove (pending_writes, filename);
+    set_cache_state (filename, NULL);
+    cache_index_remove (name);
+
+    queue_remove_file (filename);
+
+    g_free (name);
+    evictions = g_list_delete_link (evictions, evictions);
+  }
+}
+
+/*
+ * Update the index after @length bytes were queued to be written to
+ * @filename, or appended if @append is set.  A length of zero means that the
+ * file is being removed.
+ */
+static void
+cache_index_written (const char *filename, gsize length, gboolean append)
+{
+  CacheIndexEntry *entry;
+  char *name;
+
+  ensure_cache_index ();
+
+  name = g_path_get_basename (filename);
+
+  if (length == 0) {
+    cache_index_remove (name);
+  } else {
+    if (append && (entry = g_hash_table_lookup (cache_index, name)))
+      length += entry->size;
+
+    cache_index_set (name, length, time (NULL));
+    cache_index_enforce_budget (name);
+  }
+
+  g_free (name);
+}
+
+/*
+ * Look up @filename in the index, marking it as used.  Returns FALSE if there
+ * is no such cache file.
+ */
+static gboolean
+cache_index_lookup (const char *filename)
+{
+  CacheIndexEntry *entry;
+  time_t now;
+  char *name;
+
+  ensure_cache_index ();
+
+  name = g_path_get_basename (filename);
+  entry = g_hash_table_lookup (cache_index, name);
+  g_free (name);
+
+  if (entry == NULL)
+    return FALSE;
+
+  now = time (NULL);
+  if (entry->last_access + CACHE_INDEX_TOUCH_INTERVAL < now)
+    cache_index_dirty = TRUE;
+  entry->last_access = now;
+
+  return TRUE;
+}
+
+/**
+ * sw_cache_set_max_size:
+ * @max_size: the maximum size in bytes
+ *
+ * Set the maximum total size of all of the cache files.  When the caches
+ * grow beyond this the least recently used ones are removed.
+ */
+void
+sw_cache_set_max_size (gsize max_size)
+{
+  cache_max_size = max_size;
+
+  ensure_cache_index ();
+  cache_index_enforce_budget (NULL);
 }
 
 /**
@@ -124,7 +1307,9 @@ set_keyfile_from_item (gpointer data, gpointer user_data)
  * differentiate between different service functionality
  * @set: The set of items to cache
  *
- * Cache the items in @set to disk.
+ * Cache the items in @set to disk.  The items are copied as they are now, and
+ * written in the background a short while later.  Further saves for the same
+ * query in the meantime replace this one.
  */
 void
 sw_cache_save (SwService   *service,
@@ -132,6 +1317,7 @@ sw_cache_save (SwService   *service,
                GHashTable  *params,
                SwSet       *set)
 {
+  PendingWrite *pending;
   char *filename;
 
   g_return_if_fail (SW_IS_SERVICE (service));
@@ -141,26 +1327,50 @@ sw_cache_save (SwService   *service,
 
   filename = get_cache_filename (service, query, params);
 
-  if (set == NULL || sw_set_is_empty (set)) {
-    g_remove (filename);
+  if (pending_writes == NULL)
+    pending_writes = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                            (GDestroyNotify)pending_write_free);
+
+  pending = g_hash_table_lookup (pending_writes, filename);
+  if (pending) {
+    g_free (filename);
+
+    if (pending->set)
+      sw_set_unref (pending->set);
   } else {
-    GKeyFile *keys;
-    char *data;
-    GError *error = NULL;
+    pending = g_slice_new0 (PendingWrite);
+    pending->filename = filename;
+    g_hash_table_insert (pending_writes, pending->filename, pending);
+  }
 
-    keys = g_key_file_new ();
-    sw_set_foreach (set, set_keyfile_from_item, keys);
+  /* Later changes to the items mustn't change what is written */
+  pending->set = set ? copy_set (service, set, sw_set_new ()) : NULL;
 
-    data = g_key_file_to_data (keys, NULL, NULL);
-    if (!g_file_set_contents (filename, data, -1, &error)) {
-      g_message ("Cannot write cache: %s", error->message);
-      g_error_free (error);
-    }
-    g_free (data);
-    g_key_file_free (keys);
+  schedule_pending_writes ();
+}
+
+/**
+ * sw_cache_flush:
+ *
+ * Write out every cache save that is still pending and wait for the writes
+ * to finish.  This should be called before the process exits.
+ */
+void
+sw_cache_flush (void)
+{
+  if (pending_timeout_id) {
+    g_source_remove (pending_timeout_id);
+    pending_timeout_id = 0;
   }
 
-  g_free (filename);
+  if (pending_writes)
+    g_hash_table_foreach_steal (pending_writes,
+                                queue_pending_writes_foreach,
+                                NULL);
+
+  cache_index_save ();
+
+  wait_for_writes ();
 }
 
 /*
@@ -231,36 +1441,364 @@ load_item_from_keyfile (SwService  *service,
   return cacheable;
 }
 
-/**
- * sw_cache_load:
- * @service: The service to read the cache for
- * @query: The query for this cache
- * @params: A set of parameters (strings) that can be used by the service to
- * differentiate between different service functionality
- *
- * Load the cache for @service from disk, returning a #SwSet if there was a
- * cache.
+/*
+ * Check that the mapped data is a binary cache that we can read, returning
+ * the header if it is.  @base_size is set to the size of the snapshot; any
+ * data after that is the journal.
  */
-SwSet *
-sw_cache_load (SwService   *service,
-               const gchar *query,
-               GHashTable  *params,
-               SwSet* (*set_constr)())
+static const CacheHeader *
+get_binary_header (const char *data, gsize length, gsize *base_size)
 {
-  char *filename;
-  GKeyFile *keys;
-  SwSet *set = NULL;
+  const CacheHeader *header;
+  guint64 expected;
 
-  g_return_val_if_fail (SW_IS_SERVICE (service), NULL);
+  if (length < sizeof (CacheHeader))
+    return NULL;
 
-  if (query == NULL)
-    query = "feed";
+  header = (const CacheHeader *)data;
 
-  keys = g_key_file_new ();
+  if (memcmp (header->magic, CACHE_MAGIC, sizeof (CACHE_MAGIC)) != 0)
+    return NULL;
 
-  filename = get_cache_filename (service, query, params);
+  if (header->byte_order != CACHE_BYTE_ORDER ||
+      header->version != CACHE_VERSION) {
+    g_message ("Ignoring cache with unsupported version %u", header->version);
+    return NULL;
+  }
+
+  expected = sizeof (CacheHeader)
+    + (guint64)header->n_records * sizeof (CacheRecord)
+    + (guint64)header->n_fields * sizeof (CacheField)
+    + header->strings_size;
+
+  if (expected > length ||
+      header->strings_size == 0 ||
+      data[expected - 1] != '\0') {
+    g_message ("Ignoring truncated or corrupt cache");
+    return NULL;
+  }
+
+  *base_size = expected;
+
+  return header;
+}
+
+static SwCacheable *
+cacheable_new (SwService *service, guint32 type)
+{
+  SwCacheable *cacheable;
+
+  switch (type) {
+  case CACHE_RECORD_ITEM:
+    cacheable = SW_CACHEABLE (sw_item_new ());
+    sw_item_set_service (SW_ITEM (cacheable), service);
+    return cacheable;
+  case CACHE_RECORD_CONTACT:
+    cacheable = SW_CACHEABLE (sw_contact_new ());
+    sw_contact_set_service (SW_CONTACT (cacheable), service);
+    return cacheable;
+  default:
+    return NULL;
+  }
+}
+
+static void
+cacheable_put (SwCacheable *cacheable, const char *key, const char *value)
+{
+  if (SW_IS_ITEM (cacheable)) {
+    char *new_value;
+
+    /*
+     * Make the cached relative paths absolute so that the client doesn't
+     * have to know any internal details.
+     */
+    new_value = make_absolute_path (key, value);
+    if (new_value)
+      sw_item_take (SW_ITEM (cacheable), key, new_value);
+    else
+      sw_item_put (SW_ITEM (cacheable), key, value);
+  } else {
+    sw_contact_put (SW_CONTACT (cacheable), key, value);
+  }
+}
+
+static void
+copy_field (const char *key, const char *value, gpointer user_data)
+{
+  cacheable_put (user_data, key, value);
+}
+
+typedef struct {
+  SwService *service;
+  SwSet *copy;
+} CopyClosure;
+
+/*
+ * Add a new item or contact to the set in @user_data with the cached form of
+ * @data, as if it had been written to the cache and loaded again.
+ */
+static void
+copy_cacheable (gpointer data, gpointer user_data)
+{
+  SwCacheable *cacheable = data;
+  CopyClosure *closure = user_data;
+  SwCacheable *copy;
+  guint32 type;
+
+  if (sw_cacheable_get_id (cacheable) == NULL ||
+      sw_service_is_uid_banned (closure->service,
+                                sw_cacheable_get_id (cacheable)))
+    return;
+
+  copy = cacheable_new (closure->service,
+                        SW_IS_ITEM (cacheable) ?
+                        CACHE_RECORD_ITEM : CACHE_RECORD_CONTACT);
+
+  if (foreach_cache_field (cacheable, &type, copy_field, copy)) {
+    cacheable_put (copy, "cached", "1");
+    sw_set_add (closure->copy, (GObject *)copy);
+  }
+
+  g_object_unref (copy);
+}
+
+/*
+ * Add copies of the items in @set for @service to @copy, and return @copy.
+ * The copies don't share any state with the originals.
+ */
+static SwSet *
+copy_set (SwService *service, SwSet *set, SwSet *copy)
+{
+  CopyClosure closure = { service, copy };
+
+  sw_set_foreach (set, copy_cacheable, &closure);
+
+  return copy;
+}
+
+/*
+ * From the binary cache @record create a new #SwItem or #SwContact for
+ * @service.  Returns NULL if the record is invalid or the item is banned.
+ */
+static SwCacheable *
+load_item_from_record (SwService         *service,
+                       const CacheHeader *header,
+                       const CacheRecord *record,
+                       const CacheField  *fields,
+                       const char        *strings)
+{
+  SwCacheable *cacheable;
+  guint32 i;
+
+  if (record->id >= header->strings_size ||
+      record->first_field > header->n_fields ||
+      record->n_fields > header->n_fields - record->first_field)
+    return NULL;
+
+  /* Check the ban list before creating anything */
+  if (sw_service_is_uid_banned (service, strings + record->id))
+    return NULL;
+
+  cacheable = cacheable_new (service, record->type);
+  if (cacheable == NULL)
+    return NULL;
+
+  for (i = record->first_field; i < record->first_field + record->n_fields; i++) {
+    if (fields[i].key >= header->strings_size ||
+        fields[i].value >= header->strings_size)
+      continue;
+
+    cacheable_put (cacheable,
+                   strings + fields[i].key,
+                   strings + fields[i].value);
+  }
+
+  /* Set a magic field saying that this item is cached */
+  cacheable_put (cacheable, "cached", "1");
+
+  return cacheable;
+}
+
+/*
+ * Return the start of the string following the one at @p, or NULL if the
+ * string at @p isn't terminated before @end.
+ */
+static const char *
+next_string (const char *p, const char *end)
+{
+  const char *nul;
+
+  if (p >= end)
+    return NULL;
+
+  nul = memchr (p, '\0', end - p);
+
+  return nul ? nul + 1 : NULL;
+}
+
+/*
+ * Apply the journal entry with @payload to @items, a hash of id to
+ * #SwCacheable.  Returns FALSE if the entry is malformed.
+ */
+static gboolean
+replay_journal_entry (SwService          *service,
+                      const JournalEntry *entry,
+                      const char         *payload,
+                      GHashTable         *items)
+{
+  const char *end = payload + entry->length;
+  const char *id, *p;
+  SwCacheable *cacheable;
+  guint32 i;
+
+  id = payload;
+  p = next_string (id, end);
+  if (p == NULL)
+    return FALSE;
+
+  if (entry->op == JOURNAL_REMOVE) {
+    g_hash_table_remove (items, id);
+    return TRUE;
+  }
+
+  if (entry->op != JOURNAL_ADD && entry->op != JOURNAL_CHANGE)
+    return FALSE;
+
+  cacheable = cacheable_new (service, entry->type);
+  if (cacheable == NULL)
+    return FALSE;
+
+  for (i = 0; i < entry->n_fields; i++) {
+    const char *key = p, *value;
+
+    value = next_string (key, end);
+    p = value ? next_string (value, end) : NULL;
+    if (p == NULL) {
+      g_object_unref (cacheable);
+      return FALSE;
+    }
+
+    cacheable_put (cacheable, key, value);
+  }
+
+  cacheable_put (cacheable, "cached", "1");
+
+  if (sw_service_is_uid_banned (service, id))
+    g_object_unref (cacheable);
+  else
+    g_hash_table_replace (items, g_strdup (id), cacheable);
+
+  return TRUE;
+}
+
+/*
+ * Load the snapshot described by @header and replay the journal that follows
+ * it.  If @state is not NULL it is set to a description of the file contents
+ * for appending further journal entries.
+ */
+static SwSet *
+load_binary_cache (SwService         *service,
+                   const CacheHeader *header,
+                   gsize              base_size,
+                   gsize              length,
+                   SwSet* (*set_constr)(),
+                   CacheState       **state)
+{
+  const CacheRecord *records;
+  const CacheField *fields;
+  const char *strings, *data;
+  GHashTable *items;
+  GHashTableIter iter;
+  gpointer value;
+  gboolean torn = FALSE;
+  gsize offset;
+  SwSet *set;
+  guint32 i;
+
+  data = (const char *)header;
+  records = (const CacheRecord *)(header + 1);
+  fields = (const CacheField *)(records + header->n_records);
+  strings = (const char *)(fields + header->n_fields);
+
+  items = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                 g_free, g_object_unref);
+
+  for (i = 0; i < header->n_records; i++) {
+    SwCacheable *item;
+
+    /* May be null if it's banned */
+    item = load_item_from_record (service, header, &records[i],
+                                  fields, strings);
+    if (item)
+      g_hash_table_replace (items,
+                            g_strdup (sw_cacheable_get_id (item)),
+                            item);
+  }
+
+  offset = base_size;
+  while (offset < length) {
+    JournalEntry entry;
+
+    /* The entry may have been cut short by a crash while appending */
+    if (length - offset < sizeof (entry)) {
+      torn = TRUE;
+      break;
+    }
+
+    memcpy (&entry, data + offset, sizeof (entry));
+    offset += sizeof (entry);
+
+    if (entry.length > length - offset ||
+        !replay_journal_entry (service, &entry, data + offset, items)) {
+      torn = TRUE;
+      break;
+    }
+
+    offset += entry.length;
+  }
+
+  if (state) {
+    *state = g_slice_new0 (CacheState);
+    (*state)->digests = digests_new ();
+    (*state)->base_size = base_size;
+    /* Force a new snapshot rather than appending after garbage */
+    (*state)->journal_size = torn ? G_MAXSIZE : length - base_size;
+  }
+
+  set = NULL;
+  if (g_hash_table_size (items) > 0)
+    set = set_constr ();
+
+  g_hash_table_iter_init (&iter, items);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    guint64 digest;
 
-  if (g_key_file_load_from_file (keys, filename, G_KEY_FILE_NONE, NULL)) {
+    if (state && get_digest (value, &digest))
+      digests_insert ((*state)->digests, sw_cacheable_get_id (value), digest);
+
+    sw_set_add (set, value);
+  }
+
+  g_hash_table_unref (items);
+
+  return set;
+}
+
+/*
+ * Fallback reader for caches written before the binary format existed.
+ */
+static SwSet *
+load_keyfile_cache (SwService  *service,
+                    const char *data,
+                    gsize       length,
+                    SwSet* (*set_constr)())
+{
+  GKeyFile *keys;
+  SwSet *set = NULL;
+
+  keys = g_key_file_new ();
+
+  if (g_key_file_load_from_data (keys, data, length, G_KEY_FILE_NONE, NULL)) {
     char **groups;
     gsize i, count;
 
@@ -284,10 +1822,85 @@ sw_cache_load (SwService   *service,
     }
 
     g_strfreev (groups);
-
   }
 
   g_key_file_free (keys);
+
+  return set;
+}
+
+/**
+ * sw_cache_load:
+ * @service: The service to read the cache for
+ * @query: The query for this cache
+ * @params: A set of parameters (strings) that can be used by the service to
+ * differentiate between different service functionality
+ *
+ * Load the cache for @service from disk, returning a #SwSet if there was a
+ * cache.
+ */
+SwSet *
+sw_cache_load (SwService   *service,
+               const gchar *query,
+               GHashTable  *params,
+               SwSet* (*set_constr)())
+{
+  char *filename;
+  GMappedFile *map;
+  SwSet *set = NULL;
+
+  g_return_val_if_fail (SW_IS_SERVICE (service), NULL);
+
+  if (query == NULL)
+    query = "feed";
+
+  filename = get_cache_filename (service, query, params);
+
+  /* Don't read a file which is about to be replaced, use what will be in it */
+  if (get_unwritten_set (service, filename, set_constr, &set)) {
+    cache_index_lookup (filename);
+    g_free (filename);
+    return set;
+  }
+
+  /* If the index doesn't know about it then there is nothing to load */
+  if (!cache_index_lookup (filename)) {
+    g_free (filename);
+    return NULL;
+  }
+
+  map = g_mapped_file_new (filename, FALSE, NULL);
+  if (map) {
+    const char *data = g_mapped_file_get_contents (map);
+    gsize length = g_mapped_file_get_length (map);
+    const CacheHeader *header;
+    gsize base_size;
+
+    header = get_binary_header (data, length, &base_size);
+    if (header) {
+      CacheState *state;
+
+      set = load_binary_cache (service, header, base_size, length,
+                               set_constr, &state);
+
+      /*
+       * Remember what is on disk so that saves can append to it, unless we
+       * already know better because we have queued writes to it.
+       */
+      if (get_cache_state (filename) == NULL)
+        set_cache_state (filename, state);
+      else
+        cache_state_free (state);
+    } else if (length >= sizeof (CACHE_MAGIC) &&
+               memcmp (data, CACHE_MAGIC, sizeof (CACHE_MAGIC)) == 0) {
+      set = NULL;
+    } else {
+      set = load_keyfile_cache (service, data, length, set_constr);
+    }
+
+    g_mapped_file_unref (map);
+  }
+
   g_free (filename);
 
   return set;
@@ -316,9 +1929,49 @@ sw_cache_drop (SwService   *service,
 
   filename = get_cache_filename (service, query, params);
 
-  g_remove (filename);
+  /* Don't let a pending write bring the file back */
+  cancel_pending_write (filename);
+  set_cache_state (filename, NULL);
+  cache_index_written (filename, 0, FALSE);
+  schedule_pending_writes ();
 
-  g_free (filename);
+  queue_remove_file (filename);
+}
+
+/*
+ * Recalculate the total size after entries were removed behind our back.
+ */
+static void
+cache_index_recount (void)
+{
+  GHashTableIter iter;
+  CacheIndexEntry *entry;
+
+  cache_index_total = 0;
+
+  g_hash_table_iter_init (&iter, cache_index);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer)&entry))
+    cache_index_total += entry->size;
+
+  cache_index_dirty = TRUE;
+}
+
+/*
+ * Whether the cache filename @key is for the service prefix in @user_data.
+ */
+static gboolean
+pending_has_prefix (gpointer key,
+                    gpointer value,
+                    gpointer user_data)
+{
+  char *basename;
+  gboolean ret;
+
+  basename = g_path_get_basename (key);
+  ret = g_str_has_prefix (basename, user_data);
+  g_free (basename);
+
+  return ret;
 }
 
 /**
@@ -342,6 +1995,19 @@ sw_cache_drop_all (SwService *service)
                            "cache",
                            NULL);
 
+  prefix = g_strconcat (sw_service_get_name (service), "-", NULL);
+
+  /* Don't let a pending write bring any of the files back */
+  if (pending_writes)
+    g_hash_table_foreach_remove (pending_writes, pending_has_prefix, prefix);
+  if (cache_states)
+    g_hash_table_foreach_remove (cache_states, pending_has_prefix, prefix);
+  ensure_cache_index ();
+  if (g_hash_table_foreach_remove (cache_index, pending_has_prefix, prefix)) {
+    cache_index_recount ();
+    schedule_pending_writes ();
+  }
+
   if (!g_file_test (path, G_FILE_TEST_IS_DIR)) {
     /* No cache directory */
     goto done;
@@ -354,17 +2020,28 @@ sw_cache_drop_all (SwService *service)
     goto done;
   }
 
-  prefix = g_strconcat (sw_service_get_name (service), "-", NULL);
-
   while ((name = g_dir_read_name (dir)) != NULL) {
-    if (g_str_has_prefix (name, prefix)) {
-      char *filename = g_build_filename (path, name, NULL);
-      g_remove (filename);
-      g_free (filename);
-    }
+    if (g_str_has_prefix (name, prefix))
+      queue_remove_file (g_build_filename (path, name, NULL));
   }
 
+  g_dir_close (dir);
+
  done:
+  /* Files which are queued to be written but aren't on disk yet */
+  if (queued_files) {
+    GList *names, *l;
+
+    names = g_hash_table_get_keys (queued_files);
+    for (l = names; l; l = l->next) {
+      QueuedFile *queued = g_hash_table_lookup (queued_files, l->data);
+
+      if (queued->set && pending_has_prefix (l->data, NULL, prefix))
+        queue_remove_file (g_strdup (l->data));
+    }
+    g_list_free (names);
+  }
+
   g_free (prefix);
   g_free (path);
 }
@@ -372,6 +2049,7 @@ sw_cache_drop_all (SwService *service)
 #if BUILD_TESTS
 
 #include "test-runner.h"
+#include "services/dummy/dummy.h"
 
 void
 test_cache_relative (void)
@@ -416,4 +2094,398 @@ test_cache_absolute (void)
   expected = g_build_filename (g_get_user_cache_dir (), PACKAGE, "thumbnails", "abcd", NULL);
   g_assert_cmpstr (s, ==, expected);
 }
+
+void
+test_cache_binary (void)
+{
+  SwService *service;
+  SwSet *set, *loaded;
+  SwItem *item, *loaded_item;
+  SwContact *contact;
+  const CacheHeader *header;
+  guint8 *data;
+  gsize length, base_size;
+  GList *l;
+  char *thumbnail;
+
+  service = g_object_new (SW_TYPE_SERVICE_DUMMY, NULL);
+  thumbnail = g_build_filename (g_get_user_cache_dir (), PACKAGE, "thumbnails", "abcd", NULL);
+
+  set = sw_item_set_new ();
+  item = sw_item_new ();
+  sw_item_set_service (item, service);
+  sw_item_put (item, "id", "1234");
+  sw_item_put (item, "author", "Ross");
+  sw_item_put (item, "thumbnail", thumbnail);
+  sw_set_add (set, (GObject *)item);
+
+  data = write_binary_cache (set, &length, NULL);
+  header = get_binary_header ((const char *)data, length, &base_size);
+  g_assert (header != NULL);
+  g_assert_cmpint (header->n_records, ==, 1);
+  g_assert_cmpint (base_size, ==, length);
+
+  loaded = load_binary_cache (service, header, base_size, length,
+                              sw_item_set_new, NULL);
+  g_assert_cmpint (sw_set_size (loaded), ==, 1);
+  l = sw_set_as_list (loaded);
+  loaded_item = l->data;
+  g_assert_cmpstr (sw_item_get (loaded_item, "author"), ==, "Ross");
+  g_assert_cmpstr (sw_item_get (loaded_item, "cached"), ==, "1");
+  g_assert_cmpstr (sw_item_get (loaded_item, "thumbnail"), ==, thumbnail);
+  g_assert (sw_item_equal (item, loaded_item));
+  g_list_foreach (l, (GFunc)g_object_unref, NULL);
+  g_list_free (l);
+  sw_set_unref (loaded);
+
+  /* A truncated file must be rejected */
+  g_assert (get_binary_header ((const char *)data, length - 1, &base_size) == NULL);
+  g_free (data);
+
+  /* Multi-valued contact keys keep their order */
+  sw_set_unref (set);
+  set = sw_contact_set_new ();
+  contact = sw_contact_new ();
+  sw_contact_set_service (contact, service);
+  sw_contact_put (contact, "id", "ross");
+  sw_contact_put (contact, "email", "a@example.com");
+  sw_contact_put (contact, "email", "b@example.com");
+  sw_set_add (set, (GObject *)contact);
+
+  data = write_binary_cache (set, &length, NULL);
+  header = get_binary_header ((const char *)data, length, &base_size);
+  g_assert (header != NULL);
+
+  loaded = load_binary_cache (service, header, base_size, length,
+                              sw_contact_set_new, NULL);
+  g_assert (sw_set_has (loaded, (GObject *)contact));
+  l = sw_set_as_list (loaded);
+  g_assert (sw_contact_equal (contact, l->data));
+  g_list_foreach (l, (GFunc)g_object_unref, NULL);
+  g_list_free (l);
+  sw_set_unref (loaded);
+  g_free (data);
+
+  g_object_unref (item);
+  g_object_unref (contact);
+  sw_set_unref (set);
+  g_object_unref (service);
+  g_free (thumbnail);
+}
+
+static SwItem *
+make_test_item (SwService *service, const char *id, const char *content)
+{
+  SwItem *item;
+
+  item = sw_item_new ();
+  sw_item_set_service (item, service);
+  sw_item_put (item, "id", id);
+  sw_item_put (item, "content", content);
+
+  return item;
+}
+
+static SwItem *
+find_test_item (SwSet *set, const char *id)
+{
+  SwItem *found = NULL;
+  GList *l, *items;
+
+  items = sw_set_as_list (set);
+  for (l = items; l; l = l->next) {
+    if (g_str_equal (sw_item_get (l->data, "id"), id))
+      found = l->data;
+  }
+  g_list_foreach (items, (GFunc)g_object_unref, NULL);
+  g_list_free (items);
+
+  return found;
+}
+
+void
+test_cache_digest (void)
+{
+  SwService *service;
+  SwContact *a, *b;
+  SwItem *item;
+  guint64 digest_a, digest_b;
+
+  service = g_object_new (SW_TYPE_SERVICE_DUMMY, NULL);
+
+  /* Changing a value changes the digest */
+  item = make_test_item (service, "1", "one");
+  g_assert (get_digest (SW_CACHEABLE (item), &digest_a));
+  sw_item_put (item, "content", "uno");
+  g_assert (get_digest (SW_CACHEABLE (item), &digest_b));
+  g_assert (digest_a != digest_b);
+  sw_item_put (item, "content", "one");
+  g_assert (get_digest (SW_CACHEABLE (item), &digest_b));
+  g_assert (digest_a == digest_b);
+  g_object_unref (item);
+
+  /* So does changing the order of the values of a key */
+  a = sw_contact_new ();
+  sw_contact_set_service (a, service);
+  sw_contact_put (a, "id", "ross");
+  sw_contact_put (a, "email", "a@example.com");
+  sw_contact_put (a, "email", "b@example.com");
+
+  b = sw_contact_new ();
+  sw_contact_set_service (b, service);
+  sw_contact_put (b, "id", "ross");
+  sw_contact_put (b, "email", "b@example.com");
+  sw_contact_put (b, "email", "a@example.com");
+
+  g_assert (get_digest (SW_CACHEABLE (a), &digest_a));
+  g_assert (get_digest (SW_CACHEABLE (b), &digest_b));
+  g_assert (digest_a != digest_b);
+
+  g_object_unref (a);
+  g_object_unref (b);
+  g_object_unref (service);
+}
+
+void
+test_cache_journal (void)
+{
+  SwService *service;
+  SwSet *set, *loaded;
+  SwItem *item;
+  CacheState *state, *loaded_state;
+  const CacheHeader *header;
+  GByteArray *file;
+  guint8 *data;
+  gsize length, base_size;
+
+  service = g_object_new (SW_TYPE_SERVICE_DUMMY, NULL);
+
+  set = sw_item_set_new ();
+  item = make_test_item (service, "1", "one");
+  sw_set_add (set, (GObject *)item);
+  g_object_unref (item);
+  item = make_test_item (service, "2", "two");
+  sw_set_add (set, (GObject *)item);
+  g_object_unref (item);
+
+  state = g_slice_new0 (CacheState);
+  state->digests = digests_new ();
+  data = write_binary_cache (set, &length, state->digests);
+  state->base_size = length;
+  g_assert_cmpint (g_hash_table_size (state->digests), ==, 2);
+
+  file = g_byte_array_new ();
+  g_byte_array_append (file, data, length);
+  g_free (data);
+
+  /* Saving the same thing again doesn't append anything */
+  data = write_journal (state, set, &length);
+  g_assert (data == NULL);
+  g_assert_cmpint (length, ==, 0);
+
+  /* Change 1, remove 2 and add 3 */
+  sw_set_unref (set);
+  set = sw_item_set_new ();
+  item = make_test_item (service, "1", "uno");
+  sw_set_add (set, (GObject *)item);
+  g_object_unref (item);
+  item = make_test_item (service, "3", "three");
+  sw_set_add (set, (GObject *)item);
+  g_object_unref (item);
+
+  data = write_journal (state, set, &length);
+  g_assert (data != NULL);
+  g_assert_cmpint (state->journal_size, ==, length);
+  g_byte_array_append (file, data, length);
+  g_free (data);
+
+  header = get_binary_header ((const char *)file->data, file->len, &base_size);
+  g_assert (header != NULL);
+  g_assert_cmpint (base_size, ==, state->base_size);
+
+  loaded = load_binary_cache (service, header, base_size, file->len,
+                              sw_item_set_new, &loaded_state);
+  g_assert_cmpint (sw_set_size (loaded), ==, 2);
+  g_assert_cmpstr (sw_item_get (find_test_item (loaded, "1"), "content"), ==, "uno");
+  g_assert (find_test_item (loaded, "2") == NULL);
+  g_assert (find_test_item (loaded, "3") != NULL);
+  g_assert_cmpint (loaded_state->journal_size, ==, state->journal_size);
+
+  /* What we loaded matches what we saved, so there is nothing to append */
+  data = write_journal (loaded_state, set, &length);
+  g_assert (data == NULL);
+  cache_state_free (loaded_state);
+  sw_set_unref (loaded);
+
+  /*
+   * A torn final entry (the removal of 2) is ignored, the entries before it
+   * still apply, and a new snapshot is forced.
+   */
+  loaded = load_binary_cache (service, header, base_size, file->len - 1,
+                              sw_item_set_new, &loaded_state);
+  g_assert (find_test_item (loaded, "2") != NULL);
+  g_assert_cmpstr (sw_item_get (find_test_item (loaded, "1"), "content"), ==, "uno");
+  g_assert_cmpint (loaded_state->journal_size, >, loaded_state->base_size);
+  cache_state_free (loaded_state);
+  sw_set_unref (loaded);
+
+  cache_state_free (state);
+  g_byte_array_free (file, TRUE);
+  sw_set_unref (set);
+  g_object_unref (service);
+}
+
+void
+test_cache_unwritten (void)
+{
+  SwService *service;
+  SwSet *set, *copy, *loaded;
+  SwItem *item, *loaded_item;
+  WriteJob job = { 0, };
+  WriteDone *done;
+  guint first_serial;
+
+  service = g_object_new (SW_TYPE_SERVICE_DUMMY, NULL);
+
+  set = sw_item_set_new ();
+  item = make_test_item (service, "1", "one");
+  sw_set_add (set, (GObject *)item);
+
+  /* What is saved doesn't change when the item does */
+  copy = copy_set (service, set, sw_set_new ());
+  sw_item_put (item, "content", "uno");
+  g_assert_cmpstr (sw_item_get (find_test_item (copy, "1"), "content"), ==, "one");
+  g_object_unref (item);
+
+  job.filename = (char *)"/nonexistent/dummy-feed";
+  g_assert (!get_unwritten_set (service, job.filename, sw_item_set_new, &loaded));
+
+  /* A queued write is answered from memory */
+  track_write_job (&job, copy);
+  first_serial = job.serial;
+  g_assert (get_unwritten_set (service, job.filename, sw_item_set_new, &loaded));
+  loaded_item = find_test_item (loaded, "1");
+  g_assert (loaded_item != NULL);
+
+  /* Each load gets its own items, marked as cached */
+  g_assert (loaded_item != find_test_item (copy, "1"));
+  g_assert_cmpstr (sw_item_get (loaded_item, "content"), ==, "one");
+  g_assert_cmpstr (sw_item_get (loaded_item, "cached"), ==, "1");
+  sw_set_unref (loaded);
+
+  /* A queued removal means there is nothing to load */
+  track_write_job (&job, NULL);
+  g_assert (get_unwritten_set (service, job.filename, sw_item_set_new, &loaded));
+  g_assert (loaded == NULL);
+
+  /* Finishing the first write doesn't mean the removal has happened */
+  done = g_slice_new (WriteDone);
+  done->filename = g_strdup (job.filename);
+  done->serial = first_serial;
+  write_done_cb (done);
+  g_assert (get_unwritten_set (service, job.filename, sw_item_set_new, &loaded));
+
+  /* Once the last job is done the disk is up to date */
+  done = g_slice_new (WriteDone);
+  done->filename = g_strdup (job.filename);
+  done->serial = job.serial;
+  write_done_cb (done);
+  g_assert (!get_unwritten_set (service, job.filename, sw_item_set_new, &loaded));
+
+  sw_set_unref (copy);
+  sw_set_unref (set);
+  g_object_unref (service);
+}
+
+void
+test_cache_index (void)
+{
+  GHashTable *old_index = cache_index;
+  gsize old_total = cache_index_total;
+  gboolean old_dirty = cache_index_dirty;
+  CacheIndexEntry *entry;
+  GList *evictions;
+  char *path, *filename;
+  guint timeout_id;
+
+  cache_index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                       (GDestroyNotify)cache_index_entry_free);
+  cache_index_total = 0;
+
+  cache_index_parse ("100 30 twitter-feed-a\n"
+                     "200 10 flickr-feed-b\n"
+                     "garbage\n"
+                     "300 20 lastfm-feed-c\n");
+  g_assert_cmpint (g_hash_table_size (cache_index), ==, 3);
+  g_assert_cmpint (cache_index_total, ==, 600);
+
+  /* Within budget, nothing to do */
+  g_assert (cache_index_get_evictions (600, NULL) == NULL);
+
+  /* Oldest first until it fits */
+  evictions = cache_index_get_evictions (350, NULL);
+  g_assert_cmpint (g_list_length (evictions), ==, 2);
+  g_assert_cmpstr (evictions->data, ==, "flickr-feed-b");
+  g_assert_cmpstr (evictions->next->data, ==, "lastfm-feed-c");
+  g_list_foreach (evictions, (GFunc)g_free, NULL);
+  g_list_free (evictions);
+
+  /* The file being saved is never evicted */
+  evictions = cache_index_get_evictions (250, "flickr-feed-b");
+  g_assert_cmpint (g_list_length (evictions), ==, 2);
+  g_assert_cmpstr (evictions->data, ==, "lastfm-feed-c");
+  g_assert_cmpstr (evictions->next->data, ==, "twitter-feed-a");
+  g_list_foreach (evictions, (GFunc)g_free, NULL);
+  g_list_free (evictions);
+
+  cache_index_remove ("lastfm-feed-c");
+  g_assert_cmpint (cache_index_total, ==, 300);
+
+  /* Files the index doesn't know about are adopted by the scan */
+  path = g_strdup_printf ("%s/sw-cache-test-%d", g_get_tmp_dir (), getpid ());
+  g_assert (g_mkdir (path, 0700) == 0);
+  filename = g_build_filename (path, "twitter-feed-a", NULL);
+  g_assert (g_file_set_contents (filename, "cache", 5, NULL));
+  g_free (filename);
+  filename = g_build_filename (path, "vimeo-feed-d", NULL);
+  g_assert (g_file_set_contents (filename, "cache", 5, NULL));
+
+  cache_index_dirty = FALSE;
+  cache_index_scan (path);
+  g_assert_cmpint (g_hash_table_size (cache_index), ==, 3);
+  g_assert_cmpint (cache_index_total, ==, 305);
+  g_assert (cache_index_dirty);
+
+  /* After that a miss doesn't look at the disk */
+  g_assert (cache_index_lookup (filename));
+  g_remove (filename);
+  g_free (filename);
+  filename = g_build_filename (path, "youtube-feed-e", NULL);
+  g_assert (g_file_set_contents (filename, "cache", 5, NULL));
+  g_assert (!cache_index_lookup (filename));
+  g_remove (filename);
+  g_free (filename);
+  filename = g_build_filename (path, "twitter-feed-a", NULL);
+  g_remove (filename);
+  g_free (filename);
+  g_rmdir (path);
+  g_free (path);
+
+  /* Old last accesses are worth saving, recent ones wait for the next save */
+  timeout_id = pending_timeout_id;
+  cache_index_dirty = FALSE;
+  entry = g_hash_table_lookup (cache_index, "twitter-feed-a");
+  g_assert (cache_index_lookup ("twitter-feed-a"));
+  g_assert_cmpint (entry->last_access, >=, time (NULL) - 1);
+  g_assert (cache_index_dirty);
+  cache_index_dirty = FALSE;
+  g_assert (cache_index_lookup ("twitter-feed-a"));
+  g_assert (!cache_index_dirty);
+  g_assert_cmpint (pending_timeout_id, ==, timeout_id);
+
+  g_hash_table_destroy (cache_index);
+  cache_index = old_index;
+  cache_index_total = old_total;
+  cache_index_dirty = old_dirty;
+}
 #endif
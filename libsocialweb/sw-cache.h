@@ -40,6 +40,10 @@ void sw_cache_drop (SwService   *service,
 
 void sw_cache_drop_all (SwService *service);
 
+void sw_cache_flush (void);
+
+void sw_cache_set_max_size (gsize max_size);
+
 char *make_relative_path (const char *key, const char *value);
 
 G_END_DECLS
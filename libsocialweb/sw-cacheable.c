@@ -43,20 +43,18 @@ sw_cacheable_is_ready (SwCacheable *self)
   return iface->is_ready (self);
 }
 
+/*
+ * Call @func for every key and value to be saved in the cache, with the
+ * values of a multi-valued key one after another in order.  The magic keys
+ * that the cache sets itself on load, such as "cached", are left out.
+ */
 void
-sw_cacheable_save_into_cache (SwCacheable *self, GKeyFile *keys)
+sw_cacheable_foreach_field (SwCacheable          *self,
+                            SwCacheableFieldFunc  func,
+                            gpointer              user_data)
 {
   SwCacheableInterface *iface = SW_CACHEABLE_GET_IFACE (self);
-  const gchar *group;
   g_return_if_fail (iface);
 
-  group = sw_cacheable_get_id (self);
-  if (group == NULL)
-    return;
-
-  /* Skip items that are not ready. Their properties will not be intact */
-  if (!sw_cacheable_is_ready (self))
-    return;
-
-  return iface->save_into_cache (self, keys, group);
+  iface->foreach_field (self, func, user_data);
 }
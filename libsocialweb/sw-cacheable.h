@@ -38,19 +38,27 @@ G_BEGIN_DECLS
 
 typedef struct _SwCacheable SwCacheable;
 typedef struct _SwCacheableInterface SwCacheableInterface;
+
+typedef void (*SwCacheableFieldFunc) (const gchar *key,
+                                      const gchar *value,
+                                      gpointer     user_data);
+
 struct _SwCacheableInterface {
   GTypeInterface parent_iface;
   const gchar * (*get_id) (SwCacheable *self);
   gboolean (*is_ready) (SwCacheable *self);
-  void (*save_into_cache) (SwCacheable *self, GKeyFile *keys,
-                           const gchar *group);
+  void (*foreach_field) (SwCacheable          *self,
+                         SwCacheableFieldFunc  func,
+                         gpointer              user_data);
 };
 
 GType sw_cacheable_get_type (void);
 
 const gchar *sw_cacheable_get_id (SwCacheable *self);
 gboolean sw_cacheable_is_ready (SwCacheable *self);
-void sw_cacheable_save_into_cache (SwCacheable *self, GKeyFile *keys);
+void sw_cacheable_foreach_field (SwCacheable          *self,
+                                 SwCacheableFieldFunc  func,
+                                 gpointer              user_data);
 
 
 G_END_DECLS
@@ -20,6 +20,7 @@
 #include <glib.h>
 #include <rest/rest-proxy.h>
 #include "sw-call-list.h"
+#include "sw-request-governor.h"
 
 struct _SwCallList {
   GList *l;
@@ -87,6 +88,8 @@ sw_call_list_cancel_all (SwCallList *list)
     g_object_weak_unref (G_OBJECT (call), call_weak_notify, list);
     list->l = g_list_delete_link (list->l, list->l);
 
+    /* The call may not have been made yet */
+    sw_request_governor_cancel (call);
     rest_proxy_call_cancel (call);
   }
 }
@@ -25,6 +25,65 @@
 
 /* Hash of client addresses to GList of GObjects */
 static GHashTable *clients;
+/* Hash of GObjects to the number of clients using them */
+static GHashTable *n_clients;
+/* List of NotifyData, called when a client goes away */
+static GList *notifies;
+
+typedef struct {
+  SwClientMonitorNotify callback;
+  gpointer user_data;
+} NotifyData;
+
+static void
+ensure_tables (void)
+{
+  if (clients)
+    return;
+
+  clients = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  n_clients = g_hash_table_new (NULL, NULL);
+}
+
+static void
+count_client (GObject *object,
+              gint     delta)
+{
+  guint count;
+
+  count = GPOINTER_TO_UINT (g_hash_table_lookup (n_clients, object)) + delta;
+
+  if (count)
+    g_hash_table_insert (n_clients, object, GUINT_TO_POINTER (count));
+  else
+    g_hash_table_remove (n_clients, object);
+}
+
+/* Tell everyone that @sender has gone, then unref all of the objects that it
+   was connected to. */
+static void
+client_gone (const char *sender)
+{
+  GList *list, *l;
+
+  list = g_hash_table_lookup (clients, sender);
+  SW_DEBUG (CLIENT_MONITOR, "Client %s went away. It was using %d objects",
+            sender,
+            g_list_length (list));
+  g_hash_table_remove (clients, sender);
+
+  while (list) {
+    for (l = notifies; l; l = l->next) {
+      NotifyData *data = l->data;
+
+      data->callback (sender, list->data, data->user_data);
+    }
+
+    count_client (list->data, -1);
+    g_object_unref (list->data);
+    list = g_list_delete_link (list, list);
+  }
+}
 
 static void
 name_owner_changed (DBusGProxy *proxy,
@@ -35,20 +94,8 @@ name_owner_changed (DBusGProxy *proxy,
 {
   /* If a client we are tracking has disappeared, then unref all of the objects
      that they are connected to. */
-  if (new_owner[0] == '\0' && strcmp (name, prev_owner) == 0) {
-    GList *list;
-
-    list = g_hash_table_lookup (clients, prev_owner);
-    SW_DEBUG (CLIENT_MONITOR, "Client %s went away. It was using %d objects",
-              name,
-              g_list_length (list));
-    g_hash_table_remove (clients, prev_owner);
-
-    while (list) {
-      g_object_unref (list->data);
-      list = g_list_delete_link (list, list);
-    }
-  }
+  if (new_owner[0] == '\0' && strcmp (name, prev_owner) == 0)
+    client_gone (prev_owner);
 }
 
 /* init structures, listen to nameownerchanged */
@@ -57,7 +104,7 @@ sw_client_monitor_init (DBusGConnection *connection)
 {
   DBusGProxy *bus;
 
-  clients = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  ensure_tables ();
 
   bus = dbus_g_proxy_new_for_name (connection,
                                    DBUS_SERVICE_DBUS,
@@ -98,6 +145,8 @@ sw_client_monitor_add (char    *sender,
   g_return_if_fail (sender);
   g_return_if_fail (G_IS_OBJECT (object));
 
+  ensure_tables ();
+
   g_object_weak_ref (object,
                      _view_weak_notify,
                      g_strdup (sender)); /* freed by _remove */
@@ -110,6 +159,8 @@ sw_client_monitor_add (char    *sender,
   list = g_hash_table_lookup (clients, sender);
   list = g_list_prepend (list, object);
   g_hash_table_insert (clients, sender, list);
+
+  count_client (object, 1);
 }
 
 /* @sender has disconnected from @object.  Takes ownership of sender. This does
@@ -120,13 +171,121 @@ sw_client_monitor_remove (char    *sender,
 {
   GList *list;
 
+  ensure_tables ();
+
   SW_DEBUG (CLIENT_MONITOR, "Unmonitoring object (%p) for client: %s",
             object,
             sender);
 
   list = g_hash_table_lookup (clients, sender);
-  list = g_list_remove (list, object);
+  if (g_list_find (list, object))
+  {
+    list = g_list_remove (list, object);
+    count_client (object, -1);
+  }
   /* This will cause sender to be freed */
   g_hash_table_insert (clients, sender, list);
 }
 
+/* The number of clients that are using @object. Objects that are shared
+   between clients should only be torn down when the last one is done. */
+guint
+sw_client_monitor_get_n_clients (GObject *object)
+{
+  if (n_clients == NULL)
+    return 0;
+
+  return GPOINTER_TO_UINT (g_hash_table_lookup (n_clients, object));
+}
+
+/* The number of times @sender is using @object, as a client may open the
+   same shared object more than once. */
+guint
+sw_client_monitor_get_n_uses (const char *sender,
+                              GObject    *object)
+{
+  GList *l;
+  guint count = 0;
+
+  if (clients == NULL)
+    return 0;
+
+  for (l = g_hash_table_lookup (clients, sender); l; l = l->next)
+    if (l->data == object)
+      count++;
+
+  return count;
+}
+
+/* Call @callback for each object a client was using when the client goes
+   away, before the client's reference on the object is dropped. */
+void
+sw_client_monitor_add_notify (SwClientMonitorNotify callback,
+                              gpointer              user_data)
+{
+  NotifyData *data;
+
+  g_return_if_fail (callback);
+
+  data = g_slice_new (NotifyData);
+  data->callback = callback;
+  data->user_data = user_data;
+
+  notifies = g_list_append (notifies, data);
+}
+
+#if BUILD_TESTS
+#include "test-runner.h"
+
+/* "sender " for each object that a client was using when it went away */
+static GString *gone_log = NULL;
+
+static void
+log_gone_cb (const char *sender,
+             GObject    *object,
+             gpointer    user_data)
+{
+  /* The object is still alive */
+  g_assert (G_IS_OBJECT (object));
+
+  g_string_append_printf (gone_log, "%s ", sender);
+}
+
+void
+test_client_monitor_gone (void)
+{
+  GObject *a, *b;
+
+  gone_log = g_string_new (NULL);
+  sw_client_monitor_add_notify (log_gone_cb, NULL);
+
+  a = (GObject *)dummy_object_new ();
+  b = (GObject *)dummy_object_new ();
+  g_object_add_weak_pointer (a, (gpointer)&a);
+  g_object_add_weak_pointer (b, (gpointer)&b);
+
+  /* Both clients hold a reference on b */
+  sw_client_monitor_add (g_strdup (":1.1"), a);
+  sw_client_monitor_add (g_strdup (":1.1"), b);
+  sw_client_monitor_add (g_strdup (":1.2"), g_object_ref (b));
+  g_assert_cmpint (sw_client_monitor_get_n_clients (b), ==, 2);
+  g_assert_cmpint (sw_client_monitor_get_n_uses (":1.1", b), ==, 1);
+  g_assert_cmpint (sw_client_monitor_get_n_uses (":1.3", b), ==, 0);
+
+  client_gone (":1.1");
+  g_assert_cmpstr (gone_log->str, ==, ":1.1 :1.1 ");
+  g_assert (a == NULL);
+  g_assert (b != NULL);
+  g_assert_cmpint (sw_client_monitor_get_n_clients (b), ==, 1);
+
+  g_string_truncate (gone_log, 0);
+  client_gone (":1.2");
+  g_assert_cmpstr (gone_log->str, ==, ":1.2 ");
+  g_assert (b == NULL);
+
+  /* Clients we know nothing about are ignored */
+  g_string_truncate (gone_log, 0);
+  client_gone (":1.3");
+  g_assert_cmpstr (gone_log->str, ==, "");
+}
+#endif
@@ -27,6 +27,15 @@ G_BEGIN_DECLS
 void sw_client_monitor_init (DBusGConnection *connection);
 void sw_client_monitor_add (char *sender, GObject *object);
 void sw_client_monitor_remove (char *sender, GObject *object);
+guint sw_client_monitor_get_n_clients (GObject *object);
+guint sw_client_monitor_get_n_uses (const char *sender, GObject *object);
+
+typedef void (*SwClientMonitorNotify) (const char *sender,
+                                       GObject    *object,
+                                       gpointer    user_data);
+
+void sw_client_monitor_add_notify (SwClientMonitorNotify callback,
+                                   gpointer              user_data);
 
 G_END_DECLS
 
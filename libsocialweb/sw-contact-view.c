@@ -26,6 +26,8 @@
 #include <libsocialweb/sw-utils.h>
 #include <libsocialweb/sw-core.h>
 
+#include "sw-poll-scheduler.h"
+
 static void sw_contact_view_iface_init (gpointer g_iface, gpointer iface_data);
 G_DEFINE_TYPE_WITH_CODE (SwContactView, sw_contact_view, G_TYPE_OBJECT,
                          G_IMPLEMENT_INTERFACE (SW_TYPE_CONTACT_VIEW_IFACE,
@@ -50,9 +52,22 @@ struct _SwContactViewPrivate {
 
   GHashTable *uid_to_contacts;
 
-  GList *changed_contacts;
+  /* Contacts that changed since the last ContactsChanged, in order of change */
+  GQueue changed_contacts;
+  GHashTable *changed_contacts_set;
+
+  /* Seconds to coalesce changes for, and the batch size that flushes early */
+  guint changed_window;
+  guint changed_max_batch;
+
+  /* Seconds between refreshes, adapted to how often they find changes */
+  SwPollInterval refresh;
 };
 
+/* Default coalescing of ContactsChanged: seconds to wait, and the most to hold */
+#define CHANGED_WINDOW_DEFAULT 10
+#define CHANGED_MAX_BATCH_DEFAULT 100
+
 enum
 {
   PROP_0,
@@ -145,6 +160,14 @@ sw_contact_view_dispose (GObject *object)
     priv->refresh_timeout_id = 0;
   }
 
+  if (priv->changed_contacts_set)
+  {
+    g_queue_foreach (&priv->changed_contacts, (GFunc)g_object_unref, NULL);
+    g_queue_clear (&priv->changed_contacts);
+    g_hash_table_unref (priv->changed_contacts_set);
+    priv->changed_contacts_set = NULL;
+  }
+
   G_OBJECT_CLASS (sw_contact_view_parent_class)->dispose (object);
 }
 
@@ -253,6 +276,13 @@ sw_contact_view_init (SwContactView *self)
                                               g_str_equal,
                                               g_free,
                                               g_object_unref);
+
+  g_queue_init (&priv->changed_contacts);
+  priv->changed_contacts_set = g_hash_table_new (NULL, NULL);
+  priv->changed_window = CHANGED_WINDOW_DEFAULT;
+  priv->changed_max_batch = CHANGED_MAX_BATCH_DEFAULT;
+
+  sw_poll_interval_init (&priv->refresh);
 }
 
 /* DBUS interface to class vfunc bindings */
@@ -334,27 +364,27 @@ _handle_ready_pending_cb (gpointer data)
   SwContactView *contact_view = SW_CONTACT_VIEW (data);
   SwContactViewPrivate *priv = GET_PRIVATE (contact_view);
   GList *contacts_to_send = NULL;
-  GList *pending_contacts, *l;
+  SwSetIter iter;
+  GObject *object;
 
   SW_DEBUG (VIEWS, "Delayed ready timeout fired");
 
-  /* FIXME: Reword this to avoid unnecessary list creation ? */
-  pending_contacts = sw_set_as_list (priv->pending_contacts_set);
-
-  for (l = pending_contacts; l; l = l->next)
+  sw_set_iter_init (&iter, priv->pending_contacts_set);
+  while (sw_set_iter_next (&iter, &object))
   {
-    SwContact *contact = SW_CONTACT (l->data);
+    SwContact *contact = SW_CONTACT (object);
 
     if (sw_contact_get_ready (contact))
     {
-      contacts_to_send = g_list_prepend (contacts_to_send, contact);
-      sw_set_remove (priv->pending_contacts_set, (GObject *)contact);
+      contacts_to_send = g_list_prepend (contacts_to_send, g_object_ref (contact));
+      sw_set_iter_remove (&iter);
     }
   }
 
   sw_contact_view_add_contacts (contact_view, contacts_to_send);
 
-  g_list_free (pending_contacts);
+  g_list_foreach (contacts_to_send, (GFunc)g_object_unref, NULL);
+  g_list_free (contacts_to_send);
 
   priv->pending_timeout_id = 0;
 
@@ -416,18 +446,42 @@ _setup_ready_handler (SwContact     *contact,
                      contact);
 }
 
+/*
+ * Send everything that has changed, in the order it changed.
+ */
+static void
+_flush_changed_contacts (SwContactView *contact_view)
+{
+  SwContactViewPrivate *priv = GET_PRIVATE (contact_view);
+  GQueue changed;
+
+  if (priv->refresh_timeout_id)
+  {
+    g_source_remove (priv->refresh_timeout_id);
+    priv->refresh_timeout_id = 0;
+  }
+
+  /* Take the queue first so that changes made while sending start a new one */
+  changed = priv->changed_contacts;
+  g_queue_init (&priv->changed_contacts);
+  g_hash_table_remove_all (priv->changed_contacts_set);
+
+  SW_DEBUG (VIEWS, "Flushing %d changed contacts", changed.length);
+
+  sw_contact_view_update_contacts (contact_view, changed.head);
+
+  g_queue_foreach (&changed, (GFunc)g_object_unref, NULL);
+  g_queue_clear (&changed);
+}
+
 static gboolean
 _contact_changed_timeout_cb (gpointer data)
 {
   SwContactView *contact_view = SW_CONTACT_VIEW (data);
   SwContactViewPrivate *priv = GET_PRIVATE (contact_view);
 
-  sw_contact_view_update_contacts (contact_view, priv->changed_contacts);
-  g_list_foreach (priv->changed_contacts, (GFunc)g_object_unref, NULL);
-  g_list_free (priv->changed_contacts);
-  priv->changed_contacts = NULL;
-
   priv->refresh_timeout_id = 0;
+  _flush_changed_contacts (contact_view);
 
   return FALSE;
 }
@@ -445,14 +499,21 @@ _contact_changed_cb (SwContact     *contact,
   if (!sw_contact_get_ready (contact))
     return;
 
-  if (!g_list_find (priv->changed_contacts, contact))
-    priv->changed_contacts = g_list_append (priv->changed_contacts, contact);
+  if (g_hash_table_lookup (priv->changed_contacts_set, contact))
+    return;
 
-  if (!priv->refresh_timeout_id)
+  g_hash_table_insert (priv->changed_contacts_set, contact, contact);
+  g_queue_push_tail (&priv->changed_contacts, g_object_ref (contact));
+
+  if (priv->changed_max_batch &&
+      priv->changed_contacts.length >= priv->changed_max_batch)
   {
+    SW_DEBUG (VIEWS, "Contact changed, batch is full");
+    _flush_changed_contacts (contact_view);
+  } else if (!priv->refresh_timeout_id) {
     SW_DEBUG (VIEWS, "Contact changed, Setting up timeout");
 
-    priv->refresh_timeout_id = g_timeout_add_seconds (10,
+    priv->refresh_timeout_id = g_timeout_add_seconds (priv->changed_window,
                                                       _contact_changed_timeout_cb,
                                                       contact_view);
   }
@@ -483,6 +544,46 @@ _setup_changed_handler (SwContact     *contact,
                      g_object_ref (contact));
 }
 
+/*
+ * Queue @contact for a ContactsAdded signal, or hold it back until it is
+ * ready.
+ */
+static void
+_append_added_contact (SwContactView *contact_view,
+                       SwContact     *contact,
+                       GPtrArray     *contacts_ptr_array)
+{
+  SwContactViewPrivate *priv = GET_PRIVATE (contact_view);
+
+  if (sw_contact_get_ready (contact))
+  {
+    SW_DEBUG (VIEWS, "Contact ready: %s",
+              sw_contact_get (contact, "id"));
+    g_ptr_array_add (contacts_ptr_array,
+                     _sw_contact_to_value_array (contact));
+  } else {
+    SW_DEBUG (VIEWS, "Contact not ready, setting up handler: %s",
+              sw_contact_get (contact, "id"));
+    _setup_ready_handler (contact, contact_view);
+    sw_set_add (priv->pending_contacts_set, (GObject *)contact);
+  }
+
+  _setup_changed_handler (contact, contact_view);
+}
+
+static void
+_emit_contacts_added (SwContactView *contact_view,
+                      GPtrArray     *contacts_ptr_array)
+{
+  SW_DEBUG (VIEWS, "Number of contacts to be added: %d", contacts_ptr_array->len);
+
+  if (contacts_ptr_array->len > 0)
+    sw_contact_view_iface_emit_contacts_added (contact_view,
+                                            contacts_ptr_array);
+
+  g_ptr_array_free (contacts_ptr_array, TRUE);
+}
+
 /**
  * sw_contact_view_add_contacts
  * @contact_view: A #SwContactView
@@ -499,8 +600,6 @@ static void
 sw_contact_view_add_contacts (SwContactView *contact_view,
                         GList      *contacts)
 {
-  SwContactViewPrivate *priv = GET_PRIVATE (contact_view);
-  GValueArray *value_array;
   GPtrArray *contacts_ptr_array;
   GList *l;
 
@@ -508,32 +607,10 @@ sw_contact_view_add_contacts (SwContactView *contact_view,
       ((GDestroyNotify)g_value_array_free);
 
   for (l = contacts; l; l = l->next)
-  {
-    SwContact *contact = SW_CONTACT (l->data);
-
-    if (sw_contact_get_ready (contact))
-    {
-      SW_DEBUG (VIEWS, "Contact ready: %s",
-                sw_contact_get (contact, "id"));
-      value_array = _sw_contact_to_value_array (contact);
-      g_ptr_array_add (contacts_ptr_array, value_array);
-    } else {
-      SW_DEBUG (VIEWS, "Contact not ready, setting up handler: %s",
-                sw_contact_get (contact, "id"));
-      _setup_ready_handler (contact, contact_view);
-      sw_set_add (priv->pending_contacts_set, (GObject *)contact);
-    }
+    _append_added_contact (contact_view, SW_CONTACT (l->data),
+                           contacts_ptr_array);
 
-    _setup_changed_handler (contact, contact_view);
-  }
-
-  SW_DEBUG (VIEWS, "Number of contacts to be added: %d", contacts_ptr_array->len);
-
-  if (contacts_ptr_array->len > 0)
-    sw_contact_view_iface_emit_contacts_added (contact_view,
-                                            contacts_ptr_array);
-
-  g_ptr_array_free (contacts_ptr_array, TRUE);
+  _emit_contacts_added (contact_view, contacts_ptr_array);
 }
 
 /**
@@ -580,6 +657,40 @@ sw_contact_view_update_contacts (SwContactView *contact_view,
   g_ptr_array_free (contacts_ptr_array, TRUE);
 }
 
+/*
+ * The (service, uid) pair that ContactsRemoved sends for @contact.
+ */
+static GValueArray *
+_contact_to_removed_value_array (SwContact *contact)
+{
+  GValueArray *value_array;
+
+  value_array = g_value_array_new (2);
+
+  value_array = g_value_array_append (value_array, NULL);
+  g_value_init (g_value_array_get_nth (value_array, 0), G_TYPE_STRING);
+  g_value_set_string (g_value_array_get_nth (value_array, 0),
+                      sw_service_get_name (sw_contact_get_service (contact)));
+
+  value_array = g_value_array_append (value_array, NULL);
+  g_value_init (g_value_array_get_nth (value_array, 1), G_TYPE_STRING);
+  g_value_set_string (g_value_array_get_nth (value_array, 1),
+                      sw_contact_get (contact, "id"));
+
+  return value_array;
+}
+
+static void
+_emit_contacts_removed (SwContactView *contact_view,
+                        GPtrArray     *contacts_ptr_array)
+{
+  if (contacts_ptr_array->len > 0)
+    sw_contact_view_iface_emit_contacts_removed (contact_view,
+                                           contacts_ptr_array);
+
+  g_ptr_array_free (contacts_ptr_array, TRUE);
+}
+
 /**
  * sw_contact_view_remove_contacts
  * @contact_view: A #SwContactView
@@ -597,38 +708,17 @@ static void
 sw_contact_view_remove_contacts (SwContactView *contact_view,
                            GList      *contacts)
 {
-  GValueArray *value_array;
   GPtrArray *contacts_ptr_array;
   GList *l;
-  SwContact *contact;
 
   contacts_ptr_array = g_ptr_array_new_with_free_func
       ((GDestroyNotify)g_value_array_free);
 
   for (l = contacts; l; l = l->next)
-  {
-    contact = SW_CONTACT (l->data);
-
-    value_array = g_value_array_new (2);
-
-    value_array = g_value_array_append (value_array, NULL);
-    g_value_init (g_value_array_get_nth (value_array, 0), G_TYPE_STRING);
-    g_value_set_string (g_value_array_get_nth (value_array, 0),
-                        sw_service_get_name (sw_contact_get_service (contact)));
-
-    value_array = g_value_array_append (value_array, NULL);
-    g_value_init (g_value_array_get_nth (value_array, 1), G_TYPE_STRING);
-    g_value_set_string (g_value_array_get_nth (value_array, 1),
-                        sw_contact_get (contact, "id"));
+    g_ptr_array_add (contacts_ptr_array,
+                     _contact_to_removed_value_array (l->data));
 
-    g_ptr_array_add (contacts_ptr_array, value_array);
-  }
-
-  if (contacts_ptr_array->len > 0)
-    sw_contact_view_iface_emit_contacts_removed (contact_view,
-                                           contacts_ptr_array);
-
-  g_ptr_array_free (contacts_ptr_array, TRUE);
+  _emit_contacts_removed (contact_view, contacts_ptr_array);
 }
 
 /**
@@ -664,26 +754,79 @@ sw_contact_view_get_service (SwContactView *contact_view)
   return priv->service;
 }
 
-/* TODO: Export this function ? */
-/**
- * sw_contact_view_add_from_set
- * @contact_view: A #SwContactView
- * @set: A #SwSet
- *
- * Add the contacts that are in the supplied set to the view.
- *
- * This is used in the implementation of sw_contact_view_set_from_set()
+static void
+_free_contact_list (GList *contacts)
+{
+  g_list_foreach (contacts, (GFunc)g_object_unref, NULL);
+  g_list_free (contacts);
+}
+
+static void
+_register_contact (SwContactView *contact_view,
+                   SwContact     *contact)
+{
+  SwContactViewPrivate *priv = GET_PRIVATE (contact_view);
+
+  sw_set_add (priv->current_contacts_set, (GObject *)contact);
+  g_hash_table_replace (priv->uid_to_contacts,
+                        g_strdup (sw_contact_get (contact, "id")),
+                        g_object_ref (contact));
+}
+
+/*
+ * Drop the view's references to @contact.  The caller must hold one.
  */
-void
-sw_contact_view_add_from_set (SwContactView *contact_view,
-                           SwSet      *set)
+static void
+_unregister_contact (SwContactView *contact_view,
+                     SwContact     *contact)
 {
   SwContactViewPrivate *priv = GET_PRIVATE (contact_view);
-  GList *contacts;
+
+  sw_set_remove (priv->current_contacts_set, (GObject *)contact);
+  g_hash_table_remove (priv->uid_to_contacts,
+                       sw_contact_get (contact, "id"));
+}
+
+/*
+ * Add @contacts to the view.
+ */
+static void
+_add_contact_list (SwContactView *contact_view,
+                   GList         *contacts)
+{
+  GList *l;
+
+  for (l = contacts; l; l = l->next)
+    _register_contact (contact_view, (SwContact *)l->data);
+
+  sw_contact_view_add_contacts (contact_view, contacts);
+}
+
+/*
+ * Remove @contacts from the view.
+ */
+static void
+_remove_contact_list (SwContactView *contact_view,
+                      GList         *contacts)
+{
   GList *l;
 
-  sw_set_add_from (priv->current_contacts_set, set);
-  contacts = sw_set_as_list (set);
+  for (l = contacts; l; l = l->next)
+    _unregister_contact (contact_view, (SwContact *)l->data);
+
+  sw_contact_view_remove_contacts (contact_view, contacts);
+}
+
+/*
+ * Replace the versions of @contacts in the view with these ones and send
+ * them as changed.
+ */
+static void
+_update_contact_list (SwContactView *contact_view,
+                      GList         *contacts)
+{
+  SwContactViewPrivate *priv = GET_PRIVATE (contact_view);
+  GList *l;
 
   for (l = contacts; l; l = l->next)
   {
@@ -692,95 +835,76 @@ sw_contact_view_add_from_set (SwContactView *contact_view,
     g_hash_table_replace (priv->uid_to_contacts,
                           g_strdup (sw_contact_get (contact, "id")),
                           g_object_ref (contact));
+    /*
+     * This works because sw_set_add uses g_hash_table_replace behind the
+     * scenes
+     */
+    sw_set_add (priv->current_contacts_set, (GObject *)contact);
   }
 
-  sw_contact_view_add_contacts (contact_view, contacts);
-  g_list_free (contacts);
+  sw_contact_view_update_contacts (contact_view, contacts);
 }
 
 /* TODO: Export this function ? */
 /**
- * sw_contact_view_remove_from_set
+ * sw_contact_view_add_from_set
  * @contact_view: A #SwContactView
  * @set: A #SwSet
  *
- * Remove the contacts that are in the supplied set from the view.
+ * Add the contacts that are in the supplied set to the view.
  *
  * This is used in the implementation of sw_contact_view_set_from_set()
  */
 void
-sw_contact_view_remove_from_set (SwContactView *contact_view,
-                              SwSet      *set)
+sw_contact_view_add_from_set (SwContactView *contact_view,
+                           SwSet      *set)
 {
-  SwContactViewPrivate *priv = GET_PRIVATE (contact_view);
-  GList *contacts;
-  GList *l;
-
-  sw_set_remove_from (priv->current_contacts_set, set);
+  GPtrArray *contacts_ptr_array;
+  SwSetIter iter;
+  GObject *object;
 
-  contacts = sw_set_as_list (set);
+  contacts_ptr_array = g_ptr_array_new_with_free_func
+      ((GDestroyNotify)g_value_array_free);
 
-  for (l = contacts; l; l = l->next)
+  sw_set_iter_init (&iter, set);
+  while (sw_set_iter_next (&iter, &object))
   {
-    SwContact *contact = (SwContact *)l->data;
-
-    g_hash_table_remove (priv->uid_to_contacts,
-                         sw_contact_get (contact, "id"));
+    _register_contact (contact_view, (SwContact *)object);
+    _append_added_contact (contact_view, (SwContact *)object,
+                           contacts_ptr_array);
   }
 
-  sw_contact_view_remove_contacts (contact_view, contacts);
-  g_list_free (contacts);
+  _emit_contacts_added (contact_view, contacts_ptr_array);
 }
 
+/* TODO: Export this function ? */
 /**
- * sw_contact_view_update_existing
+ * sw_contact_view_remove_from_set
  * @contact_view: A #SwContactView
  * @set: A #SwSet
  *
- * Replaces contacts in the internal set for the #SwContactView with the version
- * from #SwSet if and only if they are sw_contact_equal() says that they are
- * unequal. This prevents sending excessive contacts changed signals.
+ * Remove the contacts that are in the supplied set from the view.
  */
-static void
-sw_contact_view_update_existing (SwContactView *contact_view,
+void
+sw_contact_view_remove_from_set (SwContactView *contact_view,
                               SwSet      *set)
 {
-  SwContactViewPrivate *priv = GET_PRIVATE (contact_view);
-  GList *contacts;
-  SwContact *new_contact;
-  SwContact *old_contact;
-  GList *l;
-  GList *contacts_to_send = NULL;
+  GPtrArray *contacts_ptr_array;
+  SwSetIter iter;
+  GObject *object;
 
-  contacts = sw_set_as_list (set);
+  contacts_ptr_array = g_ptr_array_new_with_free_func
+      ((GDestroyNotify)g_value_array_free);
 
-  for (l = contacts; l; l = l->next)
+  sw_set_iter_init (&iter, set);
+  while (sw_set_iter_next (&iter, &object))
   {
-    new_contact = (SwContact *)l->data;
-    old_contact = g_hash_table_lookup (priv->uid_to_contacts,
-                                    sw_contact_get (new_contact, "id"));
-
-    /* This is just a new contact so we won't find it */
-    if (!old_contact)
-      continue;
-
-    if (!sw_contact_equal (new_contact, old_contact))
-    {
-      g_hash_table_replace (priv->uid_to_contacts,
-                            g_strdup (sw_contact_get (new_contact, "id")),
-                            new_contact);
-      /* 
-       * This works because sw_set_add uses g_hash_table_replace behind the
-       * scenes
-       */
-      sw_set_add (priv->current_contacts_set, (GObject *)new_contact);
-      contacts_to_send = g_list_append (contacts_to_send, g_object_ref (new_contact));
-    }
+    g_ptr_array_add (contacts_ptr_array,
+                     _contact_to_removed_value_array ((SwContact *)object));
+    _unregister_contact (contact_view, (SwContact *)object);
   }
 
-  sw_contact_view_update_contacts (contact_view, contacts_to_send);
-
-  g_list_free (contacts);
+  _emit_contacts_removed (contact_view, contacts_ptr_array);
 }
 
 /**
@@ -791,7 +915,9 @@ sw_contact_view_update_existing (SwContactView *contact_view,
  * Updates what the view contains based on the given #SwSet. Removed
  * signals will be fired for any contacts that were in the view but that are not
  * present in the supplied set. Conversely any contacts that are new will cause
- * signals to be fired indicating their addition.
+ * signals to be fired indicating their addition. Contacts present in both are
+ * replaced, and signalled as changed, only if sw_contact_equal() says that
+ * they differ.
  *
  * This implemented by maintaining a set inside the #SwContactView
  */
@@ -800,31 +926,106 @@ sw_contact_view_set_from_set (SwContactView *contact_view,
                            SwSet      *set)
 {
   SwContactViewPrivate *priv = GET_PRIVATE (contact_view);
-  SwSet *added_contacts, *removed_contacts;
+  GList *added_contacts, *removed_contacts, *changed_contacts;
 
   if (sw_set_is_empty (priv->current_contacts_set))
   {
+    /* Filling an empty view says nothing about how often it changes */
     sw_contact_view_add_from_set (contact_view, set);
   } else {
-    removed_contacts = sw_set_difference (priv->current_contacts_set, set);
-    added_contacts = sw_set_difference (set, priv->current_contacts_set);
-
-    if (!sw_set_is_empty (removed_contacts))
-      sw_contact_view_remove_from_set (contact_view, removed_contacts);
-
-    /* 
-     * Replace contacts that exist in the new set that are also present in the
-     * original set iff they're not equal
-     *
-     * This function will also cause the ContactsChanged signal to be fired with
-     * the contacts that have changed.
-     */
-    sw_contact_view_update_existing (contact_view, set);
+    sw_set_diff (priv->current_contacts_set,
+                 set,
+                 (GEqualFunc)sw_contact_equal,
+                 &added_contacts,
+                 &removed_contacts,
+                 &changed_contacts);
+
+    sw_poll_interval_update (&priv->refresh,
+                             added_contacts ||
+                             removed_contacts ||
+                             changed_contacts);
+
+    if (removed_contacts)
+      _remove_contact_list (contact_view, removed_contacts);
+
+    if (changed_contacts)
+      _update_contact_list (contact_view, changed_contacts);
+
+    if (added_contacts)
+      _add_contact_list (contact_view, added_contacts);
+
+    _free_contact_list (removed_contacts);
+    _free_contact_list (changed_contacts);
+    _free_contact_list (added_contacts);
+  }
+}
 
-    if (!sw_set_is_empty (added_contacts))
-      sw_contact_view_add_from_set (contact_view, added_contacts);
+/**
+ * sw_contact_view_set_change_batching
+ * @contact_view: A #SwContactView
+ * @window: Seconds to collect changes for before sending them
+ * @max_batch: Number of changed contacts that are sent straight away, or 0
+ * for no limit
+ *
+ * Control how changes to contacts already in the view are coalesced into
+ * ContactsChanged signals. Changes are held for up to @window seconds from the
+ * first one, unless @max_batch contacts have changed before then.
+ */
+void
+sw_contact_view_set_change_batching (SwContactView *contact_view,
+                                     guint          window,
+                                     guint          max_batch)
+{
+  SwContactViewPrivate *priv;
 
-    sw_set_unref (removed_contacts);
-    sw_set_unref (added_contacts);
-  }
+  g_return_if_fail (SW_IS_CONTACT_VIEW (contact_view));
+  g_return_if_fail (window > 0);
+
+  priv = GET_PRIVATE (contact_view);
+  priv->changed_window = window;
+  priv->changed_max_batch = max_batch;
+
+  if (priv->changed_max_batch &&
+      priv->changed_contacts.length >= priv->changed_max_batch)
+    _flush_changed_contacts (contact_view);
+}
+
+/**
+ * sw_contact_view_set_refresh_bounds
+ * @contact_view: A #SwContactView
+ * @min_interval: Fewest seconds between refreshes
+ * @max_interval: Most seconds between refreshes
+ *
+ * The view learns how often refreshes find something new and suggests a
+ * refresh interval to match, backing off when the service is quiet and
+ * tightening when it is busy. This sets the bounds on that interval.
+ */
+void
+sw_contact_view_set_refresh_bounds (SwContactView *contact_view,
+                                    guint          min_interval,
+                                    guint          max_interval)
+{
+  SwContactViewPrivate *priv;
+
+  g_return_if_fail (SW_IS_CONTACT_VIEW (contact_view));
+  g_return_if_fail (min_interval > 0);
+  g_return_if_fail (min_interval <= max_interval);
+
+  priv = GET_PRIVATE (contact_view);
+  sw_poll_interval_set_bounds (&priv->refresh, min_interval, max_interval);
+}
+
+/**
+ * sw_contact_view_get_refresh_interval
+ * @contact_view: A #SwContactView
+ *
+ * Returns: the number of seconds that the view suggests waiting before the
+ * next refresh, based on how often recent refreshes found changes.
+ */
+guint
+sw_contact_view_get_refresh_interval (SwContactView *contact_view)
+{
+  g_return_val_if_fail (SW_IS_CONTACT_VIEW (contact_view), 0);
+
+  return GET_PRIVATE (contact_view)->refresh.interval;
 }
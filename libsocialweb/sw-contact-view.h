@@ -62,6 +62,16 @@ GType sw_contact_view_get_type (void);
 void sw_contact_view_set_from_set (SwContactView *contact_view,
                                 SwSet      *set);
 
+void sw_contact_view_set_change_batching (SwContactView *contact_view,
+                                          guint          window,
+                                          guint          max_batch);
+
+void sw_contact_view_set_refresh_bounds (SwContactView *contact_view,
+                                         guint          min_interval,
+                                         guint          max_interval);
+
+guint sw_contact_view_get_refresh_interval (SwContactView *contact_view);
+
 const gchar *sw_contact_view_get_object_path (SwContactView *contact_view);
 SwService *sw_contact_view_get_service (SwContactView *contact_view);
 
@@ -38,6 +38,9 @@ struct _SwContactPrivate {
   /* Contact: hash (key: string) -> (GStrv value)
    */
   GHashTable *hash;
+  /* g_str_hash of the id, and the sum of values_fingerprint of every key */
+  guint id_hash;
+  guint64 fingerprint;
   time_t cached_date;
   time_t mtime;
   gint remaining_fetches;
@@ -166,30 +169,68 @@ sw_contact_get_service (SwContact *contact)
   return contact->priv->service;
 }
 
-void
-sw_contact_put (SwContact *contact, const char *key, const char *value)
+static guint64
+values_fingerprint (const char *key, GStrv values)
 {
-  g_return_if_fail (SW_IS_CONTACT (contact));
-  g_return_if_fail (key);
+  guint64 hash;
+  int i;
+
+  hash = sw_hash_string_64 (SW_HASH_64_INIT, key);
+  for (i = 0; values[i]; i++)
+    hash = sw_hash_string_64 (hash, values[i]);
 
+  return hash;
+}
+
+/*
+ * Append @value to the values of @key, taking ownership of @value.
+ */
+static void
+append_value (SwContact *contact, const char *key, char *value)
+{
+  SwContactPrivate *priv = contact->priv;
   GStrv str_array;
   GStrv new_str_array;
-  str_array = g_hash_table_lookup (contact->priv->hash,
-                               (gpointer)g_intern_string (key));
+
+  str_array = g_hash_table_lookup (priv->hash,
+                                   (gpointer)g_intern_string (key));
   if (str_array == NULL) {
     new_str_array = g_new0 (gchar *, 2);
-    new_str_array[0] = g_strdup (value);
+    new_str_array[0] = value;
   } else {
     int i;
     int len = g_strv_length (str_array);
     new_str_array = g_new0 (gchar *, len + 2);
     for (i = 0 ; i < len ; i++)
       new_str_array[i] = g_strdup (str_array[i]);
-    new_str_array[len] = g_strdup (value);
+    new_str_array[len] = value;
+  }
+
+  /*
+   * Keep the fingerprint up to date.  It is a sum so that the contribution
+   * of the old values can be taken out.  The cached flag doesn't count.
+   */
+  if (!g_str_equal (key, "cached")) {
+    if (str_array)
+      priv->fingerprint -= values_fingerprint (key, str_array);
+    priv->fingerprint += values_fingerprint (key, new_str_array);
   }
-  g_hash_table_insert (contact->priv->hash,
+
+  if (str_array == NULL && g_str_equal (key, "id"))
+    priv->id_hash = g_str_hash (value);
+
+  g_hash_table_insert (priv->hash,
                        (gpointer)g_intern_string (key),
                        new_str_array);
+}
+
+void
+sw_contact_put (SwContact *contact, const char *key, const char *value)
+{
+  g_return_if_fail (SW_IS_CONTACT (contact));
+  g_return_if_fail (key);
+
+  append_value (contact, key, g_strdup (value));
 
   sw_contact_touch (contact);
 }
@@ -200,24 +241,7 @@ sw_contact_take (SwContact *contact, const char *key, char *value)
   g_return_if_fail (SW_IS_CONTACT (contact));
   g_return_if_fail (key);
 
-  GStrv str_array;
-  GStrv new_str_array;
-  str_array = g_hash_table_lookup (contact->priv->hash,
-                               (gpointer)g_intern_string (key));
-  if (str_array == NULL) {
-    new_str_array = g_new0 (gchar *, 2);
-    new_str_array[0] = value;
-  } else {
-    int i;
-    int len = g_strv_length (str_array);
-    new_str_array = g_new0 (gchar *, len + 2);
-    for (i = 0 ; i < len ; i++)
-      new_str_array[i] = g_strdup (str_array[i]);
-    new_str_array[len] = value;
-  }
-  g_hash_table_insert (contact->priv->hash,
-                       (gpointer)g_intern_string (key),
-                       new_str_array);
+  append_value (contact, key, value);
 
   sw_contact_touch (contact);
 }
@@ -235,16 +259,6 @@ sw_contact_get (const SwContact *contact, const char *key)
   return str_array[0];
 }
 
-static const GStrv
-sw_contact_get_all (const SwContact *contact, const char *key)
-{
-  g_return_val_if_fail (SW_IS_CONTACT (contact), NULL);
-  g_return_val_if_fail (key, NULL);
-
-  return g_hash_table_lookup (contact->priv->hash,
-        g_intern_string (key));
-}
-
 static void
 cache_date (SwContact *contact)
 {
@@ -284,7 +298,7 @@ static guint
 contact_hash (gconstpointer key)
 {
   const SwContact *contact = key;
-  return g_str_hash (sw_contact_get (contact, "id"));
+  return contact->priv->id_hash;
 }
 
 gboolean
@@ -293,8 +307,9 @@ contact_equal (gconstpointer a, gconstpointer b)
   const SwContact *contact_a = a;
   const SwContact *contact_b = b;
 
-  return g_str_equal (sw_contact_get (contact_a, "id"),
-                      sw_contact_get (contact_b, "id"));
+  return contact_a->priv->id_hash == contact_b->priv->id_hash &&
+    g_str_equal (sw_contact_get (contact_a, "id"),
+                 sw_contact_get (contact_b, "id"));
 }
 
 SwSet *
@@ -397,7 +412,8 @@ _sw_contact_to_value_array (SwContact *contact)
   GValueArray *value_array;
   time_t time;
 
-  time = sw_time_t_from_string (sw_contact_get (contact, "date"));
+  cache_date (contact);
+  time = contact->priv->cached_date;
 
   value_array = g_value_array_new (4);
 
@@ -442,18 +458,17 @@ sw_contact_get_mtime (SwContact *contact)
   return contact->priv->mtime;
 }
 
-/* Intentionally don't compare the mtime */
+/*
+ * Intentionally don't compare the mtime.  The fingerprints are 64-bit
+ * hashes of the contents, so contacts with equal fingerprints are taken to
+ * be equal.
+ */
 gboolean
 sw_contact_equal (SwContact *a,
                SwContact *b)
 {
   SwContactPrivate *priv_a = GET_PRIVATE (a);
   SwContactPrivate *priv_b = GET_PRIVATE (b);
-  GHashTable *hash_a = priv_a->hash;
-  GHashTable *hash_b = priv_b->hash;
-  GHashTableIter iter_a;
-  gpointer key_a, value_a;
-  guint size_a, size_b;
 
   if (priv_a->service != priv_b->service)
     return FALSE;
@@ -461,38 +476,7 @@ sw_contact_equal (SwContact *a,
   if (priv_a->remaining_fetches != priv_b->remaining_fetches)
     return FALSE;
 
-  size_a = g_hash_table_size (hash_a);
-  size_b = g_hash_table_size (hash_b);
-
-  if (sw_contact_get (a, "cached"))
-    size_a--;
-
-  if (sw_contact_get (b, "cached"))
-    size_b--;
-
-  if (size_a != size_b)
-    return FALSE;
-
-  g_hash_table_iter_init (&iter_a, hash_a);
-
-  while (g_hash_table_iter_next (&iter_a, &key_a, &value_a)) 
-  {
-    if (g_str_equal (key_a, "cached"))
-      continue;
-
-    GStrv value_b;
-    int i;
-    value_b = sw_contact_get_all (b, key_a);
-    if (g_strv_length (value_a) != g_strv_length (value_b))
-      return FALSE;
-
-    for (i = 0 ; i < g_strv_length (value_a) ; i++) {
-      if (!g_str_equal (((GStrv)value_a)[i], value_b[i]))
-        return FALSE;
-    }
-  }
-
-  return TRUE;
+  return priv_a->fingerprint == priv_b->fingerprint;
 }
 
 static const gchar *
@@ -503,24 +487,27 @@ sw_contact_get_id (SwCacheable *cacheable)
 }
 
 static void
-sw_contact_save_into_cache (SwCacheable *cacheable, GKeyFile *keys,
-                            const gchar *group)
+sw_contact_foreach_field (SwCacheable          *cacheable,
+                          SwCacheableFieldFunc  func,
+                          gpointer              user_data)
 {
   SwContact *contact = SW_CONTACT (cacheable);
   const char *key;
-  const gpointer value;
+  gpointer value;
   GHashTableIter iter;
 
-  /* Set a magic field saying that this contact is cached */
-  g_key_file_set_string (keys, group, "cached", "1");
-  g_key_file_set_string (keys, group, "type", "contact");
-
   g_hash_table_iter_init (&iter, sw_contact_peek_hash (contact));
   while (g_hash_table_iter_next (&iter, (gpointer)&key, &value)) {
-    g_key_file_set_string_list (keys, group, key, value,
-        g_strv_length (value));
-  }
+    GStrv str_array = value;
+    int i;
+
+    /* Set by the cache on load */
+    if (g_str_equal (key, "cached") || g_str_equal (key, "type"))
+      continue;
 
+    for (i = 0; str_array && str_array[i]; i++)
+      func (key, str_array[i], user_data);
+  }
 }
 
 static void
@@ -529,5 +516,5 @@ sw_contact_cacheable_init (SwCacheableInterface *iface,
 {
   iface->get_id = sw_contact_get_id;
   iface->is_ready = sw_contact_get_ready;
-  iface->save_into_cache = sw_contact_save_into_cache;
+  iface->foreach_field = sw_contact_foreach_field;
 }
@@ -16,6 +16,11 @@
  * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <gio/gio.h>
 #include <dbus/dbus-glib-lowlevel.h>
 #include "sw-core.h"
@@ -24,6 +29,7 @@
 #include "sw-banned.h"
 #include "sw-debug.h"
 #include "sw-item.h"
+#include "sw-cache.h"
 
 #include "sw-client-monitor.h"
 
@@ -322,7 +328,8 @@ sw_core_constructed (GObject *object)
     load_modules_from_dir (core);
   }
 
-  sw_online_add_notify (online_changed, object);
+  /* Tell clients straight away, before the services start reconnecting */
+  sw_online_add_notify_full (online_changed, object, G_PRIORITY_HIGH);
 }
 
 static void
@@ -391,16 +398,95 @@ sw_core_new (void)
   return g_object_new (SW_TYPE_CORE, NULL);
 }
 
+/*
+ * SIGTERM and SIGINT are turned into a byte on a pipe so that the main loop
+ * can be quit from a normal watch rather than from inside the signal handler.
+ */
+static int quit_pipe[2] = { -1, -1 };
+
+static void
+quit_signal_handler (int signum)
+{
+  char c = 0;
+  ssize_t ret;
+
+  ret = write (quit_pipe[1], &c, 1);
+  (void)ret;
+}
+
+static gboolean
+quit_pipe_cb (GIOChannel   *source,
+              GIOCondition  condition,
+              gpointer      user_data)
+{
+  GMainLoop *loop = user_data;
+
+  SW_DEBUG (CORE, "Received termination signal, quitting");
+  g_main_loop_quit (loop);
+
+  return TRUE;
+}
+
+static guint
+install_quit_handlers (GMainLoop *loop)
+{
+  struct sigaction action;
+  GIOChannel *channel;
+  guint id;
+
+  if (pipe (quit_pipe) < 0) {
+    g_warning ("Cannot create signal pipe: %s", g_strerror (errno));
+    return 0;
+  }
+
+  fcntl (quit_pipe[1], F_SETFL, O_NONBLOCK);
+
+  channel = g_io_channel_unix_new (quit_pipe[0]);
+  id = g_io_add_watch (channel, G_IO_IN, quit_pipe_cb, loop);
+  g_io_channel_unref (channel);
+
+  memset (&action, 0, sizeof (action));
+  action.sa_handler = quit_signal_handler;
+  sigemptyset (&action.sa_mask);
+  sigaction (SIGTERM, &action, NULL);
+  sigaction (SIGINT, &action, NULL);
+
+  return id;
+}
+
+static void
+remove_quit_handlers (guint id)
+{
+  if (id == 0)
+    return;
+
+  signal (SIGTERM, SIG_DFL);
+  signal (SIGINT, SIG_DFL);
+
+  g_source_remove (id);
+  close (quit_pipe[0]);
+  close (quit_pipe[1]);
+  quit_pipe[0] = quit_pipe[1] = -1;
+}
+
 void
 sw_core_run (SwCore *core)
 {
   GMainLoop *loop;
+  guint quit_id;
 
   g_return_if_fail (SW_IS_CORE (core));
 
   loop = g_main_loop_new (NULL, TRUE);
+  quit_id = install_quit_handlers (loop);
+
   g_main_loop_run (loop);
+
+  remove_quit_handlers (quit_id);
   g_main_loop_unref (loop);
+
+  /* Don't lose any cache writes that are still queued */
+  sw_cache_flush ();
 }
 
 gboolean
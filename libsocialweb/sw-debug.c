@@ -41,7 +41,10 @@ sw_debug_init (const char *string)
     { "smugmug", SW_DEBUG_SMUGMUG },
     { "photobucket", SW_DEBUG_PHOTOBUCKET },
     { "facebook", SW_DEBUG_FACEBOOK },
-    { "client-monitor", SW_DEBUG_CLIENT_MONITOR }
+    { "client-monitor", SW_DEBUG_CLIENT_MONITOR },
+    { "web", SW_DEBUG_WEB },
+    { "poll", SW_DEBUG_POLL },
+    { "governor", SW_DEBUG_GOVERNOR }
   };
 
   if (G_LIKELY (setup_done))
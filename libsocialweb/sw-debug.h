@@ -32,7 +32,10 @@ typedef enum {
   SW_DEBUG_SMUGMUG = 1 << 10,
   SW_DEBUG_PHOTOBUCKET = 1 << 11,
   SW_DEBUG_FACEBOOK = 1 << 12,
-  SW_DEBUG_CLIENT_MONITOR = 1 << 13
+  SW_DEBUG_CLIENT_MONITOR = 1 << 13,
+  SW_DEBUG_WEB = 1 << 14,
+  SW_DEBUG_POLL = 1 << 15,
+  SW_DEBUG_GOVERNOR = 1 << 16
 } SwDebugFlags;
 
 extern guint sw_debug_flags;
@@ -304,27 +304,27 @@ _handle_ready_pending_cb (gpointer data)
   SwItemStream *item_stream = SW_ITEM_STREAM (data);
   SwItemStreamPrivate *priv = GET_PRIVATE (item_stream);
   GList *items_to_send = NULL;
-  GList *pending_items, *l;
+  SwSetIter iter;
+  GObject *object;
 
   SW_DEBUG (VIEWS, "Delayed ready timeout fired");
 
-  /* FIXME: Reword this to avoid unnecessary list creation ? */
-  pending_items = sw_set_as_list (priv->pending_items_set);
-
-  for (l = pending_items; l; l = l->next)
+  sw_set_iter_init (&iter, priv->pending_items_set);
+  while (sw_set_iter_next (&iter, &object))
   {
-    SwItem *item = SW_ITEM (l->data);
+    SwItem *item = SW_ITEM (object);
 
     if (sw_item_get_ready (item))
     {
-      items_to_send = g_list_prepend (items_to_send, item);
-      sw_set_remove (priv->pending_items_set, (GObject *)item);
+      items_to_send = g_list_prepend (items_to_send, g_object_ref (item));
+      sw_set_iter_remove (&iter);
     }
   }
 
   sw_item_stream_add_items (item_stream, items_to_send);
 
-  g_list_free (pending_items);
+  g_list_foreach (items_to_send, (GFunc)g_object_unref, NULL);
+  g_list_free (items_to_send);
 
   priv->pending_timeout_id = 0;
 
@@ -23,6 +23,13 @@
 
 #include <libsocialweb/sw-utils.h>
 #include <libsocialweb/sw-core.h>
+#include <libsocialweb/sw-cache.h>
+#include <dbus/dbus-glib.h>
+
+#include "sw-thumbnails.h"
+#include "sw-client-monitor.h"
+#include "sw-view-multiplexer.h"
+#include "sw-poll-scheduler.h"
 
 static void sw_item_view_iface_init (gpointer g_iface, gpointer iface_data);
 G_DEFINE_TYPE_WITH_CODE (SwItemView, sw_item_view, G_TYPE_OBJECT,
@@ -37,25 +44,96 @@ typedef struct _SwItemViewPrivate SwItemViewPrivate;
 struct _SwItemViewPrivate {
   SwService *service;
   gchar *object_path;
+  gboolean registered;
   SwSet *current_items_set;
   SwSet *pending_items_set;
 
   /* timeout used for coalescing multiple delayed ready additions */
   guint pending_timeout_id;
 
+  /* Items that became ready since the last flush, and when to flush */
+  guint n_ready;
+  guint ready_latency;
+  guint ready_batch_size;
+
+  /*
+   * Whether items are added before they are ready, and those items that have
+   * since become ready and need to be sent again
+   */
+  gboolean add_immediately;
+  GQueue landed_items;
+
+  /*
+   * Sender => how many of its uses of the view want changes as
+   * ItemsChangedDelta rather than ItemsChanged. The view may be shared with
+   * clients that don't.
+   */
+  GHashTable *delta_senders;
+
   /* timeout used for ratelimiting checking for changed items */
   guint refresh_timeout_id;
 
   GHashTable *uid_to_items;
 
-  GList *changed_items;
+  /* The current items newest first, and uid => position in it */
+  GSequence *ordered_items;
+  GHashTable *uid_to_iter;
+
+  /* Most items the view holds, 0 for no limit */
+  guint max_items;
+
+  /*
+   * The part of ordered_items the client follows, see SetWindow. The uids
+   * are those the client has been sent; NULL if the client follows
+   * everything.
+   */
+  guint window_offset;
+  guint window_count;
+  GHashTable *window_uids;
+  guint window_sync_id;
+
+  /* Items that changed since the last ItemsChanged, in order of change */
+  GQueue changed_items;
+  GHashTable *changed_items_set;
+
+  /* Seconds to coalesce changes for, and the batch size that flushes early */
+  guint changed_window;
+  guint changed_max_batch;
+
+  /* Seconds between refreshes, adapted to how often they find changes */
+  SwPollInterval refresh;
+
+  /* cached items still to be added, newest first */
+  GList *cached_items;
+  guint cache_stream_id;
+
+  /*
+   * Sender => how many of its uses of the view have started it and not
+   * stopped it. A client may open a shared view more than once.
+   */
+  GHashTable *started_by;
 };
 
+/* Number of cached items added in each ItemsAdded emission */
+#define CACHE_STREAM_CHUNK 20
+
+/*
+ * Default coalescing of items that were waiting to be ready: milliseconds
+ * from the first one becoming ready, and the most to hold
+ */
+#define READY_LATENCY_DEFAULT 250
+#define READY_BATCH_SIZE_DEFAULT 25
+
+/* Default coalescing of ItemsChanged: seconds to wait, and the most to hold */
+#define CHANGED_WINDOW_DEFAULT 10
+#define CHANGED_MAX_BATCH_DEFAULT 100
+
 enum
 {
   PROP_0,
   PROP_SERVICE,
-  PROP_OBJECT_PATH
+  PROP_OBJECT_PATH,
+  PROP_REGISTER
 };
 
 #if 0
@@ -73,6 +151,12 @@ static void sw_item_view_update_items (SwItemView *item_view,
                                        GList      *items);
 static void sw_item_view_remove_items (SwItemView *item_view,
                                        GList      *items);
+static void _stop_cache_stream (SwItemView *item_view);
+static void _enforce_max_items (SwItemView *item_view);
+static void _touch_thumbnails (SwItem *item);
+static gboolean _item_is_visible (SwItemView *item_view,
+                                  SwItem     *item);
+static GValueArray *_item_to_sent_value_array (SwItem *item);
 
 static void
 sw_item_view_get_property (GObject    *object,
@@ -89,6 +173,9 @@ sw_item_view_get_property (GObject    *object,
     case PROP_OBJECT_PATH:
       g_value_set_string (value, priv->object_path);
       break;
+    case PROP_REGISTER:
+      g_value_set_boolean (value, priv->registered);
+      break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
   }
@@ -106,6 +193,9 @@ sw_item_view_set_property (GObject      *object,
     case PROP_SERVICE:
       priv->service = g_value_dup_object (value);
       break;
+    case PROP_REGISTER:
+      priv->registered = g_value_get_boolean (value);
+      break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
   }
@@ -134,6 +224,18 @@ sw_item_view_dispose (GObject *object)
     priv->pending_items_set = NULL;
   }
 
+  if (priv->ordered_items)
+  {
+    g_sequence_free (priv->ordered_items);
+    priv->ordered_items = NULL;
+  }
+
+  if (priv->uid_to_iter)
+  {
+    g_hash_table_unref (priv->uid_to_iter);
+    priv->uid_to_iter = NULL;
+  }
+
   if (priv->uid_to_items)
   {
     g_hash_table_unref (priv->uid_to_items);
@@ -146,12 +248,37 @@ sw_item_view_dispose (GObject *object)
     priv->pending_timeout_id = 0;
   }
 
+  g_queue_foreach (&priv->landed_items, (GFunc)g_object_unref, NULL);
+  g_queue_clear (&priv->landed_items);
+
+  if (priv->window_sync_id)
+  {
+    g_source_remove (priv->window_sync_id);
+    priv->window_sync_id = 0;
+  }
+
+  if (priv->window_uids)
+  {
+    g_hash_table_unref (priv->window_uids);
+    priv->window_uids = NULL;
+  }
+
   if (priv->refresh_timeout_id)
   {
     g_source_remove (priv->refresh_timeout_id);
     priv->refresh_timeout_id = 0;
   }
 
+  if (priv->changed_items_set)
+  {
+    g_queue_foreach (&priv->changed_items, (GFunc)g_object_unref, NULL);
+    g_queue_clear (&priv->changed_items);
+    g_hash_table_unref (priv->changed_items_set);
+    priv->changed_items_set = NULL;
+  }
+
+  _stop_cache_stream ((SwItemView *)object);
+
   G_OBJECT_CLASS (sw_item_view_parent_class)->dispose (object);
 }
 
@@ -161,6 +288,8 @@ sw_item_view_finalize (GObject *object)
   SwItemViewPrivate *priv = GET_PRIVATE (object);
 
   g_free (priv->object_path);
+  g_hash_table_unref (priv->started_by);
+  g_hash_table_unref (priv->delta_senders);
 
   G_OBJECT_CLASS (sw_item_view_parent_class)->finalize (object);
 }
@@ -186,13 +315,16 @@ sw_item_view_constructed (GObject *object)
   SwItemViewPrivate *priv = GET_PRIVATE (item_view);
   SwCore *core;
 
-  core = sw_core_dup_singleton ();
-
   priv->object_path = _make_object_path (item_view);
-  dbus_g_connection_register_g_object (sw_core_get_connection (core),
-                                       priv->object_path,
-                                       G_OBJECT (item_view));
-  g_object_unref (core);
+
+  if (priv->registered)
+  {
+    core = sw_core_dup_singleton ();
+    dbus_g_connection_register_g_object (sw_core_get_connection (core),
+                                         priv->object_path,
+                                         G_OBJECT (item_view));
+    g_object_unref (core);
+  }
   /* The only reference should be the one on the bus */
 
   if (G_OBJECT_CLASS (sw_item_view_parent_class)->constructed)
@@ -208,10 +340,13 @@ sw_item_view_default_close (SwItemView *item_view)
 
   SW_DEBUG (VIEWS, "%s called on %s", G_STRFUNC, priv->object_path);
 
-  core = sw_core_dup_singleton ();
-  dbus_g_connection_unregister_g_object (sw_core_get_connection (core),
-                                         G_OBJECT (item_view));
-  g_object_unref (core);
+  if (priv->registered)
+  {
+    core = sw_core_dup_singleton ();
+    dbus_g_connection_unregister_g_object (sw_core_get_connection (core),
+                                           G_OBJECT (item_view));
+    g_object_unref (core);
+  }
 
   /* Object is no longer needed */
   g_object_unref (item_view);
@@ -233,6 +368,8 @@ sw_item_view_class_init (SwItemViewClass *klass)
 
   klass->close = sw_item_view_default_close;
 
+  sw_client_monitor_add_notify (_client_gone_cb, NULL);
+
   pspec = g_param_spec_object ("service",
                                "service",
                                "The service this view is using",
@@ -246,6 +383,13 @@ sw_item_view_class_init (SwItemViewClass *klass)
                                NULL,
                                G_PARAM_READABLE);
   g_object_class_install_property (object_class, PROP_OBJECT_PATH, pspec);
+
+  pspec = g_param_spec_boolean ("register",
+                                "Register",
+                                "Whether to export the view on the bus",
+                                TRUE,
+                                G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+  g_object_class_install_property (object_class, PROP_REGISTER, pspec);
 }
 
 static void
@@ -260,10 +404,237 @@ sw_item_view_init (SwItemView *self)
                                               g_str_equal,
                                               g_free,
                                               g_object_unref);
+
+  priv->ready_latency = READY_LATENCY_DEFAULT;
+  priv->ready_batch_size = READY_BATCH_SIZE_DEFAULT;
+  g_queue_init (&priv->landed_items);
+
+  g_queue_init (&priv->changed_items);
+  priv->changed_items_set = g_hash_table_new (NULL, NULL);
+  priv->changed_window = CHANGED_WINDOW_DEFAULT;
+  priv->changed_max_batch = CHANGED_MAX_BATCH_DEFAULT;
+
+  sw_poll_interval_init (&priv->refresh);
+
+  /* The items are owned by uid_to_items */
+  priv->ordered_items = g_sequence_new (NULL);
+  priv->uid_to_iter = g_hash_table_new_full (g_str_hash,
+                                             g_str_equal,
+                                             g_free,
+                                             NULL);
+
+  priv->started_by = g_hash_table_new_full (g_str_hash,
+                                            g_str_equal,
+                                            g_free,
+                                            NULL);
+  priv->delta_senders = g_hash_table_new_full (g_str_hash,
+                                               g_str_equal,
+                                               g_free,
+                                               NULL);
 }
 
 /* DBUS interface to class vfunc bindings */
 
+/*
+ * Send everything in the view again, for a client that has just started a
+ * view that other clients were already using.
+ */
+static void
+_resend_items (SwItemView *item_view)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  GPtrArray *ptr_array;
+  GSequenceIter *iter;
+
+  /* Windowed views are never shared */
+  if (priv->window_uids)
+    return;
+
+  ptr_array = g_ptr_array_new_with_free_func ((GDestroyNotify)g_value_array_free);
+
+  for (iter = g_sequence_get_begin_iter (priv->ordered_items);
+       !g_sequence_iter_is_end (iter);
+       iter = g_sequence_iter_next (iter))
+  {
+    SwItem *item = g_sequence_get (iter);
+
+    if (!_item_is_visible (item_view, item))
+      continue;
+
+    _touch_thumbnails (item);
+    g_ptr_array_add (ptr_array, _item_to_sent_value_array (item));
+  }
+
+  SW_DEBUG (VIEWS, "Sending %d items again", ptr_array->len);
+
+  if (ptr_array->len > 0)
+    sw_item_view_iface_emit_items_added (item_view, ptr_array);
+
+  g_ptr_array_free (ptr_array, TRUE);
+}
+
+static guint
+_get_sender_count (GHashTable  *counts,
+                   const gchar *sender)
+{
+  return GPOINTER_TO_UINT (g_hash_table_lookup (counts, sender));
+}
+
+/*
+ * Set the count for @sender in @counts, which is at most the number of times
+ * it is using @item_view.
+ */
+static void
+_set_sender_count (SwItemView  *item_view,
+                   GHashTable  *counts,
+                   const gchar *sender,
+                   guint        count)
+{
+  guint uses;
+
+  uses = sw_client_monitor_get_n_uses (sender, G_OBJECT (item_view));
+  count = MIN (count, MAX (uses, 1));
+
+  if (count)
+    g_hash_table_insert (counts, g_strdup (sender), GUINT_TO_POINTER (count));
+  else
+    g_hash_table_remove (counts, sender);
+}
+
+static guint
+_get_total_count (GHashTable *counts)
+{
+  GHashTableIter iter;
+  gpointer value;
+  guint total = 0;
+
+  g_hash_table_iter_init (&iter, counts);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    total += GPOINTER_TO_UINT (value);
+
+  return total;
+}
+
+/*
+ * @sender has started the view. The view may be shared, in which case it only
+ * needs starting once. This takes the sender.
+ */
+static void
+_start (SwItemView *item_view,
+        gchar      *sender)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  gboolean running;
+
+  running = g_hash_table_size (priv->started_by) > 0;
+  _set_sender_count (item_view, priv->started_by, sender,
+                     _get_sender_count (priv->started_by, sender) + 1);
+  g_free (sender);
+
+  if (running)
+    _resend_items (item_view);
+  else if (SW_ITEM_VIEW_GET_CLASS (item_view)->start)
+    SW_ITEM_VIEW_GET_CLASS (item_view)->start (item_view);
+}
+
+/*
+ * Leave @sender with at most @count starts of the view. Keep going while
+ * other uses of the view still want it.
+ */
+static void
+_stop_to (SwItemView  *item_view,
+          const gchar *sender,
+          guint        count)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+
+  if (_get_sender_count (priv->started_by, sender) <= count)
+    return;
+
+  _set_sender_count (item_view, priv->started_by, sender, count);
+
+  if (g_hash_table_size (priv->started_by) == 0 &&
+      SW_ITEM_VIEW_GET_CLASS (item_view)->stop)
+    SW_ITEM_VIEW_GET_CLASS (item_view)->stop (item_view);
+}
+
+/*
+ * @sender has stopped one of its uses of the view.
+ */
+static void
+_stop (SwItemView  *item_view,
+       const gchar *sender)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  guint count;
+
+  count = _get_sender_count (priv->started_by, sender);
+  if (count)
+    _stop_to (item_view, sender, count - 1);
+}
+
+/*
+ * @sender has closed the view. This takes the sender.
+ */
+static void
+_close (SwItemView *item_view,
+        gchar      *sender)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  gboolean shared;
+  guint remaining;
+
+  /*
+   * The uses of a view by one client can't be told apart, so its other uses
+   * keep their modes unless there are now more of them than uses left.
+   */
+  remaining = sw_client_monitor_get_n_uses (sender, G_OBJECT (item_view));
+  remaining = remaining ? remaining - 1 : 0;
+  if (_get_sender_count (priv->delta_senders, sender) > remaining)
+    _set_sender_count (item_view, priv->delta_senders, sender, remaining);
+
+  shared = sw_client_monitor_get_n_clients (G_OBJECT (item_view)) > 1;
+  if (shared)
+    _stop_to (item_view, sender, remaining);
+  else
+    g_hash_table_remove (priv->started_by, sender);
+
+  /*
+   * Stop tracking the client, so that it going away later doesn't drop the
+   * view again. This takes the sender.
+   */
+  sw_client_monitor_remove (sender, G_OBJECT (item_view));
+
+  if (shared)
+  {
+    /* Other clients still use the view, so just drop our reference */
+    g_object_unref (item_view);
+  } else if (SW_ITEM_VIEW_GET_CLASS (item_view)->close) {
+    SW_ITEM_VIEW_GET_CLASS (item_view)->close (item_view);
+  }
+}
+
+/*
+ * A client went away without closing the view. The client monitor drops its
+ * reference after this.
+ */
+static void
+_client_gone_cb (const char *sender,
+                 GObject    *object,
+                 gpointer    user_data)
+{
+  SwItemView *item_view;
+
+  if (!SW_IS_ITEM_VIEW (object))
+    return;
+
+  item_view = SW_ITEM_VIEW (object);
+
+  /* This is called for each use, but every one of them has gone */
+  g_hash_table_remove (GET_PRIVATE (item_view)->delta_senders, sender);
+  _stop_to (item_view, sender, 0);
+}
+
 static void
 sw_item_view_start (SwItemViewIface       *iface,
                     DBusGMethodInvocation *context)
@@ -273,8 +644,7 @@ sw_item_view_start (SwItemViewIface       *iface,
 
   SW_DEBUG (VIEWS, "%s called on %s", G_STRFUNC, priv->object_path);
 
-  if (SW_ITEM_VIEW_GET_CLASS (iface)->start)
-    SW_ITEM_VIEW_GET_CLASS (iface)->start (item_view);
+  _start (item_view, dbus_g_method_get_sender (context));
 
   sw_item_view_iface_return_from_start (context);
 }
@@ -300,11 +670,13 @@ sw_item_view_stop (SwItemViewIface       *iface,
 {
   SwItemView *item_view = SW_ITEM_VIEW (iface);
   SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  gchar *sender;
 
   SW_DEBUG (VIEWS, "%s called on %s", G_STRFUNC, priv->object_path);
 
-  if (SW_ITEM_VIEW_GET_CLASS (iface)->stop)
-    SW_ITEM_VIEW_GET_CLASS (iface)->stop (item_view);
+  sender = dbus_g_method_get_sender (context);
+  _stop (item_view, sender);
+  g_free (sender);
 
   sw_item_view_iface_return_from_stop (context);
 }
@@ -318,623 +690,2177 @@ sw_item_view_close (SwItemViewIface       *iface,
 
   SW_DEBUG (VIEWS, "%s called on %s", G_STRFUNC, priv->object_path);
 
-  if (SW_ITEM_VIEW_GET_CLASS (iface)->close)
-    SW_ITEM_VIEW_GET_CLASS (iface)->close (item_view);
+  _close (item_view, dbus_g_method_get_sender (context));
 
   sw_item_view_iface_return_from_close (context);
 }
 
-static void
-sw_item_view_iface_init (gpointer g_iface,
-                         gpointer iface_data)
+/*
+ * Everything about @item is about to be broadcast, so nothing is left dirty.
+ * Method replies go to a single caller and must use _sw_item_to_value_array.
+ */
+static GValueArray *
+_item_to_sent_value_array (SwItem *item)
 {
-  SwItemViewIfaceClass *klass = (SwItemViewIfaceClass*)g_iface;
-  sw_item_view_iface_implement_start (klass, sw_item_view_start);
-  sw_item_view_iface_implement_refresh (klass, sw_item_view_refresh);
-  sw_item_view_iface_implement_stop (klass, sw_item_view_stop);
-  sw_item_view_iface_implement_close (klass, sw_item_view_close);
+  sw_item_clear_dirty (item);
+
+  return _sw_item_to_value_array (item);
 }
 
-static gboolean
-_handle_ready_pending_cb (gpointer data)
+typedef struct {
+  GHashTable *set_keys;
+  GPtrArray *removed_keys;
+} ItemDelta;
+
+static void
+_add_to_delta (gpointer key,
+               gpointer value,
+               gpointer user_data)
 {
-  SwItemView *item_view = SW_ITEM_VIEW (data);
-  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
-  GList *items_to_send = NULL;
-  GList *pending_items, *l;
+  ItemDelta *delta = (ItemDelta *)user_data;
 
-  SW_DEBUG (VIEWS, "Delayed ready timeout fired");
+  if (value)
+    g_hash_table_insert (delta->set_keys, key, value);
+  else
+    g_ptr_array_add (delta->removed_keys, g_strdup (key));
+}
 
-  /* FIXME: Reword this to avoid unnecessary list creation ? */
-  pending_items = sw_set_as_list (priv->pending_items_set);
+/*
+ * Construct the (service, id, time, set keys, removed keys) structure that
+ * ItemsChangedDelta sends for @item, from the keys that changed since it was
+ * last sent.
+ */
+static GValueArray *
+_item_to_delta_value_array (SwItem *item)
+{
+  GValueArray *value_array;
+  ItemDelta delta;
 
-  for (l = pending_items; l; l = l->next)
-  {
-    SwItem *item = SW_ITEM (l->data);
+  delta.set_keys = g_hash_table_new (g_str_hash, g_str_equal);
+  delta.removed_keys = g_ptr_array_new ();
 
-    if (sw_item_get_ready (item))
-    {
-      items_to_send = g_list_prepend (items_to_send, item);
-      sw_set_remove (priv->pending_items_set, (GObject *)item);
-    }
-  }
+  sw_item_foreach_dirty (item, _add_to_delta, &delta);
+  sw_item_clear_dirty (item);
 
-  sw_item_view_add_items (item_view, items_to_send);
+  g_ptr_array_add (delta.removed_keys, NULL);
 
-  g_list_free (pending_items);
+  value_array = g_value_array_new (5);
 
-  priv->pending_timeout_id = 0;
+  value_array = g_value_array_append (value_array, NULL);
+  g_value_init (g_value_array_get_nth (value_array, 0), G_TYPE_STRING);
+  g_value_set_string (g_value_array_get_nth (value_array, 0),
+                      sw_service_get_name (sw_item_get_service (item)));
 
-  return FALSE;
-}
+  value_array = g_value_array_append (value_array, NULL);
+  g_value_init (g_value_array_get_nth (value_array, 1), G_TYPE_STRING);
+  g_value_set_string (g_value_array_get_nth (value_array, 1),
+                      sw_item_get (item, "id"));
 
-static void
-_item_ready_weak_notify_cb (gpointer  data,
-                            GObject  *dead_object);
+  value_array = g_value_array_append (value_array, NULL);
+  g_value_init (g_value_array_get_nth (value_array, 2), G_TYPE_INT64);
+  g_value_set_int64 (g_value_array_get_nth (value_array, 2),
+                     sw_item_get_date (item));
 
-static void
-_item_ready_notify_cb (SwItem     *item,
-                       GParamSpec *pspec,
-                       SwItemView *item_view)
-{
-  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  value_array = g_value_array_append (value_array, NULL);
+  g_value_init (g_value_array_get_nth (value_array, 3),
+                dbus_g_type_get_map ("GHashTable",
+                                     G_TYPE_STRING,
+                                     G_TYPE_STRING));
+  /* The item won't change before the signal is emitted */
+  g_value_take_boxed (g_value_array_get_nth (value_array, 3),
+                      delta.set_keys);
 
-  if (sw_item_get_ready (item)) {
-    SW_DEBUG (VIEWS, "Item became ready: %s.",
-              sw_item_get (item, "id"));
-    g_signal_handlers_disconnect_by_func (item,
-                                          _item_ready_notify_cb,
-                                          item_view);
-    g_object_weak_unref ((GObject *)item_view,
-                         _item_ready_weak_notify_cb,
-                         item);
+  value_array = g_value_array_append (value_array, NULL);
+  g_value_init (g_value_array_get_nth (value_array, 4), G_TYPE_STRV);
+  g_value_take_boxed (g_value_array_get_nth (value_array, 4),
+                      g_ptr_array_free (delta.removed_keys, FALSE));
 
-    if (!priv->pending_timeout_id)
-    {
-      SW_DEBUG (VIEWS, "Setting up timeout");
-      priv->pending_timeout_id = g_timeout_add_seconds (1,
-                                                        _handle_ready_pending_cb,
-                                                        item_view);
-    } else {
-      SW_DEBUG (VIEWS, "Timeout already set up.");
-    }
-  }
+  return value_array;
 }
 
-static void
-_item_ready_weak_notify_cb (gpointer  data,
-                            GObject  *dead_object)
+/*
+ * Items that are held back until they are ready haven't been sent yet, so
+ * they don't count when paging through the view.
+ */
+static gboolean
+_item_is_visible (SwItemView *item_view,
+                  SwItem     *item)
 {
-  g_signal_handlers_disconnect_by_func (data,
-                                        _item_ready_notify_cb,
-                                        dead_object);
-}
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
 
-static void
-_setup_ready_handler (SwItem     *item,
-                      SwItemView *item_view)
-{
-  g_signal_connect (item,
-                    "notify::ready",
-                    (GCallback)_item_ready_notify_cb,
-                    item_view);
-  g_object_weak_ref ((GObject *)item_view,
-                     _item_ready_weak_notify_cb,
-                     item);
+  return !sw_set_has (priv->pending_items_set, (GObject *)item);
 }
 
-static gboolean
-_item_changed_timeout_cb (gpointer data)
+static GValueArray *
+_make_removed_value_array (const gchar *service_name,
+                           const gchar *uid)
 {
-  SwItemView *item_view = SW_ITEM_VIEW (data);
-  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  GValueArray *value_array;
 
-  sw_item_view_update_items (item_view, priv->changed_items);
-  g_list_foreach (priv->changed_items, (GFunc)g_object_unref, NULL);
-  g_list_free (priv->changed_items);
-  priv->changed_items = NULL;
+  value_array = g_value_array_new (2);
 
-  priv->refresh_timeout_id = 0;
+  value_array = g_value_array_append (value_array, NULL);
+  g_value_init (g_value_array_get_nth (value_array, 0), G_TYPE_STRING);
+  g_value_set_string (g_value_array_get_nth (value_array, 0), service_name);
 
-  return FALSE;
+  value_array = g_value_array_append (value_array, NULL);
+  g_value_init (g_value_array_get_nth (value_array, 1), G_TYPE_STRING);
+  g_value_set_string (g_value_array_get_nth (value_array, 1), uid);
+
+  return value_array;
 }
 
+/*
+ * Work out which items are in the window now and send the client the
+ * difference from what it had.
+ */
 static void
-_item_changed_cb (SwItem     *item,
-                  SwItemView *item_view)
+_sync_window (SwItemView *item_view)
 {
   SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  GHashTable *window;
+  GPtrArray *added, *removed;
+  GSequenceIter *iter;
+  GHashTableIter hash_iter;
+  const gchar *uid;
+  guint pos = 0;
+
+  if (priv->window_sync_id)
+  {
+    g_source_remove (priv->window_sync_id);
+    priv->window_sync_id = 0;
+  }
 
-  /* We only care if the item is ready. If it's not then we don't want to be
-   * emitting changed but instead it will be added through the readiness
-   * tracking.
-   */
-  if (!sw_item_get_ready (item))
-    return;
-
-  if (!g_list_find (priv->changed_items, item))
-    priv->changed_items = g_list_append (priv->changed_items, item);
+  window = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  added = g_ptr_array_new_with_free_func ((GDestroyNotify)g_value_array_free);
+  removed = g_ptr_array_new_with_free_func ((GDestroyNotify)g_value_array_free);
 
-  if (!priv->refresh_timeout_id)
+  for (iter = g_sequence_get_begin_iter (priv->ordered_items);
+       !g_sequence_iter_is_end (iter);
+       iter = g_sequence_iter_next (iter))
   {
+    SwItem *item = g_sequence_get (iter);
+
+    if (!_item_is_visible (item_view, item))
+      continue;
+
+    if (pos < priv->window_offset)
+    {
+      pos++;
+      continue;
+    }
+
+    if (priv->window_count && pos >= priv->window_offset + priv->window_count)
+      break;
+
+    pos++;
+
+    uid = sw_item_get (item, "id");
+    g_hash_table_insert (window, g_strdup (uid), GINT_TO_POINTER (TRUE));
+
+    if (!g_hash_table_lookup (priv->window_uids, uid))
+    {
+      _touch_thumbnails (item);
+      g_ptr_array_add (added, _item_to_sent_value_array (item));
+    }
+  }
+
+  g_hash_table_iter_init (&hash_iter, priv->window_uids);
+  while (g_hash_table_iter_next (&hash_iter, (gpointer *)&uid, NULL))
+  {
+    if (!g_hash_table_lookup (window, uid))
+      g_ptr_array_add (removed,
+                       _make_removed_value_array (sw_service_get_name (priv->service),
+                                                  uid));
+  }
+
+  g_hash_table_unref (priv->window_uids);
+  priv->window_uids = window;
+
+  SW_DEBUG (VIEWS, "Window moved: %d items in, %d items out",
+            added->len, removed->len);
+
+  if (removed->len > 0)
+    sw_item_view_iface_emit_items_removed (item_view, removed);
+
+  if (added->len > 0)
+    sw_item_view_iface_emit_items_added (item_view, added);
+
+  g_ptr_array_free (removed, TRUE);
+  g_ptr_array_free (added, TRUE);
+}
+
+static gboolean
+_sync_window_cb (gpointer data)
+{
+  SwItemView *item_view = SW_ITEM_VIEW (data);
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+
+  priv->window_sync_id = 0;
+  _sync_window (item_view);
+
+  return FALSE;
+}
+
+/*
+ * Called instead of sending ItemsAdded and ItemsRemoved when the client is
+ * following a window. Returns FALSE if it isn't.
+ */
+static gboolean
+_queue_window_sync (SwItemView *item_view)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+
+  if (priv->window_uids == NULL)
+    return FALSE;
+
+  if (!priv->window_sync_id)
+    priv->window_sync_id = g_idle_add (_sync_window_cb, item_view);
+
+  return TRUE;
+}
+
+static void
+sw_item_view_get_items (SwItemViewIface       *iface,
+                        guint                  offset,
+                        guint                  count,
+                        DBusGMethodInvocation *context)
+{
+  SwItemView *item_view = SW_ITEM_VIEW (iface);
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  GPtrArray *ptr_array;
+  GSequenceIter *iter;
+  guint pos = 0;
+
+  SW_DEBUG (VIEWS, "%s called on %s", G_STRFUNC, priv->object_path);
+
+  ptr_array = g_ptr_array_new_with_free_func ((GDestroyNotify)g_value_array_free);
+
+  for (iter = g_sequence_get_begin_iter (priv->ordered_items);
+       !g_sequence_iter_is_end (iter);
+       iter = g_sequence_iter_next (iter))
+  {
+    SwItem *item = g_sequence_get (iter);
+
+    if (!_item_is_visible (item_view, item))
+      continue;
+
+    /*
+     * This only goes to the caller, so changes queued for the signal
+     * subscribers must stay dirty
+     */
+    if (pos >= offset && (count == 0 || pos < offset + count))
+    {
+      _touch_thumbnails (item);
+      g_ptr_array_add (ptr_array, _sw_item_to_value_array (item));
+    }
+
+    pos++;
+  }
+
+  sw_item_view_iface_return_from_get_items (context, ptr_array, pos);
+
+  g_ptr_array_free (ptr_array, TRUE);
+}
+
+static void
+_set_window (SwItemView *item_view,
+             guint       offset,
+             guint       count)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  GSequenceIter *iter;
+
+  /* What this client sees is now different to what anyone else would */
+  sw_view_multiplexer_remove (G_OBJECT (item_view));
+
+  if (priv->window_uids == NULL)
+  {
+    /* Up to now the client has been sent everything */
+    priv->window_uids = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                               g_free, NULL);
+
+    for (iter = g_sequence_get_begin_iter (priv->ordered_items);
+         !g_sequence_iter_is_end (iter);
+         iter = g_sequence_iter_next (iter))
+    {
+      SwItem *item = g_sequence_get (iter);
+
+      if (_item_is_visible (item_view, item))
+        g_hash_table_insert (priv->window_uids,
+                             g_strdup (sw_item_get (item, "id")),
+                             GINT_TO_POINTER (TRUE));
+    }
+  }
+
+  priv->window_offset = offset;
+  priv->window_count = count;
+
+  _sync_window (item_view);
+}
+
+static void
+sw_item_view_set_window (SwItemViewIface       *iface,
+                         guint                  offset,
+                         guint                  count,
+                         DBusGMethodInvocation *context)
+{
+  SwItemView *item_view = SW_ITEM_VIEW (iface);
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+
+  SW_DEBUG (VIEWS, "%s called on %s: %u items from %u",
+            G_STRFUNC, priv->object_path, count, offset);
+
+  /*
+   * The window belongs to the view, so one client can't narrow what the
+   * others sharing it see
+   */
+  if (sw_client_monitor_get_n_clients (G_OBJECT (item_view)) > 1)
+  {
+    dbus_g_method_return_error (context,
+                                g_error_new (SW_SERVICE_ERROR,
+                                             SW_SERVICE_ERROR_NOT_SUPPORTED,
+                                             "Views shared with other clients "
+                                             "can't have a window"));
+    return;
+  }
+
+  _set_window (item_view, offset, count);
+
+  sw_item_view_iface_return_from_set_window (context);
+}
+
+/*
+ * Changes are sent to @sender as ItemsChangedDelta if @enabled. This takes
+ * the sender.
+ */
+static void
+_set_change_deltas (SwItemView *item_view,
+                    gchar      *sender,
+                    gboolean    enabled)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  guint count;
+
+  count = _get_sender_count (priv->delta_senders, sender);
+
+  if (enabled)
+    _set_sender_count (item_view, priv->delta_senders, sender, count + 1);
+  else if (count)
+    _set_sender_count (item_view, priv->delta_senders, sender, count - 1);
+
+  g_free (sender);
+}
+
+/*
+ * Whether any client wants ItemsChanged. Every client using the view that
+ * hasn't asked for ItemsChangedDelta does.
+ */
+static gboolean
+_wants_full_changes (SwItemView *item_view)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  guint n_deltas;
+
+  n_deltas = _get_total_count (priv->delta_senders);
+
+  return n_deltas == 0 ||
+    sw_client_monitor_get_n_clients (G_OBJECT (item_view)) > n_deltas;
+}
+
+static void
+sw_item_view_set_change_deltas (SwItemViewIface       *iface,
+                                gboolean               enabled,
+                                DBusGMethodInvocation *context)
+{
+  SwItemView *item_view = SW_ITEM_VIEW (iface);
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+
+  SW_DEBUG (VIEWS, "%s called on %s: %d",
+            G_STRFUNC, priv->object_path, enabled);
+
+  _set_change_deltas (item_view, dbus_g_method_get_sender (context), enabled);
+
+  sw_item_view_iface_return_from_set_change_deltas (context);
+}
+
+static void
+sw_item_view_iface_init (gpointer g_iface,
+                         gpointer iface_data)
+{
+  SwItemViewIfaceClass *klass = (SwItemViewIfaceClass*)g_iface;
+  sw_item_view_iface_implement_start (klass, sw_item_view_start);
+  sw_item_view_iface_implement_refresh (klass, sw_item_view_refresh);
+  sw_item_view_iface_implement_stop (klass, sw_item_view_stop);
+  sw_item_view_iface_implement_close (klass, sw_item_view_close);
+  sw_item_view_iface_implement_get_items (klass, sw_item_view_get_items);
+  sw_item_view_iface_implement_set_window (klass, sw_item_view_set_window);
+  sw_item_view_iface_implement_set_change_deltas (klass,
+                                                  sw_item_view_set_change_deltas);
+}
+
+/*
+ * Send the items that have become ready: ItemsAdded for those that were held
+ * back, ItemsChanged for those that were added before they were ready.
+ */
+static void
+_flush_ready_items (SwItemView *item_view)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  GList *items_to_send = NULL;
+  SwSetIter iter;
+  GObject *object;
+  GQueue landed;
+
+  if (priv->pending_timeout_id)
+  {
+    g_source_remove (priv->pending_timeout_id);
+    priv->pending_timeout_id = 0;
+  }
+
+  SW_DEBUG (VIEWS, "Flushing %d ready items", priv->n_ready);
+  priv->n_ready = 0;
+
+  sw_set_iter_init (&iter, priv->pending_items_set);
+  while (sw_set_iter_next (&iter, &object))
+  {
+    SwItem *item = SW_ITEM (object);
+
+    if (sw_item_get_ready (item))
+    {
+      items_to_send = g_list_prepend (items_to_send, g_object_ref (item));
+      sw_set_iter_remove (&iter);
+    }
+  }
+
+  if (items_to_send)
+    sw_item_view_add_items (item_view, items_to_send);
+
+  g_list_foreach (items_to_send, (GFunc)g_object_unref, NULL);
+  g_list_free (items_to_send);
+
+  landed = priv->landed_items;
+  g_queue_init (&priv->landed_items);
+
+  if (landed.head)
+    sw_item_view_update_items (item_view, landed.head);
+
+  g_queue_foreach (&landed, (GFunc)g_object_unref, NULL);
+  g_queue_clear (&landed);
+}
+
+static gboolean
+_handle_ready_pending_cb (gpointer data)
+{
+  SwItemView *item_view = SW_ITEM_VIEW (data);
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+
+  SW_DEBUG (VIEWS, "Delayed ready timeout fired");
+
+  priv->pending_timeout_id = 0;
+  _flush_ready_items (item_view);
+
+  return FALSE;
+}
+
+static void
+_item_ready_weak_notify_cb (gpointer  data,
+                            GObject  *dead_object);
+
+static void
+_item_ready_notify_cb (SwItem     *item,
+                       GParamSpec *pspec,
+                       SwItemView *item_view)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+
+  if (sw_item_get_ready (item)) {
+    SW_DEBUG (VIEWS, "Item became ready: %s.",
+              sw_item_get (item, "id"));
+    g_signal_handlers_disconnect_by_func (item,
+                                          _item_ready_notify_cb,
+                                          item_view);
+    g_object_weak_unref ((GObject *)item_view,
+                         _item_ready_weak_notify_cb,
+                         item);
+
+    /*
+     * Items added before they were ready need to be sent again, as long as
+     * they are still in the view.
+     */
+    if (!sw_set_has (priv->pending_items_set, (GObject *)item))
+    {
+      if (g_hash_table_lookup (priv->uid_to_items,
+                               sw_item_get (item, "id")) != item)
+        return;
+
+      g_queue_push_tail (&priv->landed_items, g_object_ref (item));
+    }
+
+    /* Flush on a full batch, or at the deadline set by the first item */
+    if (++priv->n_ready >= priv->ready_batch_size)
+    {
+      SW_DEBUG (VIEWS, "Ready batch is full");
+      _flush_ready_items (item_view);
+    } else if (!priv->pending_timeout_id) {
+      SW_DEBUG (VIEWS, "Setting up timeout");
+      priv->pending_timeout_id = g_timeout_add (priv->ready_latency,
+                                                _handle_ready_pending_cb,
+                                                item_view);
+    } else {
+      SW_DEBUG (VIEWS, "Timeout already set up.");
+    }
+  }
+}
+
+static void
+_item_ready_weak_notify_cb (gpointer  data,
+                            GObject  *dead_object)
+{
+  g_signal_handlers_disconnect_by_func (data,
+                                        _item_ready_notify_cb,
+                                        dead_object);
+}
+
+static void
+_setup_ready_handler (SwItem     *item,
+                      SwItemView *item_view)
+{
+  g_signal_connect (item,
+                    "notify::ready",
+                    (GCallback)_item_ready_notify_cb,
+                    item_view);
+  g_object_weak_ref ((GObject *)item_view,
+                     _item_ready_weak_notify_cb,
+                     item);
+}
+
+/*
+ * Send everything that has changed, in the order it changed.
+ */
+static void
+_flush_changed_items (SwItemView *item_view)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  GQueue changed;
+
+  if (priv->refresh_timeout_id)
+  {
+    g_source_remove (priv->refresh_timeout_id);
+    priv->refresh_timeout_id = 0;
+  }
+
+  /* Take the queue first so that changes made while sending start a new one */
+  changed = priv->changed_items;
+  g_queue_init (&priv->changed_items);
+  g_hash_table_remove_all (priv->changed_items_set);
+
+  SW_DEBUG (VIEWS, "Flushing %d changed items", changed.length);
+
+  sw_item_view_update_items (item_view, changed.head);
+
+  g_queue_foreach (&changed, (GFunc)g_object_unref, NULL);
+  g_queue_clear (&changed);
+}
+
+static gboolean
+_item_changed_timeout_cb (gpointer data)
+{
+  SwItemView *item_view = SW_ITEM_VIEW (data);
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+
+  priv->refresh_timeout_id = 0;
+  _flush_changed_items (item_view);
+
+  return FALSE;
+}
+
+static void
+_item_changed_cb (SwItem     *item,
+                  SwItemView *item_view)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+
+  /* We only care if the item is ready. If it's not then we don't want to be
+   * emitting changed but instead it will be added through the readiness
+   * tracking.
+   */
+  if (!sw_item_get_ready (item))
+    return;
+
+  if (g_hash_table_lookup (priv->changed_items_set, item))
+    return;
+
+  g_hash_table_insert (priv->changed_items_set, item, item);
+  g_queue_push_tail (&priv->changed_items, g_object_ref (item));
+
+  if (priv->changed_max_batch &&
+      priv->changed_items.length >= priv->changed_max_batch)
+  {
+    SW_DEBUG (VIEWS, "Item changed, batch is full");
+    _flush_changed_items (item_view);
+  } else if (!priv->refresh_timeout_id) {
     SW_DEBUG (VIEWS, "Item changed, Setting up timeout");
 
-    priv->refresh_timeout_id = g_timeout_add_seconds (10,
-                                                      _item_changed_timeout_cb,
-                                                      item_view);
+    priv->refresh_timeout_id = g_timeout_add_seconds (priv->changed_window,
+                                                      _item_changed_timeout_cb,
+                                                      item_view);
+  }
+}
+
+static void
+_item_changed_weak_notify_cb (gpointer  data,
+                              GObject  *dead_object)
+{
+  SwItem *item = (SwItem *)data;
+
+  g_signal_handlers_disconnect_by_func (item,
+                                        _item_changed_cb,
+                                        dead_object);
+  g_object_unref (item);
+}
+
+static void
+_setup_changed_handler (SwItem     *item,
+                        SwItemView *item_view)
+{
+  g_signal_connect (item,
+                    "changed",
+                    (GCallback)_item_changed_cb,
+                    item_view);
+  g_object_weak_ref ((GObject *)item_view,
+                     _item_changed_weak_notify_cb,
+                     g_object_ref (item));
+}
+
+/* FIXME: Do we need these functions still? */
+#if 0
+/**
+ * sw_item_view_add_item
+ * @item_view: A #SwItemView
+ * @item: A #SwItem
+ *
+ * Add a single item in the #SwItemView. This will cause a signal to be
+ * emitted across the bus.
+ */
+static void
+sw_item_view_add_item (SwItemView *item_view,
+                       SwItem     *item)
+{
+  GList *tmp_list = NULL;
+
+  tmp_list = g_list_append (tmp_list, item);
+  sw_item_view_add_items (item_view, tmp_list);
+  g_list_free (tmp_list);
+}
+
+/**
+ * sw_item_view_update_item
+ * @item_view: A #SwItemView
+ * @item: A #SwItem
+ *
+ * Update a single item in the #SwItemView. This will cause a signal to be
+ * emitted across the bus.
+ */
+void
+sw_item_view_update_item (SwItemView *item_view,
+                          SwItem     *item)
+{
+  GList *tmp_list = NULL;
+
+  tmp_list = g_list_append (tmp_list, item);
+  sw_item_view_update_items (item_view, tmp_list);
+  g_list_free (tmp_list);
+}
+
+/**
+ * sw_item_view_remove_item
+ * @item_view: A #SwItemView
+ * @item: A #SwItem
+ *
+ * Remove a single item to the #SwItemView. This will cause a signal to be
+ * emitted across the bus.
+ */
+void
+sw_item_view_remove_item (SwItemView *item_view,
+                          SwItem     *item)
+{
+  GList *tmp_list = NULL;
+
+  tmp_list = g_list_append (tmp_list, item);
+  sw_item_view_remove_items (item_view, tmp_list);
+  g_list_free (tmp_list);
+}
+#endif
+
+/*
+ * Mark the images that @item uses as in use, so that they are kept in the
+ * thumbnail store.
+ */
+static void
+_touch_thumbnails (SwItem *item)
+{
+  const gchar *filename;
+
+  filename = sw_item_get (item, "thumbnail");
+  if (filename)
+    sw_thumbnails_touch (filename);
+
+  filename = sw_item_get (item, "authoricon");
+  if (filename)
+    sw_thumbnails_touch (filename);
+}
+
+/*
+ * Queue @item for an ItemsAdded signal, or hold it back until it is ready.
+ */
+static void
+_append_added_item (SwItemView *item_view,
+                    SwItem     *item,
+                    GPtrArray  *ptr_array)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+
+  if (sw_item_get_ready (item))
+  {
+    SW_DEBUG (VIEWS, "Item ready: %s",
+              sw_item_get (item, "id"));
+    _touch_thumbnails (item);
+    g_ptr_array_add (ptr_array, _item_to_sent_value_array (item));
+  } else if (priv->add_immediately) {
+    SW_DEBUG (VIEWS, "Item not ready, adding it anyway: %s",
+              sw_item_get (item, "id"));
+    _setup_ready_handler (item, item_view);
+    g_ptr_array_add (ptr_array, _item_to_sent_value_array (item));
+  } else {
+    SW_DEBUG (VIEWS, "Item not ready, setting up handler: %s",
+              sw_item_get (item, "id"));
+    _setup_ready_handler (item, item_view);
+    sw_set_add (priv->pending_items_set, (GObject *)item);
+  }
+
+  _setup_changed_handler (item, item_view);
+}
+
+static void
+_emit_items_added (SwItemView *item_view,
+                   GPtrArray  *ptr_array)
+{
+  SW_DEBUG (VIEWS, "Number of items to be added: %d", ptr_array->len);
+
+  if (!_queue_window_sync (item_view))
+    sw_item_view_iface_emit_items_added (item_view,
+                                         ptr_array);
+
+  g_ptr_array_free (ptr_array, TRUE);
+}
+
+static void
+_emit_items_removed (SwItemView *item_view,
+                     GPtrArray  *ptr_array)
+{
+  if (!_queue_window_sync (item_view))
+    sw_item_view_iface_emit_items_removed (item_view,
+                                           ptr_array);
+
+  g_ptr_array_free (ptr_array, TRUE);
+}
+
+/**
+ * sw_item_view_add_items
+ * @item_view: A #SwItemView
+ * @items: A list of #SwItem objects
+ *
+ * Add the items supplied in the list from the #SwItemView. In many
+ * cases what you actually want is sw_item_view_remove_from_set() or
+ * sw_item_view_set_from_set(). This will cause signal emissions over the
+ * bus.
+ *
+ * This is used in the implementation of sw_item_view_remove_from_set()
+ */
+static void
+sw_item_view_add_items (SwItemView *item_view,
+                        GList      *items)
+{
+  GPtrArray *ptr_array;
+  GList *l;
+
+  ptr_array = g_ptr_array_new_with_free_func ((GDestroyNotify)g_value_array_free);
+
+  for (l = items; l; l = l->next)
+    _append_added_item (item_view, SW_ITEM (l->data), ptr_array);
+
+  _emit_items_added (item_view, ptr_array);
+}
+
+/**
+ * sw_item_view_update_items
+ * @item_view: A #SwItemView
+ * @items: A list of #SwItem objects that need updating
+ *
+ * Update the items supplied in the list in the #SwItemView. This is
+ * will cause signal emissions over the bus.
+ */
+static void
+sw_item_view_update_items (SwItemView *item_view,
+                           GList      *items)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  GPtrArray *ptr_array, *delta_array;
+  gboolean full, deltas;
+  GList *l;
+
+  full = _wants_full_changes (item_view);
+  deltas = g_hash_table_size (priv->delta_senders) > 0;
+
+  ptr_array = g_ptr_array_new_with_free_func ((GDestroyNotify)g_value_array_free);
+  delta_array = g_ptr_array_new_with_free_func ((GDestroyNotify)g_value_array_free);
+
+  for (l = items; l; l = l->next)
+  {
+    SwItem *item = SW_ITEM (l->data);
+
+    /* Clients following a window only hear about items inside it */
+    if (priv->window_uids &&
+        !g_hash_table_lookup (priv->window_uids, sw_item_get (item, "id")))
+      continue;
+
+    /*
+     * Item must be ready and also not in the pending items set; we need to
+     * check this to prevent ItemsChanged coming before ItemsAdded
+     */
+    if (sw_item_get_ready (item))
+    {
+      _touch_thumbnails (item);
+
+      /* The delta has to be taken before sending the item clears it */
+      if (deltas && sw_item_is_dirty (item))
+        g_ptr_array_add (delta_array, _item_to_delta_value_array (item));
+
+      if (full)
+        g_ptr_array_add (ptr_array, _item_to_sent_value_array (item));
+    }
+  }
+
+  SW_DEBUG (VIEWS, "Number of items to be changed: %d",
+            MAX (ptr_array->len, delta_array->len));
+
+  /* A change of date can move items in or out of the window */
+  _queue_window_sync (item_view);
+
+  if (delta_array->len > 0)
+    sw_item_view_iface_emit_items_changed_delta (item_view,
+                                                 delta_array);
+
+  if (ptr_array->len > 0)
+    sw_item_view_iface_emit_items_changed (item_view,
+                                           ptr_array);
+
+  g_ptr_array_free (delta_array, TRUE);
+  g_ptr_array_free (ptr_array, TRUE);
+}
+
+/*
+ * The (service, uid) pair that ItemsRemoved sends for @item.
+ */
+static GValueArray *
+_item_to_removed_value_array (SwItem *item)
+{
+  return _make_removed_value_array (sw_service_get_name (sw_item_get_service (item)),
+                                    sw_item_get (item, "id"));
+}
+
+/**
+ * sw_item_view_remove_items
+ * @item_view: A #SwItemView
+ * @items: A list of #SwItem objects
+ *
+ * Remove the items supplied in the list from the #SwItemView. In many
+ * cases what you actually want is sw_item_view_remove_from_set() or
+ * sw_item_view_set_from_set(). This will cause signal emissions over the
+ * bus.
+ *
+ * This is used in the implementation of sw_item_view_remove_from_set()
+ *
+ */
+static void
+sw_item_view_remove_items (SwItemView *item_view,
+                           GList      *items)
+{
+  GPtrArray *ptr_array;
+  GList *l;
+
+  ptr_array = g_ptr_array_new_with_free_func ((GDestroyNotify)g_value_array_free);
+
+  for (l = items; l; l = l->next)
+    g_ptr_array_add (ptr_array, _item_to_removed_value_array (l->data));
+
+  _emit_items_removed (item_view, ptr_array);
+}
+
+/**
+ * sw_item_view_get_object_path
+ * @item_view: A #SwItemView
+ *
+ * Since #SwItemView is responsible for constructing the object path and
+ * registering the object on the bus. This function is necessary for
+ * #SwCore to be able to return the object path as the result of a
+ * function to open a view.
+ *
+ * Returns: A string providing the object path.
+ */
+const gchar *
+sw_item_view_get_object_path (SwItemView *item_view)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+
+  return priv->object_path;
+}
+
+/**
+ * sw_item_view_get_service
+ * @item_view: A #SwItemView
+ *
+ * Returns: The #SwService that #SwItemView is for
+ */
+SwService *
+sw_item_view_get_service (SwItemView *item_view)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+
+  return priv->service;
+}
+
+static void
+_free_item_list (GList *items)
+{
+  g_list_foreach (items, (GFunc)g_object_unref, NULL);
+  g_list_free (items);
+}
+
+/*
+ * Order items newest first, using the uid to break ties so that the order is
+ * total.
+ */
+static gint
+_compare_items_newest_first (gconstpointer a,
+                             gconstpointer b,
+                             gpointer      user_data)
+{
+  time_t date_a, date_b;
+
+  date_a = sw_item_get_date ((SwItem *)a);
+  date_b = sw_item_get_date ((SwItem *)b);
+
+  if (date_a != date_b)
+    return date_a > date_b ? -1 : 1;
+
+  return g_strcmp0 (sw_item_get ((SwItem *)a, "id"),
+                    sw_item_get ((SwItem *)b, "id"));
+}
+
+/*
+ * Add @item to the view's bookkeeping, replacing any older version of it.
+ */
+static void
+_register_item (SwItemView *item_view,
+                SwItem     *item)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  const gchar *uid = sw_item_get (item, "id");
+  GSequenceIter *iter;
+
+  /* Do this first, replacing in uid_to_items may drop the last reference */
+  iter = g_hash_table_lookup (priv->uid_to_iter, uid);
+  if (iter)
+    g_sequence_remove (iter);
+
+  sw_set_add (priv->current_items_set, (GObject *)item);
+  g_hash_table_replace (priv->uid_to_items,
+                        g_strdup (uid),
+                        g_object_ref (item));
+
+  iter = g_sequence_insert_sorted (priv->ordered_items,
+                                   item,
+                                   _compare_items_newest_first,
+                                   NULL);
+  g_hash_table_replace (priv->uid_to_iter, g_strdup (uid), iter);
+}
+
+/*
+ * Add @items to the view, emitting them in the order of the list.
+ */
+static void
+_add_item_list (SwItemView *item_view,
+                GList      *items)
+{
+  GList *l;
+
+  for (l = items; l; l = l->next)
+    _register_item (item_view, (SwItem *)l->data);
+
+  sw_item_view_add_items (item_view, items);
+
+  _enforce_max_items (item_view);
+}
+
+/* TODO: Export this function ? */
+/**
+ * sw_item_view_add_from_set
+ * @item_view: A #SwItemView
+ * @set: A #SwSet
+ *
+ * Add the items that are in the supplied set to the view.
+ *
+ * This is used in the implementation of sw_item_view_set_from_set()
+ */
+void
+sw_item_view_add_from_set (SwItemView *item_view,
+                           SwSet      *set)
+{
+  GPtrArray *ptr_array;
+  SwSetIter iter;
+  GObject *object;
+
+  ptr_array = g_ptr_array_new_with_free_func ((GDestroyNotify)g_value_array_free);
+
+  sw_set_iter_init (&iter, set);
+  while (sw_set_iter_next (&iter, &object))
+  {
+    _register_item (item_view, (SwItem *)object);
+    _append_added_item (item_view, (SwItem *)object, ptr_array);
   }
+
+  _emit_items_added (item_view, ptr_array);
+
+  _enforce_max_items (item_view);
 }
 
+/*
+ * Drop the view's references to @item.  The caller must hold one.
+ */
 static void
-_item_changed_weak_notify_cb (gpointer  data,
-                              GObject  *dead_object)
+_unregister_item (SwItemView *item_view,
+                  SwItem     *item)
 {
-  SwItem *item = (SwItem *)data;
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  const gchar *uid = sw_item_get (item, "id");
+  GSequenceIter *iter;
 
-  g_signal_handlers_disconnect_by_func (item,
-                                        _item_changed_cb,
-                                        dead_object);
-  g_object_unref (item);
+  iter = g_hash_table_lookup (priv->uid_to_iter, uid);
+  if (iter)
+  {
+    g_sequence_remove (iter);
+    g_hash_table_remove (priv->uid_to_iter, uid);
+  }
+
+  sw_set_remove (priv->current_items_set, (GObject *)item);
+  g_hash_table_remove (priv->uid_to_items, uid);
 }
 
+/*
+ * Drop the oldest items until the view is within its limit.
+ */
 static void
-_setup_changed_handler (SwItem     *item,
-                        SwItemView *item_view)
+_enforce_max_items (SwItemView *item_view)
 {
-  g_signal_connect (item,
-                    "changed",
-                    (GCallback)_item_changed_cb,
-                    item_view);
-  g_object_weak_ref ((GObject *)item_view,
-                     _item_changed_weak_notify_cb,
-                     g_object_ref (item));
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  GSequenceIter *iter;
+  GList *evicted = NULL;
+  SwItem *item;
+  gboolean sent;
+
+  if (priv->max_items == 0)
+    return;
+
+  while (g_sequence_get_length (priv->ordered_items) > (gint)priv->max_items)
+  {
+    iter = g_sequence_iter_prev (g_sequence_get_end_iter (priv->ordered_items));
+    item = g_object_ref (g_sequence_get (iter));
+
+    /* Items still held back until they are ready were never sent */
+    sent = _item_is_visible (item_view, item);
+
+    _unregister_item (item_view, item);
+    sw_set_remove (priv->pending_items_set, (GObject *)item);
+
+    if (sent)
+      evicted = g_list_prepend (evicted, item);
+    else
+      g_object_unref (item);
+  }
+
+  if (evicted)
+  {
+    SW_DEBUG (VIEWS, "Evicting %d items over the limit of %d",
+              g_list_length (evicted), priv->max_items);
+    sw_item_view_remove_items (item_view, evicted);
+    _free_item_list (evicted);
+  }
 }
 
-/* FIXME: Do we need these functions still? */
-#if 0
-/**
- * sw_item_view_add_item
- * @item_view: A #SwItemView
- * @item: A #SwItem
- *
- * Add a single item in the #SwItemView. This will cause a signal to be
- * emitted across the bus.
+/*
+ * The newest max_items items of @set, or @set itself if it is small enough.
+ * Returns a new reference.
+ */
+static SwSet *
+_newest_items (SwItemView *item_view,
+               SwSet      *set)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  SwSet *newest;
+  GList *items, *l;
+  guint n;
+
+  if (priv->max_items == 0 || sw_set_size (set) <= (int)priv->max_items)
+    return sw_set_ref (set);
+
+  items = sw_set_as_list (set);
+  items = g_list_sort_with_data (items, _compare_items_newest_first, NULL);
+
+  newest = sw_item_set_new ();
+  for (l = items, n = 0; l && n < priv->max_items; l = l->next, n++)
+    sw_set_add (newest, (GObject *)l->data);
+
+  _free_item_list (items);
+
+  return newest;
+}
+
+/*
+ * Remove @items from the view.
  */
 static void
-sw_item_view_add_item (SwItemView *item_view,
-                       SwItem     *item)
+_remove_item_list (SwItemView *item_view,
+                   GList      *items)
 {
-  GList *tmp_list = NULL;
+  GList *l;
 
-  tmp_list = g_list_append (tmp_list, item);
-  sw_item_view_add_items (item_view, tmp_list);
-  g_list_free (tmp_list);
+  for (l = items; l; l = l->next)
+    _unregister_item (item_view, (SwItem *)l->data);
+
+  sw_item_view_remove_items (item_view, items);
 }
 
-/**
- * sw_item_view_update_item
- * @item_view: A #SwItemView
- * @item: A #SwItem
- *
- * Update a single item in the #SwItemView. This will cause a signal to be
- * emitted across the bus.
+/*
+ * Replace the versions of @items in the view with these ones and send them
+ * as changed.
  */
-void
-sw_item_view_update_item (SwItemView *item_view,
-                          SwItem     *item)
+static void
+_update_item_list (SwItemView *item_view,
+                   GList      *items)
 {
-  GList *tmp_list = NULL;
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  SwItem *previous;
+  GList *l;
 
-  tmp_list = g_list_append (tmp_list, item);
-  sw_item_view_update_items (item_view, tmp_list);
-  g_list_free (tmp_list);
+  /* This works because sw_set_add uses g_hash_table_replace behind the scenes */
+  for (l = items; l; l = l->next)
+  {
+    SwItem *item = (SwItem *)l->data;
+
+    /* The client has the old version, so a delta is against that */
+    previous = g_hash_table_lookup (priv->uid_to_items,
+                                    sw_item_get (item, "id"));
+    if (previous && previous != item)
+      sw_item_merge_dirty (item, previous);
+
+    _register_item (item_view, item);
+  }
+
+  sw_item_view_update_items (item_view, items);
 }
 
+/* TODO: Export this function ? */
 /**
- * sw_item_view_remove_item
+ * sw_item_view_remove_from_set
  * @item_view: A #SwItemView
- * @item: A #SwItem
+ * @set: A #SwSet
  *
- * Remove a single item to the #SwItemView. This will cause a signal to be
- * emitted across the bus.
+ * Remove the items that are in the supplied set from the view.
  */
 void
-sw_item_view_remove_item (SwItemView *item_view,
-                          SwItem     *item)
+sw_item_view_remove_from_set (SwItemView *item_view,
+                              SwSet      *set)
 {
-  GList *tmp_list = NULL;
+  GPtrArray *ptr_array;
+  SwSetIter iter;
+  GObject *object;
 
-  tmp_list = g_list_append (tmp_list, item);
-  sw_item_view_remove_items (item_view, tmp_list);
-  g_list_free (tmp_list);
+  ptr_array = g_ptr_array_new_with_free_func ((GDestroyNotify)g_value_array_free);
+
+  sw_set_iter_init (&iter, set);
+  while (sw_set_iter_next (&iter, &object))
+  {
+    g_ptr_array_add (ptr_array, _item_to_removed_value_array ((SwItem *)object));
+    _unregister_item (item_view, (SwItem *)object);
+  }
+
+  _emit_items_removed (item_view, ptr_array);
 }
-#endif
 
 /**
- * sw_item_view_add_items
+ * sw_item_view_set_from_set
  * @item_view: A #SwItemView
- * @items: A list of #SwItem objects
+ * @set: A #SwSet
  *
- * Add the items supplied in the list from the #SwItemView. In many
- * cases what you actually want is sw_item_view_remove_from_set() or
- * sw_item_view_set_from_set(). This will cause signal emissions over the
- * bus.
+ * Updates what the view contains based on the given #SwSet. Removed
+ * signals will be fired for any items that were in the view but that are not
+ * present in the supplied set. Conversely any items that are new will cause
+ * signals to be fired indicating their addition. Items present in both are
+ * replaced, and signalled as changed, only if sw_item_equal() says that they
+ * differ. If the view has a limit on the number of items only the newest
+ * items in @set are used.
  *
- * This is used in the implementation of sw_item_view_remove_from_set()
+ * This implemented by maintaining a set inside the #SwItemView
  */
-static void
-sw_item_view_add_items (SwItemView *item_view,
-                        GList      *items)
+void
+sw_item_view_set_from_set (SwItemView *item_view,
+                           SwSet      *set)
 {
   SwItemViewPrivate *priv = GET_PRIVATE (item_view);
-  GValueArray *value_array;
+  GList *added_items, *removed_items, *changed_items;
+
+  /*
+   * The new set supersedes whatever was cached; anything from the cache that
+   * is still current will be added below.
+   */
+  _stop_cache_stream (item_view);
+
+  set = _newest_items (item_view, set);
+
+  if (sw_set_is_empty (priv->current_items_set))
+  {
+    /* Filling an empty view says nothing about how often it changes */
+    sw_item_view_add_from_set (item_view, set);
+  } else {
+    sw_set_diff (priv->current_items_set,
+                 set,
+                 (GEqualFunc)sw_item_equal,
+                 &added_items,
+                 &removed_items,
+                 &changed_items);
+
+    sw_poll_interval_update (&priv->refresh,
+                             added_items || removed_items || changed_items);
+
+    if (removed_items)
+      _remove_item_list (item_view, removed_items);
+
+    if (changed_items)
+      _update_item_list (item_view, changed_items);
+
+    if (added_items)
+      _add_item_list (item_view, added_items);
+
+    _free_item_list (removed_items);
+    _free_item_list (changed_items);
+    _free_item_list (added_items);
+  }
+
+  sw_set_unref (set);
+}
+
+static void
+sw_item_view_remove_item (SwItemView *item_view,
+                          SwItem     *item)
+{
   GPtrArray *ptr_array;
-  GList *l;
 
   ptr_array = g_ptr_array_new_with_free_func ((GDestroyNotify)g_value_array_free);
+  g_ptr_array_add (ptr_array, _item_to_removed_value_array (item));
 
-  for (l = items; l; l = l->next)
+  _emit_items_removed (item_view, ptr_array);
+}
+
+static gint
+_compare_item_uid (gconstpointer a,
+                   gconstpointer b)
+{
+  return g_strcmp0 (sw_item_get ((SwItem *)a, "id"), b);
+}
+
+static void
+_stop_cache_stream (SwItemView *item_view)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+
+  if (priv->cache_stream_id)
   {
-    SwItem *item = SW_ITEM (l->data);
+    g_source_remove (priv->cache_stream_id);
+    priv->cache_stream_id = 0;
+  }
 
-    if (sw_item_get_ready (item))
-    {
-      SW_DEBUG (VIEWS, "Item ready: %s",
-                sw_item_get (item, "id"));
-      value_array = _sw_item_to_value_array (item);
-      g_ptr_array_add (ptr_array, value_array);
-    } else {
-      SW_DEBUG (VIEWS, "Item not ready, setting up handler: %s",
-                sw_item_get (item, "id"));
-      _setup_ready_handler (item, item_view);
-      sw_set_add (priv->pending_items_set, (GObject *)item);
-    }
+  g_list_foreach (priv->cached_items, (GFunc)g_object_unref, NULL);
+  g_list_free (priv->cached_items);
+  priv->cached_items = NULL;
+}
+
+static gboolean
+_cache_stream_cb (gpointer data)
+{
+  SwItemView *item_view = SW_ITEM_VIEW (data);
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  GList *chunk, *rest;
 
-    _setup_changed_handler (item, item_view);
+  chunk = priv->cached_items;
+  rest = g_list_nth (chunk, CACHE_STREAM_CHUNK);
+  if (rest)
+  {
+    rest->prev->next = NULL;
+    rest->prev = NULL;
   }
+  priv->cached_items = rest;
 
-  SW_DEBUG (VIEWS, "Number of items to be added: %d", ptr_array->len);
+  SW_DEBUG (VIEWS, "Adding %d cached items, %d to go",
+            g_list_length (chunk), g_list_length (rest));
 
-  sw_item_view_iface_emit_items_added (item_view,
-                                       ptr_array);
+  _add_item_list (item_view, chunk);
 
-  g_ptr_array_free (ptr_array, TRUE);
+  g_list_foreach (chunk, (GFunc)g_object_unref, NULL);
+  g_list_free (chunk);
+
+  if (priv->cached_items == NULL)
+  {
+    priv->cache_stream_id = 0;
+    return FALSE;
+  }
+
+  return TRUE;
 }
 
 /**
- * sw_item_view_update_items
+ * sw_item_view_load_from_cache
  * @item_view: A #SwItemView
- * @items: A list of #SwItem objects that need updating
+ * @query: The query the view is for
+ * @params: The parameters of the query
  *
- * Update the items supplied in the list in the #SwItemView. This is
- * will cause signal emissions over the bus.
+ * Load any cached items for this view and add them to it. The items are added
+ * newest first, a few at a time from the main loop, so that clients get
+ * something to show straight away rather than waiting for the whole cache to
+ * be sent in one go. Calling sw_item_view_set_from_set() before all of the
+ * cached items are added replaces them. Only as many items as the view's limit
+ * allows are loaded.
  */
-static void
-sw_item_view_update_items (SwItemView *item_view,
-                           GList      *items)
+void
+sw_item_view_load_from_cache (SwItemView  *item_view,
+                              const gchar *query,
+                              GHashTable  *params)
 {
-  GValueArray *value_array;
-  GPtrArray *ptr_array;
-  GList *l;
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  SwSet *set;
+  GList *items;
 
-  ptr_array = g_ptr_array_new_with_free_func ((GDestroyNotify)g_value_array_free);
+  g_return_if_fail (SW_IS_ITEM_VIEW (item_view));
 
-  for (l = items; l; l = l->next)
-  {
-    SwItem *item = SW_ITEM (l->data);
+  set = sw_cache_load (priv->service, query, params, sw_item_set_new);
+  if (set == NULL)
+    return;
 
-    /*
-     * Item must be ready and also not in the pending items set; we need to
-     * check this to prevent ItemsChanged coming before ItemsAdded
-     */
-    if (sw_item_get_ready (item))
-    {
-      value_array = _sw_item_to_value_array (item);
-      g_ptr_array_add (ptr_array, value_array);
-    }
+  items = sw_set_as_list (set);
+  sw_set_unref (set);
+
+  _stop_cache_stream (item_view);
+  priv->cached_items = g_list_sort_with_data (items,
+                                              _compare_items_newest_first,
+                                              NULL);
+
+  /* Don't bother with anything that would be evicted straight away */
+  if (priv->max_items &&
+      (items = g_list_nth (priv->cached_items, priv->max_items)))
+  {
+    items->prev->next = NULL;
+    items->prev = NULL;
+    _free_item_list (items);
   }
 
-  SW_DEBUG (VIEWS, "Number of items to be changed: %d", ptr_array->len);
+  /* Send the first chunk now, the rest when the main loop is idle */
+  if (_cache_stream_cb (item_view))
+    priv->cache_stream_id = g_idle_add (_cache_stream_cb, item_view);
+}
 
-  if (ptr_array->len > 0)
-    sw_item_view_iface_emit_items_changed (item_view,
-                                           ptr_array);
-  g_ptr_array_free (ptr_array, TRUE);
+void
+sw_item_view_remove_by_uid (SwItemView  *item_view,
+                            const gchar *uid)
+{
+  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  SwItem *item;
+  GList *l;
+
+  item = g_hash_table_lookup (priv->uid_to_items,
+                              uid);
+
+  if (item)
+  {
+    sw_item_view_remove_item (item_view, item);
+    _unregister_item (item_view, item);
+  } else if ((l = g_list_find_custom (priv->cached_items, uid,
+                                      _compare_item_uid))) {
+    /* Not added yet, so just don't add it */
+    g_object_unref (l->data);
+    priv->cached_items = g_list_delete_link (priv->cached_items, l);
+  } else {
+    g_critical (G_STRLOC ": Asked to remove unknown item: %s", uid);
+  }
 }
 
 /**
- * sw_item_view_remove_items
+ * sw_item_view_set_max_items
  * @item_view: A #SwItemView
- * @items: A list of #SwItem objects
- *
- * Remove the items supplied in the list from the #SwItemView. In many
- * cases what you actually want is sw_item_view_remove_from_set() or
- * sw_item_view_set_from_set(). This will cause signal emissions over the
- * bus.
- *
- * This is used in the implementation of sw_item_view_remove_from_set()
+ * @max_items: The most items the view should hold, or 0 for no limit
  *
+ * Limit the view to the @max_items newest items. When newer items arrive the
+ * oldest are removed from the view.
  */
-static void
-sw_item_view_remove_items (SwItemView *item_view,
-                           GList      *items)
+void
+sw_item_view_set_max_items (SwItemView *item_view,
+                            guint       max_items)
 {
-  GValueArray *value_array;
-  GPtrArray *ptr_array;
-  GList *l;
-  SwItem *item;
+  SwItemViewPrivate *priv;
 
-  ptr_array = g_ptr_array_new_with_free_func ((GDestroyNotify)g_value_array_free);
+  g_return_if_fail (SW_IS_ITEM_VIEW (item_view));
 
-  for (l = items; l; l = l->next)
-  {
-    item = SW_ITEM (l->data);
+  priv = GET_PRIVATE (item_view);
+  priv->max_items = max_items;
 
-    value_array = g_value_array_new (2);
+  _enforce_max_items (item_view);
+}
 
-    value_array = g_value_array_append (value_array, NULL);
-    g_value_init (g_value_array_get_nth (value_array, 0), G_TYPE_STRING);
-    g_value_set_string (g_value_array_get_nth (value_array, 0),
-                        sw_service_get_name (sw_item_get_service (item)));
+guint
+sw_item_view_get_max_items (SwItemView *item_view)
+{
+  g_return_val_if_fail (SW_IS_ITEM_VIEW (item_view), 0);
 
-    value_array = g_value_array_append (value_array, NULL);
-    g_value_init (g_value_array_get_nth (value_array, 1), G_TYPE_STRING);
-    g_value_set_string (g_value_array_get_nth (value_array, 1),
-                        sw_item_get (item, "id"));
+  return GET_PRIVATE (item_view)->max_items;
+}
 
-    g_ptr_array_add (ptr_array, value_array);
-  }
+/**
+ * sw_item_view_set_max_items_from_params
+ * @item_view: A #SwItemView
+ * @params: The parameters of the query, or %NULL
+ *
+ * Set the limit on the number of items from the "count" parameter of the
+ * query, if there is one. Services call this when the view is constructed.
+ */
+void
+sw_item_view_set_max_items_from_params (SwItemView *item_view,
+                                        GHashTable *params)
+{
+  const gchar *count;
+  gchar *end;
+  guint64 n;
 
-  sw_item_view_iface_emit_items_removed (item_view,
-                                         ptr_array);
+  g_return_if_fail (SW_IS_ITEM_VIEW (item_view));
 
-  g_ptr_array_free (ptr_array, TRUE);
+  if (params == NULL)
+    return;
+
+  count = g_hash_table_lookup (params, "count");
+  if (count == NULL)
+    return;
+
+  n = g_ascii_strtoull (count, &end, 10);
+  if (end == count || *end != '\0' || n > G_MAXUINT)
+  {
+    g_message (G_STRLOC ": Ignoring invalid count: %s", count);
+    return;
+  }
+
+  sw_item_view_set_max_items (item_view, n);
 }
 
 /**
- * sw_item_view_get_object_path
+ * sw_item_view_set_ready_batching
  * @item_view: A #SwItemView
+ * @latency: Most milliseconds to hold an item after it becomes ready
+ * @batch_size: Number of ready items that are sent straight away
  *
- * Since #SwItemView is responsible for constructing the object path and
- * registering the object on the bus. This function is necessary for
- * #SwCore to be able to return the object path as the result of a
- * function to open a view.
- *
- * Returns: A string providing the object path.
+ * Items that are waiting for images are held back until they are ready and
+ * then sent in batches. A batch is sent when @batch_size items are ready or
+ * @latency milliseconds after the first of them became ready, whichever
+ * comes first.
  */
-const gchar *
-sw_item_view_get_object_path (SwItemView *item_view)
+void
+sw_item_view_set_ready_batching (SwItemView *item_view,
+                                 guint       latency,
+                                 guint       batch_size)
 {
-  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  SwItemViewPrivate *priv;
 
-  return priv->object_path;
+  g_return_if_fail (SW_IS_ITEM_VIEW (item_view));
+  g_return_if_fail (batch_size > 0);
+
+  priv = GET_PRIVATE (item_view);
+  priv->ready_latency = latency;
+  priv->ready_batch_size = batch_size;
 }
 
 /**
- * sw_item_view_get_service
+ * sw_item_view_set_add_immediately
  * @item_view: A #SwItemView
+ * @add_immediately: Whether to add items before they are ready
  *
- * Returns: The #SwService that #SwItemView is for
+ * If @add_immediately is %TRUE, items are sent in ItemsAdded straight away
+ * even when they are still waiting for images, and sent again in
+ * ItemsChanged once the images have arrived. Otherwise they are held back
+ * until they are ready, which is the default.
  */
-SwService *
-sw_item_view_get_service (SwItemView *item_view)
+void
+sw_item_view_set_add_immediately (SwItemView *item_view,
+                                  gboolean    add_immediately)
 {
-  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
+  g_return_if_fail (SW_IS_ITEM_VIEW (item_view));
 
-  return priv->service;
+  GET_PRIVATE (item_view)->add_immediately = add_immediately;
 }
 
-/* TODO: Export this function ? */
 /**
- * sw_item_view_add_from_set
+ * sw_item_view_set_change_batching
  * @item_view: A #SwItemView
- * @set: A #SwSet
+ * @window: Seconds to collect changes for before sending them
+ * @max_batch: Number of changed items that are sent straight away, or 0 for
+ * no limit
  *
- * Add the items that are in the supplied set to the view.
- *
- * This is used in the implementation of sw_item_view_set_from_set()
+ * Control how changes to items already in the view are coalesced into
+ * ItemsChanged signals. Changes are held for up to @window seconds from the
+ * first one, unless @max_batch items have changed before then.
  */
 void
-sw_item_view_add_from_set (SwItemView *item_view,
-                           SwSet      *set)
+sw_item_view_set_change_batching (SwItemView *item_view,
+                                  guint       window,
+                                  guint       max_batch)
 {
-  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
-  GList *items;
-  GList *l;
+  SwItemViewPrivate *priv;
 
-  sw_set_add_from (priv->current_items_set, set);
-  items = sw_set_as_list (set);
-
-  for (l = items; l; l = l->next)
-  {
-    SwItem *item = (SwItem *)l->data;
+  g_return_if_fail (SW_IS_ITEM_VIEW (item_view));
+  g_return_if_fail (window > 0);
 
-    g_hash_table_replace (priv->uid_to_items,
-                          g_strdup (sw_item_get (item, "id")),
-                          g_object_ref (item));
-  }
+  priv = GET_PRIVATE (item_view);
+  priv->changed_window = window;
+  priv->changed_max_batch = max_batch;
 
-  sw_item_view_add_items (item_view, items);
-  g_list_free (items);
+  if (priv->changed_max_batch &&
+      priv->changed_items.length >= priv->changed_max_batch)
+    _flush_changed_items (item_view);
 }
 
-/* TODO: Export this function ? */
 /**
- * sw_item_view_remove_from_set
+ * sw_item_view_set_refresh_bounds
  * @item_view: A #SwItemView
- * @set: A #SwSet
- *
- * Remove the items that are in the supplied set from the view.
+ * @min_interval: Fewest seconds between refreshes
+ * @max_interval: Most seconds between refreshes
  *
- * This is used in the implementation of sw_item_view_set_from_set()
+ * The view learns how often refreshes find something new and suggests a
+ * refresh interval to match, backing off when the service is quiet and
+ * tightening when it is busy. This sets the bounds on that interval.
  */
 void
-sw_item_view_remove_from_set (SwItemView *item_view,
-                              SwSet      *set)
+sw_item_view_set_refresh_bounds (SwItemView *item_view,
+                                 guint       min_interval,
+                                 guint       max_interval)
 {
-  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
-  GList *items;
-  GList *l;
-
-  sw_set_remove_from (priv->current_items_set, set);
-
-  items = sw_set_as_list (set);
-
-  for (l = items; l; l = l->next)
-  {
-    SwItem *item = (SwItem *)l->data;
+  SwItemViewPrivate *priv;
 
-    g_hash_table_remove (priv->uid_to_items,
-                         sw_item_get (item, "id"));
-  }
+  g_return_if_fail (SW_IS_ITEM_VIEW (item_view));
+  g_return_if_fail (min_interval > 0);
+  g_return_if_fail (min_interval <= max_interval);
 
-  sw_item_view_remove_items (item_view, items);
-  g_list_free (items);
+  priv = GET_PRIVATE (item_view);
+  sw_poll_interval_set_bounds (&priv->refresh, min_interval, max_interval);
 }
 
 /**
- * sw_item_view_update_existing
+ * sw_item_view_get_refresh_interval
  * @item_view: A #SwItemView
- * @set: A #SwSet
  *
- * Replaces items in the internal set for the #SwItemView with the version
- * from #SwSet if and only if they are sw_item_equal() says that they are
- * unequal. This prevents sending excessive items changed signals.
+ * Returns: the number of seconds that the view suggests waiting before the
+ * next refresh, based on how often recent refreshes found changes.
  */
-static void
-sw_item_view_update_existing (SwItemView *item_view,
-                              SwSet      *set)
+guint
+sw_item_view_get_refresh_interval (SwItemView *item_view)
+{
+  g_return_val_if_fail (SW_IS_ITEM_VIEW (item_view), 0);
+
+  return GET_PRIVATE (item_view)->refresh.interval;
+}
+
+#if BUILD_TESTS
+#include "test-runner.h"
+#include "services/dummy/dummy.h"
+
+static SwItem *
+make_test_item (SwService   *service,
+                const gchar *id,
+                time_t       date)
+{
+  SwItem *item;
+
+  item = sw_item_new ();
+  sw_item_set_service (item, service);
+  sw_item_put (item, "id", id);
+  sw_item_set_date (item, date);
+
+  return item;
+}
+
+static SwSet *
+make_test_set (SwItem *item, ...)
+{
+  SwSet *set;
+  va_list args;
+
+  set = sw_item_set_new ();
+
+  va_start (args, item);
+  for (; item; item = va_arg (args, SwItem *))
+    sw_set_add (set, (GObject *)item);
+  va_end (args);
+
+  return set;
+}
+
+/* The ids of the items in the view, newest first */
+static gchar *
+get_order (SwItemView *item_view)
 {
   SwItemViewPrivate *priv = GET_PRIVATE (item_view);
-  GList *items;
-  SwItem *new_item;
-  SwItem *old_item;
-  GList *l;
-  GList *items_to_send = NULL;
+  GSequenceIter *iter;
+  GString *order;
 
-  items = sw_set_as_list (set);
+  order = g_string_new (NULL);
 
-  for (l = items; l; l = l->next)
+  for (iter = g_sequence_get_begin_iter (priv->ordered_items);
+       !g_sequence_iter_is_end (iter);
+       iter = g_sequence_iter_next (iter))
   {
-    new_item = (SwItem *)l->data;
-    old_item = g_hash_table_lookup (priv->uid_to_items,
-                                    sw_item_get (new_item, "id"));
+    if (order->len)
+      g_string_append_c (order, ' ');
+    g_string_append (order, sw_item_get (g_sequence_get (iter), "id"));
+  }
 
-    /* This is just a new item so we won't find it */
-    if (!old_item)
-      continue;
+  return g_string_free (order, FALSE);
+}
 
-    if (!sw_item_equal (new_item, old_item))
-    {
-      g_hash_table_replace (priv->uid_to_items,
-                            g_strdup (sw_item_get (new_item, "id")),
-                            new_item);
-      /* 
-       * This works because sw_set_add uses g_hash_table_replace behind the
-       * scenes
-       */
-      sw_set_add (priv->current_items_set, (GObject *)new_item);
-      items_to_send = g_list_append (items_to_send, g_object_ref (new_item));
-    }
+static void
+log_items (GString     *log,
+           const gchar *prefix,
+           GPtrArray   *items)
+{
+  guint i;
+
+  for (i = 0; i < items->len; i++)
+  {
+    GValueArray *value_array = g_ptr_array_index (items, i);
+
+    g_string_append_printf (log, "%s%s ", prefix,
+                            g_value_get_string (g_value_array_get_nth (value_array, 1)));
   }
+}
 
-  sw_item_view_update_items (item_view, items_to_send);
+static void
+log_added_cb (SwItemView *item_view, GPtrArray *items, GString *log)
+{
+  log_items (log, "+", items);
+}
 
-  g_list_free (items);
+static void
+log_removed_cb (SwItemView *item_view, GPtrArray *items, GString *log)
+{
+  log_items (log, "-", items);
 }
 
-/**
- * sw_item_view_set_from_set
- * @item_view: A #SwItemView
- * @set: A #SwSet
- *
- * Updates what the view contains based on the given #SwSet. Removed
- * signals will be fired for any items that were in the view but that are not
- * present in the supplied set. Conversely any items that are new will cause
- * signals to be fired indicating their addition.
- *
- * This implemented by maintaining a set inside the #SwItemView
+static void
+log_changed_cb (SwItemView *item_view, GPtrArray *items, GString *log)
+{
+  log_items (log, "~", items);
+}
+
+static void
+log_changed_delta_cb (SwItemView *item_view, GPtrArray *items, GString *log)
+{
+  log_items (log, "^", items);
+}
+
+/*
+ * A view on the dummy service, with every signal it emits appended to @log
+ * as +id, -id, ~id or ^id.
  */
-void
-sw_item_view_set_from_set (SwItemView *item_view,
-                           SwSet      *set)
+static SwItemView *
+make_test_view (SwService *service,
+                GString   *log)
 {
-  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
-  SwSet *added_items, *removed_items;
+  SwItemView *item_view;
+
+  item_view = g_object_new (SW_TYPE_ITEM_VIEW,
+                            "service", service,
+                            "register", FALSE,
+                            NULL);
+
+  g_signal_connect (item_view, "items-added",
+                    G_CALLBACK (log_added_cb), log);
+  g_signal_connect (item_view, "items-removed",
+                    G_CALLBACK (log_removed_cb), log);
+  g_signal_connect (item_view, "items-changed",
+                    G_CALLBACK (log_changed_cb), log);
+  g_signal_connect (item_view, "items-changed-delta",
+                    G_CALLBACK (log_changed_delta_cb), log);
+
+  return item_view;
+}
 
-  if (sw_set_is_empty (priv->current_items_set))
-  {
-    sw_item_view_add_from_set (item_view, set);
-  } else {
-    removed_items = sw_set_difference (priv->current_items_set, set);
-    added_items = sw_set_difference (set, priv->current_items_set);
-
-    if (!sw_set_is_empty (removed_items))
-      sw_item_view_remove_from_set (item_view, removed_items);
-
-    /* 
-     * Replace items that exist in the new set that are also present in the
-     * original set iff they're not equal
-     *
-     * This function will also cause the ItemsChanged signal to be fired with
-     * the items that have changed.
-     */
-    sw_item_view_update_existing (item_view, set);
+static void
+assert_order (SwItemView  *item_view,
+              const gchar *expected)
+{
+  gchar *order;
+
+  order = get_order (item_view);
+  g_assert_cmpstr (order, ==, expected);
+  g_free (order);
+}
 
-    if (!sw_set_is_empty (added_items))
-      sw_item_view_add_from_set (item_view, added_items);
+/*
+ * The log with its entries sorted, for signals that carry several items in
+ * no particular order.
+ */
+static gchar *
+sort_log (GString *log)
+{
+  gchar **entries;
+  GList *sorted = NULL, *l;
+  GString *result;
+  gint i;
 
-    sw_set_unref (removed_items);
-    sw_set_unref (added_items);
+  entries = g_strsplit (log->str, " ", 0);
+  for (i = 0; entries[i]; i++)
+  {
+    if (entries[i][0])
+      sorted = g_list_insert_sorted (sorted, entries[i],
+                                     (GCompareFunc)g_strcmp0);
   }
+
+  result = g_string_new (NULL);
+  for (l = sorted; l; l = l->next)
+    g_string_append_printf (result, "%s ", (gchar *)l->data);
+
+  g_list_free (sorted);
+  g_strfreev (entries);
+  g_string_truncate (log, 0);
+
+  return g_string_free (result, FALSE);
 }
 
 static void
-sw_item_view_remove_item (SwItemView *item_view,
-                          SwItem     *item)
+assert_log (GString     *log,
+            const gchar *expected)
 {
-  GValueArray *value_array;
-  GPtrArray *ptr_array;
+  gchar *sorted;
 
-  ptr_array = g_ptr_array_new ();
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
 
-  value_array = g_value_array_new (2);
+  sorted = sort_log (log);
+  g_assert_cmpstr (sorted, ==, expected);
+  g_free (sorted);
+}
 
-  value_array = g_value_array_append (value_array, NULL);
-  g_value_init (g_value_array_get_nth (value_array, 0), G_TYPE_STRING);
-  g_value_set_string (g_value_array_get_nth (value_array, 0),
-                      sw_service_get_name (sw_item_get_service (item)));
+void
+test_item_view_order (void)
+{
+  SwService *service;
+  SwItemView *item_view;
+  SwItem *a, *b, *b2, *c, *d, *e, *f;
+  GString *log;
+  SwSet *set;
+
+  service = g_object_new (SW_TYPE_SERVICE_DUMMY, NULL);
+  log = g_string_new (NULL);
+  item_view = make_test_view (service, log);
+
+  a = make_test_item (service, "a", 100);
+  b = make_test_item (service, "b", 300);
+  c = make_test_item (service, "c", 200);
+  d = make_test_item (service, "d", 400);
+  e = make_test_item (service, "e", 50);
+
+  /* Items are kept newest first whatever order they arrive in */
+  set = make_test_set (a, b, c, NULL);
+  sw_item_view_set_from_set (item_view, set);
+  sw_set_unref (set);
+  assert_order (item_view, "b c a");
+
+  /* Filling the view doesn't count as a busy refresh */
+  g_assert_cmpint (sw_item_view_get_refresh_interval (item_view), ==, 5 * 60);
+
+  /* Lowering the limit evicts the oldest */
+  g_string_truncate (log, 0);
+  sw_item_view_set_max_items (item_view, 2);
+  assert_order (item_view, "b c");
+  g_assert_cmpstr (log->str, ==, "-a ");
+
+  /* Only the newest items of a refresh are used */
+  g_string_truncate (log, 0);
+  set = make_test_set (b, c, d, e, NULL);
+  sw_item_view_set_from_set (item_view, set);
+  sw_set_unref (set);
+  assert_order (item_view, "d b");
+  g_assert_cmpstr (log->str, ==, "-c +d ");
+
+  /* A change of date moves the item */
+  g_string_truncate (log, 0);
+  b2 = make_test_item (service, "b", 500);
+  set = make_test_set (b2, d, NULL);
+  sw_item_view_set_from_set (item_view, set);
+  sw_set_unref (set);
+  assert_order (item_view, "b d");
+  g_assert_cmpstr (log->str, ==, "~b ");
+
+  /* Items can come back, and go again when the limit is lowered */
+  g_string_truncate (log, 0);
+  sw_item_view_set_max_items (item_view, 0);
+  set = make_test_set (b2, d, c, NULL);
+  sw_item_view_set_from_set (item_view, set);
+  sw_set_unref (set);
+  assert_order (item_view, "b d c");
+  sw_item_view_set_max_items (item_view, 2);
+  assert_order (item_view, "b d");
+  g_assert_cmpstr (log->str, ==, "+c -c ");
+
+  /* Items that were never sent are evicted without telling the client */
+  g_string_truncate (log, 0);
+  f = make_test_item (service, "f", 10);
+  sw_item_push_pending (f);
+  sw_item_view_set_max_items (item_view, 0);
+  set = make_test_set (b2, d, f, NULL);
+  sw_item_view_set_from_set (item_view, set);
+  sw_set_unref (set);
+  assert_order (item_view, "b d f");
+  sw_item_view_set_max_items (item_view, 2);
+  assert_order (item_view, "b d");
+  g_assert_cmpstr (log->str, ==, "");
 
-  value_array = g_value_array_append (value_array, NULL);
-  g_value_init (g_value_array_get_nth (value_array, 1), G_TYPE_STRING);
-  g_value_set_string (g_value_array_get_nth (value_array, 1),
-                      sw_item_get (item, "id"));
+  g_object_unref (item_view);
+  g_object_unref (f);
+  g_object_unref (a);
+  g_object_unref (b);
+  g_object_unref (b2);
+  g_object_unref (c);
+  g_object_unref (d);
+  g_object_unref (e);
+  g_string_free (log, TRUE);
+  g_object_unref (service);
+}
 
-  g_ptr_array_add (ptr_array, value_array);
+void
+test_item_view_window (void)
+{
+  SwService *service;
+  SwItemView *item_view;
+  SwItem *a, *a2, *b, *b2, *c, *d, *d2, *e;
+  GString *log;
+  SwSet *set;
+
+  service = g_object_new (SW_TYPE_SERVICE_DUMMY, NULL);
+  log = g_string_new (NULL);
+  item_view = make_test_view (service, log);
+
+  a = make_test_item (service, "a", 100);
+  b = make_test_item (service, "b", 200);
+  c = make_test_item (service, "c", 300);
+  d = make_test_item (service, "d", 400);
+  e = make_test_item (service, "e", 350);
+
+  set = make_test_set (a, b, c, d, NULL);
+  sw_item_view_set_from_set (item_view, set);
+  sw_set_unref (set);
+  assert_log (log, "+a +b +c +d ");
+
+  /* Items that were sent and are outside the window are removed */
+  _set_window (item_view, 1, 2);
+  assert_log (log, "-a -d ");
+
+  /* A new item pushes the last one out of the window */
+  set = make_test_set (a, b, c, d, e, NULL);
+  sw_item_view_set_from_set (item_view, set);
+  sw_set_unref (set);
+  assert_order (item_view, "d e c b a");
+  assert_log (log, "+e -b ");
+
+  /* Removing one pulls the next one in */
+  set = make_test_set (a, b, d, e, NULL);
+  sw_item_view_set_from_set (item_view, set);
+  sw_set_unref (set);
+  assert_log (log, "+b -c ");
+
+  /* Only changes inside the window are sent */
+  a2 = make_test_item (service, "a", 100);
+  sw_item_put (a2, "content", "changed");
+  b2 = make_test_item (service, "b", 200);
+  sw_item_put (b2, "content", "changed");
+  set = make_test_set (a2, b2, d, e, NULL);
+  sw_item_view_set_from_set (item_view, set);
+  sw_set_unref (set);
+  assert_log (log, "~b ");
+
+  /* A change of date moves items in and out */
+  d2 = make_test_item (service, "d", 10);
+  set = make_test_set (a2, b2, d2, e, NULL);
+  sw_item_view_set_from_set (item_view, set);
+  sw_set_unref (set);
+  assert_order (item_view, "e b a d");
+  assert_log (log, "+a -e ");
+
+  /* Evicting items outside the window isn't noticed, inside it is */
+  sw_item_view_set_max_items (item_view, 3);
+  assert_log (log, "");
+  sw_item_view_set_max_items (item_view, 2);
+  assert_order (item_view, "e b");
+  assert_log (log, "-a ");
+
+  /* Moving the window */
+  _set_window (item_view, 0, 0);
+  assert_log (log, "+e ");
 
-  sw_item_view_iface_emit_items_removed (item_view,
-                                         ptr_array);
+  g_object_unref (item_view);
+  g_object_unref (a);
+  g_object_unref (a2);
+  g_object_unref (b);
+  g_object_unref (b2);
+  g_object_unref (c);
+  g_object_unref (d);
+  g_object_unref (d2);
+  g_object_unref (e);
+  g_string_free (log, TRUE);
+  g_object_unref (service);
+}
 
-  g_ptr_array_free (ptr_array, TRUE);
+/* A view that counts how often it is started and stopped */
+typedef struct {
+  SwItemView parent;
+  guint n_started;
+  guint n_stopped;
+} CountingItemView;
+
+typedef struct {
+  SwItemViewClass parent_class;
+} CountingItemViewClass;
+
+static GType counting_item_view_get_type (void);
+G_DEFINE_TYPE (CountingItemView, counting_item_view, SW_TYPE_ITEM_VIEW);
+
+static void
+counting_item_view_start (SwItemView *item_view)
+{
+  ((CountingItemView *)item_view)->n_started++;
+}
+
+static void
+counting_item_view_stop (SwItemView *item_view)
+{
+  ((CountingItemView *)item_view)->n_stopped++;
+}
+
+static void
+counting_item_view_class_init (CountingItemViewClass *klass)
+{
+  SwItemViewClass *item_view_class = SW_ITEM_VIEW_CLASS (klass);
+
+  item_view_class->start = counting_item_view_start;
+  item_view_class->stop = counting_item_view_stop;
+}
+
+static void
+counting_item_view_init (CountingItemView *self)
+{
+}
+
+/* What the client monitor does when @sender disconnects from the bus */
+static void
+disconnect_client (SwItemView  *item_view,
+                   const gchar *sender)
+{
+  _client_gone_cb (sender, G_OBJECT (item_view), NULL);
+  sw_client_monitor_remove (g_strdup (sender), G_OBJECT (item_view));
+  g_object_unref (item_view);
 }
 
 void
-sw_item_view_remove_by_uid (SwItemView  *item_view,
-                            const gchar *uid)
+test_item_view_clients (void)
 {
-  SwItemViewPrivate *priv = GET_PRIVATE (item_view);
-  SwItem *item;
+  SwService *service;
+  SwItemView *item_view;
+  CountingItemView *counting;
+
+  service = g_object_new (SW_TYPE_SERVICE_DUMMY, NULL);
+  item_view = g_object_new (counting_item_view_get_type (),
+                            "service", service,
+                            "register", FALSE,
+                            NULL);
+  counting = (CountingItemView *)item_view;
+  g_object_add_weak_pointer (G_OBJECT (item_view), (gpointer)&item_view);
+
+  /* Two clients share the view, each holding a reference */
+  sw_client_monitor_add (g_strdup (":1.1"), G_OBJECT (item_view));
+  sw_client_monitor_add (g_strdup (":1.2"), g_object_ref (item_view));
+
+  /* It is only started once */
+  _start (item_view, g_strdup (":1.1"));
+  _start (item_view, g_strdup (":1.2"));
+  g_assert_cmpint (counting->n_started, ==, 1);
+
+  /* And keeps going until every client has stopped */
+  _stop (item_view, ":1.1");
+  _stop (item_view, ":1.1");
+  g_assert_cmpint (counting->n_stopped, ==, 0);
+
+  /* A client that goes away without stopping counts as stopped */
+  disconnect_client (item_view, ":1.2");
+  g_assert_cmpint (counting->n_stopped, ==, 1);
+  g_assert_cmpint (sw_client_monitor_get_n_clients (G_OBJECT (item_view)), ==, 1);
+
+  /* Closing a shared view stops it for that client only */
+  sw_client_monitor_add (g_strdup (":1.3"), g_object_ref (item_view));
+  _start (item_view, g_strdup (":1.3"));
+  _start (item_view, g_strdup (":1.1"));
+  g_assert_cmpint (counting->n_started, ==, 2);
+
+  _close (item_view, g_strdup (":1.3"));
+  g_assert (item_view != NULL);
+  g_assert_cmpint (counting->n_stopped, ==, 1);
+
+  /* The last client to close it disposes of it */
+  _close (item_view, g_strdup (":1.1"));
+  g_assert (item_view == NULL);
+
+  g_object_unref (service);
+}
 
-  item = g_hash_table_lookup (priv->uid_to_items,
-                              uid);
+void
+test_item_view_change_modes (void)
+{
+  SwService *service;
+  SwItemView *item_view;
+  SwItem *a, *a2, *a3;
+  GString *log;
+  SwSet *set;
+
+  service = g_object_new (SW_TYPE_SERVICE_DUMMY, NULL);
+  log = g_string_new (NULL);
+  item_view = make_test_view (service, log);
+
+  sw_client_monitor_add (g_strdup (":1.1"), G_OBJECT (item_view));
+  sw_client_monitor_add (g_strdup (":1.2"), g_object_ref (item_view));
+
+  a = make_test_item (service, "a", 100);
+  set = make_test_set (a, NULL);
+  sw_item_view_set_from_set (item_view, set);
+  sw_set_unref (set);
+  assert_log (log, "+a ");
+
+  /* One client asking for deltas doesn't take ItemsChanged from the other */
+  _set_change_deltas (item_view, g_strdup (":1.1"), TRUE);
+
+  a2 = make_test_item (service, "a", 100);
+  sw_item_put (a2, "content", "changed");
+  set = make_test_set (a2, NULL);
+  sw_item_view_set_from_set (item_view, set);
+  sw_set_unref (set);
+  assert_log (log, "^a ~a ");
+
+  /* Once the other client has gone only deltas are sent */
+  disconnect_client (item_view, ":1.2");
+
+  a3 = make_test_item (service, "a", 100);
+  sw_item_put (a3, "content", "changed again");
+  set = make_test_set (a3, NULL);
+  sw_item_view_set_from_set (item_view, set);
+  sw_set_unref (set);
+  assert_log (log, "^a ");
+
+  _close (item_view, g_strdup (":1.1"));
+
+  g_object_unref (a);
+  g_object_unref (a2);
+  g_object_unref (a3);
+  g_string_free (log, TRUE);
+  g_object_unref (service);
+}
 
-  if (item)
-  {
-    sw_item_view_remove_item (item_view, item);
-    sw_set_remove (priv->current_items_set, (GObject *)item);
-    g_hash_table_remove (priv->uid_to_items,
-                         uid);
-  } else {
-    g_critical (G_STRLOC ": Asked to remove unknown item: %s", uid);
-  }
+void
+test_item_view_same_client (void)
+{
+  SwService *service;
+  SwItemView *item_view;
+  CountingItemView *counting;
+  SwItem *a, *a2, *a3;
+  GString *log;
+  SwSet *set;
+
+  service = g_object_new (SW_TYPE_SERVICE_DUMMY, NULL);
+
+  /* One client opens the view twice, for two widgets say */
+  item_view = g_object_new (counting_item_view_get_type (),
+                            "service", service,
+                            "register", FALSE,
+                            NULL);
+  counting = (CountingItemView *)item_view;
+  sw_client_monitor_add (g_strdup (":1.1"), G_OBJECT (item_view));
+  sw_client_monitor_add (g_strdup (":1.1"), g_object_ref (item_view));
+
+  /* Stopping one use leaves the other running */
+  _start (item_view, g_strdup (":1.1"));
+  _start (item_view, g_strdup (":1.1"));
+  g_assert_cmpint (counting->n_started, ==, 1);
+  _stop (item_view, ":1.1");
+  g_assert_cmpint (counting->n_stopped, ==, 0);
+  _stop (item_view, ":1.1");
+  g_assert_cmpint (counting->n_stopped, ==, 1);
+
+  /* And so does closing one */
+  _start (item_view, g_strdup (":1.1"));
+  _start (item_view, g_strdup (":1.1"));
+  _close (item_view, g_strdup (":1.1"));
+  g_assert_cmpint (counting->n_stopped, ==, 1);
+  _close (item_view, g_strdup (":1.1"));
+
+  log = g_string_new (NULL);
+  item_view = make_test_view (service, log);
+  sw_client_monitor_add (g_strdup (":1.1"), G_OBJECT (item_view));
+  sw_client_monitor_add (g_strdup (":1.1"), g_object_ref (item_view));
+
+  a = make_test_item (service, "a", 100);
+  set = make_test_set (a, NULL);
+  sw_item_view_set_from_set (item_view, set);
+  sw_set_unref (set);
+  assert_log (log, "+a ");
+
+  /* Both uses want deltas, so only deltas are sent */
+  _set_change_deltas (item_view, g_strdup (":1.1"), TRUE);
+  _set_change_deltas (item_view, g_strdup (":1.1"), TRUE);
+
+  a2 = make_test_item (service, "a", 100);
+  sw_item_put (a2, "content", "changed");
+  set = make_test_set (a2, NULL);
+  sw_item_view_set_from_set (item_view, set);
+  sw_set_unref (set);
+  assert_log (log, "^a ");
+
+  /* Closing one use doesn't take deltas away from the other */
+  _close (item_view, g_strdup (":1.1"));
+
+  a3 = make_test_item (service, "a", 100);
+  sw_item_put (a3, "content", "changed again");
+  set = make_test_set (a3, NULL);
+  sw_item_view_set_from_set (item_view, set);
+  sw_set_unref (set);
+  assert_log (log, "^a ");
+
+  _close (item_view, g_strdup (":1.1"));
+
+  g_object_unref (a);
+  g_object_unref (a2);
+  g_object_unref (a3);
+  g_string_free (log, TRUE);
+  g_object_unref (service);
 }
+#endif
@@ -61,6 +61,28 @@ void sw_item_view_set_from_set (SwItemView *item_view,
                                 SwSet      *set);
 void sw_item_view_remove_by_uid (SwItemView  *item_view,
                                  const gchar *uid);
+void sw_item_view_load_from_cache (SwItemView  *item_view,
+                                   const gchar *query,
+                                   GHashTable  *params);
+
+void sw_item_view_set_max_items (SwItemView *item_view,
+                                 guint       max_items);
+guint sw_item_view_get_max_items (SwItemView *item_view);
+void sw_item_view_set_max_items_from_params (SwItemView *item_view,
+                                             GHashTable *params);
+
+void sw_item_view_set_ready_batching (SwItemView *item_view,
+                                      guint       latency,
+                                      guint       batch_size);
+void sw_item_view_set_add_immediately (SwItemView *item_view,
+                                       gboolean    add_immediately);
+void sw_item_view_set_change_batching (SwItemView *item_view,
+                                       guint       window,
+                                       guint       max_batch);
+void sw_item_view_set_refresh_bounds (SwItemView *item_view,
+                                      guint       min_interval,
+                                      guint       max_interval);
+guint sw_item_view_get_refresh_interval (SwItemView *item_view);
 
 const gchar *sw_item_view_get_object_path (SwItemView *item_view);
 SwService *sw_item_view_get_service (SwItemView *item_view);
@@ -33,13 +33,64 @@ G_DEFINE_TYPE_WITH_CODE (SwItem, sw_item, G_TYPE_OBJECT,
 #define GET_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((o), SW_TYPE_ITEM, SwItemPrivate))
 
+/*
+ * The well-known keys are stored in a fixed array of slots, so that looking
+ * them up doesn't need the global intern table or a hash probe.  Anything
+ * else goes in the overflow hash, which is only created when needed.
+ */
+typedef enum {
+  SLOT_ID,
+  SLOT_DATE,
+  SLOT_AUTHORID,
+  SLOT_AUTHOR,
+  SLOT_AUTHORICON,
+  SLOT_CONTENT,
+  SLOT_URL,
+  SLOT_THUMBNAIL,
+  SLOT_TITLE,
+  SLOT_LOCATION,
+  SLOT_LATITUDE,
+  SLOT_LONGITUDE,
+  SLOT_CACHED,
+  N_SLOTS
+} ItemSlot;
+
+static const char * const slot_names[N_SLOTS] = {
+  "id",
+  "date",
+  "authorid",
+  "author",
+  "authoricon",
+  "content",
+  "url",
+  "thumbnail",
+  "title",
+  "location",
+  "latitude",
+  "longitude",
+  "cached"
+};
+
 struct _SwItemPrivate {
   /* TODO: fix lifecycle */
   SwService *service;
+  char *slots[N_SLOTS];
+  /* Interned key to value, for keys without a slot.  May be NULL */
+  GHashTable *overflow;
+  /* All of the keys, built by sw_item_peek_hash().  May be NULL */
   GHashTable *hash;
+  /* g_str_hash of the id, and the sum of value_fingerprint of every key */
+  guint id_hash;
+  guint64 fingerprint;
   time_t cached_date;
   time_t mtime;
   gint remaining_fetches;
+  /*
+   * Keys changed since sw_item_clear_dirty(): a bit per slot, and the
+   * interned names of other keys.  dirty_overflow may be NULL.
+   */
+  guint dirty_slots;
+  GHashTable *dirty_overflow;
 };
 
 enum
@@ -67,9 +118,31 @@ sw_item_dispose (GObject *object)
     priv->hash = NULL;
   }
 
+  if (priv->overflow) {
+    g_hash_table_unref (priv->overflow);
+    priv->overflow = NULL;
+  }
+
+  if (priv->dirty_overflow) {
+    g_hash_table_unref (priv->dirty_overflow);
+    priv->dirty_overflow = NULL;
+  }
+
   G_OBJECT_CLASS (sw_item_parent_class)->dispose (object);
 }
 
+static void
+sw_item_finalize (GObject *object)
+{
+  SwItem *item = SW_ITEM (object);
+  int i;
+
+  for (i = 0; i < N_SLOTS; i++)
+    g_free (item->priv->slots[i]);
+
+  G_OBJECT_CLASS (sw_item_parent_class)->finalize (object);
+}
+
 static void
 sw_item_get_property (GObject    *object,
                           guint       property_id,
@@ -98,6 +171,7 @@ sw_item_class_init (SwItemClass *klass)
   g_type_class_add_private (klass, sizeof (SwItemPrivate));
 
   object_class->dispose = sw_item_dispose;
+  object_class->finalize = sw_item_finalize;
   object_class->get_property = sw_item_get_property;
 
   pspec = g_param_spec_boolean ("ready",
@@ -122,8 +196,6 @@ static void
 sw_item_init (SwItem *self)
 {
   self->priv = GET_PRIVATE (self);
-
-  self->priv->hash = g_hash_table_new_full (NULL, NULL, NULL, g_free);
 }
 
 SwItem*
@@ -150,19 +222,134 @@ sw_item_get_service (SwItem *item)
   return item->priv->service;
 }
 
+/*
+ * Return the slot for @key, or -1 if it doesn't have one.
+ */
+static int
+get_slot (const char *key)
+{
+  int slot;
+
+  switch (key[0]) {
+  case 'a':
+    if (key[1] != 'u' || strncmp (key, "author", 6) != 0)
+      return -1;
+    if (key[6] == '\0')
+      return SLOT_AUTHOR;
+    slot = strcmp (key + 6, "id") == 0 ? SLOT_AUTHORID :
+      strcmp (key + 6, "icon") == 0 ? SLOT_AUTHORICON : -1;
+    return slot;
+  case 'c':
+    slot = strcmp (key, "content") == 0 ? SLOT_CONTENT :
+      strcmp (key, "cached") == 0 ? SLOT_CACHED : -1;
+    return slot;
+  case 'd':
+    return strcmp (key, "date") == 0 ? SLOT_DATE : -1;
+  case 'i':
+    return strcmp (key, "id") == 0 ? SLOT_ID : -1;
+  case 'l':
+    slot = strcmp (key, "location") == 0 ? SLOT_LOCATION :
+      strcmp (key, "latitude") == 0 ? SLOT_LATITUDE :
+      strcmp (key, "longitude") == 0 ? SLOT_LONGITUDE : -1;
+    return slot;
+  case 't':
+    slot = strcmp (key, "thumbnail") == 0 ? SLOT_THUMBNAIL :
+      strcmp (key, "title") == 0 ? SLOT_TITLE : -1;
+    return slot;
+  case 'u':
+    return strcmp (key, "url") == 0 ? SLOT_URL : -1;
+  default:
+    return -1;
+  }
+}
+
+static guint64
+value_fingerprint (const char *key, const char *value)
+{
+  return sw_hash_string_64 (sw_hash_string_64 (SW_HASH_64_INIT, key), value);
+}
+
+static void
+mark_dirty (SwItem *item, const char *key, int slot)
+{
+  SwItemPrivate *priv = item->priv;
+
+  if (slot >= 0) {
+    priv->dirty_slots |= 1 << slot;
+    return;
+  }
+
+  if (priv->dirty_overflow == NULL)
+    priv->dirty_overflow = g_hash_table_new (NULL, NULL);
+
+  g_hash_table_insert (priv->dirty_overflow,
+                       (gpointer)g_intern_string (key),
+                       (gpointer)g_intern_string (key));
+}
+
+/*
+ * Store @value under @key, taking ownership of @value.  A NULL @value removes
+ * the key.
+ */
+static void
+set_value (SwItem *item, const char *key, char *value)
+{
+  SwItemPrivate *priv = item->priv;
+  const char *old_value;
+  int slot;
+
+  /* Any hash handed out is now out of date */
+  if (priv->hash) {
+    g_hash_table_unref (priv->hash);
+    priv->hash = NULL;
+  }
+
+  slot = get_slot (key);
+  old_value = sw_item_get (item, key);
+
+  if (g_strcmp0 (old_value, value) != 0)
+    mark_dirty (item, key, slot);
+
+  /*
+   * Keep the fingerprint up to date.  It is a sum so that the contribution
+   * of the old value can be taken out.  The cached flag doesn't count.
+   */
+  if (slot != SLOT_CACHED) {
+    if (old_value)
+      priv->fingerprint -= value_fingerprint (key, old_value);
+    if (value)
+      priv->fingerprint += value_fingerprint (key, value);
+  }
+
+  if (slot == SLOT_ID)
+    priv->id_hash = value ? g_str_hash (value) : 0;
+
+  if (slot >= 0) {
+    g_free (priv->slots[slot]);
+    priv->slots[slot] = value;
+
+    if (slot == SLOT_DATE)
+      priv->cached_date = 0;
+  } else if (value) {
+    if (priv->overflow == NULL)
+      priv->overflow = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+
+    g_hash_table_insert (priv->overflow,
+                         (gpointer)g_intern_string (key),
+                         value);
+  } else if (priv->overflow) {
+    g_hash_table_remove (priv->overflow,
+                         (gpointer)g_intern_string (key));
+  }
+}
+
 void
 sw_item_put (SwItem *item, const char *key, const char *value)
 {
   g_return_if_fail (SW_IS_ITEM (item));
   g_return_if_fail (key);
 
-  if (value)
-    g_hash_table_insert (item->priv->hash,
-                         (gpointer)g_intern_string (key),
-                         g_strdup (value));
-  else
-    g_hash_table_remove (item->priv->hash,
-                         (gpointer)g_intern_string (key));
+  set_value (item, key, g_strdup (value));
 
   sw_item_touch (item);
 }
@@ -173,13 +360,7 @@ sw_item_take (SwItem *item, const char *key, char *value)
   g_return_if_fail (SW_IS_ITEM (item));
   g_return_if_fail (key);
 
-  if (value)
-    g_hash_table_insert (item->priv->hash,
-                         (gpointer)g_intern_string (key),
-                         value);
-  else
-    g_hash_table_remove (item->priv->hash,
-                         (gpointer)g_intern_string (key));
+  set_value (item, key, value);
 
   sw_item_touch (item);
 }
@@ -187,10 +368,188 @@ sw_item_take (SwItem *item, const char *key, char *value)
 const char *
 sw_item_get (const SwItem *item, const char *key)
 {
+  int slot;
+
   g_return_val_if_fail (SW_IS_ITEM (item), NULL);
   g_return_val_if_fail (key, NULL);
 
-  return g_hash_table_lookup (item->priv->hash, g_intern_string (key));
+  slot = get_slot (key);
+  if (slot >= 0)
+    return item->priv->slots[slot];
+
+  if (item->priv->overflow == NULL)
+    return NULL;
+
+  return g_hash_table_lookup (item->priv->overflow, g_intern_string (key));
+}
+
+/**
+ * sw_item_foreach:
+ * @item: a #SwItem
+ * @func: the function to call
+ * @user_data: data to pass to @func
+ *
+ * Call @func for every key and value set on @item.  @item must not be
+ * changed by @func.
+ */
+void
+sw_item_foreach (SwItem *item, GHFunc func, gpointer user_data)
+{
+  SwItemPrivate *priv;
+  int i;
+
+  g_return_if_fail (SW_IS_ITEM (item));
+  g_return_if_fail (func);
+
+  priv = item->priv;
+
+  for (i = 0; i < N_SLOTS; i++) {
+    if (priv->slots[i])
+      func ((gpointer)slot_names[i], priv->slots[i], user_data);
+  }
+
+  if (priv->overflow)
+    g_hash_table_foreach (priv->overflow, func, user_data);
+}
+
+/**
+ * sw_item_foreach_dirty:
+ * @item: a #SwItem
+ * @func: the function to call
+ * @user_data: data to pass to @func
+ *
+ * Call @func for every key that has been set or removed since
+ * sw_item_clear_dirty() was last called, with the current value or %NULL if
+ * the key was removed.  @item must not be changed by @func.
+ */
+void
+sw_item_foreach_dirty (SwItem *item, GHFunc func, gpointer user_data)
+{
+  SwItemPrivate *priv;
+  GHashTableIter iter;
+  gpointer key;
+  int i;
+
+  g_return_if_fail (SW_IS_ITEM (item));
+  g_return_if_fail (func);
+
+  priv = item->priv;
+
+  for (i = 0; i < N_SLOTS; i++) {
+    if (priv->dirty_slots & (1 << i))
+      func ((gpointer)slot_names[i], priv->slots[i], user_data);
+  }
+
+  if (priv->dirty_overflow == NULL)
+    return;
+
+  g_hash_table_iter_init (&iter, priv->dirty_overflow);
+  while (g_hash_table_iter_next (&iter, &key, NULL)) {
+    func (key,
+          priv->overflow ? g_hash_table_lookup (priv->overflow, key) : NULL,
+          user_data);
+  }
+}
+
+gboolean
+sw_item_is_dirty (SwItem *item)
+{
+  g_return_val_if_fail (SW_IS_ITEM (item), FALSE);
+
+  return item->priv->dirty_slots != 0 ||
+    (item->priv->dirty_overflow &&
+     g_hash_table_size (item->priv->dirty_overflow) > 0);
+}
+
+void
+sw_item_clear_dirty (SwItem *item)
+{
+  SwItemPrivate *priv;
+
+  g_return_if_fail (SW_IS_ITEM (item));
+
+  priv = item->priv;
+
+  priv->dirty_slots = 0;
+
+  if (priv->dirty_overflow) {
+    g_hash_table_unref (priv->dirty_overflow);
+    priv->dirty_overflow = NULL;
+  }
+}
+
+typedef struct {
+  SwItem *item;
+  SwItem *other;
+} MergeClosure;
+
+/* Mark @key dirty on the item if @other doesn't have @value for it */
+static void
+mark_if_different (gpointer key, gpointer value, gpointer user_data)
+{
+  MergeClosure *closure = user_data;
+
+  if (g_strcmp0 (sw_item_get (closure->other, key), value) != 0)
+    mark_dirty (closure->item, key, get_slot (key));
+}
+
+static void
+mark_dirty_cb (gpointer key, gpointer value, gpointer user_data)
+{
+  MergeClosure *closure = user_data;
+
+  mark_dirty (closure->item, key, get_slot (key));
+}
+
+/**
+ * sw_item_merge_dirty:
+ * @item: a #SwItem
+ * @previous: the #SwItem that @item replaces
+ *
+ * Mark as dirty every key where @item differs from @previous, as well as
+ * those still dirty on @previous, so that @item carries whatever a client
+ * that last saw @previous is missing.
+ */
+void
+sw_item_merge_dirty (SwItem *item, SwItem *previous)
+{
+  MergeClosure closure;
+
+  g_return_if_fail (SW_IS_ITEM (item));
+  g_return_if_fail (SW_IS_ITEM (previous));
+
+  sw_item_clear_dirty (item);
+
+  closure.item = item;
+
+  sw_item_foreach_dirty (previous, mark_dirty_cb, &closure);
+
+  closure.other = item;
+  sw_item_foreach (previous, mark_if_different, &closure);
+
+  closure.other = previous;
+  sw_item_foreach (item, mark_if_different, &closure);
+}
+
+static void
+add_to_hash (gpointer key, gpointer value, gpointer user_data)
+{
+  g_hash_table_insert (user_data, key, value);
+}
+
+/*
+ * Make a hash of all of the keys and values of @item.  The hash doesn't own
+ * them, so it is only valid until @item is changed.
+ */
+static GHashTable *
+make_hash (SwItem *item)
+{
+  GHashTable *hash;
+
+  hash = g_hash_table_new (g_str_hash, g_str_equal);
+  sw_item_foreach (item, add_to_hash, hash);
+
+  return hash;
 }
 
 static void
@@ -201,13 +560,38 @@ cache_date (SwItem *item)
   if (item->priv->cached_date)
     return;
 
-  s = g_hash_table_lookup (item->priv->hash, g_intern_string ("date"));
+  s = item->priv->slots[SLOT_DATE];
   if (!s)
     return;
 
   item->priv->cached_date = sw_time_t_from_string (s);
 }
 
+/*
+ * Set the date of the item directly, saving a round-trip through the
+ * string form.  The "date" string is still kept for the cache and clients.
+ */
+void
+sw_item_set_date (SwItem *item, time_t date)
+{
+  g_return_if_fail (SW_IS_ITEM (item));
+
+  set_value (item, "date", sw_time_t_to_string (date));
+  item->priv->cached_date = date;
+
+  sw_item_touch (item);
+}
+
+time_t
+sw_item_get_date (SwItem *item)
+{
+  g_return_val_if_fail (SW_IS_ITEM (item), 0);
+
+  cache_date (item);
+
+  return item->priv->cached_date;
+}
+
 int
 sw_item_compare_date_older (SwItem *a, SwItem *b)
 {
@@ -232,29 +616,26 @@ sw_item_compare_date_newer (SwItem *a, SwItem *b)
   return b->priv->cached_date - a->priv->cached_date;
 }
 
+static void
+dump_value (gpointer key, gpointer value, gpointer user_data)
+{
+  g_printerr (" %s=%s\n", (char *)key, (char *)value);
+}
+
 void
 sw_item_dump (SwItem *item)
 {
-  GHashTableIter iter;
-  const char *key, *value;
-
   g_return_if_fail (SW_IS_ITEM (item));
 
   g_printerr ("SwItem %p\n", item);
-  g_hash_table_iter_init (&iter, item->priv->hash);
-  while (g_hash_table_iter_next (&iter,
-                                 (gpointer)&key,
-                                 (gpointer)&value)) {
-    g_printerr (" %s=%s\n", key, value);
-  }
+  sw_item_foreach (item, dump_value, NULL);
 }
 
 static guint
 item_hash (gconstpointer key)
 {
   const SwItem *item = key;
-  return g_str_hash (g_hash_table_lookup (item->priv->hash,
-                                          g_intern_string ("id")));
+  return item->priv->id_hash;
 }
 
 gboolean
@@ -263,10 +644,9 @@ item_equal (gconstpointer a, gconstpointer b)
   const SwItem *item_a = a;
   const SwItem *item_b = b;
 
-  return g_str_equal (g_hash_table_lookup (item_a->priv->hash,
-                                           g_intern_string ("id")),
-                      g_hash_table_lookup (item_b->priv->hash,
-                                           g_intern_string ("id")));
+  return item_a->priv->id_hash == item_b->priv->id_hash &&
+    g_str_equal (item_a->priv->slots[SLOT_ID],
+                 item_b->priv->slots[SLOT_ID]);
 }
 
 SwSet *
@@ -275,11 +655,18 @@ sw_item_set_new (void)
   return sw_set_new_full (item_hash, item_equal);
 }
 
+/*
+ * The returned hash is only valid until the item is next changed;
+ * sw_item_foreach() is cheaper if you just want to look at every key.
+ */
 GHashTable *
 sw_item_peek_hash (SwItem *item)
 {
   g_return_val_if_fail (SW_IS_ITEM (item), NULL);
 
+  if (item->priv->hash == NULL)
+    item->priv->hash = make_hash (item);
+
   return item->priv->hash;
 }
 
@@ -369,7 +756,7 @@ _sw_item_to_value_array (SwItem *item)
   GValueArray *value_array;
   time_t time;
 
-  time = sw_time_t_from_string (sw_item_get (item, "date"));
+  time = sw_item_get_date (item);
 
   value_array = g_value_array_new (4);
 
@@ -393,8 +780,9 @@ _sw_item_to_value_array (SwItem *item)
                 dbus_g_type_get_map ("GHashTable",
                                      G_TYPE_STRING,
                                      G_TYPE_STRING));
-  g_value_set_boxed (g_value_array_get_nth (value_array, 3),
-                     sw_item_peek_hash (item));
+  /* The item won't change before the signal is emitted */
+  g_value_take_boxed (g_value_array_get_nth (value_array, 3),
+                      make_hash (item));
 
   return value_array;
 }
@@ -413,19 +801,17 @@ sw_item_get_mtime (SwItem *item)
   return item->priv->mtime;
 }
 
-/* Intentionally don't compare the mtime */
+/*
+ * Intentionally don't compare the mtime.  The fingerprints are 64-bit
+ * hashes of the contents, so items with equal fingerprints are taken to be
+ * equal.
+ */
 gboolean
 sw_item_equal (SwItem *a,
                SwItem *b)
 {
   SwItemPrivate *priv_a = GET_PRIVATE (a);
   SwItemPrivate *priv_b = GET_PRIVATE (b);
-  GHashTable *hash_a = priv_a->hash;
-  GHashTable *hash_b = priv_b->hash;
-  GHashTableIter iter_a;
-  gpointer key_a, value_a;
-  gpointer value_b;
-  guint size_a, size_b;
 
   if (priv_a->service != priv_b->service)
     return FALSE;
@@ -433,36 +819,7 @@ sw_item_equal (SwItem *a,
   if (priv_a->remaining_fetches != priv_b->remaining_fetches)
     return FALSE;
 
-  size_a = g_hash_table_size (hash_a);
-  size_b = g_hash_table_size (hash_b);
-
-  if (g_hash_table_lookup (hash_a, "cached"))
-    size_a--;
-
-  if (g_hash_table_lookup (hash_b, "cached"))
-    size_b--;
-
-  if (size_a != size_b)
-    return FALSE;
-
-  g_hash_table_iter_init (&iter_a, hash_a);
-
-  while (g_hash_table_iter_next (&iter_a, &key_a, &value_a)) 
-  {
-    if (g_str_equal (key_a, "cached"))
-      continue;
-
-    value_b = g_hash_table_lookup (hash_b, key_a);
-
-    if (value_b == NULL)
-      return FALSE;
-
-    if (!g_str_equal (value_a, value_b))
-      return FALSE;
-
-  }
-
-  return TRUE;
+  return priv_a->fingerprint == priv_b->fingerprint;
 }
 
 static const gchar *
@@ -472,36 +829,31 @@ sw_item_get_id (SwCacheable *cacheable)
   return sw_item_get (self, "id");
 }
 
+typedef struct {
+  SwCacheableFieldFunc func;
+  gpointer user_data;
+} FieldClosure;
+
 static void
-sw_item_save_into_cache (SwCacheable *cacheable, GKeyFile *keys,
-                         const gchar *group)
+field_cb (gpointer key, gpointer value, gpointer user_data)
 {
-  SwItem *item = SW_ITEM (cacheable);
-  const char *key;
-  const gpointer value;
-  GHashTableIter iter;
+  FieldClosure *closure = user_data;
 
-  /* Set a magic field saying that this item is cached */
-  g_key_file_set_string (keys, group, "cached", "1");
-  g_key_file_set_string (keys, group, "type", "item");
-
-  g_hash_table_iter_init (&iter, sw_item_peek_hash (item));
-  while (g_hash_table_iter_next (&iter, (gpointer)&key, &value)) {
-    char *new_value;
-    /*
-     * We make relative paths when saving so that the cache files are portable
-     * between users.  This normally doesn't happen but it's useful and the
-     * preloaded cache depends on this.
-     */
-    new_value = make_relative_path (key, value);
-    if (new_value) {
-      g_key_file_set_string (keys, group, key, new_value);
-      g_free (new_value);
-    } else {
-      g_key_file_set_string (keys, group, key, value);
-    }
-  }
+  /* Set by the cache on load */
+  if (g_str_equal (key, "cached") || g_str_equal (key, "type"))
+    return;
 
+  closure->func (key, value, closure->user_data);
+}
+
+static void
+sw_item_foreach_field (SwCacheable          *cacheable,
+                       SwCacheableFieldFunc  func,
+                       gpointer              user_data)
+{
+  FieldClosure closure = { func, user_data };
+
+  sw_item_foreach (SW_ITEM (cacheable), field_cb, &closure);
 }
 
 static void
@@ -510,5 +862,150 @@ sw_item_cacheable_init (SwCacheableInterface *iface,
 {
   iface->get_id = sw_item_get_id;
   iface->is_ready = sw_item_get_ready;
-  iface->save_into_cache = sw_item_save_into_cache;
+  iface->foreach_field = sw_item_foreach_field;
+}
+
+#if BUILD_TESTS
+#include "test-runner.h"
+
+void
+test_item_slots (void)
+{
+  SwItem *a, *b;
+  GHashTable *hash;
+
+  a = sw_item_new ();
+  b = sw_item_new ();
+
+  /* Well-known and overflow keys */
+  sw_item_put (a, "id", "1");
+  sw_item_put (a, "authoricon", "/tmp/icon");
+  sw_item_put (a, "album", "Holiday");
+  g_assert_cmpstr (sw_item_get (a, "id"), ==, "1");
+  g_assert_cmpstr (sw_item_get (a, "authoricon"), ==, "/tmp/icon");
+  g_assert_cmpstr (sw_item_get (a, "album"), ==, "Holiday");
+  g_assert (sw_item_get (a, "author") == NULL);
+  g_assert (sw_item_get (a, "auth") == NULL);
+
+  hash = sw_item_peek_hash (a);
+  g_assert_cmpint (g_hash_table_size (hash), ==, 3);
+  g_assert_cmpstr (g_hash_table_lookup (hash, "album"), ==, "Holiday");
+  g_assert_cmpstr (g_hash_table_lookup (hash, "id"), ==, "1");
+
+  /* Equal apart from the cached flag */
+  sw_item_put (b, "album", "Holiday");
+  sw_item_put (b, "authoricon", "/tmp/icon");
+  sw_item_put (b, "id", "1");
+  sw_item_put (b, "cached", "1");
+  g_assert (sw_item_equal (a, b));
+
+  /* Putting the same value again doesn't change anything */
+  sw_item_put (b, "id", "1");
+  g_assert (sw_item_equal (a, b));
+
+  sw_item_put (b, "album", NULL);
+  g_assert (sw_item_get (b, "album") == NULL);
+  g_assert (!sw_item_equal (a, b));
+
+  sw_item_put (a, "album", NULL);
+  sw_item_put (a, "id", "2");
+  g_assert (!sw_item_equal (a, b));
+
+  /* Changing the item rebuilds the hash */
+  hash = sw_item_peek_hash (a);
+  g_assert_cmpint (g_hash_table_size (hash), ==, 2);
+  g_assert_cmpstr (g_hash_table_lookup (hash, "id"), ==, "2");
+
+  g_object_unref (a);
+  g_object_unref (b);
+}
+
+void
+test_item_date (void)
+{
+  SwItem *item;
+  char *s;
+
+  item = sw_item_new ();
+  g_assert_cmpint (sw_item_get_mtime (item), ==, 0);
+
+  sw_item_set_date (item, 784111777);
+  g_assert_cmpint (sw_item_get_date (item), ==, 784111777);
+  g_assert (sw_item_get (item, "date") != NULL);
+  /* Setting the date is a change like any other */
+  g_assert_cmpint (sw_item_get_mtime (item), !=, 0);
+
+  /* The string form is parsed lazily */
+  sw_item_put (item, "date", "1994-11-06T08:49:38Z");
+  g_assert_cmpint (sw_item_get_date (item), ==, 784111778);
+
+  s = sw_time_t_to_string (784111779);
+  sw_item_take (item, "date", s);
+  g_assert_cmpint (sw_item_get_date (item), ==, 784111779);
+
+  g_object_unref (item);
+}
+
+static void
+count_dirty (gpointer key, gpointer value, gpointer user_data)
+{
+  GHashTable *dirty = user_data;
+
+  g_hash_table_insert (dirty, key, value ? value : (gpointer)"(removed)");
+}
+
+static GHashTable *
+get_dirty (SwItem *item)
+{
+  GHashTable *dirty;
+
+  dirty = g_hash_table_new (g_str_hash, g_str_equal);
+  sw_item_foreach_dirty (item, count_dirty, dirty);
+
+  return dirty;
+}
+
+void
+test_item_dirty (void)
+{
+  SwItem *a, *b;
+  GHashTable *dirty;
+
+  a = sw_item_new ();
+  sw_item_put (a, "id", "1");
+  sw_item_put (a, "album", "Holiday");
+  g_assert (sw_item_is_dirty (a));
+
+  sw_item_clear_dirty (a);
+  g_assert (!sw_item_is_dirty (a));
+
+  /* Putting the same value again isn't a change */
+  sw_item_put (a, "id", "1");
+  sw_item_put (a, "album", "Holiday");
+  g_assert (!sw_item_is_dirty (a));
+
+  sw_item_put (a, "authoricon", "/tmp/icon");
+  sw_item_put (a, "album", NULL);
+  dirty = get_dirty (a);
+  g_assert_cmpint (g_hash_table_size (dirty), ==, 2);
+  g_assert_cmpstr (g_hash_table_lookup (dirty, "authoricon"), ==, "/tmp/icon");
+  g_assert_cmpstr (g_hash_table_lookup (dirty, "album"), ==, "(removed)");
+  g_hash_table_unref (dirty);
+
+  /* A replacement carries the differences and the unsent changes */
+  b = sw_item_new ();
+  sw_item_put (b, "id", "1");
+  sw_item_put (b, "authoricon", "/tmp/icon");
+  sw_item_put (b, "content", "Hello");
+  sw_item_merge_dirty (b, a);
+  dirty = get_dirty (b);
+  g_assert_cmpint (g_hash_table_size (dirty), ==, 3);
+  g_assert_cmpstr (g_hash_table_lookup (dirty, "content"), ==, "Hello");
+  g_assert_cmpstr (g_hash_table_lookup (dirty, "authoricon"), ==, "/tmp/icon");
+  g_assert_cmpstr (g_hash_table_lookup (dirty, "album"), ==, "(removed)");
+  g_hash_table_unref (dirty);
+
+  g_object_unref (a);
+  g_object_unref (b);
 }
+#endif
@@ -78,14 +78,33 @@ void sw_item_request_image_fetch (SwItem      *item,
 
 const char * sw_item_get (const SwItem *item, const char *key);
 
+void sw_item_set_date (SwItem *item, time_t date);
+
+time_t sw_item_get_date (SwItem *item);
+
 int sw_item_compare_date_older (SwItem *a, SwItem *b);
 
 int sw_item_compare_date_newer (SwItem *a, SwItem *b);
 
 void sw_item_dump (SwItem *item);
 
+void sw_item_foreach (SwItem   *item,
+                      GHFunc    func,
+                      gpointer  user_data);
+
 GHashTable *sw_item_peek_hash (SwItem *item);
 
+void sw_item_foreach_dirty (SwItem   *item,
+                            GHFunc    func,
+                            gpointer  user_data);
+
+gboolean sw_item_is_dirty (SwItem *item);
+
+void sw_item_clear_dirty (SwItem *item);
+
+void sw_item_merge_dirty (SwItem *item,
+                          SwItem *previous);
+
 gboolean sw_item_get_ready (SwItem *item);
 
 void sw_item_push_pending (SwItem *item);
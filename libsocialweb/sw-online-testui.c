@@ -30,7 +30,7 @@ on_toggled (GtkToggleButton *button, gpointer user_data)
 
   gtk_button_set_label (GTK_BUTTON (button), state ? "Go Offline" : "Go Online");
 
-  emit_notify (state);
+  queue_notify (state);
 }
 
 static gboolean
@@ -23,19 +23,54 @@
 #include "sw-debug.h"
 #include "sw-marshals.h"
 
-/* This is the common infrastructure */
+/*
+ * This is the common infrastructure.
+ *
+ * Changes of state from the backends are debounced, so that a connection
+ * that flaps up and down only notifies once it has settled, and not at all
+ * if it settles back where it was.  When we go online the listeners are
+ * then released a few at a time in priority order, rather than all at once,
+ * as each of them is likely to start making requests.  Going offline is
+ * cheap so every listener is told at once.
+ */
 typedef struct {
   SwOnlineNotify callback;
   gpointer user_data;
+  gint priority;
 } ListenerData;
 
+/* How long a state has to last before listeners are told about it */
+#define ONLINE_DEBOUNCE_MS 2000
+#define OFFLINE_DEBOUNCE_MS 1000
+/* Listeners told we are online at a time, and how long between them */
+#define RECONNECT_BATCH 2
+#define RECONNECT_INTERVAL_MS 1000
+
 static GList *listeners = NULL;
+/* Listeners yet to be told we are online, in the order to tell them */
+static GList *pending = NULL;
+static guint release_id = 0;
+
+static guint debounce_id = 0;
+static gboolean debounce_state;
+/* The state listeners were last told about, or -1 */
+static gint notified_state = -1;
 
 static gboolean online_init (void);
 
+/**
+ * sw_online_add_notify_full:
+ * @callback: the function to call when the online state changes
+ * @user_data: data to pass to @callback
+ * @priority: the priority of @callback, lower values are told first
+ *
+ * Call @callback when we go online or offline.  When going online the
+ * listeners are told in order of @priority, a few at a time.
+ */
 void
-sw_online_add_notify (SwOnlineNotify callback,
-                      gpointer       user_data)
+sw_online_add_notify_full (SwOnlineNotify callback,
+                           gpointer       user_data,
+                           gint           priority)
 {
   ListenerData *data;
 
@@ -45,10 +80,18 @@ sw_online_add_notify (SwOnlineNotify callback,
   data = g_slice_new (ListenerData);
   data->callback = callback;
   data->user_data = user_data;
+  data->priority = priority;
 
   listeners = g_list_prepend (listeners, data);
 }
 
+void
+sw_online_add_notify (SwOnlineNotify callback,
+                      gpointer       user_data)
+{
+  sw_online_add_notify_full (callback, user_data, G_PRIORITY_DEFAULT);
+}
+
 void
 sw_online_remove_notify (SwOnlineNotify callback,
                          gpointer       user_data)
@@ -59,7 +102,9 @@ sw_online_remove_notify (SwOnlineNotify callback,
     ListenerData *data = l->data;
     if (data->callback == callback && data->user_data == user_data) {
       GList *next = l->next;
+      pending = g_list_remove (pending, data);
       listeners = g_list_delete_link (listeners, l);
+      g_slice_free (ListenerData, data);
       l = next;
     } else {
       l = l->next;
@@ -67,6 +112,39 @@ sw_online_remove_notify (SwOnlineNotify callback,
   }
 }
 
+static gint
+compare_priority (gconstpointer a,
+                  gconstpointer b)
+{
+  const ListenerData *data_a = a;
+  const ListenerData *data_b = b;
+
+  return data_a->priority - data_b->priority;
+}
+
+static gboolean
+_release_cb (gpointer user_data)
+{
+  gint i;
+
+  release_id = 0;
+
+  for (i = 0; pending && i < RECONNECT_BATCH; i++) {
+    ListenerData *data = pending->data;
+
+    pending = g_list_delete_link (pending, pending);
+    data->callback (TRUE, data->user_data);
+  }
+
+  if (pending) {
+    SW_DEBUG (ONLINE, "%d listeners still to reconnect",
+              g_list_length (pending));
+    release_id = g_timeout_add (RECONNECT_INTERVAL_MS, _release_cb, NULL);
+  }
+
+  return FALSE;
+}
+
 static void
 emit_notify (gboolean online)
 {
@@ -74,19 +152,66 @@ emit_notify (gboolean online)
 
   SW_DEBUG (ONLINE, "Now %s", online ? "online" : "offline");
 
+  /* Listeners not yet told we went online needn't be any more */
+  g_list_free (pending);
+  pending = NULL;
+  if (release_id) {
+    g_source_remove (release_id);
+    release_id = 0;
+  }
+
+  if (online) {
+    /* The sort is stable, so equal priorities keep their order */
+    pending = g_list_sort (g_list_copy (listeners), compare_priority);
+    _release_cb (NULL);
+    return;
+  }
+
   for (l = listeners; l; l = l->next) {
     ListenerData *data = l->data;
     data->callback (online, data->user_data);
   }
 }
 
+static gboolean
+_debounce_cb (gpointer user_data)
+{
+  debounce_id = 0;
+
+  if (notified_state == debounce_state) {
+    SW_DEBUG (ONLINE, "Still %s, ignoring flap",
+              debounce_state ? "online" : "offline");
+    return FALSE;
+  }
+
+  notified_state = debounce_state;
+  emit_notify (debounce_state);
+
+  return FALSE;
+}
+
+/*
+ * Called by the backends when the state may have changed.
+ */
+static void
+queue_notify (gboolean online)
+{
+  if (debounce_id)
+    g_source_remove (debounce_id);
+
+  debounce_state = online;
+  debounce_id = g_timeout_add (online ? ONLINE_DEBOUNCE_MS : OFFLINE_DEBOUNCE_MS,
+                               _debounce_cb,
+                               NULL);
+}
+
 #if WITH_ONLINE_ALWAYS
 
 /*
- * A bit nasty but this case never uses emit_notify we get a compile warning
+ * A bit nasty but this case never uses queue_notify we get a compile warning
  * otherwise.
  */
-static const gpointer dummy = &emit_notify;
+static const gpointer dummy = &queue_notify;
 
 static gboolean
 online_init (void)
@@ -116,24 +241,13 @@ sw_is_online (void)
  */
 static NMClient *client = NULL;
 
-static gboolean
-we_are_online (gpointer user_data)
-{
-  emit_notify (sw_is_online ());
-  return FALSE;
-}
-
 static void
 state_changed (NMClient         *client,
                const GParamSpec *pspec,
                gpointer          data)
 {
-  if (sw_is_online()) {
-    /* NM is notifying us too early - workaround that */
-    g_timeout_add (1500, (GSourceFunc)we_are_online, NULL);
-  } else {
-    emit_notify (FALSE); /* sw_is_online ()); */
-  }
+  /* NM notifies us a little early, which the debouncing also covers */
+  queue_notify (sw_is_online ());
 }
 
 static gboolean
@@ -192,7 +306,7 @@ static void
 state_changed (DBusGProxy *proxy, const char *new_state)
 {
   current_state = (g_strcmp0 (new_state, "online") == 0);
-  emit_notify (current_state);
+  queue_notify (current_state);
 }
 
 static void
@@ -212,7 +326,7 @@ got_state_cb (DBusGProxy     *proxy,
   }
 
   current_state = (g_strcmp0 (state, "online") == 0);
-  emit_notify (current_state);
+  queue_notify (current_state);
   g_free (state);
 }
 
@@ -265,3 +379,139 @@ sw_is_online (void)
 #if WITH_ONLINE_TEST
 #include "sw-online-testui.c"
 #endif
+
+#if BUILD_TESTS
+#include <string.h>
+#include "test-runner.h"
+
+static GString *notify_log = NULL;
+
+static void
+log_notify (gboolean online, gpointer user_data)
+{
+  g_string_append_printf (notify_log, "%s%c ",
+                          (const char *)user_data, online ? '+' : '-');
+}
+
+/* Add a listener without starting a backend */
+static void
+add_test_listener (const char *name, gint priority)
+{
+  ListenerData *data;
+
+  data = g_slice_new (ListenerData);
+  data->callback = log_notify;
+  data->user_data = (gpointer)name;
+  data->priority = priority;
+
+  listeners = g_list_prepend (listeners, data);
+}
+
+/* Run the timeout in *@id now instead of waiting for it */
+static void
+fire_timeout (guint *id, GSourceFunc func)
+{
+  g_assert (*id != 0);
+  g_source_remove (*id);
+  *id = 0;
+  func (NULL);
+}
+
+static void
+reset_online (void)
+{
+  while (listeners) {
+    g_slice_free (ListenerData, listeners->data);
+    listeners = g_list_delete_link (listeners, listeners);
+  }
+
+  g_list_free (pending);
+  pending = NULL;
+  if (release_id) {
+    g_source_remove (release_id);
+    release_id = 0;
+  }
+  if (debounce_id) {
+    g_source_remove (debounce_id);
+    debounce_id = 0;
+  }
+  notified_state = -1;
+
+  if (notify_log)
+    g_string_truncate (notify_log, 0);
+  else
+    notify_log = g_string_new (NULL);
+}
+
+void
+test_online_debounce (void)
+{
+  reset_online ();
+  add_test_listener ("a", 0);
+
+  queue_notify (FALSE);
+  fire_timeout (&debounce_id, _debounce_cb);
+  g_assert_cmpstr (notify_log->str, ==, "a- ");
+
+  /* Only the last state of a flap counts */
+  queue_notify (TRUE);
+  queue_notify (FALSE);
+  fire_timeout (&debounce_id, _debounce_cb);
+  g_assert_cmpstr (notify_log->str, ==, "a- ");
+
+  queue_notify (FALSE);
+  queue_notify (TRUE);
+  fire_timeout (&debounce_id, _debounce_cb);
+  g_assert_cmpstr (notify_log->str, ==, "a- a+ ");
+
+  /* Settling back online is ignored too */
+  queue_notify (FALSE);
+  queue_notify (TRUE);
+  fire_timeout (&debounce_id, _debounce_cb);
+  g_assert_cmpstr (notify_log->str, ==, "a- a+ ");
+
+  reset_online ();
+}
+
+void
+test_online_release (void)
+{
+  reset_online ();
+  add_test_listener ("c", 30);
+  add_test_listener ("a", 10);
+  add_test_listener ("e", 50);
+  add_test_listener ("b", 20);
+  add_test_listener ("d", 40);
+  notified_state = FALSE;
+
+  /* Going online tells a batch at a time, in priority order */
+  queue_notify (TRUE);
+  fire_timeout (&debounce_id, _debounce_cb);
+  g_assert_cmpstr (notify_log->str, ==, "a+ b+ ");
+
+  fire_timeout (&release_id, _release_cb);
+  g_assert_cmpstr (notify_log->str, ==, "a+ b+ c+ d+ ");
+
+  fire_timeout (&release_id, _release_cb);
+  g_assert_cmpstr (notify_log->str, ==, "a+ b+ c+ d+ e+ ");
+  g_assert (release_id == 0);
+  g_assert (pending == NULL);
+
+  /* Going offline tells everyone at once and stops any release */
+  queue_notify (FALSE);
+  fire_timeout (&debounce_id, _debounce_cb);
+  queue_notify (TRUE);
+  fire_timeout (&debounce_id, _debounce_cb);
+  g_string_truncate (notify_log, 0);
+
+  queue_notify (FALSE);
+  fire_timeout (&debounce_id, _debounce_cb);
+  /* Each listener adds three characters to the log */
+  g_assert_cmpint (notify_log->len, ==, 5 * 3);
+  g_assert (strstr (notify_log->str, "+") == NULL);
+  g_assert (release_id == 0);
+  g_assert (pending == NULL);
+
+  reset_online ();
+}
+#endif
@@ -27,9 +27,20 @@ gboolean sw_is_online (void);
 
 typedef void (*SwOnlineNotify) (gboolean online, gpointer user_data);
 
+/*
+ * Priorities for services: those the user talks through are told before
+ * those that mostly fetch in the background.
+ */
+#define SW_ONLINE_PRIORITY_INTERACTIVE G_PRIORITY_DEFAULT
+#define SW_ONLINE_PRIORITY_BACKGROUND G_PRIORITY_DEFAULT_IDLE
+
 void sw_online_add_notify (SwOnlineNotify callback,
                            gpointer       user_data);
 
+void sw_online_add_notify_full (SwOnlineNotify callback,
+                                gpointer       user_data,
+                                gint           priority);
+
 void sw_online_remove_notify (SwOnlineNotify callback,
                               gpointer       user_data);
 
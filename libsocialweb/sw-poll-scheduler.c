@@ -0,0 +1,685 @@
+/*
+ * libsocialweb - social data store
+ * Copyright (C) 2010 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <config.h>
+#include <time.h>
+
+#include "sw-poll-scheduler.h"
+#include "sw-service.h"
+#include "sw-debug.h"
+
+/*
+ * The poll scheduler.
+ *
+ * Views that poll a web service every so often register here instead of
+ * each arming their own timer.  Polls are only ever due on slot boundaries,
+ * every SLOT_SECONDS from a random phase picked at start up, so polls with
+ * similar intervals come due together and a single timer wakes us up for
+ * all of them.  Each poll is pushed back by a little random jitter so that
+ * views started at the same moment drift apart slowly instead of hitting a
+ * service at once forever.
+ *
+ * No poll runs more often than the minimum interval of its service.
+ *
+ * A poll can also be asked to run soon, for example when its service comes
+ * online.  These are run in the order they were asked for, at most
+ * SOON_BATCH every SOON_INTERVAL_MS, so that a service with many views
+ * doesn't refresh all of them at once.
+ */
+
+#define SLOT_SECONDS 30
+#define DEFAULT_MIN_INTERVAL 60
+/* Most jitter added to a poll, as a percentage of its interval */
+#define JITTER_PERCENT 10
+/* Polls asked to run soon that are run at a time, and how long between */
+#define SOON_BATCH 2
+#define SOON_INTERVAL_MS 1000
+
+typedef struct {
+  guint id;
+  /* Interned, may be NULL */
+  const gchar *service_name;
+  guint interval;
+  time_t due;
+  GSourceFunc func;
+  gpointer data;
+} SwPoll;
+
+/* id => SwPoll */
+static GHashTable *polls = NULL;
+/* Interned service name => minimum interval */
+static GHashTable *min_intervals = NULL;
+static guint next_id = 1;
+static guint phase;
+
+static guint timeout_id = 0;
+static time_t timeout_due = 0;
+
+/* Ids of the polls asked to run soon, oldest first */
+static GQueue soon = G_QUEUE_INIT;
+static guint soon_id = 0;
+
+static void
+ensure_init (void)
+{
+  if (polls)
+    return;
+
+  polls = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+  min_intervals = g_hash_table_new (NULL, NULL);
+  phase = g_random_int_range (0, SLOT_SECONDS);
+}
+
+/*
+ * Round @t up to the next slot boundary.
+ */
+static time_t
+align_to_slot (time_t t)
+{
+  time_t offset;
+
+  offset = (t - phase) % SLOT_SECONDS;
+  if (offset == 0)
+    return t;
+
+  return t + SLOT_SECONDS - offset;
+}
+
+static guint
+get_interval (SwPoll *poll)
+{
+  gpointer min_interval;
+
+  if (poll->service_name &&
+      g_hash_table_lookup_extended (min_intervals,
+                                    poll->service_name,
+                                    NULL,
+                                    &min_interval))
+    return MAX (poll->interval, GPOINTER_TO_UINT (min_interval));
+
+  return MAX (poll->interval, DEFAULT_MIN_INTERVAL);
+}
+
+static void
+schedule_poll (SwPoll *poll,
+               time_t  now)
+{
+  guint interval, jitter;
+
+  interval = get_interval (poll);
+  jitter = interval * JITTER_PERCENT / 100;
+  if (jitter)
+    jitter = g_random_int_range (0, jitter + 1);
+
+  poll->due = align_to_slot (now + interval + jitter);
+}
+
+static gchar *describe_schedule (void);
+
+static void
+dump_schedule (void)
+{
+  gchar *schedule;
+
+  if (!SW_DEBUG_ENABLED (POLL))
+    return;
+
+  schedule = describe_schedule ();
+  SW_DEBUG (POLL, "Schedule:\n%s", schedule);
+  g_free (schedule);
+}
+
+static gboolean _dispatch_cb (gpointer data);
+
+/*
+ * Make the poll @id now, if it is still there, and reschedule it from now.
+ */
+static void
+run_poll (guint  id,
+          time_t now)
+{
+  SwPoll *poll;
+
+  /* Polls can be added and removed by the callbacks, so look each one up */
+  poll = g_hash_table_lookup (polls, GUINT_TO_POINTER (id));
+  if (poll == NULL)
+    return;
+
+  schedule_poll (poll, now);
+
+  if (!poll->func (poll->data))
+    g_hash_table_remove (polls, GUINT_TO_POINTER (id));
+}
+
+/*
+ * Make sure the timer goes off when the earliest poll is due.
+ */
+static void
+rearm (time_t now)
+{
+  GHashTableIter iter;
+  SwPoll *poll;
+  time_t earliest = 0;
+
+  g_hash_table_iter_init (&iter, polls);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&poll))
+  {
+    if (earliest == 0 || poll->due < earliest)
+      earliest = poll->due;
+  }
+
+  if (timeout_id && timeout_due == earliest)
+    return;
+
+  if (timeout_id)
+  {
+    g_source_remove (timeout_id);
+    timeout_id = 0;
+  }
+
+  if (earliest == 0)
+    return;
+
+  timeout_due = earliest;
+  timeout_id = g_timeout_add_seconds (earliest > now ? earliest - now : 0,
+                                      _dispatch_cb,
+                                      NULL);
+}
+
+static gboolean
+_dispatch_cb (gpointer data)
+{
+  GHashTableIter iter;
+  SwPoll *poll;
+  GList *due = NULL, *l;
+  time_t now;
+
+  timeout_id = 0;
+  now = time (NULL);
+
+  g_hash_table_iter_init (&iter, polls);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&poll))
+  {
+    /* Second timers can go off a little early */
+    if (poll->due <= now + 1)
+      due = g_list_prepend (due, GUINT_TO_POINTER (poll->id));
+  }
+
+  SW_DEBUG (POLL, "Woke up for %d polls", g_list_length (due));
+
+  for (l = due; l; l = l->next)
+  {
+    guint id = GPOINTER_TO_UINT (l->data);
+
+    /* It has run anyway */
+    g_queue_remove (&soon, l->data);
+    run_poll (id, now);
+  }
+
+  g_list_free (due);
+
+  rearm (now);
+  dump_schedule ();
+
+  return FALSE;
+}
+
+/**
+ * sw_poll_scheduler_add:
+ * @service: the #SwService that @func polls, or %NULL
+ * @interval: the number of seconds between polls
+ * @func: the function to call
+ * @data: data to pass to @func
+ *
+ * Call @func about every @interval seconds, like g_timeout_add_seconds(),
+ * but at times shared with other polls.  The first call is after @interval.
+ * If @func returns %FALSE it isn't called again.
+ *
+ * Returns: the id of the poll, to pass to sw_poll_scheduler_remove()
+ */
+guint
+sw_poll_scheduler_add (SwService   *service,
+                       guint        interval,
+                       GSourceFunc  func,
+                       gpointer     data)
+{
+  SwPoll *poll;
+  time_t now;
+
+  g_return_val_if_fail (func, 0);
+
+  ensure_init ();
+
+  poll = g_new0 (SwPoll, 1);
+  poll->id = next_id++;
+  poll->service_name = service ?
+    g_intern_string (sw_service_get_name (service)) : NULL;
+  poll->interval = interval;
+  poll->func = func;
+  poll->data = data;
+
+  now = time (NULL);
+  schedule_poll (poll, now);
+
+  g_hash_table_insert (polls, GUINT_TO_POINTER (poll->id), poll);
+
+  SW_DEBUG (POLL, "Added poll %u for %s every %us",
+            poll->id,
+            poll->service_name ? poll->service_name : "-",
+            get_interval (poll));
+
+  rearm (now);
+
+  return poll->id;
+}
+
+void
+sw_poll_scheduler_remove (guint id)
+{
+  g_return_if_fail (id);
+
+  if (polls == NULL || !g_hash_table_remove (polls, GUINT_TO_POINTER (id)))
+  {
+    g_warning (G_STRLOC ": No poll with id %u", id);
+    return;
+  }
+
+  SW_DEBUG (POLL, "Removed poll %u", id);
+
+  g_queue_remove (&soon, GUINT_TO_POINTER (id));
+
+  rearm (time (NULL));
+}
+
+static gboolean
+_soon_cb (gpointer data)
+{
+  time_t now;
+  gint i;
+
+  soon_id = 0;
+  now = time (NULL);
+
+  for (i = 0; i < SOON_BATCH && !g_queue_is_empty (&soon); i++)
+    run_poll (GPOINTER_TO_UINT (g_queue_pop_head (&soon)), now);
+
+  if (!g_queue_is_empty (&soon))
+  {
+    SW_DEBUG (POLL, "%d polls still to run soon", g_queue_get_length (&soon));
+    soon_id = g_timeout_add (SOON_INTERVAL_MS, _soon_cb, NULL);
+  }
+
+  rearm (now);
+
+  return FALSE;
+}
+
+/**
+ * sw_poll_scheduler_poll_soon:
+ * @id: the id of a poll
+ *
+ * Make the poll @id as soon as possible, rather than waiting until it is
+ * due, and reschedule it from then.  Only a few of these are made at a
+ * time, in the order they were asked for.
+ */
+void
+sw_poll_scheduler_poll_soon (guint id)
+{
+  g_return_if_fail (id);
+
+  if (polls == NULL || !g_hash_table_lookup (polls, GUINT_TO_POINTER (id)))
+  {
+    g_warning (G_STRLOC ": No poll with id %u", id);
+    return;
+  }
+
+  if (g_queue_find (&soon, GUINT_TO_POINTER (id)))
+    return;
+
+  g_queue_push_tail (&soon, GUINT_TO_POINTER (id));
+
+  if (!soon_id)
+    soon_id = g_idle_add (_soon_cb, NULL);
+}
+
+/**
+ * sw_poll_scheduler_set_interval:
+ * @id: the id of a poll
+ * @interval: the number of seconds between polls
+ *
+ * Change how often a poll is made.  The next poll is @interval from now, so
+ * this is usually called when a poll is made.
+ */
+void
+sw_poll_scheduler_set_interval (guint id,
+                                guint interval)
+{
+  SwPoll *poll;
+  time_t now;
+
+  g_return_if_fail (id);
+
+  poll = polls ? g_hash_table_lookup (polls, GUINT_TO_POINTER (id)) : NULL;
+  if (poll == NULL)
+  {
+    g_warning (G_STRLOC ": No poll with id %u", id);
+    return;
+  }
+
+  if (poll->interval == interval)
+    return;
+
+  SW_DEBUG (POLL, "Poll %u now every %us", id, interval);
+
+  now = time (NULL);
+
+  poll->interval = interval;
+  schedule_poll (poll, now);
+
+  rearm (now);
+}
+
+/**
+ * sw_poll_scheduler_set_min_interval:
+ * @service: a #SwService
+ * @min_interval: a number of seconds
+ *
+ * Never poll @service more often than every @min_interval seconds.  This
+ * applies from the next time each poll of @service is scheduled.
+ */
+void
+sw_poll_scheduler_set_min_interval (SwService *service,
+                                    guint      min_interval)
+{
+  g_return_if_fail (service);
+
+  ensure_init ();
+
+  g_hash_table_insert (min_intervals,
+                       (gpointer)g_intern_string (sw_service_get_name (service)),
+                       GUINT_TO_POINTER (min_interval));
+}
+
+static gint
+compare_due (gconstpointer a,
+             gconstpointer b)
+{
+  const SwPoll *poll_a = a;
+  const SwPoll *poll_b = b;
+
+  if (poll_a->due != poll_b->due)
+    return poll_a->due < poll_b->due ? -1 : 1;
+
+  return poll_a->id - poll_b->id;
+}
+
+/*
+ * Describe every poll in the order they are due, for debugging.
+ */
+static gchar *
+describe_schedule (void)
+{
+  GString *string;
+  GList *sorted, *l;
+  time_t now;
+
+  string = g_string_new (NULL);
+
+  if (polls == NULL)
+    return g_string_free (string, FALSE);
+
+  now = time (NULL);
+  sorted = g_list_sort (g_hash_table_get_values (polls), compare_due);
+
+  for (l = sorted; l; l = l->next)
+  {
+    SwPoll *poll = l->data;
+
+    g_string_append_printf (string, "%u: %s every %us, due in %lds\n",
+                            poll->id,
+                            poll->service_name ? poll->service_name : "-",
+                            get_interval (poll),
+                            (long)(poll->due - now));
+  }
+
+  g_list_free (sorted);
+
+  return g_string_free (string, FALSE);
+}
+
+/*
+ * Default poll interval in seconds and its bounds. The interval is halved
+ * when the churn goes over CHURN_BUSY and doubled when it drops under
+ * CHURN_QUIET.
+ */
+#define INTERVAL_DEFAULT (5 * 60)
+#define INTERVAL_MIN_DEFAULT (2 * 60)
+#define INTERVAL_MAX_DEFAULT (60 * 60)
+#define CHURN_DEFAULT 50
+#define CHURN_BUSY 60
+#define CHURN_QUIET 25
+
+/**
+ * sw_poll_interval_init:
+ * @interval: a #SwPollInterval
+ *
+ * Start @interval off at the default interval and bounds.
+ */
+void
+sw_poll_interval_init (SwPollInterval *interval)
+{
+  g_return_if_fail (interval);
+
+  interval->interval = INTERVAL_DEFAULT;
+  interval->min = INTERVAL_MIN_DEFAULT;
+  interval->max = INTERVAL_MAX_DEFAULT;
+  interval->churn = CHURN_DEFAULT;
+}
+
+/**
+ * sw_poll_interval_set_bounds:
+ * @interval: a #SwPollInterval
+ * @min_interval: fewest seconds between polls
+ * @max_interval: most seconds between polls
+ *
+ * Keep @interval between @min_interval and @max_interval.
+ */
+void
+sw_poll_interval_set_bounds (SwPollInterval *interval,
+                             guint           min_interval,
+                             guint           max_interval)
+{
+  g_return_if_fail (interval);
+  g_return_if_fail (min_interval > 0);
+  g_return_if_fail (min_interval <= max_interval);
+
+  interval->min = min_interval;
+  interval->max = max_interval;
+  interval->interval = CLAMP (interval->interval, min_interval, max_interval);
+}
+
+/**
+ * sw_poll_interval_update:
+ * @interval: a #SwPollInterval
+ * @busy: whether the last poll found anything new
+ *
+ * Learn from a poll whether anything changed, backing off when polls keep
+ * finding nothing and tightening when they keep finding something.
+ */
+void
+sw_poll_interval_update (SwPollInterval *interval,
+                         gboolean        busy)
+{
+  guint seconds;
+
+  g_return_if_fail (interval);
+
+  seconds = interval->interval;
+  interval->churn = (interval->churn * 3 + (busy ? 100 : 0)) / 4;
+
+  if (interval->churn > CHURN_BUSY)
+    seconds = MAX (seconds / 2, interval->min);
+  else if (interval->churn < CHURN_QUIET)
+    seconds = MIN (seconds * 2, interval->max);
+
+  if (seconds != interval->interval)
+  {
+    SW_DEBUG (POLL, "Churn is %d%%, polling every %ds",
+              interval->churn, seconds);
+    interval->interval = seconds;
+  }
+}
+
+#if BUILD_TESTS
+#include "test-runner.h"
+
+static gboolean
+dummy_poll_cb (gpointer data)
+{
+  return TRUE;
+}
+
+void
+test_poll_scheduler_slots (void)
+{
+  guint a, b;
+  SwPoll *poll_a, *poll_b;
+  time_t now;
+  gchar *schedule, *prefix;
+
+  now = time (NULL);
+
+  a = sw_poll_scheduler_add (NULL, 300, dummy_poll_cb, NULL);
+  b = sw_poll_scheduler_add (NULL, 10, dummy_poll_cb, NULL);
+
+  poll_a = g_hash_table_lookup (polls, GUINT_TO_POINTER (a));
+  poll_b = g_hash_table_lookup (polls, GUINT_TO_POINTER (b));
+
+  /* Polls are only due on slot boundaries, after the interval and jitter */
+  g_assert_cmpint ((poll_a->due - phase) % SLOT_SECONDS, ==, 0);
+  g_assert_cmpint (poll_a->due, >=, now + 300);
+  g_assert_cmpint (poll_a->due, <=, now + 300 + 30 + SLOT_SECONDS + 1);
+
+  /* The minimum interval applies */
+  g_assert_cmpint ((poll_b->due - phase) % SLOT_SECONDS, ==, 0);
+  g_assert_cmpint (poll_b->due, >=, now + DEFAULT_MIN_INTERVAL);
+
+  /* The timer is set for the earliest */
+  g_assert (timeout_id != 0);
+  g_assert_cmpint (timeout_due, ==, poll_b->due);
+
+  schedule = describe_schedule ();
+  prefix = g_strdup_printf ("%u: ", b);
+  g_assert (g_str_has_prefix (schedule, prefix));
+  g_free (prefix);
+  g_free (schedule);
+
+  sw_poll_scheduler_remove (b);
+  g_assert_cmpint (timeout_due, ==, poll_a->due);
+
+  sw_poll_scheduler_remove (a);
+  g_assert (timeout_id == 0);
+}
+
+static gboolean
+count_poll_cb (gpointer data)
+{
+  guint *count = data;
+
+  (*count)++;
+
+  return TRUE;
+}
+
+void
+test_poll_scheduler_soon (void)
+{
+  guint ids[5], counts[5] = { 0, };
+  gint i;
+
+  for (i = 0; i < 5; i++)
+    ids[i] = sw_poll_scheduler_add (NULL, 300, count_poll_cb, &counts[i]);
+
+  /* Asking twice doesn't run it twice, and removed polls are forgotten */
+  for (i = 0; i < 5; i++)
+    sw_poll_scheduler_poll_soon (ids[i]);
+  sw_poll_scheduler_poll_soon (ids[0]);
+  sw_poll_scheduler_remove (ids[1]);
+  g_assert_cmpint (g_queue_get_length (&soon), ==, 4);
+  g_assert (soon_id != 0);
+
+  /* A batch at a time, in order */
+  g_source_remove (soon_id);
+  _soon_cb (NULL);
+  g_assert_cmpint (counts[0], ==, 1);
+  g_assert_cmpint (counts[2], ==, 1);
+  g_assert_cmpint (counts[3], ==, 0);
+  g_assert (soon_id != 0);
+
+  g_source_remove (soon_id);
+  _soon_cb (NULL);
+  g_assert_cmpint (counts[3], ==, 1);
+  g_assert_cmpint (counts[4], ==, 1);
+  g_assert_cmpint (counts[1], ==, 0);
+  g_assert (soon_id == 0);
+
+  for (i = 0; i < 5; i++)
+    if (i != 1)
+      sw_poll_scheduler_remove (ids[i]);
+}
+
+void
+test_poll_scheduler_interval (void)
+{
+  SwPollInterval interval;
+  gint i;
+
+  sw_poll_interval_init (&interval);
+  g_assert_cmpint (interval.interval, ==, INTERVAL_DEFAULT);
+
+  /* A single quiet poll isn't enough to back off */
+  sw_poll_interval_update (&interval, FALSE);
+  g_assert_cmpint (interval.interval, ==, INTERVAL_DEFAULT);
+
+  /* A run of them is, up to the maximum */
+  sw_poll_interval_update (&interval, FALSE);
+  sw_poll_interval_update (&interval, FALSE);
+  g_assert_cmpint (interval.interval, ==, INTERVAL_DEFAULT * 2);
+
+  for (i = 0; i < 20; i++)
+    sw_poll_interval_update (&interval, FALSE);
+  g_assert_cmpint (interval.interval, ==, INTERVAL_MAX_DEFAULT);
+
+  /* After a long quiet spell it takes a few busy polls to tighten */
+  sw_poll_interval_update (&interval, TRUE);
+  sw_poll_interval_update (&interval, TRUE);
+  g_assert_cmpint (interval.interval, ==, INTERVAL_MAX_DEFAULT);
+
+  for (i = 0; i < 20; i++)
+    sw_poll_interval_update (&interval, TRUE);
+  g_assert_cmpint (interval.interval, ==, INTERVAL_MIN_DEFAULT);
+
+  /* Bounds clamp the current interval */
+  sw_poll_interval_set_bounds (&interval, 600, 1200);
+  g_assert_cmpint (interval.interval, ==, 600);
+
+  for (i = 0; i < 20; i++)
+    sw_poll_interval_update (&interval, FALSE);
+  g_assert_cmpint (interval.interval, ==, 1200);
+}
+#endif
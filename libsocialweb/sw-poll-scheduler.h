@@ -0,0 +1,65 @@
+/*
+ * libsocialweb - social data store
+ * Copyright (C) 2010 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _SW_POLL_SCHEDULER
+#define _SW_POLL_SCHEDULER
+
+#include <glib.h>
+#include <libsocialweb/sw-types.h>
+
+G_BEGIN_DECLS
+
+guint sw_poll_scheduler_add (SwService   *service,
+                             guint        interval,
+                             GSourceFunc  func,
+                             gpointer     data);
+
+void sw_poll_scheduler_remove (guint id);
+
+void sw_poll_scheduler_set_interval (guint id,
+                                     guint interval);
+
+void sw_poll_scheduler_poll_soon (guint id);
+
+void sw_poll_scheduler_set_min_interval (SwService *service,
+                                         guint      min_interval);
+
+/*
+ * An interval that adapts to how often polls find something new. Views keep
+ * one of these and poll every @interval seconds.
+ */
+typedef struct {
+  guint interval;
+  guint min;
+  guint max;
+  /* How often recent polls found something new, as a percentage */
+  guint churn;
+} SwPollInterval;
+
+void sw_poll_interval_init (SwPollInterval *interval);
+
+void sw_poll_interval_set_bounds (SwPollInterval *interval,
+                                  guint           min_interval,
+                                  guint           max_interval);
+
+void sw_poll_interval_update (SwPollInterval *interval,
+                              gboolean        busy);
+
+G_END_DECLS
+
+#endif /* _SW_POLL_SCHEDULER */
@@ -0,0 +1,784 @@
+/*
+ * libsocialweb - social data store
+ * Copyright (C) 2010 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <config.h>
+#include <time.h>
+
+#include "sw-request-governor.h"
+#include "sw-service.h"
+#include "sw-debug.h"
+
+/*
+ * The request governor.
+ *
+ * Every service has a token bucket that calls made through the governor
+ * take a token from.  Until a service tells us otherwise the bucket holds
+ * DEFAULT_CAPACITY tokens and refills over DEFAULT_WINDOW seconds.  Once a
+ * response carries X-RateLimit-Limit, X-RateLimit-Remaining and
+ * X-RateLimit-Reset headers (as Twitter and Sina send) the bucket follows
+ * them instead, and refills all at once when the limit resets.  A
+ * Retry-After header, or a response saying we are being rate limited, stops
+ * all but interactive calls until then.
+ *
+ * Interactive calls such as status updates and uploads are always made.
+ * Refreshes are queued until the bucket has more than a small reserve left,
+ * and background calls are dropped unless it has more than a larger one, so
+ * that there is always something left for the user.
+ */
+
+#define DEFAULT_CAPACITY 60
+#define DEFAULT_WINDOW 3600
+/* Used when we are rate limited without being told for how long */
+#define DEFAULT_BACKOFF 60
+#define MAX_BACKOFF 3600
+/* Tokens kept back for interactive calls, as percentages of the bucket */
+#define REFRESH_RESERVE_PERCENT 10
+#define BACKGROUND_RESERVE_PERCENT 25
+
+typedef struct {
+  /* Interned */
+  const gchar *service_name;
+  gdouble tokens;
+  guint capacity;
+  /* Tokens per second, when the service hasn't said when it resets */
+  gdouble rate;
+  time_t last_refill;
+  /* When the service said the limit resets, or 0 */
+  time_t reset;
+  /* No refreshes or background calls before this */
+  time_t blocked_until;
+  GQueue *deferred;
+  guint deferred_id;
+  SwRequestGovernorCounters counters;
+} SwBucket;
+
+typedef struct {
+  SwBucket *bucket;
+  RestProxyCall *call;
+  RestProxyCallAsyncCallback callback;
+  /* Weak pointer, the call is dropped if it goes away */
+  GObject *weak_object;
+  gboolean has_weak_object;
+  gpointer userdata;
+} SwDeferredCall;
+
+typedef struct {
+  SwBucket *bucket;
+  RestProxyCallAsyncCallback callback;
+  gpointer userdata;
+} SwGovernedCall;
+
+/* Interned service name => SwBucket */
+static GHashTable *buckets = NULL;
+
+static SwBucket *
+bucket_new (const gchar *service_name)
+{
+  SwBucket *bucket;
+
+  bucket = g_new0 (SwBucket, 1);
+  bucket->service_name = service_name;
+  bucket->capacity = DEFAULT_CAPACITY;
+  bucket->tokens = DEFAULT_CAPACITY;
+  bucket->rate = (gdouble)DEFAULT_CAPACITY / DEFAULT_WINDOW;
+  bucket->last_refill = time (NULL);
+  bucket->deferred = g_queue_new ();
+
+  return bucket;
+}
+
+static SwBucket *
+get_bucket (SwService *service)
+{
+  const gchar *service_name;
+  SwBucket *bucket;
+
+  if (buckets == NULL)
+    buckets = g_hash_table_new (NULL, NULL);
+
+  service_name = g_intern_string (sw_service_get_name (service));
+
+  bucket = g_hash_table_lookup (buckets, service_name);
+  if (bucket == NULL)
+  {
+    bucket = bucket_new (service_name);
+    g_hash_table_insert (buckets, (gpointer)service_name, bucket);
+  }
+
+  return bucket;
+}
+
+static void
+refill (SwBucket *bucket,
+        time_t    now)
+{
+  if (bucket->reset)
+  {
+    if (now >= bucket->reset)
+    {
+      bucket->tokens = bucket->capacity;
+      bucket->reset = 0;
+    }
+  } else if (now > bucket->last_refill) {
+    bucket->tokens = MIN (bucket->capacity,
+                          bucket->tokens +
+                          (now - bucket->last_refill) * bucket->rate);
+  }
+
+  bucket->last_refill = now;
+}
+
+static gdouble
+get_reserve (SwBucket          *bucket,
+             SwRequestPriority  priority)
+{
+  switch (priority)
+  {
+    case SW_REQUEST_PRIORITY_INTERACTIVE:
+      return 0;
+    case SW_REQUEST_PRIORITY_REFRESH:
+      return bucket->capacity * REFRESH_RESERVE_PERCENT / 100.0;
+    case SW_REQUEST_PRIORITY_BACKGROUND:
+    default:
+      return bucket->capacity * BACKGROUND_RESERVE_PERCENT / 100.0;
+  }
+}
+
+static gboolean
+bucket_allows (SwBucket          *bucket,
+               SwRequestPriority  priority,
+               time_t             now)
+{
+  if (priority == SW_REQUEST_PRIORITY_INTERACTIVE)
+    return TRUE;
+
+  if (bucket->blocked_until > now)
+    return FALSE;
+
+  return bucket->tokens >= 1 + get_reserve (bucket, priority);
+}
+
+/*
+ * How long until a call of @priority would be allowed, assuming nothing else
+ * takes any tokens.
+ */
+static guint
+get_wait (SwBucket          *bucket,
+          SwRequestPriority  priority,
+          time_t             now)
+{
+  gdouble needed;
+  guint wait = 0;
+
+  if (bucket->blocked_until > now)
+    wait = bucket->blocked_until - now;
+
+  needed = 1 + get_reserve (bucket, priority) - bucket->tokens;
+  if (needed > 0)
+  {
+    if (bucket->reset > now)
+      wait = MAX (wait, bucket->reset - now);
+    else if (bucket->rate > 0)
+      wait = MAX (wait, (guint)(needed / bucket->rate) + 1);
+    else
+      wait = MAX (wait, DEFAULT_BACKOFF);
+  }
+
+  return MAX (wait, 1);
+}
+
+static void
+update_from_headers (SwBucket    *bucket,
+                     const gchar *limit,
+                     const gchar *remaining,
+                     const gchar *reset,
+                     const gchar *retry_after,
+                     guint        status,
+                     time_t       now)
+{
+  guint64 value, backoff = 0;
+
+  refill (bucket, now);
+
+  if (limit && remaining)
+  {
+    value = g_ascii_strtoull (limit, NULL, 10);
+    if (value > 0)
+    {
+      bucket->capacity = value;
+      bucket->rate = (gdouble)value / DEFAULT_WINDOW;
+      bucket->tokens = MIN (g_ascii_strtoull (remaining, NULL, 10), value);
+    }
+  }
+
+  if (reset)
+  {
+    value = g_ascii_strtoull (reset, NULL, 10);
+    bucket->reset = value > (guint64)now ? (time_t)value : 0;
+  }
+
+  /* Only the delta-seconds form of Retry-After is understood */
+  if (retry_after)
+    backoff = g_ascii_strtoull (retry_after, NULL, 10);
+
+  /* 420 is what Twitter's search API says */
+  if (status == 420 || status == 429 || status == 503)
+  {
+    bucket->counters.rate_limited++;
+    bucket->tokens = 0;
+
+    if (backoff == 0)
+      backoff = bucket->reset > now ? bucket->reset - now : DEFAULT_BACKOFF;
+  }
+
+  if (backoff)
+  {
+    bucket->blocked_until = now + MIN (backoff, MAX_BACKOFF);
+    SW_DEBUG (GOVERNOR, "%s: holding off for %us",
+              bucket->service_name, (guint)MIN (backoff, MAX_BACKOFF));
+  }
+}
+
+static void schedule_deferred (SwBucket *bucket);
+
+static void
+_call_cb (RestProxyCall *call,
+          const GError  *error,
+          GObject       *weak_object,
+          gpointer       userdata)
+{
+  SwGovernedCall *governed = userdata;
+  SwBucket *bucket = governed->bucket;
+  RestProxyCallAsyncCallback callback = governed->callback;
+
+  update_from_headers (bucket,
+                       rest_proxy_call_lookup_response_header (call, "X-RateLimit-Limit"),
+                       rest_proxy_call_lookup_response_header (call, "X-RateLimit-Remaining"),
+                       rest_proxy_call_lookup_response_header (call, "X-RateLimit-Reset"),
+                       rest_proxy_call_lookup_response_header (call, "Retry-After"),
+                       rest_proxy_call_get_status_code (call),
+                       time (NULL));
+
+  /* The call owns @governed, and the callback may drop the last ref */
+  callback (call, error, weak_object, governed->userdata);
+
+  schedule_deferred (bucket);
+}
+
+static gboolean
+send_call (SwBucket                    *bucket,
+           RestProxyCall               *call,
+           RestProxyCallAsyncCallback   callback,
+           GObject                     *weak_object,
+           gpointer                     userdata,
+           GError                     **error)
+{
+  SwGovernedCall *governed;
+
+  governed = g_new0 (SwGovernedCall, 1);
+  governed->bucket = bucket;
+  governed->callback = callback;
+  governed->userdata = userdata;
+  g_object_set_data_full (G_OBJECT (call), "sw-request-governor",
+                          governed, g_free);
+
+  bucket->tokens = MAX (bucket->tokens - 1, 0);
+  bucket->counters.sent++;
+
+  return rest_proxy_call_async (call, _call_cb, weak_object, governed, error);
+}
+
+static void
+deferred_call_free (SwDeferredCall *deferred)
+{
+  if (deferred->weak_object)
+    g_object_remove_weak_pointer (deferred->weak_object,
+                                  (gpointer *)&deferred->weak_object);
+  g_object_unref (deferred->call);
+  g_free (deferred);
+}
+
+static gboolean
+params_equal (RestProxyCall *a,
+              RestProxyCall *b)
+{
+  GHashTable *params_a, *params_b;
+  GHashTableIter iter;
+  gpointer key, value;
+  gboolean ret;
+
+  params_a = rest_params_as_string_hash_table (rest_proxy_call_get_params (a));
+  params_b = rest_params_as_string_hash_table (rest_proxy_call_get_params (b));
+
+  ret = g_hash_table_size (params_a) == g_hash_table_size (params_b);
+
+  g_hash_table_iter_init (&iter, params_a);
+  while (ret && g_hash_table_iter_next (&iter, &key, &value))
+    ret = g_strcmp0 (value, g_hash_table_lookup (params_b, key)) == 0;
+
+  g_hash_table_unref (params_a);
+  g_hash_table_unref (params_b);
+
+  return ret;
+}
+
+/*
+ * Whether @a and @b would make the same request.
+ */
+static gboolean
+same_request (RestProxyCall *a,
+              RestProxyCall *b)
+{
+  return g_strcmp0 (rest_proxy_call_get_method (a),
+                    rest_proxy_call_get_method (b)) == 0 &&
+    g_strcmp0 (rest_proxy_call_get_function (a),
+               rest_proxy_call_get_function (b)) == 0 &&
+    params_equal (a, b);
+}
+
+/*
+ * Queue @call to be made later.  A deferred call that makes the same request
+ * for the same object, callback and data is superseded by @call, which takes
+ * its place in the queue.  The callback of the superseded call is called
+ * with a cancelled error, as if it had been cancelled, so that its caller
+ * can let go of it.
+ */
+static void
+defer_call (SwBucket                   *bucket,
+            RestProxyCall              *call,
+            RestProxyCallAsyncCallback  callback,
+            GObject                    *weak_object,
+            gpointer                    userdata)
+{
+  SwDeferredCall *deferred;
+  GList *l;
+
+  if (weak_object)
+  {
+    for (l = bucket->deferred->head; l; l = l->next)
+    {
+      deferred = l->data;
+
+      if (deferred->weak_object == weak_object &&
+          deferred->callback == callback &&
+          deferred->userdata == userdata &&
+          same_request (deferred->call, call))
+      {
+        RestProxyCall *superseded = deferred->call;
+        GError *error;
+
+        SW_DEBUG (GOVERNOR, "%s: replacing deferred call",
+                  bucket->service_name);
+        deferred->call = g_object_ref (call);
+
+        error = g_error_new (REST_PROXY_ERROR, REST_PROXY_ERROR_CANCELLED,
+                             "Superseded by a later call");
+        callback (superseded, error, weak_object, userdata);
+        g_error_free (error);
+        g_object_unref (superseded);
+        return;
+      }
+    }
+  }
+
+  deferred = g_new0 (SwDeferredCall, 1);
+  deferred->bucket = bucket;
+  deferred->call = g_object_ref (call);
+  deferred->callback = callback;
+  deferred->userdata = userdata;
+  if (weak_object)
+  {
+    deferred->weak_object = weak_object;
+    deferred->has_weak_object = TRUE;
+    g_object_add_weak_pointer (weak_object,
+                               (gpointer *)&deferred->weak_object);
+  }
+
+  g_queue_push_tail (bucket->deferred, deferred);
+}
+
+static gboolean
+_deferred_cb (gpointer data)
+{
+  SwBucket *bucket = data;
+  SwDeferredCall *deferred;
+  time_t now;
+
+  bucket->deferred_id = 0;
+
+  now = time (NULL);
+  refill (bucket, now);
+
+  while ((deferred = g_queue_peek_head (bucket->deferred)))
+  {
+    GError *error = NULL;
+
+    if (deferred->has_weak_object && deferred->weak_object == NULL)
+    {
+      g_queue_pop_head (bucket->deferred);
+      deferred_call_free (deferred);
+      continue;
+    }
+
+    if (!bucket_allows (bucket, SW_REQUEST_PRIORITY_REFRESH, now))
+      break;
+
+    g_queue_pop_head (bucket->deferred);
+
+    SW_DEBUG (GOVERNOR, "%s: making deferred call", bucket->service_name);
+
+    if (!send_call (bucket,
+                    deferred->call,
+                    deferred->callback,
+                    deferred->weak_object,
+                    deferred->userdata,
+                    &error))
+    {
+      g_warning (G_STRLOC ": Cannot make deferred call: %s", error->message);
+      g_error_free (error);
+    }
+
+    deferred_call_free (deferred);
+  }
+
+  schedule_deferred (bucket);
+
+  return FALSE;
+}
+
+static void
+schedule_deferred (SwBucket *bucket)
+{
+  if (bucket->deferred_id)
+  {
+    g_source_remove (bucket->deferred_id);
+    bucket->deferred_id = 0;
+  }
+
+  if (g_queue_is_empty (bucket->deferred))
+    return;
+
+  bucket->deferred_id =
+    g_timeout_add_seconds (get_wait (bucket,
+                                     SW_REQUEST_PRIORITY_REFRESH,
+                                     time (NULL)),
+                           _deferred_cb,
+                           bucket);
+}
+
+/**
+ * sw_request_governor_call_async:
+ * @service: the #SwService that @call is made for
+ * @priority: how much the call matters to the user
+ * @call: a #RestProxyCall
+ * @callback: the function to call when @call completes
+ * @weak_object: an object to tie the call to, or %NULL
+ * @userdata: data to pass to @callback
+ * @error: a #GError, or %NULL
+ *
+ * Make @call like rest_proxy_call_async(), while keeping within the rate
+ * limits of @service.  Refreshes made while the limit is close may be made
+ * later on, and background calls made then are dropped.  A refresh that is
+ * still waiting when the same request is made again for the same
+ * @weak_object, @callback and @userdata is replaced by the new one, and its
+ * callback is called with %REST_PROXY_ERROR_CANCELLED.
+ *
+ * Returns: %TRUE if the call was or will be made, or %FALSE if it won't be,
+ * in which case @callback will not be called either.
+ */
+gboolean
+sw_request_governor_call_async (SwService                  *service,
+                                SwRequestPriority           priority,
+                                RestProxyCall              *call,
+                                RestProxyCallAsyncCallback  callback,
+                                GObject                    *weak_object,
+                                gpointer                    userdata,
+                                GError                    **error)
+{
+  SwBucket *bucket;
+  time_t now;
+
+  g_return_val_if_fail (SW_IS_SERVICE (service), FALSE);
+  g_return_val_if_fail (REST_IS_PROXY_CALL (call), FALSE);
+  g_return_val_if_fail (callback, FALSE);
+
+  bucket = get_bucket (service);
+
+  now = time (NULL);
+  refill (bucket, now);
+
+  /* Let queued refreshes go first */
+  if (bucket_allows (bucket, priority, now) &&
+      (priority == SW_REQUEST_PRIORITY_INTERACTIVE ||
+       g_queue_is_empty (bucket->deferred)))
+    return send_call (bucket, call, callback, weak_object, userdata, error);
+
+  if (priority == SW_REQUEST_PRIORITY_BACKGROUND)
+  {
+    SW_DEBUG (GOVERNOR, "%s: dropping call", bucket->service_name);
+    bucket->counters.dropped++;
+    g_set_error (error, SW_SERVICE_ERROR, SW_SERVICE_ERROR_RATE_LIMITED,
+                 "Call to %s dropped to stay within its rate limit",
+                 bucket->service_name);
+    return FALSE;
+  }
+
+  SW_DEBUG (GOVERNOR, "%s: deferring call", bucket->service_name);
+  bucket->counters.deferred++;
+
+  defer_call (bucket, call, callback, weak_object, userdata);
+
+  if (bucket->deferred_id == 0)
+    schedule_deferred (bucket);
+
+  return TRUE;
+}
+
+/**
+ * sw_request_governor_cancel:
+ * @call: a #RestProxyCall
+ *
+ * If @call was deferred by sw_request_governor_call_async(), don't make it.
+ */
+void
+sw_request_governor_cancel (RestProxyCall *call)
+{
+  GHashTableIter iter;
+  SwBucket *bucket;
+  GList *l;
+
+  if (buckets == NULL)
+    return;
+
+  g_hash_table_iter_init (&iter, buckets);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&bucket))
+  {
+    for (l = bucket->deferred->head; l; l = l->next)
+    {
+      SwDeferredCall *deferred = l->data;
+
+      if (deferred->call == call)
+      {
+        g_queue_delete_link (bucket->deferred, l);
+        deferred_call_free (deferred);
+        schedule_deferred (bucket);
+        return;
+      }
+    }
+  }
+}
+
+/**
+ * sw_request_governor_get_counters:
+ * @service: a #SwService
+ * @counters: a #SwRequestGovernorCounters to fill in
+ *
+ * Get how many calls to @service have been made, deferred and dropped, how
+ * many times it said we were being rate limited, and how many tokens are
+ * left in its bucket.
+ */
+void
+sw_request_governor_get_counters (SwService                 *service,
+                                  SwRequestGovernorCounters *counters)
+{
+  SwBucket *bucket;
+
+  g_return_if_fail (SW_IS_SERVICE (service));
+  g_return_if_fail (counters);
+
+  bucket = get_bucket (service);
+  refill (bucket, time (NULL));
+
+  *counters = bucket->counters;
+  counters->tokens = (guint)bucket->tokens;
+  counters->capacity = bucket->capacity;
+}
+
+/**
+ * sw_request_governor_describe:
+ *
+ * Describe the bucket of every service, for debugging.
+ *
+ * Returns: a newly allocated string
+ */
+gchar *
+sw_request_governor_describe (void)
+{
+  GString *string;
+  GHashTableIter iter;
+  SwBucket *bucket;
+  time_t now;
+
+  string = g_string_new (NULL);
+
+  if (buckets == NULL)
+    return g_string_free (string, FALSE);
+
+  now = time (NULL);
+
+  g_hash_table_iter_init (&iter, buckets);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&bucket))
+  {
+    refill (bucket, now);
+
+    g_string_append_printf (string,
+                            "%s: %u/%u tokens, %u sent, %u deferred, "
+                            "%u dropped, %u rate limited, %u queued",
+                            bucket->service_name,
+                            (guint)bucket->tokens,
+                            bucket->capacity,
+                            bucket->counters.sent,
+                            bucket->counters.deferred,
+                            bucket->counters.dropped,
+                            bucket->counters.rate_limited,
+                            g_queue_get_length (bucket->deferred));
+
+    if (bucket->blocked_until > now)
+      g_string_append_printf (string, ", holding off for %lds",
+                              (long)(bucket->blocked_until - now));
+
+    g_string_append_c (string, '\n');
+  }
+
+  return g_string_free (string, FALSE);
+}
+
+#if BUILD_TESTS
+#include "test-runner.h"
+
+void
+test_request_governor_bucket (void)
+{
+  SwBucket *bucket;
+  time_t now;
+  gchar *reset;
+
+  now = time (NULL);
+  bucket = bucket_new ("test");
+
+  /* A full bucket allows everything */
+  g_assert (bucket_allows (bucket, SW_REQUEST_PRIORITY_BACKGROUND, now));
+
+  /* Background calls stop first, interactive ones never do */
+  bucket->tokens = DEFAULT_CAPACITY * 20 / 100;
+  g_assert (!bucket_allows (bucket, SW_REQUEST_PRIORITY_BACKGROUND, now));
+  g_assert (bucket_allows (bucket, SW_REQUEST_PRIORITY_REFRESH, now));
+  bucket->tokens = 0;
+  g_assert (!bucket_allows (bucket, SW_REQUEST_PRIORITY_REFRESH, now));
+  g_assert (bucket_allows (bucket, SW_REQUEST_PRIORITY_INTERACTIVE, now));
+
+  /* The headers replace the defaults, and the bucket refills on reset */
+  reset = g_strdup_printf ("%ld", (long)(now + 600));
+  update_from_headers (bucket, "150", "3", reset, NULL, 200, now);
+  g_free (reset);
+  g_assert_cmpuint (bucket->capacity, ==, 150);
+  g_assert_cmpint (bucket->tokens, ==, 3);
+  g_assert_cmpuint (get_wait (bucket, SW_REQUEST_PRIORITY_REFRESH, now), ==, 600);
+  refill (bucket, now + 600);
+  g_assert_cmpint (bucket->tokens, ==, 150);
+
+  /* Being rate limited holds off everything but interactive calls */
+  update_from_headers (bucket, NULL, NULL, NULL, "120", 429, now + 600);
+  g_assert_cmpuint (bucket->counters.rate_limited, ==, 1);
+  g_assert (!bucket_allows (bucket, SW_REQUEST_PRIORITY_REFRESH, now + 700));
+  g_assert (bucket_allows (bucket, SW_REQUEST_PRIORITY_INTERACTIVE, now + 700));
+  g_assert_cmpuint (get_wait (bucket, SW_REQUEST_PRIORITY_REFRESH, now + 600),
+                    >=, 120);
+
+  g_queue_free (bucket->deferred);
+  g_free (bucket);
+}
+
+static RestProxyCall *superseded_call = NULL;
+
+static void
+test_callback (RestProxyCall *call,
+               const GError  *error,
+               GObject       *weak_object,
+               gpointer       userdata)
+{
+  g_assert (g_error_matches (error, REST_PROXY_ERROR,
+                             REST_PROXY_ERROR_CANCELLED));
+  superseded_call = call;
+}
+
+static RestProxyCall *
+make_test_call (RestProxy *proxy, const char *ids)
+{
+  RestProxyCall *call;
+
+  call = rest_proxy_new_call (proxy);
+  rest_proxy_call_set_function (call, "users/lookup.xml");
+  rest_proxy_call_add_param (call, "user_id", ids);
+
+  return call;
+}
+
+void
+test_request_governor_coalesce (void)
+{
+  SwBucket *bucket;
+  RestProxy *proxy;
+  RestProxyCall *first, *second, *other, *batch;
+  DummyObject *a, *b;
+  SwDeferredCall *deferred;
+
+  bucket = bucket_new ("test");
+  proxy = rest_proxy_new ("http://example.com/", FALSE);
+  first = make_test_call (proxy, "1,2");
+  second = make_test_call (proxy, "1,2");
+  other = make_test_call (proxy, "1,2");
+  batch = make_test_call (proxy, "3,4");
+  a = dummy_object_new ();
+  b = dummy_object_new ();
+
+  /* Making the same request again replaces the first, which is cancelled */
+  defer_call (bucket, first, test_callback, G_OBJECT (a), NULL);
+  defer_call (bucket, other, test_callback, G_OBJECT (b), NULL);
+  g_assert (superseded_call == NULL);
+  defer_call (bucket, second, test_callback, G_OBJECT (a), NULL);
+  g_assert (superseded_call == first);
+  g_assert_cmpuint (g_queue_get_length (bucket->deferred), ==, 2);
+
+  deferred = g_queue_peek_head (bucket->deferred);
+  g_assert (deferred->call == second);
+  g_assert (deferred->weak_object == G_OBJECT (a));
+  deferred = g_queue_peek_tail (bucket->deferred);
+  g_assert (deferred->call == other);
+
+  /* Different parameters or data mean a different request */
+  superseded_call = NULL;
+  defer_call (bucket, batch, test_callback, G_OBJECT (a), NULL);
+  defer_call (bucket, first, test_callback, G_OBJECT (a), bucket);
+  g_assert (superseded_call == NULL);
+  g_assert_cmpuint (g_queue_get_length (bucket->deferred), ==, 4);
+
+  while ((deferred = g_queue_pop_head (bucket->deferred)))
+    deferred_call_free (deferred);
+
+  g_object_unref (a);
+  g_object_unref (b);
+  g_object_unref (first);
+  g_object_unref (second);
+  g_object_unref (other);
+  g_object_unref (batch);
+  g_object_unref (proxy);
+  g_queue_free (bucket->deferred);
+  g_free (bucket);
+}
+#endif
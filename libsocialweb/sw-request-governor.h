@@ -0,0 +1,60 @@
+/*
+ * libsocialweb - social data store
+ * Copyright (C) 2010 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _SW_REQUEST_GOVERNOR
+#define _SW_REQUEST_GOVERNOR
+
+#include <glib.h>
+#include <rest/rest-proxy.h>
+#include <libsocialweb/sw-types.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+  SW_REQUEST_PRIORITY_INTERACTIVE, /*< nick=Interactive >*/
+  SW_REQUEST_PRIORITY_REFRESH, /*< nick=Refresh >*/
+  SW_REQUEST_PRIORITY_BACKGROUND /*< nick=Background >*/
+} SwRequestPriority;
+
+typedef struct {
+  guint sent;
+  guint deferred;
+  guint dropped;
+  guint rate_limited;
+  guint tokens;
+  guint capacity;
+} SwRequestGovernorCounters;
+
+gboolean sw_request_governor_call_async (SwService                  *service,
+                                         SwRequestPriority           priority,
+                                         RestProxyCall              *call,
+                                         RestProxyCallAsyncCallback  callback,
+                                         GObject                    *weak_object,
+                                         gpointer                    userdata,
+                                         GError                    **error);
+
+void sw_request_governor_cancel (RestProxyCall *call);
+
+void sw_request_governor_get_counters (SwService                 *service,
+                                       SwRequestGovernorCounters *counters);
+
+gchar *sw_request_governor_describe (void);
+
+G_END_DECLS
+
+#endif /* _SW_REQUEST_GOVERNOR */
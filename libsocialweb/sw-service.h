@@ -34,7 +34,8 @@ typedef enum {
   SW_SERVICE_ERROR_NO_KEYS, /*< nick=NoKeys >*/
   SW_SERVICE_ERROR_INVALID_QUERY, /*< nick=InvalidQuery >*/
   SW_SERVICE_ERROR_NOT_SUPPORTED, /*< nick=NotSupported >*/
-  SW_SERVICE_ERROR_REMOTE_ERROR /*< nick=RemoteError >*/
+  SW_SERVICE_ERROR_REMOTE_ERROR, /*< nick=RemoteError >*/
+  SW_SERVICE_ERROR_RATE_LIMITED /*< nick=RateLimited >*/
 } SwServiceError;
 
 #define SW_SERVICE_ERROR sw_service_error_quark ()
@@ -197,6 +197,65 @@ sw_set_difference (SwSet *set_a,
   return set;
 }
 
+/*
+ * Compare @new_set against @old_set, walking each at most once.  Objects only
+ * in @new_set are returned in @added and objects only in @old_set in
+ * @removed.  Objects in both that @content_equal_func says differ are
+ * returned in @changed, using the version from @new_set.  The lists hold a
+ * reference on each object.  Any of the lists can be NULL if the caller
+ * isn't interested.
+ */
+void
+sw_set_diff (SwSet       *old_set,
+             SwSet       *new_set,
+             GEqualFunc   content_equal_func,
+             GList      **added,
+             GList      **removed,
+             GList      **changed)
+{
+  GHashTableIter iter;
+  GObject *object;
+  gpointer old_object;
+  guint matched = 0;
+
+  g_return_if_fail (old_set);
+  g_return_if_fail (new_set);
+
+  if (added)
+    *added = NULL;
+  if (removed)
+    *removed = NULL;
+  if (changed)
+    *changed = NULL;
+
+  g_hash_table_iter_init (&iter, new_set->hash);
+  while (g_hash_table_iter_next (&iter, (gpointer)&object, NULL)) {
+    if (!g_hash_table_lookup_extended (old_set->hash, object,
+                                       &old_object, NULL)) {
+      if (added)
+        *added = g_list_prepend (*added, g_object_ref (object));
+      continue;
+    }
+
+    matched++;
+
+    if (changed && content_equal_func &&
+        !content_equal_func (old_object, object)) {
+      *changed = g_list_prepend (*changed, g_object_ref (object));
+    }
+  }
+
+  /* If every old object was matched then nothing was removed */
+  if (removed == NULL || matched == g_hash_table_size (old_set->hash))
+    return;
+
+  g_hash_table_iter_init (&iter, old_set->hash);
+  while (g_hash_table_iter_next (&iter, (gpointer)&object, NULL)) {
+    if (!g_hash_table_lookup (new_set->hash, object))
+      *removed = g_list_prepend (*removed, g_object_ref (object));
+  }
+}
+
 void
 sw_set_add_from (SwSet *set,
                  SwSet *from)
@@ -241,6 +300,48 @@ sw_set_as_list (SwSet *set)
   return list;
 }
 
+/*
+ * Iterate over a set without building a list first.  The iterator lives on
+ * the stack:
+ *
+ *   SwSetIter iter;
+ *   GObject *object;
+ *
+ *   sw_set_iter_init (&iter, set);
+ *   while (sw_set_iter_next (&iter, &object))
+ *     ...
+ *
+ * The set must not be changed during the iteration other than through
+ * sw_set_iter_remove().  The object is owned by the set, so take a reference
+ * before removing it if it is still needed.
+ */
+void
+sw_set_iter_init (SwSetIter *iter,
+                  SwSet     *set)
+{
+  g_return_if_fail (iter);
+  g_return_if_fail (set);
+
+  g_hash_table_iter_init (&iter->hash_iter, set->hash);
+}
+
+gboolean
+sw_set_iter_next (SwSetIter  *iter,
+                  GObject   **object)
+{
+  g_return_val_if_fail (iter, FALSE);
+
+  return g_hash_table_iter_next (&iter->hash_iter, (gpointer *)object, NULL);
+}
+
+void
+sw_set_iter_remove (SwSetIter *iter)
+{
+  g_return_if_fail (iter);
+
+  g_hash_table_iter_remove (&iter->hash_iter);
+}
+
 SwSet *
 sw_set_from_list (GList *list)
 {
@@ -411,6 +512,107 @@ test_set_foreach_remove (void)
   sw_set_unref (set);
 }
 
+static GObject *diff_changed_object;
+
+static gboolean
+diff_content_equal (gconstpointer a, gconstpointer b)
+{
+  return b != diff_changed_object;
+}
+
+void
+test_set_diff (void)
+{
+  SwSet *old_set, *new_set;
+  DummyObject *kept, *changed, *gone, *fresh;
+  GList *added, *removed, *changed_list;
+
+  old_set = sw_set_new ();
+  new_set = sw_set_new ();
+  kept = dummy_object_new ();
+  changed = dummy_object_new ();
+  gone = dummy_object_new ();
+  fresh = dummy_object_new ();
+
+  sw_set_add (old_set, G_OBJECT (kept));
+  sw_set_add (old_set, G_OBJECT (changed));
+  sw_set_add (old_set, G_OBJECT (gone));
+
+  sw_set_add (new_set, G_OBJECT (kept));
+  sw_set_add (new_set, G_OBJECT (changed));
+  sw_set_add (new_set, G_OBJECT (fresh));
+
+  diff_changed_object = G_OBJECT (changed);
+  sw_set_diff (old_set, new_set, diff_content_equal,
+               &added, &removed, &changed_list);
+
+  g_assert_cmpint (g_list_length (added), ==, 1);
+  g_assert (added->data == fresh);
+  g_assert_cmpint (g_list_length (removed), ==, 1);
+  g_assert (removed->data == gone);
+  g_assert_cmpint (g_list_length (changed_list), ==, 1);
+  g_assert (changed_list->data == changed);
+
+  g_list_foreach (added, (GFunc)g_object_unref, NULL);
+  g_list_free (added);
+  g_list_foreach (removed, (GFunc)g_object_unref, NULL);
+  g_list_free (removed);
+  g_list_foreach (changed_list, (GFunc)g_object_unref, NULL);
+  g_list_free (changed_list);
+
+  /* Identical sets give empty lists */
+  diff_changed_object = NULL;
+  sw_set_diff (new_set, new_set, diff_content_equal,
+               &added, &removed, &changed_list);
+  g_assert (added == NULL);
+  g_assert (removed == NULL);
+  g_assert (changed_list == NULL);
+
+  g_object_unref (kept);
+  g_object_unref (changed);
+  g_object_unref (gone);
+  g_object_unref (fresh);
+  sw_set_unref (old_set);
+  sw_set_unref (new_set);
+}
+
+void
+test_set_iter (void)
+{
+  SwSet *set;
+  DummyObject *obj1, *obj2;
+  SwSetIter iter;
+  GObject *object;
+  int count = 0;
+
+  set = sw_set_new ();
+  obj1 = dummy_object_new ();
+  obj2 = dummy_object_new ();
+
+  sw_set_iter_init (&iter, set);
+  g_assert (!sw_set_iter_next (&iter, &object));
+
+  sw_set_add (set, G_OBJECT (obj1));
+  sw_set_add (set, G_OBJECT (obj2));
+
+  sw_set_iter_init (&iter, set);
+  while (sw_set_iter_next (&iter, &object)) {
+    g_assert (object == (GObject *)obj1 || object == (GObject *)obj2);
+    count++;
+
+    if (object == (GObject *)obj1)
+      sw_set_iter_remove (&iter);
+  }
+
+  g_assert_cmpint (count, ==, 2);
+  g_assert_cmpint (sw_set_size (set), ==, 1);
+  g_assert (sw_set_has (set, G_OBJECT (obj2)));
+
+  g_object_unref (obj1);
+  g_object_unref (obj2);
+  sw_set_unref (set);
+}
+
 void
 test_set_basics (void)
 {
@@ -50,11 +50,27 @@ SwSet * sw_set_union (SwSet *set_a, SwSet *set_b);
 
 SwSet * sw_set_difference (SwSet *set_a, SwSet *set_b);
 
+void sw_set_diff (SwSet       *old_set,
+                  SwSet       *new_set,
+                  GEqualFunc   content_equal_func,
+                  GList      **added,
+                  GList      **removed,
+                  GList      **changed);
+
 void sw_set_add_from (SwSet *set, SwSet *from);
 void sw_set_remove_from (SwSet *set, SwSet *from);
 
 GList * sw_set_as_list (SwSet *set);
 
+typedef struct {
+  /*< private >*/
+  GHashTableIter hash_iter;
+} SwSetIter;
+
+void sw_set_iter_init (SwSetIter *iter, SwSet *set);
+gboolean sw_set_iter_next (SwSetIter *iter, GObject **object);
+void sw_set_iter_remove (SwSetIter *iter);
+
 SwSet * sw_set_from_list (GList *list);
 
 void sw_set_foreach (SwSet *set, GFunc func, gpointer user_data);
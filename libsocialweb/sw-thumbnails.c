@@ -0,0 +1,686 @@
+/*
+ * libsocialweb - social data store
+ * Copyright (C) 2010 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+#include "sw-thumbnails.h"
+#include "sw-debug.h"
+
+/*
+ * The thumbnail store.
+ *
+ * Downloaded images live in $XDG_CACHE_HOME/libsocialweb/thumbnails, named
+ * after the MD5 of their URL.  We keep a table of the size and last use of
+ * every file, and when the total size or number of files goes over the budget
+ * the least recently used files are removed.
+ *
+ * The last use is kept on disk as the modification time of the file, which is
+ * updated at most once every THUMBNAIL_TOUCH_INTERVAL.  When the store is
+ * first used the directory is scanned to fill the table.
+ *
+ * A thumbnail may also have a file of HTTP validators, whose modification
+ * time is when the image was last checked for changes.  These are kept in the
+ * table with their thumbnail, and count against the budget like any other
+ * file.
+ *
+ * Both the scan and the eviction are done a batch of files at a time from a
+ * low priority idle, so they never block the main loop for long.  The table is
+ * locked so that downloads can be recorded from any thread.
+ */
+
+#define THUMBNAIL_MAX_SIZE (64 * 1024 * 1024)
+#define THUMBNAIL_MAX_FILES 5000
+/* Number of files stat'ed or removed each time the idle runs */
+#define THUMBNAIL_BATCH 50
+/* Seconds between updating the modification time of a used file */
+#define THUMBNAIL_TOUCH_INTERVAL (60 * 60)
+#define VALIDATORS_SUFFIX ".validators"
+
+typedef struct {
+  gsize size;
+  time_t last_use;
+  /* The validators file, and when the image was last checked for changes */
+  gboolean has_validators;
+  gsize validators_size;
+  time_t last_check;
+} ThumbnailEntry;
+
+/* Hash of file basename to ThumbnailEntry */
+static GHashTable *thumbnails = NULL;
+/* The total size and number of files, including validators */
+static gsize thumbnails_size = 0;
+static guint thumbnails_files = 0;
+static gsize max_size = THUMBNAIL_MAX_SIZE;
+static guint max_files = THUMBNAIL_MAX_FILES;
+
+/* The directory being scanned, or NULL when the table is complete */
+static GDir *scan_dir = NULL;
+/* Files to evict, oldest first, and when they were chosen */
+static GList *victims = NULL;
+static time_t victims_time = 0;
+static guint gc_idle_id = 0;
+
+G_LOCK_DEFINE_STATIC (thumbnails);
+
+/*
+ * Get the directory the thumbnails live in.  The first time this is called it
+ * creates the directory if required.
+ */
+const char *
+sw_thumbnails_get_dir (void)
+{
+  static char *path = NULL;
+
+  if (path == NULL) {
+    path = g_build_filename (g_get_user_cache_dir (),
+                             PACKAGE,
+                             "thumbnails",
+                             NULL);
+
+    if (g_mkdir_with_parents (path, 0777) != 0)
+      g_message ("Cannot create thumbnail directory: %s", g_strerror (errno));
+  }
+
+  return path;
+}
+
+/*
+ * Get the file name that the image at @url is stored in.
+ */
+char *
+sw_thumbnails_get_filename (const char *url)
+{
+  char *md5, *filename;
+
+  g_return_val_if_fail (url, NULL);
+
+  md5 = g_compute_checksum_for_string (G_CHECKSUM_MD5, url, -1);
+  /* TODO: try and guess the extension from @url and use that */
+  filename = g_build_filename (sw_thumbnails_get_dir (), md5, NULL);
+  g_free (md5);
+
+  return filename;
+}
+
+/*
+ * Get the file name that the HTTP validators for the thumbnail @filename are
+ * stored in.  These are removed along with the thumbnail.
+ */
+char *
+sw_thumbnails_get_validators_filename (const char *filename)
+{
+  return g_strconcat (filename, VALIDATORS_SUFFIX, NULL);
+}
+
+static void
+thumbnail_entry_free (ThumbnailEntry *entry)
+{
+  g_slice_free (ThumbnailEntry, entry);
+}
+
+static guint
+entry_files (ThumbnailEntry *entry)
+{
+  return entry->has_validators ? 2 : 1;
+}
+
+static ThumbnailEntry *
+set_entry (const char *name, gsize size, time_t last_use)
+{
+  ThumbnailEntry *entry;
+
+  entry = g_hash_table_lookup (thumbnails, name);
+  if (entry) {
+    thumbnails_size -= entry->size;
+  } else {
+    entry = g_slice_new0 (ThumbnailEntry);
+    g_hash_table_insert (thumbnails, g_strdup (name), entry);
+    thumbnails_files++;
+
+    /*
+     * Images downloaded before validators were kept don't have any.  Rather
+     * than checking all of them at once, take them to have been checked when
+     * they were last used.
+     */
+    entry->last_check = last_use;
+  }
+
+  entry->size = size;
+  entry->last_use = last_use;
+  thumbnails_size += size;
+
+  return entry;
+}
+
+static void
+set_validators (ThumbnailEntry *entry, gsize size, time_t last_check)
+{
+  if (!entry->has_validators) {
+    entry->has_validators = TRUE;
+    thumbnails_files++;
+  }
+
+  thumbnails_size -= entry->validators_size;
+  entry->validators_size = size;
+  thumbnails_size += size;
+
+  entry->last_check = last_check;
+}
+
+static void
+remove_entry (const char *name)
+{
+  ThumbnailEntry *entry;
+
+  entry = g_hash_table_lookup (thumbnails, name);
+  if (entry) {
+    thumbnails_size -= entry->size + entry->validators_size;
+    thumbnails_files -= entry_files (entry);
+    g_hash_table_remove (thumbnails, name);
+  }
+}
+
+static gboolean
+over_budget (void)
+{
+  return thumbnails_size > max_size || thumbnails_files > max_files;
+}
+
+static gint
+compare_last_use (gconstpointer a, gconstpointer b)
+{
+  const ThumbnailEntry *entry_a = g_hash_table_lookup (thumbnails, a);
+  const ThumbnailEntry *entry_b = g_hash_table_lookup (thumbnails, b);
+
+  if (entry_a->last_use < entry_b->last_use)
+    return -1;
+  else if (entry_a->last_use > entry_b->last_use)
+    return 1;
+  else
+    return 0;
+}
+
+/*
+ * Return the names of the least recently used files which need to be removed
+ * to get within @size bytes and @files files, oldest first.
+ */
+static GList *
+get_victims (gsize size, guint files)
+{
+  GList *names, *l, *list = NULL;
+  gsize total_size = thumbnails_size;
+  guint total_files = thumbnails_files;
+
+  if (total_size <= size && total_files <= files)
+    return NULL;
+
+  names = g_hash_table_get_keys (thumbnails);
+  names = g_list_sort (names, compare_last_use);
+
+  for (l = names; l && (total_size > size || total_files > files); l = l->next) {
+    ThumbnailEntry *entry = g_hash_table_lookup (thumbnails, l->data);
+
+    total_size -= entry->size + entry->validators_size;
+    total_files -= entry_files (entry);
+    list = g_list_prepend (list, g_strdup (l->data));
+  }
+
+  g_list_free (names);
+
+  return g_list_reverse (list);
+}
+
+/*
+ * Record the validators file @name found by the scan against its thumbnail,
+ * or remove it if the thumbnail has gone.
+ */
+static void
+scan_validators (const char *name)
+{
+  ThumbnailEntry *entry;
+  char *image, *filename;
+  struct stat st;
+
+  image = g_strndup (name, strlen (name) - strlen (VALIDATORS_SUFFIX));
+
+  entry = g_hash_table_lookup (thumbnails, image);
+  if (entry == NULL) {
+    filename = g_build_filename (sw_thumbnails_get_dir (), image, NULL);
+    if (g_stat (filename, &st) == 0 && S_ISREG (st.st_mode))
+      entry = set_entry (image, st.st_size, st.st_mtime);
+    g_free (filename);
+  }
+
+  /* Validators saved during the scan are already known */
+  filename = g_build_filename (sw_thumbnails_get_dir (), name, NULL);
+  if (entry == NULL)
+    g_remove (filename);
+  else if (!entry->has_validators && g_stat (filename, &st) == 0)
+    set_validators (entry, st.st_size, st.st_mtime);
+  g_free (filename);
+
+  g_free (image);
+}
+
+/*
+ * Do one batch of scanning or eviction.  Returns FALSE when there is nothing
+ * left to do.
+ */
+static gboolean
+gc_step (void)
+{
+  int i;
+
+  /* First finish filling the table */
+  if (scan_dir) {
+    for (i = 0; i < THUMBNAIL_BATCH; i++) {
+      const char *name;
+      char *filename;
+      struct stat st;
+
+      name = g_dir_read_name (scan_dir);
+      if (name == NULL) {
+        g_dir_close (scan_dir);
+        scan_dir = NULL;
+        SW_DEBUG (WEB, "Found %u thumbnails in %u files using %"
+                  G_GSIZE_FORMAT " bytes", g_hash_table_size (thumbnails),
+                  thumbnails_files, thumbnails_size);
+        break;
+      }
+
+      if (g_str_has_suffix (name, VALIDATORS_SUFFIX)) {
+        scan_validators (name);
+        continue;
+      }
+
+      /* Files touched during the scan are already known */
+      if (g_hash_table_lookup (thumbnails, name))
+        continue;
+
+      filename = g_build_filename (sw_thumbnails_get_dir (), name, NULL);
+      if (g_stat (filename, &st) == 0 && S_ISREG (st.st_mode))
+        set_entry (name, st.st_size, st.st_mtime);
+      g_free (filename);
+    }
+
+    return TRUE;
+  }
+
+  if (victims == NULL) {
+    victims = get_victims (max_size, max_files);
+    victims_time = time (NULL);
+
+    if (victims == NULL) {
+      gc_idle_id = 0;
+      return FALSE;
+    }
+  }
+
+  for (i = 0; i < THUMBNAIL_BATCH && victims && over_budget (); i++) {
+    char *name = victims->data;
+    ThumbnailEntry *entry;
+
+    entry = g_hash_table_lookup (thumbnails, name);
+
+    /* Don't remove anything that was used since we picked it */
+    if (entry && entry->last_use < victims_time) {
+      char *filename;
+
+      filename = g_build_filename (sw_thumbnails_get_dir (), name, NULL);
+      SW_DEBUG (WEB, "Evicting thumbnail %s", filename);
+      if (g_remove (filename) != 0 && errno != ENOENT)
+        g_message ("Cannot remove thumbnail %s: %s",
+                   filename, g_strerror (errno));
+      g_free (filename);
+
+      filename = g_strconcat (sw_thumbnails_get_dir (), G_DIR_SEPARATOR_S,
+                              name, VALIDATORS_SUFFIX, NULL);
+      g_remove (filename);
+      g_free (filename);
+
+      remove_entry (name);
+    }
+
+    g_free (name);
+    victims = g_list_delete_link (victims, victims);
+  }
+
+  /*
+   * Stop when we are within budget, or when everything we picked was used in
+   * the meantime.  In that case the next download will try again.
+   */
+  if (victims == NULL || !over_budget ()) {
+    g_list_foreach (victims, (GFunc)g_free, NULL);
+    g_list_free (victims);
+    victims = NULL;
+
+    gc_idle_id = 0;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gc_idle_cb (gpointer user_data)
+{
+  gboolean ret;
+
+  G_LOCK (thumbnails);
+  ret = gc_step ();
+  G_UNLOCK (thumbnails);
+
+  return ret;
+}
+
+static void
+schedule_gc (void)
+{
+  if (!gc_idle_id)
+    gc_idle_id = g_idle_add_full (G_PRIORITY_LOW, gc_idle_cb, NULL, NULL);
+}
+
+static void
+ensure_thumbnails (void)
+{
+  if (thumbnails)
+    return;
+
+  thumbnails = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                      (GDestroyNotify)thumbnail_entry_free);
+
+  scan_dir = g_dir_open (sw_thumbnails_get_dir (), 0, NULL);
+  schedule_gc ();
+}
+
+/**
+ * sw_thumbnails_added:
+ * @filename: the thumbnail that was written
+ * @size: the size of the file
+ *
+ * Record that @filename was just downloaded, removing old thumbnails if this
+ * takes the store over budget.
+ */
+void
+sw_thumbnails_added (const char *filename,
+                     gsize       size)
+{
+  char *name;
+
+  g_return_if_fail (filename);
+
+  G_LOCK (thumbnails);
+
+  ensure_thumbnails ();
+
+  name = g_path_get_basename (filename);
+  set_entry (name, size, time (NULL));
+  g_free (name);
+
+  if (over_budget ())
+    schedule_gc ();
+
+  G_UNLOCK (thumbnails);
+}
+
+/**
+ * sw_thumbnails_touch:
+ * @filename: a thumbnail
+ *
+ * Record that @filename is being used, so that it is kept in preference to
+ * older thumbnails.
+ */
+void
+sw_thumbnails_touch (const char *filename)
+{
+  ThumbnailEntry *entry;
+  time_t now;
+  char *name;
+
+  g_return_if_fail (filename);
+
+  G_LOCK (thumbnails);
+
+  ensure_thumbnails ();
+
+  now = time (NULL);
+
+  name = g_path_get_basename (filename);
+  entry = g_hash_table_lookup (thumbnails, name);
+
+  if (entry == NULL) {
+    struct stat st;
+
+    /* Not scanned yet */
+    if (g_stat (filename, &st) == 0)
+      entry = set_entry (name, st.st_size, st.st_mtime);
+  }
+
+  if (entry) {
+    if (entry->last_use + THUMBNAIL_TOUCH_INTERVAL < now)
+      g_utime (filename, NULL);
+    entry->last_use = now;
+  }
+
+  G_UNLOCK (thumbnails);
+
+  g_free (name);
+}
+
+/**
+ * sw_thumbnails_get_last_check:
+ * @filename: a thumbnail
+ * @last_check: return location for the time
+ *
+ * Get when @filename was last checked for changes.  This only looks at the
+ * table, and doesn't touch the disk.
+ *
+ * Returns: %FALSE if @filename isn't known yet.
+ */
+gboolean
+sw_thumbnails_get_last_check (const char *filename,
+                              time_t     *last_check)
+{
+  ThumbnailEntry *entry;
+  char *name;
+
+  g_return_val_if_fail (filename, FALSE);
+  g_return_val_if_fail (last_check, FALSE);
+
+  G_LOCK (thumbnails);
+
+  ensure_thumbnails ();
+
+  name = g_path_get_basename (filename);
+  entry = g_hash_table_lookup (thumbnails, name);
+  g_free (name);
+
+  if (entry)
+    *last_check = entry->last_check;
+
+  G_UNLOCK (thumbnails);
+
+  return entry != NULL;
+}
+
+/**
+ * sw_thumbnails_validated:
+ * @filename: a thumbnail
+ * @size: the size of its validators file
+ *
+ * Record that the validators of @filename were just saved, after it was
+ * downloaded or checked for changes.
+ */
+void
+sw_thumbnails_validated (const char *filename,
+                         gsize       size)
+{
+  ThumbnailEntry *entry;
+  char *name;
+
+  g_return_if_fail (filename);
+
+  G_LOCK (thumbnails);
+
+  ensure_thumbnails ();
+
+  name = g_path_get_basename (filename);
+  entry = g_hash_table_lookup (thumbnails, name);
+  g_free (name);
+
+  if (entry) {
+    set_validators (entry, size, time (NULL));
+
+    if (over_budget ())
+      schedule_gc ();
+  }
+
+  G_UNLOCK (thumbnails);
+}
+
+/**
+ * sw_thumbnails_set_budget:
+ * @size: the maximum total size in bytes
+ * @files: the maximum number of files
+ *
+ * Set the limits for the thumbnail store.
+ */
+void
+sw_thumbnails_set_budget (gsize size,
+                          guint files)
+{
+  G_LOCK (thumbnails);
+
+  max_size = size;
+  max_files = files;
+
+  ensure_thumbnails ();
+  if (over_budget ())
+    schedule_gc ();
+
+  G_UNLOCK (thumbnails);
+}
+
+#if BUILD_TESTS
+#include "test-runner.h"
+
+void
+test_thumbnails_victims (void)
+{
+  GHashTable *old_thumbnails = thumbnails;
+  gsize old_size = thumbnails_size;
+  guint old_files = thumbnails_files;
+  GList *list;
+
+  thumbnails = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                      (GDestroyNotify)thumbnail_entry_free);
+  thumbnails_size = 0;
+  thumbnails_files = 0;
+
+  set_entry ("a", 100, 30);
+  set_entry ("b", 200, 10);
+  set_entry ("c", 300, 20);
+  g_assert_cmpint (thumbnails_size, ==, 600);
+
+  g_assert (get_victims (600, 3) == NULL);
+
+  /* Over the byte budget, oldest go first */
+  list = get_victims (350, 3);
+  g_assert_cmpint (g_list_length (list), ==, 2);
+  g_assert_cmpstr (list->data, ==, "b");
+  g_assert_cmpstr (list->next->data, ==, "c");
+  g_list_foreach (list, (GFunc)g_free, NULL);
+  g_list_free (list);
+
+  /* Over the file budget */
+  list = get_victims (1000, 2);
+  g_assert_cmpint (g_list_length (list), ==, 1);
+  g_assert_cmpstr (list->data, ==, "b");
+  g_list_foreach (list, (GFunc)g_free, NULL);
+  g_list_free (list);
+
+  /* Updating an entry replaces its size */
+  set_entry ("b", 50, 40);
+  g_assert_cmpint (thumbnails_size, ==, 450);
+  remove_entry ("a");
+  g_assert_cmpint (thumbnails_size, ==, 350);
+  g_assert_cmpint (g_hash_table_size (thumbnails), ==, 2);
+
+  /* Validators count against both budgets */
+  set_validators (g_hash_table_lookup (thumbnails, "c"), 10, 0);
+  g_assert_cmpint (thumbnails_size, ==, 360);
+  g_assert_cmpint (thumbnails_files, ==, 3);
+  list = get_victims (1000, 2);
+  g_assert_cmpint (g_list_length (list), ==, 1);
+  g_assert_cmpstr (list->data, ==, "c");
+  g_list_foreach (list, (GFunc)g_free, NULL);
+  g_list_free (list);
+  remove_entry ("c");
+  g_assert_cmpint (thumbnails_size, ==, 50);
+  g_assert_cmpint (thumbnails_files, ==, 1);
+
+  g_hash_table_destroy (thumbnails);
+  thumbnails = old_thumbnails;
+  thumbnails_size = old_size;
+  thumbnails_files = old_files;
+}
+
+void
+test_thumbnails_last_check (void)
+{
+  GHashTable *old_thumbnails = thumbnails;
+  gsize old_size = thumbnails_size;
+  guint old_files = thumbnails_files;
+  time_t last_check;
+
+  thumbnails = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                      (GDestroyNotify)thumbnail_entry_free);
+  thumbnails_size = 0;
+  thumbnails_files = 0;
+
+  g_assert (!sw_thumbnails_get_last_check ("/thumbnails/a", &last_check));
+
+  /* Without validators, the last use is taken as the last check */
+  set_entry ("a", 100, 50);
+  g_assert (sw_thumbnails_get_last_check ("/thumbnails/a", &last_check));
+  g_assert_cmpint (last_check, ==, 50);
+
+  /* Using it doesn't change when it is due to be checked */
+  set_entry ("a", 100, 80);
+  g_assert (sw_thumbnails_get_last_check ("/thumbnails/a", &last_check));
+  g_assert_cmpint (last_check, ==, 50);
+  g_assert_cmpint (thumbnails_files, ==, 1);
+
+  /* Until it is checked */
+  sw_thumbnails_validated ("/thumbnails/a", 10);
+  g_assert (sw_thumbnails_get_last_check ("/thumbnails/a", &last_check));
+  g_assert_cmpint (last_check, >=, time (NULL) - 1);
+  g_assert_cmpint (thumbnails_size, ==, 110);
+  g_assert_cmpint (thumbnails_files, ==, 2);
+
+  g_hash_table_destroy (thumbnails);
+  thumbnails = old_thumbnails;
+  thumbnails_size = old_size;
+  thumbnails_files = old_files;
+}
+#endif
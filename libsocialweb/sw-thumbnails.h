@@ -0,0 +1,49 @@
+/*
+ * libsocialweb - social data store
+ * Copyright (C) 2010 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _SW_THUMBNAILS
+#define _SW_THUMBNAILS
+
+#include <time.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+const char *sw_thumbnails_get_dir (void);
+
+char *sw_thumbnails_get_filename (const char *url);
+
+char *sw_thumbnails_get_validators_filename (const char *filename);
+
+void sw_thumbnails_added (const char *filename,
+                          gsize       size);
+
+void sw_thumbnails_touch (const char *filename);
+
+gboolean sw_thumbnails_get_last_check (const char *filename,
+                                       time_t     *last_check);
+
+void sw_thumbnails_validated (const char *filename,
+                              gsize       size);
+
+void sw_thumbnails_set_budget (gsize max_size,
+                               guint max_files);
+
+G_END_DECLS
+
+#endif /* _SW_THUMBNAILS */
@@ -22,6 +22,272 @@
 #include <stdio.h>
 #include <libsoup/soup.h>
 
+static const char * const month_names[] = {
+  "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+static const char * const day_names[] = {
+  "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
+};
+
+/*
+ * Days between 1970-01-01 and the given date in the proleptic Gregorian
+ * calendar.  Month is 1-12.
+ */
+static gint64
+days_from_civil (int year, int month, int day)
+{
+  gint64 era;
+  int yoe, doy, doe;
+
+  year -= month <= 2;
+  era = (year >= 0 ? year : year - 399) / 400;
+  yoe = year - era * 400;
+  doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+  return era * 146097 + doe - 719468;
+}
+
+static gboolean
+parse_number (const char **p, int min_digits, int max_digits, int *value)
+{
+  const char *s = *p;
+  int n = 0, digits = 0;
+
+  while (digits < max_digits && g_ascii_isdigit (*s)) {
+    n = n * 10 + (*s - '0');
+    s++;
+    digits++;
+  }
+
+  if (digits < min_digits)
+    return FALSE;
+
+  *p = s;
+  *value = n;
+  return TRUE;
+}
+
+static gboolean
+parse_name (const char **p, const char * const *names, int n_names, int *index)
+{
+  int i;
+
+  for (i = 0; i < n_names; i++) {
+    if (g_ascii_strncasecmp (*p, names[i], 3) == 0) {
+      *p += 3;
+      *index = i;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static void
+skip_spaces (const char **p)
+{
+  while (**p == ' ' || **p == '\t')
+    (*p)++;
+}
+
+/* HH:MM[:SS] */
+static gboolean
+parse_time (const char **p, int *hour, int *minute, int *second)
+{
+  if (!parse_number (p, 1, 2, hour) || **p != ':')
+    return FALSE;
+  (*p)++;
+
+  if (!parse_number (p, 2, 2, minute))
+    return FALSE;
+
+  *second = 0;
+  if (**p == ':') {
+    (*p)++;
+    if (!parse_number (p, 2, 2, second))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/*
+ * Numeric offsets ("+0100", "-05:00") and the UTC names.  No zone at all
+ * means UTC too.  Other names are ambiguous, so leave those to libsoup.
+ */
+static gboolean
+parse_zone (const char **p, int *offset)
+{
+  const char *s = *p;
+  int sign, hours, minutes = 0;
+
+  *offset = 0;
+
+  if (*s == '+' || *s == '-') {
+    sign = *s == '-' ? -1 : 1;
+    s++;
+    if (!parse_number (&s, 2, 2, &hours))
+      return FALSE;
+    if (*s == ':')
+      s++;
+    if (g_ascii_isdigit (*s) && !parse_number (&s, 2, 2, &minutes))
+      return FALSE;
+    *offset = sign * (hours * 3600 + minutes * 60);
+  } else if (g_ascii_strncasecmp (s, "GMT", 3) == 0 ||
+             g_ascii_strncasecmp (s, "UTC", 3) == 0) {
+    s += 3;
+  } else if (g_ascii_strncasecmp (s, "UT", 2) == 0) {
+    s += 2;
+  } else if (*s == 'Z' || *s == 'z') {
+    s++;
+  } else if (g_ascii_isalpha (*s)) {
+    return FALSE;
+  }
+
+  *p = s;
+  return TRUE;
+}
+
+/* YYYY-MM-DD[(T| )HH:MM[:SS[.frac]][zone]] */
+static gboolean
+parse_iso8601 (const char *s, int *year, int *month, int *day,
+               int *hour, int *minute, int *second, int *offset)
+{
+  if (!parse_number (&s, 4, 4, year) || *s++ != '-' ||
+      !parse_number (&s, 2, 2, month) || *s++ != '-' ||
+      !parse_number (&s, 2, 2, day))
+    return FALSE;
+
+  *hour = *minute = *second = *offset = 0;
+
+  if (*s == 'T' || *s == 't' || *s == ' ') {
+    s++;
+    if (!parse_time (&s, hour, minute, second))
+      return FALSE;
+
+    /* Sub-second precision is dropped */
+    if (*s == '.' || *s == ',') {
+      s++;
+      while (g_ascii_isdigit (*s))
+        s++;
+    }
+
+    if (!parse_zone (&s, offset))
+      return FALSE;
+  }
+
+  skip_spaces (&s);
+  return *s == '\0';
+}
+
+/*
+ * RFC 2822 / HTTP dates ("Tue, 15 Nov 1994 08:12:31 GMT") and the asctime
+ * style that Twitter uses ("Wed Aug 27 13:08:45 +0000 2008").
+ */
+static gboolean
+parse_rfc2822 (const char *s, int *year, int *month, int *day,
+               int *hour, int *minute, int *second, int *offset)
+{
+  int weekday;
+
+  skip_spaces (&s);
+
+  if (parse_name (&s, day_names, G_N_ELEMENTS (day_names), &weekday)) {
+    /* Allow the long names that RFC 850 dates have */
+    while (g_ascii_isalpha (*s))
+      s++;
+    if (*s == ',')
+      s++;
+    skip_spaces (&s);
+  }
+
+  if (g_ascii_isdigit (*s)) {
+    if (!parse_number (&s, 1, 2, day))
+      return FALSE;
+    if (*s == ' ' || *s == '-')
+      s++;
+    skip_spaces (&s);
+
+    if (!parse_name (&s, month_names, G_N_ELEMENTS (month_names), month))
+      return FALSE;
+    if (*s == ' ' || *s == '-')
+      s++;
+    skip_spaces (&s);
+
+    if (!parse_number (&s, 2, 4, year))
+      return FALSE;
+    if (*year < 50)
+      *year += 2000;
+    else if (*year < 1000)
+      *year += 1900;
+    skip_spaces (&s);
+
+    if (!parse_time (&s, hour, minute, second))
+      return FALSE;
+    skip_spaces (&s);
+
+    if (!parse_zone (&s, offset))
+      return FALSE;
+  } else {
+    if (!parse_name (&s, month_names, G_N_ELEMENTS (month_names), month))
+      return FALSE;
+    skip_spaces (&s);
+
+    if (!parse_number (&s, 1, 2, day))
+      return FALSE;
+    skip_spaces (&s);
+
+    if (!parse_time (&s, hour, minute, second))
+      return FALSE;
+    skip_spaces (&s);
+
+    if (!g_ascii_isdigit (*s)) {
+      if (!parse_zone (&s, offset))
+        return FALSE;
+      skip_spaces (&s);
+    } else {
+      *offset = 0;
+    }
+
+    if (!parse_number (&s, 4, 4, year))
+      return FALSE;
+  }
+
+  (*month)++;
+
+  skip_spaces (&s);
+  return *s == '\0';
+}
+
+/*
+ * Parse the date formats that the web services and the cache use without
+ * allocating anything.  Returns FALSE if @s isn't in a form this
+ * understands, in which case @t is not touched.
+ */
+gboolean
+sw_time_t_parse (const char *s, time_t *t)
+{
+  int year, month, day, hour, minute, second, offset;
+
+  g_return_val_if_fail (s, FALSE);
+  g_return_val_if_fail (t, FALSE);
+
+  if (!parse_iso8601 (s, &year, &month, &day, &hour, &minute, &second, &offset) &&
+      !parse_rfc2822 (s, &year, &month, &day, &hour, &minute, &second, &offset))
+    return FALSE;
+
+  if (month < 1 || month > 12 || day < 1 || day > 31 ||
+      hour > 23 || minute > 59 || second > 60)
+    return FALSE;
+
+  *t = (time_t)(days_from_civil (year, month, day) * 86400 +
+                hour * 3600 + minute * 60 + second - offset);
+  return TRUE;
+}
+
 time_t
 sw_time_t_from_string (const char *s)
 {
@@ -30,7 +296,13 @@ sw_time_t_from_string (const char *s)
 
   g_return_val_if_fail (s, 0);
 
+  if (sw_time_t_parse (s, &t))
+    return t;
+
   date = soup_date_new_from_string (s);
+  if (date == NULL)
+    return 0;
+
   t = soup_date_to_time_t (date);
   soup_date_free (date);
 
@@ -79,6 +351,24 @@ sw_hash_string_dict (GHashTable *hash)
   return md5;
 }
 
+/*
+ * Continue the 64-bit FNV-1a hash @hash (which should start as
+ * SW_HASH_64_INIT) with the string @s.  The terminating nul is included so
+ * that hashing "ab" then "c" differs from hashing "a" then "bc".
+ */
+guint64
+sw_hash_string_64 (guint64 hash, const char *s)
+{
+  const guchar *p = (const guchar *)s;
+
+  do {
+    hash ^= *p;
+    hash *= G_GUINT64_CONSTANT (0x100000001b3);
+  } while (*p++);
+
+  return hash;
+}
+
 /**
  * sw_next_opid:
  *
@@ -184,3 +474,48 @@ sw_unescape_entities (gchar *string)
 
   return string;
 }
+
+#if BUILD_TESTS
+
+#include "test-runner.h"
+
+void
+test_utils_time_parse (void)
+{
+  time_t t;
+
+  g_assert (sw_time_t_parse ("Thu, 01 Jan 1970 00:00:00 GMT", &t));
+  g_assert_cmpint (t, ==, 0);
+
+  g_assert (sw_time_t_parse ("Sun, 06 Nov 1994 08:49:37 GMT", &t));
+  g_assert_cmpint (t, ==, 784111777);
+
+  g_assert (sw_time_t_parse ("Sunday, 06-Nov-94 08:49:37 GMT", &t));
+  g_assert_cmpint (t, ==, 784111777);
+
+  g_assert (sw_time_t_parse ("Sun, 6 Nov 1994 09:49:37 +0100", &t));
+  g_assert_cmpint (t, ==, 784111777);
+
+  g_assert (sw_time_t_parse ("Sun Nov 06 08:49:37 +0000 1994", &t));
+  g_assert_cmpint (t, ==, 784111777);
+
+  g_assert (sw_time_t_parse ("1994-11-06T08:49:37Z", &t));
+  g_assert_cmpint (t, ==, 784111777);
+
+  g_assert (sw_time_t_parse ("1994-11-06T03:49:37.250-05:00", &t));
+  g_assert_cmpint (t, ==, 784111777);
+
+  g_assert (sw_time_t_parse ("2000-02-29 12:00:00", &t));
+  g_assert_cmpint (t, ==, 951825600);
+
+  g_assert (!sw_time_t_parse ("", &t));
+  g_assert (!sw_time_t_parse ("yesterday", &t));
+  g_assert (!sw_time_t_parse ("Sun, 06 Nov 1994 08:49:37 EST", &t));
+  g_assert (!sw_time_t_parse ("1994-13-06T08:49:37Z", &t));
+
+  /* Anything we don't understand still goes through libsoup */
+  g_assert_cmpint (sw_time_t_from_string ("Sun, 06 Nov 1994 03:49:37 EST"),
+                   ==, 784111777);
+}
+
+#endif
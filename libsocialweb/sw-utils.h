@@ -20,8 +20,12 @@
 #include <time.h>
 
 time_t sw_time_t_from_string (const char *s);
+gboolean sw_time_t_parse (const char *s, time_t *t);
 char * sw_time_t_to_string (time_t t);
 char *sw_hash_string_dict (GHashTable *hash);
 
+#define SW_HASH_64_INIT G_GUINT64_CONSTANT (0xcbf29ce484222325)
+guint64 sw_hash_string_64 (guint64 hash, const char *s);
+
 int sw_next_opid (void);
 gchar *sw_unescape_entities (gchar *string);
@@ -0,0 +1,289 @@
+/*
+ * libsocialweb - social data store
+ * Copyright (C) 2010 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <config.h>
+
+#include "sw-view-multiplexer.h"
+#include "sw-service.h"
+#include "sw-client-monitor.h"
+#include "sw-utils.h"
+#include "sw-debug.h"
+
+/*
+ * The view multiplexer.
+ *
+ * When several clients open a view on the same query of a service with the
+ * same parameters they are all given the same view, so that it is only
+ * fetched, diffed and cached once.  Every client holds a reference on the
+ * view through sw_client_monitor_add(), so the view lives until the last of
+ * them closes it or goes away.
+ *
+ * Views are keyed on the service name, the query and sw_hash_string_dict()
+ * of the parameters, and are only weakly referenced here.
+ */
+
+/* Key => view */
+static GHashTable *views = NULL;
+/* View => key, owns the keys */
+static GHashTable *keys = NULL;
+
+static gchar *
+make_key (SwService   *service,
+          const gchar *query,
+          GHashTable  *params)
+{
+  gchar *params_hash, *key;
+
+  params_hash = params ? sw_hash_string_dict (params) : NULL;
+
+  key = g_strconcat (sw_service_get_name (service), "/",
+                     query, "/",
+                     params_hash ? params_hash : "",
+                     NULL);
+  g_free (params_hash);
+
+  return key;
+}
+
+static void
+forget_view (GObject *view)
+{
+  gchar *key;
+
+  key = g_hash_table_lookup (keys, view);
+  if (key == NULL)
+    return;
+
+  SW_DEBUG (VIEWS, "No longer sharing view for %s", key);
+
+  g_hash_table_remove (views, key);
+  g_hash_table_remove (keys, view);
+}
+
+static void
+_view_weak_notify (gpointer  data,
+                   GObject  *dead_view)
+{
+  forget_view (dead_view);
+}
+
+/**
+ * sw_view_multiplexer_lookup:
+ * @service: a #SwService
+ * @query: the query that was opened
+ * @params: the parameters of the query, or %NULL
+ *
+ * Find a view already open on @query of @service with the same @params.
+ *
+ * Returns: a new reference to the view, or %NULL
+ */
+GObject *
+sw_view_multiplexer_lookup (SwService   *service,
+                            const gchar *query,
+                            GHashTable  *params)
+{
+  GObject *view;
+  gchar *key;
+
+  g_return_val_if_fail (service, NULL);
+  g_return_val_if_fail (query, NULL);
+
+  if (views == NULL)
+    return NULL;
+
+  key = make_key (service, query, params);
+  view = g_hash_table_lookup (views, key);
+
+  if (view)
+    SW_DEBUG (VIEWS, "Sharing view for %s", key);
+
+  g_free (key);
+
+  return view ? g_object_ref (view) : NULL;
+}
+
+/**
+ * sw_view_multiplexer_add:
+ * @service: a #SwService
+ * @query: the query that was opened
+ * @params: the parameters of the query, or %NULL
+ * @view: the view that was opened
+ *
+ * Let later opens of @query with the same @params share @view, until it is
+ * finalized or passed to sw_view_multiplexer_remove().
+ */
+void
+sw_view_multiplexer_add (SwService   *service,
+                         const gchar *query,
+                         GHashTable  *params,
+                         GObject     *view)
+{
+  gchar *key;
+
+  g_return_if_fail (service);
+  g_return_if_fail (query);
+  g_return_if_fail (G_IS_OBJECT (view));
+
+  if (views == NULL)
+  {
+    views = g_hash_table_new (g_str_hash, g_str_equal);
+    keys = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+  }
+
+  g_return_if_fail (g_hash_table_lookup (keys, view) == NULL);
+
+  key = make_key (service, query, params);
+
+  /* A view that stopped being shared may still be open on the same key */
+  if (g_hash_table_lookup (views, key))
+    forget_view (g_hash_table_lookup (views, key));
+
+  g_hash_table_insert (views, key, view);
+  g_hash_table_insert (keys, view, key);
+
+  g_object_weak_ref (view, _view_weak_notify, NULL);
+}
+
+/**
+ * sw_view_multiplexer_remove:
+ * @view: a view passed to sw_view_multiplexer_add()
+ *
+ * Stop giving @view to clients opening the same query, for example because a
+ * client has asked for something that only suits it.
+ */
+void
+sw_view_multiplexer_remove (GObject *view)
+{
+  g_return_if_fail (G_IS_OBJECT (view));
+
+  if (keys == NULL || g_hash_table_lookup (keys, view) == NULL)
+    return;
+
+  forget_view (view);
+  g_object_weak_unref (view, _view_weak_notify, NULL);
+}
+
+/**
+ * sw_view_multiplexer_open:
+ * @service: a #SwService
+ * @query: the query that was opened
+ * @params: the parameters of the query, or %NULL
+ * @sender: the bus name of the client opening the view, which is taken
+ * @view_type: the type of view to create if there isn't one to share
+ * @first_property_name: the name of the first property for the new view
+ * @...: the value of the first property, followed by other name and value
+ * pairs, followed by %NULL
+ *
+ * Find a view that is already open on @query of @service with the same
+ * @params, or create one with g_object_new() and share it from now on.  The
+ * view is released when @sender closes it or goes away.
+ *
+ * Returns: the view, owned by the client monitor
+ */
+GObject *
+sw_view_multiplexer_open (SwService   *service,
+                          const gchar *query,
+                          GHashTable  *params,
+                          gchar       *sender,
+                          GType        view_type,
+                          const gchar *first_property_name,
+                          ...)
+{
+  GObject *view;
+  va_list args;
+
+  g_return_val_if_fail (service, NULL);
+  g_return_val_if_fail (query, NULL);
+  g_return_val_if_fail (sender, NULL);
+
+  view = sw_view_multiplexer_lookup (service, query, params);
+  if (view == NULL)
+  {
+    va_start (args, first_property_name);
+    view = g_object_new_valist (view_type, first_property_name, args);
+    va_end (args);
+
+    sw_view_multiplexer_add (service, query, params, view);
+  }
+
+  /* Ensure the object gets disposed when the client goes away */
+  sw_client_monitor_add (sender, view);
+
+  return view;
+}
+
+#if BUILD_TESTS
+#include "test-runner.h"
+#include "services/dummy/dummy.h"
+
+void
+test_view_multiplexer_share (void)
+{
+  SwService *service;
+  GHashTable *params, *other_params;
+  GObject *view, *shared;
+
+  service = g_object_new (SW_TYPE_SERVICE_DUMMY, NULL);
+
+  params = g_hash_table_new (g_str_hash, g_str_equal);
+  g_hash_table_insert (params, "count", "20");
+  other_params = g_hash_table_new (g_str_hash, g_str_equal);
+  g_hash_table_insert (other_params, "count", "50");
+
+  view = (GObject *)dummy_object_new ();
+  g_assert (sw_view_multiplexer_lookup (service, "feed", params) == NULL);
+  sw_view_multiplexer_add (service, "feed", params, view);
+
+  /* Only the same query with the same parameters is shared */
+  shared = sw_view_multiplexer_lookup (service, "feed", params);
+  g_assert (shared == view);
+  g_object_unref (shared);
+
+  g_assert (sw_view_multiplexer_lookup (service, "own", params) == NULL);
+  g_assert (sw_view_multiplexer_lookup (service, "feed", other_params) == NULL);
+  g_assert (sw_view_multiplexer_lookup (service, "feed", NULL) == NULL);
+
+  /* Views that are removed or finalized aren't shared any more */
+  sw_view_multiplexer_remove (view);
+  g_assert (sw_view_multiplexer_lookup (service, "feed", params) == NULL);
+
+  sw_view_multiplexer_add (service, "feed", params, view);
+  g_object_unref (view);
+  g_assert (sw_view_multiplexer_lookup (service, "feed", params) == NULL);
+
+  /* Opening creates a view the first time and shares it after that */
+  view = sw_view_multiplexer_open (service, "feed", params,
+                                   g_strdup (":1.1"), TYPE_DUMMY_OBJECT,
+                                   NULL);
+  shared = sw_view_multiplexer_open (service, "feed", params,
+                                     g_strdup (":1.2"), TYPE_DUMMY_OBJECT,
+                                     NULL);
+  g_assert (shared == view);
+  g_assert_cmpint (sw_client_monitor_get_n_clients (view), ==, 2);
+
+  sw_client_monitor_remove (g_strdup (":1.1"), view);
+  g_object_unref (view);
+  sw_client_monitor_remove (g_strdup (":1.2"), view);
+  g_object_unref (view);
+  g_assert (sw_view_multiplexer_lookup (service, "feed", params) == NULL);
+
+  g_hash_table_unref (params);
+  g_hash_table_unref (other_params);
+  g_object_unref (service);
+}
+#endif
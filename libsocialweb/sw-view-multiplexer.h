@@ -0,0 +1,48 @@
+/*
+ * libsocialweb - social data store
+ * Copyright (C) 2010 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _SW_VIEW_MULTIPLEXER
+#define _SW_VIEW_MULTIPLEXER
+
+#include <glib-object.h>
+#include <libsocialweb/sw-types.h>
+
+G_BEGIN_DECLS
+
+GObject *sw_view_multiplexer_lookup (SwService   *service,
+                                     const gchar *query,
+                                     GHashTable  *params);
+
+void sw_view_multiplexer_add (SwService   *service,
+                              const gchar *query,
+                              GHashTable  *params,
+                              GObject     *view);
+
+void sw_view_multiplexer_remove (GObject *view);
+
+GObject *sw_view_multiplexer_open (SwService   *service,
+                                   const gchar *query,
+                                   GHashTable  *params,
+                                   gchar       *sender,
+                                   GType        view_type,
+                                   const gchar *first_property_name,
+                                   ...) G_GNUC_NULL_TERMINATED;
+
+G_END_DECLS
+
+#endif /* _SW_VIEW_MULTIPLEXER */
@@ -17,12 +17,19 @@
  */
 
 #include <config.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
 #include <libsoup/soup.h>
 #if WITH_GNOME
 #include <libsoup/soup-gnome.h>
 #endif
 
 #include "sw-web.h"
+#include "sw-thumbnails.h"
+#include "sw-debug.h"
 
 #define HTTP_LOGGING 0
 
@@ -68,86 +75,608 @@ sw_web_make_async_session (void)
   return session;
 }
 
-char *
-sw_web_download_image (const char *url)
+/*
+ * Image downloads.
+ *
+ * The transfers are done by a pool of worker threads sharing a synchronous
+ * session, so they never block the main loop.  Each transfer is a
+ * DownloadJob, and when it is done the result is passed back to the main loop
+ * (or to the thread waiting in sw_web_download_image()).
+ *
+ * Asynchronous requests for a URL which is already being downloaded are
+ * merged into the existing download, and all of the callbacks are called when
+ * it finishes.  At most MAX_DOWNLOADS of these run at once, and at most
+ * MAX_DOWNLOADS_PER_HOST to any one host; the rest wait in a queue in the
+ * order they were requested.
+ */
+
+#define MAX_DOWNLOADS 8
+#define MAX_DOWNLOADS_PER_HOST 2
+/* Seconds that sw_web_download_image() waits for a download */
+#define SYNC_DOWNLOAD_TIMEOUT 30
+#define DEFAULT_MAX_IMAGE_SIZE (10 * 1024 * 1024)
+#define DEFAULT_REVALIDATE_INTERVAL (24 * 60 * 60)
+
+typedef struct _Download Download;
+
+typedef struct {
+  /* The URL and file to download it to */
+  char *url;
+  char *filename;
+  gboolean success;
+
+  /* The asynchronous download this is for, or NULL */
+  Download *download;
+
+  /* For synchronous downloads, signalled when done */
+  GMutex *lock;
+  GCond *cond;
+  gboolean done;
+
+  gint ref_count;
+} DownloadJob;
+
+typedef struct {
+  ImageDownloadCallback callback;
+  gpointer user_data;
+} DownloadWaiter;
+
+struct _Download {
+  /* The URL we are downloading */
+  char *url;
+  /* The host part of the URL, for limiting concurrency */
+  char *host;
+  /* The target filename */
+  char *filename;
+  /* List of DownloadWaiter to call when done */
+  GSList *waiters;
+};
+
+/* Hash of URL to Download, both queued and running */
+static GHashTable *downloads = NULL;
+/* Downloads waiting to start, oldest first */
+static GQueue download_queue = G_QUEUE_INIT;
+/* Hash of host to the number of running downloads */
+static GHashTable *host_running = NULL;
+static guint n_running = 0;
+/* Downloads larger than this are aborted */
+static gsize max_image_size = DEFAULT_MAX_IMAGE_SIZE;
+/* Seconds before images are checked for changes */
+static guint revalidate_interval = DEFAULT_REVALIDATE_INTERVAL;
+
+static void run_download_queue (void);
+
+static void
+download_free (Download *download)
 {
-  static GOnce once = G_ONCE_INIT;
+  g_slist_foreach (download->waiters, (GFunc)g_free, NULL);
+  g_slist_free (download->waiters);
+  g_free (download->url);
+  g_free (download->host);
+  g_free (download->filename);
+  g_slice_free (Download, download);
+}
+
+static guint
+get_host_running (const char *host)
+{
+  return GPOINTER_TO_UINT (g_hash_table_lookup (host_running, host));
+}
+
+static void
+set_host_running (const char *host, guint count)
+{
+  if (count)
+    g_hash_table_replace (host_running, g_strdup (host),
+                          GUINT_TO_POINTER (count));
+  else
+    g_hash_table_remove (host_running, host);
+}
+
+/*
+ * Call all of the callbacks for @download with the result, which is the
+ * downloaded file or NULL, and free it.
+ */
+static void
+download_finish (Download *download, gboolean success)
+{
+  GSList *l;
+
+  download->waiters = g_slist_reverse (download->waiters);
+
+  for (l = download->waiters; l; l = l->next) {
+    DownloadWaiter *waiter = l->data;
+
+    /* Each callback owns the filename it is given */
+    waiter->callback (download->url,
+                      success ? g_strdup (download->filename) : NULL,
+                      waiter->user_data);
+  }
+
+  download_free (download);
+}
+
+static DownloadJob *
+download_job_new (const char *url, const char *filename)
+{
+  DownloadJob *job;
+
+  job = g_slice_new0 (DownloadJob);
+  job->url = g_strdup (url);
+  job->filename = g_strdup (filename);
+  job->ref_count = 1;
+
+  return job;
+}
+
+static void
+download_job_unref (DownloadJob *job)
+{
+  if (!g_atomic_int_dec_and_test (&job->ref_count))
+    return;
+
+  if (job->lock) {
+    g_mutex_free (job->lock);
+    g_cond_free (job->cond);
+  }
+  g_free (job->url);
+  g_free (job->filename);
+  g_slice_free (DownloadJob, job);
+}
+
+/* State for streaming a response into a file */
+typedef struct {
   SoupSession *session;
-  char *md5, *path, *filename;
+  int fd;
+  gsize length;
+  /* Set if the download was aborted */
+  const char *error;
+} FetchState;
 
-  g_return_val_if_fail (url, NULL);
+static void
+fetch_abort (FetchState *state, SoupMessage *msg, const char *error)
+{
+  state->error = error;
+  soup_session_cancel_message (state->session, msg, SOUP_STATUS_CANCELLED);
+}
 
-  g_once (&once, (GThreadFunc)sw_web_make_sync_session, NULL);
-  session = once.retval;
-
-  md5 = g_compute_checksum_for_string (G_CHECKSUM_MD5, url, -1);
-
-  path = g_build_filename (g_get_user_cache_dir (),
-                           PACKAGE,
-                           "thumbnails",
-                           NULL);
-  g_mkdir_with_parents (path, 0777);
-
-  /* TODO: try and guess the extension from @url and use that */
-  filename = g_build_filename (path, md5, NULL);
-  g_free (md5);
-  g_free (path);
-
-  if (!g_file_test (filename, G_FILE_TEST_EXISTS)) {
-    SoupMessage *msg;
-
-    msg = soup_message_new (SOUP_METHOD_GET, url);
-    soup_session_send_message (session, msg);
-    if (msg->status_code == SOUP_STATUS_OK) {
-      /* TODO: GError */
-      g_file_set_contents (filename,
-                           msg->response_body->data,
-                           msg->response_body->length,
-                           NULL);
-    } else {
-      g_message ("Cannot download %s: %s", url, msg->reason_phrase);
-      g_free (filename);
-      filename = NULL;
+static void
+fetch_got_headers_cb (SoupMessage *msg, FetchState *state)
+{
+  goffset length;
+
+  if (msg->status_code != SOUP_STATUS_OK)
+    return;
+
+  /* Don't bother starting if we know it is too big */
+  length = soup_message_headers_get_content_length (msg->response_headers);
+  if (length > 0 && (gsize)length > max_image_size)
+    fetch_abort (state, msg, "too large");
+}
+
+static void
+fetch_got_chunk_cb (SoupMessage *msg, SoupBuffer *chunk, FetchState *state)
+{
+  const char *data = chunk->data;
+  gsize remaining = chunk->length;
+
+  if (msg->status_code != SOUP_STATUS_OK || state->error)
+    return;
+
+  if (state->length + chunk->length > max_image_size) {
+    fetch_abort (state, msg, "too large");
+    return;
+  }
+
+  while (remaining) {
+    gssize written;
+
+    written = write (state->fd, data, remaining);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      fetch_abort (state, msg, g_strerror (errno));
+      return;
     }
+
+    data += written;
+    remaining -= written;
+  }
+
+  state->length += chunk->length;
+}
+
+/*
+ * Revalidation.
+ *
+ * The ETag and Last-Modified headers of each image are kept in a key file
+ * next to it, and once revalidate_interval has passed since the image was
+ * last fetched or checked it is requested again with If-None-Match and
+ * If-Modified-Since.  Usually this gets a 304 and the image is left alone.
+ * The modification time of the validators file is the time it was last
+ * checked, whether or not the check succeeded (the modification time of the
+ * image is used as its last use).  The thumbnail store keeps track of these,
+ * so deciding whether to check doesn't touch the disk.
+ */
+
+#define VALIDATORS_GROUP "Validators"
+
+/*
+ * Whether the image in @filename should be checked for changes.
+ */
+static gboolean
+needs_revalidation (const char *filename)
+{
+  time_t last_check;
+
+  /* If it isn't known yet, it will be by the next time it is used */
+  if (!sw_thumbnails_get_last_check (filename, &last_check))
+    return FALSE;
+
+  return last_check + (time_t)revalidate_interval < time (NULL);
+}
+
+/*
+ * Add conditional headers to @msg from the validators in @keys.
+ */
+static void
+add_validators (SoupMessage *msg, GKeyFile *keys)
+{
+  char *value;
+
+  value = g_key_file_get_string (keys, VALIDATORS_GROUP, "ETag", NULL);
+  if (value)
+    soup_message_headers_append (msg->request_headers, "If-None-Match", value);
+  g_free (value);
+
+  value = g_key_file_get_string (keys, VALIDATORS_GROUP, "Last-Modified", NULL);
+  if (value)
+    soup_message_headers_append (msg->request_headers, "If-Modified-Since",
+                                 value);
+  g_free (value);
+}
+
+/*
+ * Update @keys with any validators in the response to @msg, if it isn't
+ * NULL, and save them to @validators for the image in @filename.
+ */
+static void
+save_validators (SoupMessage *msg,
+                 GKeyFile    *keys,
+                 const char  *filename,
+                 const char  *validators)
+{
+  const char *value;
+  char *data;
+  gsize length;
+
+  if (msg) {
+    value = soup_message_headers_get_one (msg->response_headers, "ETag");
+    if (value)
+      g_key_file_set_string (keys, VALIDATORS_GROUP, "ETag", value);
+
+    value = soup_message_headers_get_one (msg->response_headers,
+                                          "Last-Modified");
+    if (value)
+      g_key_file_set_string (keys, VALIDATORS_GROUP, "Last-Modified", value);
+  }
+
+  data = g_key_file_to_data (keys, &length, NULL);
+  if (g_file_set_contents (validators, data, length, NULL))
+    sw_thumbnails_validated (filename, length);
+  else
+    g_message ("Cannot save validators to %s", validators);
+  g_free (data);
+}
+
+/*
+ * Fetch @url into @filename, or check that it hasn't changed if there is
+ * already a copy.  The body is written to a temporary file as it arrives,
+ * which is renamed to @filename once it is complete.  This blocks, and is
+ * called in the worker threads.
+ */
+static gboolean
+fetch_to_file (const char *url, const char *filename)
+{
+  static GOnce once = G_ONCE_INIT;
+  SoupMessage *msg;
+  FetchState state = { NULL, -1, 0, NULL };
+  GKeyFile *keys;
+  char *tmpname, *validators;
+  gboolean success = FALSE, renamed = FALSE, revalidating;
+
+  g_once (&once, (GThreadFunc)sw_web_make_sync_session, NULL);
+  state.session = once.retval;
+
+  msg = soup_message_new (SOUP_METHOD_GET, url);
+  if (msg == NULL) {
+    g_message ("Cannot download %s: invalid URL", url);
+    return FALSE;
+  }
+
+  tmpname = g_strconcat (filename, ".XXXXXX", NULL);
+  state.fd = g_mkstemp (tmpname);
+  if (state.fd == -1) {
+    g_message ("Cannot download %s: %s", url, g_strerror (errno));
+    g_free (tmpname);
     g_object_unref (msg);
+    return FALSE;
   }
 
-  return filename;
+  keys = g_key_file_new ();
+  validators = sw_thumbnails_get_validators_filename (filename);
+  revalidating = g_file_test (filename, G_FILE_TEST_EXISTS);
+  if (revalidating &&
+      g_key_file_load_from_file (keys, validators, G_KEY_FILE_NONE, NULL))
+    add_validators (msg, keys);
+
+  /* We write the chunks out ourselves, so don't keep them around */
+  soup_message_body_set_accumulate (msg->response_body, FALSE);
+  g_signal_connect (msg, "got-headers",
+                    G_CALLBACK (fetch_got_headers_cb), &state);
+  g_signal_connect (msg, "got-chunk",
+                    G_CALLBACK (fetch_got_chunk_cb), &state);
+
+  soup_session_send_message (state.session, msg);
+
+  if (close (state.fd) != 0 && state.error == NULL)
+    state.error = g_strerror (errno);
+
+  if (state.error) {
+    g_message ("Cannot download %s: %s", url, state.error);
+  } else if (msg->status_code == SOUP_STATUS_NOT_MODIFIED) {
+    SW_DEBUG (WEB, "Not modified: %s", url);
+    success = TRUE;
+  } else if (msg->status_code != SOUP_STATUS_OK) {
+    g_message ("Cannot download %s: %s", url, msg->reason_phrase);
+  } else if (g_rename (tmpname, filename) != 0) {
+    g_message ("Cannot download %s: %s", url, g_strerror (errno));
+  } else {
+    sw_thumbnails_added (filename, state.length);
+    renamed = success = TRUE;
+  }
+
+  /*
+   * Even if nothing came back, this records when we last checked.  If the
+   * check failed we keep the copy we have and the validators we had, and
+   * don't try again until the next interval.
+   */
+  if (success)
+    save_validators (msg, keys, filename, validators);
+  else if (revalidating)
+    save_validators (NULL, keys, filename, validators);
+
+  if (!renamed)
+    g_unlink (tmpname);
+
+  g_key_file_free (keys);
+  g_free (validators);
+  g_free (tmpname);
+  g_object_unref (msg);
+
+  return success;
 }
 
-typedef struct {
-  /* The URL we are downloading.  We own this */
-  char *url;
-  /* The target filename. Ownership is passed to the caller */
-  char *filename;
-  /* Callback */
-  ImageDownloadCallback callback;
-  gpointer user_data;
-} AsyncData;
+/*
+ * Finish the asynchronous download of @user_data in the main loop.
+ */
+static gboolean
+download_done_idle (gpointer user_data)
+{
+  DownloadJob *job = user_data;
+  Download *download = job->download;
+
+  n_running--;
+  set_host_running (download->host, get_host_running (download->host) - 1);
+
+  /* Remove it first so that the callbacks can ask for the URL again */
+  g_hash_table_steal (downloads, download->url);
+
+  download_finish (download, job->success);
+  download_job_unref (job);
+
+  run_download_queue ();
+
+  return FALSE;
+}
 
 static void
-async_download_cb (SoupSession *session,
-                   SoupMessage *msg,
-                   gpointer     user_data)
+download_thread_func (gpointer data, gpointer user_data)
 {
-  AsyncData *data = user_data;
+  DownloadJob *job = data;
+
+  job->success = fetch_to_file (job->url, job->filename);
 
-  if (msg->status_code == SOUP_STATUS_OK) {
-    g_file_set_contents (data->filename,
-                         msg->response_body->data,
-                         msg->response_body->length,
-                         NULL);
+  if (job->download) {
+    g_idle_add (download_done_idle, job);
   } else {
-    g_message ("Cannot download %s: %s", data->url, msg->reason_phrase);
-    g_free (data->filename);
-    data->filename = NULL;
+    g_mutex_lock (job->lock);
+    job->done = TRUE;
+    g_cond_signal (job->cond);
+    g_mutex_unlock (job->lock);
+
+    download_job_unref (job);
+  }
+}
+
+static gpointer
+make_download_pool (gpointer data)
+{
+  GThreadPool *pool;
+  GError *error = NULL;
+
+  /* Leave room for synchronous downloads alongside the asynchronous ones */
+  pool = g_thread_pool_new (download_thread_func, NULL,
+                            MAX_DOWNLOADS + 2, FALSE, &error);
+  if (pool == NULL) {
+    g_message ("Cannot create download threads: %s", error->message);
+    g_error_free (error);
+  }
+
+  return pool;
+}
+
+static void
+push_download_job (DownloadJob *job)
+{
+  static GOnce once = G_ONCE_INIT;
+  GThreadPool *pool;
+
+  g_once (&once, (GThreadFunc)make_download_pool, NULL);
+  pool = once.retval;
+
+  if (pool)
+    g_thread_pool_push (pool, job, NULL);
+  else
+    /* Do it now instead */
+    download_thread_func (job, NULL);
+}
+
+/*
+ * Remove and return the first queued download that can be started without
+ * going over the limits, or NULL if there isn't one.
+ */
+static Download *
+pop_startable_download (void)
+{
+  GList *l;
+
+  if (n_running >= MAX_DOWNLOADS)
+    return NULL;
+
+  for (l = download_queue.head; l; l = l->next) {
+    Download *download = l->data;
+
+    if (get_host_running (download->host) < MAX_DOWNLOADS_PER_HOST) {
+      g_queue_delete_link (&download_queue, l);
+      return download;
+    }
+  }
+
+  return NULL;
+}
+
+static void
+run_download_queue (void)
+{
+  Download *download;
+
+  while ((download = pop_startable_download ()) != NULL) {
+    DownloadJob *job;
+
+    n_running++;
+    set_host_running (download->host, get_host_running (download->host) + 1);
+
+    SW_DEBUG (WEB, "Downloading %s (%u running, %u queued)",
+              download->url, n_running, download_queue.length);
+
+    job = download_job_new (download->url, download->filename);
+    job->download = download;
+    push_download_job (job);
+  }
+}
+
+/**
+ * sw_web_download_image:
+ * @url: the image to download
+ *
+ * Download @url into the thumbnail directory, if it isn't already there, and
+ * return the local file name.  This blocks for up to thirty seconds, so
+ * sw_web_download_image_async() should be used instead where possible.
+ *
+ * Returns: the file name, or %NULL if the download failed or timed out.
+ */
+char *
+sw_web_download_image (const char *url)
+{
+  DownloadJob *job;
+  GTimeVal timeout;
+  gboolean done;
+  char *filename;
+
+  g_return_val_if_fail (url, NULL);
+
+  filename = sw_thumbnails_get_filename (url);
+
+  if (g_file_test (filename, G_FILE_TEST_EXISTS)) {
+    sw_thumbnails_touch (filename);
+    return filename;
+  }
+
+  job = download_job_new (url, filename);
+  job->lock = g_mutex_new ();
+  job->cond = g_cond_new ();
+  /* One reference for us and one for the worker */
+  job->ref_count = 2;
+
+  g_get_current_time (&timeout);
+  g_time_val_add (&timeout, SYNC_DOWNLOAD_TIMEOUT * G_USEC_PER_SEC);
+
+  push_download_job (job);
+
+  g_mutex_lock (job->lock);
+  while (!job->done)
+    if (!g_cond_timed_wait (job->cond, job->lock, &timeout))
+      break;
+  done = job->done;
+  g_mutex_unlock (job->lock);
+
+  if (!done) {
+    g_message ("Timed out downloading %s", url);
+    g_free (filename);
+    filename = NULL;
+  } else if (!job->success) {
+    g_free (filename);
+    filename = NULL;
+  }
+
+  download_job_unref (job);
+
+  return filename;
+}
+
+/*
+ * Find the download of @url into @filename, or queue a new one.  Takes
+ * ownership of @filename.  Returns NULL if @url can't be downloaded.
+ */
+static Download *
+start_download (const char *url, char *filename)
+{
+  Download *download;
+  SoupURI *uri;
+
+  if (downloads == NULL) {
+    downloads = g_hash_table_new (g_str_hash, g_str_equal);
+    host_running = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          g_free, NULL);
+  }
+
+  download = g_hash_table_lookup (downloads, url);
+  if (download) {
+    SW_DEBUG (WEB, "Already downloading %s", url);
+    g_free (filename);
+    return download;
+  }
+
+  uri = soup_uri_new (url);
+  if (uri == NULL) {
+    g_message ("Cannot download %s: invalid URL", url);
+    g_free (filename);
+    return NULL;
   }
 
-  data->callback (data->url, data->filename, data->user_data);
+  download = g_slice_new0 (Download);
+  download->url = g_strdup (url);
+  download->host = g_strdup (uri->host);
+  download->filename = filename;
+  soup_uri_free (uri);
+
+  g_hash_table_insert (downloads, download->url, download);
+  g_queue_push_tail (&download_queue, download);
 
-  /* Cleanup */
-  g_free (data->url);
-  g_slice_free (AsyncData, data);
+  run_download_queue ();
+
+  return download;
 }
 
 void
@@ -155,42 +684,147 @@ sw_web_download_image_async (const char            *url,
                              ImageDownloadCallback  callback,
                              gpointer               user_data)
 {
-  static GOnce once = G_ONCE_INIT;
-  SoupSession *session;
-  char *md5, *path, *filename;
+  Download *download;
+  DownloadWaiter *waiter;
+  char *filename;
 
   g_return_if_fail (url);
   g_return_if_fail (callback);
 
-  g_once (&once, (GThreadFunc)sw_web_make_async_session, NULL);
-  session = once.retval;
+  filename = sw_thumbnails_get_filename (url);
 
-  md5 = g_compute_checksum_for_string (G_CHECKSUM_MD5, url, -1);
-
-  path = g_build_filename (g_get_user_cache_dir (),
-                           PACKAGE,
-                           "thumbnails",
-                           NULL);
-  g_mkdir_with_parents (path, 0777);
+  if (g_file_test (filename, G_FILE_TEST_EXISTS)) {
+    /*
+     * Use what we have now, and if it is time to check whether it has changed
+     * do that in the background.  If it has, the file is replaced in place.
+     * This is checked before touching the file, as its last use may be needed
+     * to work out when it was last checked.
+     */
+    if (needs_revalidation (filename)) {
+      SW_DEBUG (WEB, "Revalidating %s", url);
+      start_download (url, g_strdup (filename));
+    }
 
-  /* TODO: try and guess the extension from @url and use that */
-  filename = g_build_filename (path, md5, NULL);
-  g_free (md5);
-  g_free (path);
+    sw_thumbnails_touch (filename);
 
-  if (g_file_test (filename, G_FILE_TEST_EXISTS)) {
-    /* TODO: should get timestamp and make a GET call, which hopefully returns 304 */
     callback (url, filename, user_data);
-  } else {
-    SoupMessage *msg;
-    AsyncData *data = g_slice_new0 (AsyncData);
+    return;
+  }
+
+  download = start_download (url, filename);
+  if (download == NULL) {
+    callback (url, NULL, user_data);
+    return;
+  }
+
+  waiter = g_new0 (DownloadWaiter, 1);
+  waiter->callback = callback;
+  waiter->user_data = user_data;
+  download->waiters = g_slist_prepend (download->waiters, waiter);
+}
+
+/**
+ * sw_web_get_download_counts:
+ * @running: return location for the number of downloads in progress, or %NULL
+ * @queued: return location for the number of downloads waiting to start, or
+ * %NULL
+ *
+ * Get the number of image downloads that are running and waiting.
+ */
+void
+sw_web_get_download_counts (guint *running,
+                            guint *queued)
+{
+  if (running)
+    *running = n_running;
+  if (queued)
+    *queued = download_queue.length;
+}
+
+/**
+ * sw_web_set_max_image_size:
+ * @size: the maximum size in bytes
+ *
+ * Set the largest image that will be downloaded.  Larger downloads are
+ * abandoned as soon as they are known to be too large.
+ */
+void
+sw_web_set_max_image_size (gsize size)
+{
+  max_image_size = size;
+}
 
-    data->url = g_strdup (url);
-    data->filename = filename;
-    data->callback = callback;
-    data->user_data = user_data;
+/**
+ * sw_web_set_revalidate_interval:
+ * @seconds: the interval
+ *
+ * Set how long downloaded images are used before checking whether they have
+ * changed.
+ */
+void
+sw_web_set_revalidate_interval (guint seconds)
+{
+  revalidate_interval = seconds;
+}
+
+#if BUILD_TESTS
+#include "test-runner.h"
+
+static Download *
+make_test_download (const char *url, const char *host)
+{
+  Download *download;
 
-    msg = soup_message_new (SOUP_METHOD_GET, url);
-    soup_session_queue_message (session, msg, async_download_cb, data);
+  download = g_slice_new0 (Download);
+  download->url = g_strdup (url);
+  download->host = g_strdup (host);
+
+  g_queue_push_tail (&download_queue, download);
+
+  return download;
+}
+
+void
+test_web_download_queue (void)
+{
+  Download *download;
+  int i;
+
+  host_running = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  make_test_download ("http://a/1", "a");
+  make_test_download ("http://a/2", "a");
+  make_test_download ("http://a/3", "a");
+  make_test_download ("http://b/1", "b");
+
+  /* Limited per host, so the third from a is skipped for b */
+  for (i = 0; i < MAX_DOWNLOADS_PER_HOST; i++) {
+    download = pop_startable_download ();
+    g_assert_cmpstr (download->host, ==, "a");
+    set_host_running ("a", get_host_running ("a") + 1);
+    download_free (download);
   }
+  download = pop_startable_download ();
+  g_assert_cmpstr (download->url, ==, "http://b/1");
+  download_free (download);
+  g_assert (pop_startable_download () == NULL);
+
+  /* Once one from a finishes, the next one can start */
+  set_host_running ("a", get_host_running ("a") - 1);
+  download = pop_startable_download ();
+  g_assert_cmpstr (download->url, ==, "http://a/3");
+  download_free (download);
+
+  /* And nothing starts when the global limit is reached */
+  make_test_download ("http://c/1", "c");
+  n_running = MAX_DOWNLOADS;
+  g_assert (pop_startable_download () == NULL);
+  n_running = 0;
+
+  download_free (g_queue_pop_head (&download_queue));
+  g_assert (g_queue_is_empty (&download_queue));
+
+  g_hash_table_destroy (host_running);
+  host_running = NULL;
 }
+#endif
@@ -36,3 +36,10 @@ typedef void (*ImageDownloadCallback) (const char *url,
 void sw_web_download_image_async (const char            *url,
                                   ImageDownloadCallback  callback,
                                   gpointer               user_data);
+
+void sw_web_get_download_counts (guint *running,
+                                 guint *queued);
+
+void sw_web_set_max_image_size (gsize size);
+
+void sw_web_set_revalidate_interval (guint seconds);
@@ -50,9 +50,38 @@ main (int argc, char *argv[])
   test_add ("/set/is_empty", test_set_is_empty);
   test_add ("/set/foreach_remove", test_set_foreach_remove);
   test_add ("/set/set_basics", test_set_basics);
+  test_add ("/set/diff", test_set_diff);
+  test_add ("/set/iter", test_set_iter);
+
+  test_add ("/item/slots", test_item_slots);
+  test_add ("/item/date", test_item_date);
+  test_add ("/item/dirty", test_item_dirty);
 
   test_add ("/cache/absolute", test_cache_absolute);
   test_add ("/cache/relative", test_cache_relative);
+  test_add ("/cache/binary", test_cache_binary);
+  test_add ("/cache/digest", test_cache_digest);
+  test_add ("/cache/journal", test_cache_journal);
+  test_add ("/cache/index", test_cache_index);
+  test_add ("/cache/unwritten", test_cache_unwritten);
+  test_add ("/thumbnails/victims", test_thumbnails_victims);
+  test_add ("/thumbnails/last-check", test_thumbnails_last_check);
+  test_add ("/web/download-queue", test_web_download_queue);
+  test_add ("/poll-scheduler/slots", test_poll_scheduler_slots);
+  test_add ("/poll-scheduler/soon", test_poll_scheduler_soon);
+  test_add ("/poll-scheduler/interval", test_poll_scheduler_interval);
+  test_add ("/item-view/order", test_item_view_order);
+  test_add ("/item-view/window", test_item_view_window);
+  test_add ("/item-view/clients", test_item_view_clients);
+  test_add ("/item-view/change-modes", test_item_view_change_modes);
+  test_add ("/item-view/same-client", test_item_view_same_client);
+  test_add ("/view-multiplexer/share", test_view_multiplexer_share);
+  test_add ("/client-monitor/gone", test_client_monitor_gone);
+  test_add ("/request-governor/bucket", test_request_governor_bucket);
+  test_add ("/request-governor/coalesce", test_request_governor_coalesce);
+  test_add ("/online/debounce", test_online_debounce);
+  test_add ("/online/release", test_online_release);
+  test_add ("/utils/time-parse", test_utils_time_parse);
 
   return g_test_run ();
 }
@@ -33,6 +33,7 @@
 #include <libsocialweb/sw-contact.h>
 #include <libsocialweb/sw-set.h>
 #include <libsocialweb/sw-cache.h>
+#include <libsocialweb/sw-poll-scheduler.h>
 
 #include <rest/rest-proxy.h>
 #include <rest/rest-xml-parser.h>
@@ -480,8 +481,15 @@ facebook_contact_view_finalize (GObject *self)
 static gboolean
 _update_timeout_cb (gpointer user_data)
 {
+   SwFacebookContactViewPrivate *priv = GET_PRIVATE (user_data);
+   guint interval;
+
    get_updates ((SwContactView *) user_data);
 
+   /* Refresh more or less often depending on how much is changing */
+   interval = sw_contact_view_get_refresh_interval ((SwContactView *) user_data);
+   sw_poll_scheduler_set_interval (priv->running, interval);
+
    return TRUE;
 }
 
@@ -498,7 +506,8 @@ facebook_contact_view_start (SwContactView *self)
     {
       SW_DEBUG (FACEBOOK, "Starting up the Facebook view");
 
-      priv->running = g_timeout_add_seconds (UPDATE_TIMEOUT,
+      priv->running = sw_poll_scheduler_add (sw_contact_view_get_service (self),
+                                             UPDATE_TIMEOUT,
                                              _update_timeout_cb,
                                              self);
 
@@ -520,7 +529,7 @@ facebook_contact_view_stop (SwContactView *self)
     {
       SW_DEBUG (FACEBOOK, "Stopping the Facebook view");
 
-      g_source_remove (priv->running);
+      sw_poll_scheduler_remove (priv->running);
       priv->running = 0;
     }
 
@@ -31,6 +31,7 @@
 #include <libsocialweb/sw-item.h>
 #include <libsocialweb/sw-set.h>
 #include <libsocialweb/sw-cache.h>
+#include <libsocialweb/sw-poll-scheduler.h>
 
 #include <rest/rest-proxy.h>
 #include <rest/rest-xml-parser.h>
@@ -398,19 +399,8 @@ static void
 load_from_cache (SwItemView *self)
 {
   SwFacebookItemViewPrivate *priv = GET_PRIVATE (self);
-  SwSet *set;
-
-  set = sw_cache_load (sw_item_view_get_service (self),
-                       priv->query,
-                       priv->params,
-                       sw_item_set_new);
-
-  if (set != NULL)
-    {
-      sw_item_view_set_from_set (self, set);
 
-      sw_set_unref (set);
-    }
+  sw_item_view_load_from_cache (self, priv->query, priv->params);
 }
 
 static void
@@ -451,6 +441,9 @@ static void
 facebook_item_view_constructed (GObject *self)
 {
   SwService *service = sw_item_view_get_service ((SwItemView *) self);
+  SwFacebookItemViewPrivate *priv = GET_PRIVATE (self);
+
+  sw_item_view_set_max_items_from_params ((SwItemView *) self, priv->params);
 
   g_signal_connect_object (service, "item-hidden",
                     G_CALLBACK (_service_item_hidden), self, 0);
@@ -546,8 +539,15 @@ facebook_item_view_finalize (GObject *self)
 static gboolean
 _update_timeout_cb (gpointer user_data)
 {
+   SwFacebookItemViewPrivate *priv = GET_PRIVATE (user_data);
+   guint interval;
+
    get_status_updates ((SwItemView *) user_data);
 
+   /* Refresh more or less often depending on how much is changing */
+   interval = sw_item_view_get_refresh_interval ((SwItemView *) user_data);
+   sw_poll_scheduler_set_interval (priv->running, interval);
+
    return TRUE;
 }
 
@@ -564,7 +564,8 @@ facebook_item_view_start (SwItemView *self)
     {
       SW_DEBUG (FACEBOOK, "Starting up the Facebook view");
 
-      priv->running = g_timeout_add_seconds (UPDATE_TIMEOUT,
+      priv->running = sw_poll_scheduler_add (sw_item_view_get_service (self),
+                                             UPDATE_TIMEOUT,
                                              _update_timeout_cb,
                                              self);
 
@@ -586,7 +587,7 @@ facebook_item_view_stop (SwItemView *self)
     {
       SW_DEBUG (FACEBOOK, "Stopping the Facebook view");
 
-      g_source_remove (priv->running);
+      sw_poll_scheduler_remove (priv->running);
       priv->running = 0;
     }
 
@@ -41,6 +41,7 @@
 #include <libsocialweb-keyfob/sw-keyfob.h>
 #include <libsocialweb/sw-online.h>
 #include <libsocialweb/sw-client-monitor.h>
+#include <libsocialweb/sw-view-multiplexer.h>
 #include <dbus/dbus-glib-lowlevel.h>
 
 #include <interfaces/sw-avatar-ginterface.h>
@@ -443,7 +444,8 @@ sw_service_facebook_initable (GInitable     *initable,
   if (sw_is_online ()) {
     online_notify (TRUE, facebook);
   }
-  sw_online_add_notify (online_notify, facebook);
+  sw_online_add_notify_full (online_notify, facebook,
+                             SW_ONLINE_PRIORITY_INTERACTIVE);
 
   priv->inited = TRUE;
 
@@ -515,18 +517,18 @@ _facebook_query_open_view (SwQueryIface          *self,
 
   g_debug ("query = '%s'", query);
 
-  item_view = g_object_new (SW_TYPE_FACEBOOK_ITEM_VIEW,
-                            "service", self,
-                            "proxy", priv->proxy,
-                            "query", query,
-                            "params", params,
-                            NULL);
+  item_view = (SwItemView *)sw_view_multiplexer_open (SW_SERVICE (self),
+                                                      query,
+                                                      params,
+                                                      dbus_g_method_get_sender (context),
+                                                      SW_TYPE_FACEBOOK_ITEM_VIEW,
+                                                      "service", self,
+                                                      "proxy", priv->proxy,
+                                                      "query", query,
+                                                      "params", params,
+                                                      NULL);
   object_path = sw_item_view_get_object_path (item_view);
 
-  /* Ensure the object gets disposed when the client goes away */
-  sw_client_monitor_add (dbus_g_method_get_sender (context),
-                         (GObject *) item_view);
-
   sw_query_iface_return_from_open_view (context, object_path);
 }
 
@@ -34,6 +34,7 @@
 #include <libsocialweb/sw-contact.h>
 #include <libsocialweb-keyfob/sw-keyfob.h>
 #include <libsocialweb/sw-cache.h>
+#include <libsocialweb/sw-poll-scheduler.h>
 
 #include <rest-extras/flickr-proxy.h>
 #include "flickr-contact-view.h"
@@ -130,7 +131,7 @@ sw_flickr_contact_view_dispose (GObject *object)
 
   if (priv->timeout_id)
   {
-    g_source_remove (priv->timeout_id);
+    sw_poll_scheduler_remove (priv->timeout_id);
     priv->timeout_id = 0;
   }
 
@@ -317,9 +318,15 @@ static gboolean
 _update_timeout_cb (gpointer data)
 {
   SwFlickrContactView *contact_view = SW_FLICKR_CONTACT_VIEW (data);
+  SwFlickrContactViewPrivate *priv = GET_PRIVATE (contact_view);
+  guint interval;
 
   _get_status_updates (contact_view);
 
+  /* Refresh more or less often depending on how much is changing */
+  interval = sw_contact_view_get_refresh_interval (SW_CONTACT_VIEW (contact_view));
+  sw_poll_scheduler_set_interval (priv->timeout_id, interval);
+
   return TRUE;
 }
 
@@ -351,7 +358,8 @@ flickr_contact_view_start (SwContactView *contact_view)
   {
     g_warning (G_STRLOC ": View already started.");
   } else {
-    priv->timeout_id = g_timeout_add_seconds (UPDATE_TIMEOUT,
+    priv->timeout_id = sw_poll_scheduler_add (sw_contact_view_get_service (contact_view),
+                                              UPDATE_TIMEOUT,
                                               (GSourceFunc)_update_timeout_cb,
                                               contact_view);
     _load_from_cache ((SwFlickrContactView *)contact_view);
@@ -368,7 +376,7 @@ flickr_contact_view_stop (SwContactView *contact_view)
   {
     g_warning (G_STRLOC ": View not running");
   } else {
-    g_source_remove (priv->timeout_id);
+    sw_poll_scheduler_remove (priv->timeout_id);
     priv->timeout_id = 0;
   }
 }
@@ -404,17 +412,20 @@ _service_capabilities_changed_cb (SwService    *service,
 
   if (sw_service_has_cap (caps, CREDENTIALS_VALID))
   {
-    flickr_contact_view_refresh (contact_view);
     if (!priv->timeout_id)
     {
-      priv->timeout_id = g_timeout_add_seconds (UPDATE_TIMEOUT,
+      priv->timeout_id = sw_poll_scheduler_add (sw_contact_view_get_service (contact_view),
+                                                UPDATE_TIMEOUT,
                                                 (GSourceFunc)_update_timeout_cb,
                                                 contact_view);
     }
+
+    /* Take turns with the other views that can refresh now */
+    sw_poll_scheduler_poll_soon (priv->timeout_id);
   } else {
     if (priv->timeout_id)
     {
-      g_source_remove (priv->timeout_id);
+      sw_poll_scheduler_remove (priv->timeout_id);
       priv->timeout_id = 0;
     }
   }
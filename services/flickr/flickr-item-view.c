@@ -32,6 +32,7 @@
 #include <libsocialweb/sw-item.h>
 #include <libsocialweb-keyfob/sw-keyfob.h>
 #include <libsocialweb/sw-cache.h>
+#include <libsocialweb/sw-poll-scheduler.h>
 
 #include <rest-extras/flickr-proxy.h>
 #include "flickr-item-view.h"
@@ -131,7 +132,7 @@ sw_flickr_item_view_dispose (GObject *object)
 
   if (priv->timeout_id)
   {
-    g_source_remove (priv->timeout_id);
+    sw_poll_scheduler_remove (priv->timeout_id);
     priv->timeout_id = 0;
   }
 
@@ -257,7 +258,7 @@ _flickr_item_from_from_photo_node (SwServiceFlickr *service,
   sw_item_put (item, "x-flickr-photo-url", photo_url);
 
   date = atoi (rest_xml_node_get_attr (node, "dateupload"));
-  sw_item_take (item, "date", sw_time_t_to_string (date));
+  sw_item_set_date (item, date);
 
   photo_url = rest_xml_node_get_attr (node, "url_m");
   sw_item_request_image_fetch (item, TRUE, "thumbnail", photo_url);
@@ -423,9 +424,15 @@ static gboolean
 _update_timeout_cb (gpointer data)
 {
   SwFlickrItemView *item_view = SW_FLICKR_ITEM_VIEW (data);
+  SwFlickrItemViewPrivate *priv = GET_PRIVATE (item_view);
+  guint interval;
 
   _get_status_updates (item_view);
 
+  /* Refresh more or less often depending on how much is changing */
+  interval = sw_item_view_get_refresh_interval (SW_ITEM_VIEW (item_view));
+  sw_poll_scheduler_set_interval (priv->timeout_id, interval);
+
   return TRUE;
 }
 
@@ -433,19 +440,10 @@ static void
 _load_from_cache (SwFlickrItemView *item_view)
 {
   SwFlickrItemViewPrivate *priv = GET_PRIVATE (item_view);
-  SwSet *set;
 
-  set = sw_cache_load (sw_item_view_get_service (SW_ITEM_VIEW (item_view)),
-                       priv->query,
-                       priv->params,
-                       sw_item_set_new);
-
-  if (set)
-  {
-    sw_item_view_set_from_set (SW_ITEM_VIEW (item_view),
-                               set);
-    sw_set_unref (set);
-  }
+  sw_item_view_load_from_cache (SW_ITEM_VIEW (item_view),
+                                priv->query,
+                                priv->params);
 }
 
 static void
@@ -457,7 +455,8 @@ flickr_item_view_start (SwItemView *item_view)
   {
     g_warning (G_STRLOC ": View already started.");
   } else {
-    priv->timeout_id = g_timeout_add_seconds (UPDATE_TIMEOUT,
+    priv->timeout_id = sw_poll_scheduler_add (sw_item_view_get_service (item_view),
+                                              UPDATE_TIMEOUT,
                                               (GSourceFunc)_update_timeout_cb,
                                               item_view);
     _load_from_cache ((SwFlickrItemView *)item_view);
@@ -474,7 +473,7 @@ flickr_item_view_stop (SwItemView *item_view)
   {
     g_warning (G_STRLOC ": View not running");
   } else {
-    g_source_remove (priv->timeout_id);
+    sw_poll_scheduler_remove (priv->timeout_id);
     priv->timeout_id = 0;
   }
 }
@@ -518,17 +517,20 @@ _service_capabilities_changed_cb (SwService    *service,
 
   if (sw_service_has_cap (caps, CREDENTIALS_VALID))
   {
-    flickr_item_view_refresh (item_view);
     if (!priv->timeout_id)
     {
-      priv->timeout_id = g_timeout_add_seconds (UPDATE_TIMEOUT,
+      priv->timeout_id = sw_poll_scheduler_add (sw_item_view_get_service (item_view),
+                                                UPDATE_TIMEOUT,
                                                 (GSourceFunc)_update_timeout_cb,
                                                 item_view);
     }
+
+    /* Take turns with the other views that can refresh now */
+    sw_poll_scheduler_poll_soon (priv->timeout_id);
   } else {
     if (priv->timeout_id)
     {
-      g_source_remove (priv->timeout_id);
+      sw_poll_scheduler_remove (priv->timeout_id);
       priv->timeout_id = 0;
     }
   }
@@ -538,6 +540,9 @@ static void
 sw_flickr_item_view_constructed (GObject *object)
 {
   SwItemView *item_view = SW_ITEM_VIEW (object);
+  SwFlickrItemViewPrivate *priv = GET_PRIVATE (object);
+
+  sw_item_view_set_max_items_from_params (item_view, priv->params);
 
   g_signal_connect (sw_item_view_get_service (item_view),
                     "item-hidden",
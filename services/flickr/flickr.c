@@ -33,6 +33,7 @@
 #include <libsocialweb-keystore/sw-keystore.h>
 #include <libsocialweb-keyfob/sw-keyfob.h>
 #include <libsocialweb/sw-client-monitor.h>
+#include <libsocialweb/sw-view-multiplexer.h>
 
 #include <rest-extras/flickr-proxy.h>
 #include <rest/rest-xml-parser.h>
@@ -305,7 +306,8 @@ sw_service_flickr_initable (GInitable    *initable,
 
   priv->proxy = flickr_proxy_new (key, secret);
 
-  sw_online_add_notify (online_notify, flickr);
+  sw_online_add_notify_full (online_notify, flickr,
+                             SW_ONLINE_PRIORITY_BACKGROUND);
 
   priv->inited = TRUE;
 
@@ -365,16 +367,16 @@ _flickr_query_open_view (SwQueryIface          *self,
     return;
   }
 
-  item_view = g_object_new (SW_TYPE_FLICKR_ITEM_VIEW,
-                            "proxy", priv->proxy,
-                            "service", self,
-                            "query", query,
-                            "params", params,
-                            NULL);
-
-  /* Ensure the object gets disposed when the client goes away */
-  sw_client_monitor_add (dbus_g_method_get_sender (context),
-                         (GObject *)item_view);
+  item_view = (SwItemView *)sw_view_multiplexer_open (SW_SERVICE (self),
+                                                      query,
+                                                      params,
+                                                      dbus_g_method_get_sender (context),
+                                                      SW_TYPE_FLICKR_ITEM_VIEW,
+                                                      "proxy", priv->proxy,
+                                                      "service", self,
+                                                      "query", query,
+                                                      "params", params,
+                                                      NULL);
 
   object_path = sw_item_view_get_object_path (item_view);
   sw_query_iface_return_from_open_view (context,
@@ -30,6 +30,7 @@
 #include <libsocialweb/sw-debug.h>
 #include <libsocialweb/sw-contact.h>
 #include <libsocialweb/sw-cache.h>
+#include <libsocialweb/sw-poll-scheduler.h>
 #include <libsocialweb/sw-call-list.h>
 
 #include <libsocialweb-keystore/sw-keystore.h>
@@ -138,7 +139,7 @@ sw_lastfm_contact_view_dispose (GObject *object)
 
   if (priv->timeout_id)
   {
-    g_source_remove (priv->timeout_id);
+    sw_poll_scheduler_remove (priv->timeout_id);
     priv->timeout_id = 0;
   }
 
@@ -525,9 +526,15 @@ static gboolean
 _update_timeout_cb (gpointer data)
 {
   SwLastfmContactView *contact_view = SW_LASTFM_CONTACT_VIEW (data);
+  SwLastfmContactViewPrivate *priv = GET_PRIVATE (contact_view);
+  guint interval;
 
   _get_updates (contact_view);
 
+  /* Refresh more or less often depending on how much is changing */
+  interval = sw_contact_view_get_refresh_interval (SW_CONTACT_VIEW (contact_view));
+  sw_poll_scheduler_set_interval (priv->timeout_id, interval);
+
   return TRUE;
 }
 
@@ -560,7 +567,8 @@ lastfm_contact_view_start (SwContactView *contact_view)
     g_warning (G_STRLOC ": View already started.");
   } else {
     SW_DEBUG (LASTFM, G_STRLOC ": Setting up the timeout");
-    priv->timeout_id = g_timeout_add_seconds (UPDATE_TIMEOUT,
+    priv->timeout_id = sw_poll_scheduler_add (sw_contact_view_get_service (contact_view),
+                                              UPDATE_TIMEOUT,
                                               (GSourceFunc)_update_timeout_cb,
                                               contact_view);
 
@@ -578,7 +586,7 @@ lastfm_contact_view_stop (SwContactView *contact_view)
   {
     g_warning (G_STRLOC ": View not running");
   } else {
-    g_source_remove (priv->timeout_id);
+    sw_poll_scheduler_remove (priv->timeout_id);
     priv->timeout_id = 0;
   }
 }
@@ -614,17 +622,20 @@ _service_capabilities_changed_cb (SwService    *service,
 
   if (sw_service_has_cap (caps, CREDENTIALS_VALID))
   {
-    lastfm_contact_view_refresh (contact_view);
     if (!priv->timeout_id)
     {
-      priv->timeout_id = g_timeout_add_seconds (UPDATE_TIMEOUT,
+      priv->timeout_id = sw_poll_scheduler_add (sw_contact_view_get_service (contact_view),
+                                                UPDATE_TIMEOUT,
                                                 (GSourceFunc)_update_timeout_cb,
                                                 contact_view);
     }
+
+    /* Take turns with the other views that can refresh now */
+    sw_poll_scheduler_poll_soon (priv->timeout_id);
   } else {
     if (priv->timeout_id)
     {
-      g_source_remove (priv->timeout_id);
+      sw_poll_scheduler_remove (priv->timeout_id);
       priv->timeout_id = 0;
     }
 
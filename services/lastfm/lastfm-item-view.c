@@ -29,6 +29,7 @@
 #include <libsocialweb/sw-debug.h>
 #include <libsocialweb/sw-item.h>
 #include <libsocialweb/sw-cache.h>
+#include <libsocialweb/sw-poll-scheduler.h>
 #include <libsocialweb/sw-call-list.h>
 
 #include <libsocialweb-keystore/sw-keystore.h>
@@ -140,7 +141,7 @@ sw_lastfm_item_view_dispose (GObject *object)
 
   if (priv->timeout_id)
   {
-    g_source_remove (priv->timeout_id);
+    sw_poll_scheduler_remove (priv->timeout_id);
     priv->timeout_id = 0;
   }
 
@@ -392,10 +393,10 @@ make_item (SwLastfmItemView *item_view,
 
   date = rest_xml_node_find (track, "date");
   if (date) {
-    sw_item_take (item, "date", sw_time_t_to_string (atoi (rest_xml_node_get_attr (date, "uts"))));
+    sw_item_set_date (item, atoi (rest_xml_node_get_attr (date, "uts")));
   } else {
     /* No date means it's a now-playing item, so use now at the timestamp */
-    sw_item_take (item, "date", sw_time_t_to_string (time (NULL)));
+    sw_item_set_date (item, time (NULL));
   }
 
   s = rest_xml_node_find (user, "realname")->content;
@@ -569,9 +570,15 @@ static gboolean
 _update_timeout_cb (gpointer data)
 {
   SwLastfmItemView *item_view = SW_LASTFM_ITEM_VIEW (data);
+  SwLastfmItemViewPrivate *priv = GET_PRIVATE (item_view);
+  guint interval;
 
   _get_status_updates (item_view);
 
+  /* Refresh more or less often depending on how much is changing */
+  interval = sw_item_view_get_refresh_interval (SW_ITEM_VIEW (item_view));
+  sw_poll_scheduler_set_interval (priv->timeout_id, interval);
+
   return TRUE;
 }
 
@@ -579,19 +586,10 @@ static void
 _load_from_cache (SwLastfmItemView *item_view)
 {
   SwLastfmItemViewPrivate *priv = GET_PRIVATE (item_view);
-  SwSet *set;
 
-  set = sw_cache_load (sw_item_view_get_service (SW_ITEM_VIEW (item_view)),
-                       priv->query,
-                       priv->params,
-                       sw_item_set_new);
-
-  if (set)
-  {
-    sw_item_view_set_from_set (SW_ITEM_VIEW (item_view),
-                               set);
-    sw_set_unref (set);
-  }
+  sw_item_view_load_from_cache (SW_ITEM_VIEW (item_view),
+                                priv->query,
+                                priv->params);
 }
 
 static void
@@ -604,7 +602,8 @@ lastfm_item_view_start (SwItemView *item_view)
     g_warning (G_STRLOC ": View already started.");
   } else {
     SW_DEBUG (LASTFM, G_STRLOC ": Setting up the timeout");
-    priv->timeout_id = g_timeout_add_seconds (UPDATE_TIMEOUT,
+    priv->timeout_id = sw_poll_scheduler_add (sw_item_view_get_service (item_view),
+                                              UPDATE_TIMEOUT,
                                               (GSourceFunc)_update_timeout_cb,
                                               item_view);
 
@@ -622,7 +621,7 @@ lastfm_item_view_stop (SwItemView *item_view)
   {
     g_warning (G_STRLOC ": View not running");
   } else {
-    g_source_remove (priv->timeout_id);
+    sw_poll_scheduler_remove (priv->timeout_id);
     priv->timeout_id = 0;
   }
 }
@@ -666,17 +665,20 @@ _service_capabilities_changed_cb (SwService    *service,
 
   if (sw_service_has_cap (caps, CREDENTIALS_VALID))
   {
-    lastfm_item_view_refresh (item_view);
     if (!priv->timeout_id)
     {
-      priv->timeout_id = g_timeout_add_seconds (UPDATE_TIMEOUT,
+      priv->timeout_id = sw_poll_scheduler_add (sw_item_view_get_service (item_view),
+                                                UPDATE_TIMEOUT,
                                                 (GSourceFunc)_update_timeout_cb,
                                                 item_view);
     }
+
+    /* Take turns with the other views that can refresh now */
+    sw_poll_scheduler_poll_soon (priv->timeout_id);
   } else {
     if (priv->timeout_id)
     {
-      g_source_remove (priv->timeout_id);
+      sw_poll_scheduler_remove (priv->timeout_id);
       priv->timeout_id = 0;
     }
 
@@ -687,6 +689,9 @@ static void
 sw_lastfm_item_view_constructed (GObject *object)
 {
   SwItemView *item_view = SW_ITEM_VIEW (object);
+  SwLastfmItemViewPrivate *priv = GET_PRIVATE (object);
+
+  sw_item_view_set_max_items_from_params (item_view, priv->params);
 
   g_signal_connect (sw_item_view_get_service (item_view),
                     "item-hidden",
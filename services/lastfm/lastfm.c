@@ -32,6 +32,7 @@
 #include <libsocialweb/sw-debug.h>
 #include <libsocialweb-keystore/sw-keystore.h>
 #include <libsocialweb/sw-client-monitor.h>
+#include <libsocialweb/sw-view-multiplexer.h>
 
 #include <rest/rest-proxy.h>
 #include <rest/rest-xml-parser.h>
@@ -339,17 +340,16 @@ _lastfm_query_open_view (SwQueryIface          *self,
     return;
   }
 
-  item_view = g_object_new (SW_TYPE_LASTFM_ITEM_VIEW,
-                            "proxy", priv->proxy,
-                            "service", self,
-                            "query", query,
-                            "params", params,
-                            NULL);
-
-  /* Ensure the object gets disposed when the client goes away */
-  sw_client_monitor_add (dbus_g_method_get_sender (context),
-                         (GObject *)item_view);
-
+  item_view = (SwItemView *)sw_view_multiplexer_open (SW_SERVICE (self),
+                                                      query,
+                                                      params,
+                                                      dbus_g_method_get_sender (context),
+                                                      SW_TYPE_LASTFM_ITEM_VIEW,
+                                                      "proxy", priv->proxy,
+                                                      "service", self,
+                                                      "query", query,
+                                                      "params", params,
+                                                      NULL);
 
   object_path = sw_item_view_get_object_path (item_view);
   sw_query_iface_return_from_open_view (context,
@@ -951,7 +951,8 @@ sw_service_photobucket_initable (GInitable     *initable,
 
   oauth_proxy_set_signature_host (OAUTH_PROXY (priv->silo_proxy), url->host);
 
-  sw_online_add_notify (online_notify, self);
+  sw_online_add_notify_full (online_notify, self,
+                             SW_ONLINE_PRIORITY_BACKGROUND);
 
   refresh_credentials (self);
 
@@ -33,6 +33,7 @@
 #include <libsocialweb/sw-debug.h>
 #include <libsocialweb/sw-item.h>
 #include <libsocialweb/sw-cache.h>
+#include <libsocialweb/sw-poll-scheduler.h>
 
 #include "plurk-item-view.h"
 
@@ -148,7 +149,7 @@ sw_plurk_item_view_dispose (GObject *object)
 
   if (priv->timeout_id)
   {
-    g_source_remove (priv->timeout_id);
+    sw_poll_scheduler_remove (priv->timeout_id);
     priv->timeout_id = 0;
   }
 
@@ -266,20 +267,12 @@ base36_encode (const gchar *source)
   return encoded;
 }
 
-static char *
-make_date (const char *s)
-{
-  struct tm tm;
-  strptime (s, "%A, %d %h %Y %H:%M:%S GMT", &tm);
-  return sw_time_t_to_string (timegm (&tm));
-}
-
 static SwItem *
 make_item (SwService *service, JsonNode *plurk_node, JsonNode *plurk_users)
 {
   JsonNode *node;
   JsonObject *plurk, *user, *object;
-  char *uid, *pid, *url, *date, *base36, *content;
+  char *uid, *pid, *url, *base36, *content;
   const char *name, *qualifier;
   gint64 id, avatar, has_profile;
   SwItem *item;
@@ -333,8 +326,8 @@ make_item (SwService *service, JsonNode *plurk_node, JsonNode *plurk_users)
   sw_item_take (item, "content", content);
 
   /* Get the post date of this plurk*/
-  date = make_date (json_object_get_string_member (plurk, "posted"));
-  sw_item_take (item, "date", date);
+  sw_item_set_date (item,
+                    sw_time_t_from_string (json_object_get_string_member (plurk, "posted")));
 
   /* Construt the link of the user */
   base36 = base36_encode (pid);
@@ -434,9 +427,15 @@ static gboolean
 _update_timeout_cb (gpointer data)
 {
   SwPlurkItemView *item_view = SW_PLURK_ITEM_VIEW (data);
+  SwPlurkItemViewPrivate *priv = GET_PRIVATE (item_view);
+  guint interval;
 
   _get_status_updates (item_view);
 
+  /* Refresh more or less often depending on how much is changing */
+  interval = sw_item_view_get_refresh_interval (SW_ITEM_VIEW (item_view));
+  sw_poll_scheduler_set_interval (priv->timeout_id, interval);
+
   return TRUE;
 }
 
@@ -444,19 +443,10 @@ static void
 _load_from_cache (SwPlurkItemView *item_view)
 {
   SwPlurkItemViewPrivate *priv = GET_PRIVATE (item_view);
-  SwSet *set;
 
-  set = sw_cache_load (sw_item_view_get_service (SW_ITEM_VIEW (item_view)),
-                       priv->query,
-                       priv->params,
-                       sw_item_set_new);
-
-  if (set)
-  {
-    sw_item_view_set_from_set (SW_ITEM_VIEW (item_view),
-                               set);
-    sw_set_unref (set);
-  }
+  sw_item_view_load_from_cache (SW_ITEM_VIEW (item_view),
+                                priv->query,
+                                priv->params);
 }
 
 static void
@@ -468,7 +458,8 @@ plurk_item_view_start (SwItemView *item_view)
   {
     g_warning (G_STRLOC ": View already started.");
   } else {
-    priv->timeout_id = g_timeout_add_seconds (UPDATE_TIMEOUT,
+    priv->timeout_id = sw_poll_scheduler_add (sw_item_view_get_service (item_view),
+                                              UPDATE_TIMEOUT,
                                               (GSourceFunc)_update_timeout_cb,
                                               item_view);
     _load_from_cache ((SwPlurkItemView *)item_view);
@@ -485,7 +476,7 @@ plurk_item_view_stop (SwItemView *item_view)
   {
     g_warning (G_STRLOC ": View not running");
   } else {
-    g_source_remove (priv->timeout_id);
+    sw_poll_scheduler_remove (priv->timeout_id);
     priv->timeout_id = 0;
   }
 }
@@ -529,18 +520,20 @@ _service_capabilities_changed_cb (SwService    *service,
 
   if (sw_service_has_cap (caps, CREDENTIALS_VALID))
   {
-    plurk_item_view_refresh (item_view);
-
     if (!priv->timeout_id)
     {
-      priv->timeout_id = g_timeout_add_seconds (UPDATE_TIMEOUT,
+      priv->timeout_id = sw_poll_scheduler_add (sw_item_view_get_service (item_view),
+                                                UPDATE_TIMEOUT,
                                                 (GSourceFunc)_update_timeout_cb,
                                                 item_view);
     }
+
+    /* Take turns with the other views that can refresh now */
+    sw_poll_scheduler_poll_soon (priv->timeout_id);
   } else {
     if (priv->timeout_id)
     {
-      g_source_remove (priv->timeout_id);
+      sw_poll_scheduler_remove (priv->timeout_id);
       priv->timeout_id = 0;
     }
   }
@@ -550,6 +543,9 @@ static void
 sw_plurk_item_view_constructed (GObject *object)
 {
   SwItemView *item_view = SW_ITEM_VIEW (object);
+  SwPlurkItemViewPrivate *priv = GET_PRIVATE (object);
+
+  sw_item_view_set_max_items_from_params (item_view, priv->params);
 
   g_signal_connect (sw_item_view_get_service (item_view),
                     "item-hidden",
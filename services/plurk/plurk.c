@@ -37,6 +37,7 @@
 #include <libsocialweb-keyfob/sw-keyfob.h>
 #include <libsocialweb-keystore/sw-keystore.h>
 #include <libsocialweb/sw-client-monitor.h>
+#include <libsocialweb/sw-view-multiplexer.h>
 
 #include <rest/rest-xml-parser.h>
 #include <libsoup/soup.h>
@@ -436,7 +437,8 @@ sw_service_plurk_initable (GInitable    *initable,
 
   priv->proxy = rest_proxy_new ("http://www.plurk.com/API/", FALSE);
 
-  sw_online_add_notify (online_notify, plurk);
+  sw_online_add_notify_full (online_notify, plurk,
+                             SW_ONLINE_PRIORITY_INTERACTIVE);
 
   refresh_credentials (plurk);
 
@@ -493,18 +495,19 @@ _plurk_query_open_view (SwQueryIface          *self,
     return;
   }
 
-  item_view = g_object_new (SW_TYPE_PLURK_ITEM_VIEW,
-                            "proxy", priv->proxy,
-                            "api_key", priv->api_key,
-                            "service", self,
-                            "query", query,
-                            "params", params,
-                            NULL);
+  item_view = (SwItemView *)sw_view_multiplexer_open (SW_SERVICE (self),
+                                                      query,
+                                                      params,
+                                                      dbus_g_method_get_sender (context),
+                                                      SW_TYPE_PLURK_ITEM_VIEW,
+                                                      "proxy", priv->proxy,
+                                                      "api_key", priv->api_key,
+                                                      "service", self,
+                                                      "query", query,
+                                                      "params", params,
+                                                      NULL);
 
   object_path = sw_item_view_get_object_path (item_view);
-  /* Ensure the object gets disposed when the client goes away */
-  sw_client_monitor_add (dbus_g_method_get_sender (context),
-                         (GObject *)item_view);
   sw_query_iface_return_from_open_view (context,
                                         object_path);
 }
@@ -33,6 +33,9 @@
 #include <libsocialweb/sw-debug.h>
 #include <libsocialweb/sw-item.h>
 #include <libsocialweb/sw-cache.h>
+#include <libsocialweb/sw-call-list.h>
+#include <libsocialweb/sw-poll-scheduler.h>
+#include <libsocialweb/sw-request-governor.h>
 
 #include "sina-item-view.h"
 
@@ -50,6 +53,9 @@ struct _SwSinaItemViewPrivate {
   guint timeout_id;
   GHashTable *params;
   gchar *query;
+  /* The calls of the refresh in progress, and what they have found so far */
+  SwCallList *calls;
+  SwSet *set;
 };
 
 enum
@@ -133,10 +139,20 @@ sw_sina_item_view_dispose (GObject *object)
   }
 
   if (priv->timeout_id) {
-    g_source_remove (priv->timeout_id);
+    sw_poll_scheduler_remove (priv->timeout_id);
     priv->timeout_id = 0;
   }
 
+  if (priv->calls) {
+    sw_call_list_free (priv->calls);
+    priv->calls = NULL;
+  }
+
+  if (priv->set) {
+    sw_set_unref (priv->set);
+    priv->set = NULL;
+  }
+
   g_signal_handlers_disconnect_by_func (sw_item_view_get_service (item_view),
                                         _service_item_hidden_cb,
                                         item_view);
@@ -286,7 +302,7 @@ _populate_set_from_node (SwService   *service,
   }
 }
 
-static void _get_user_status_updates (SwSinaItemView *item_view, SwSet *set);
+static void _get_user_status_updates (SwSinaItemView *item_view);
 
 static void
 _got_user_status_cb (RestProxyCall *call,
@@ -296,10 +312,11 @@ _got_user_status_cb (RestProxyCall *call,
 {
   SwSinaItemView *item_view = SW_SINA_ITEM_VIEW (weak_object);
   SwSinaItemViewPrivate *priv = GET_PRIVATE (item_view);
-  SwSet *set = (SwSet *)userdata;
   RestXmlNode *root;
   SwService *service;
 
+  sw_call_list_remove (priv->calls, call);
+
   if (error) {
     g_message ("Error: %s", error->message);
     return;
@@ -308,20 +325,19 @@ _got_user_status_cb (RestProxyCall *call,
   service = sw_item_view_get_service (SW_ITEM_VIEW (item_view));
 
   root = xml_node_from_call (call, "Sina");
-  _populate_set_from_node (service, set, root);
+  _populate_set_from_node (service, priv->set, root);
   rest_xml_node_unref (root);
 
-  g_object_unref (call);
-
-  sw_item_view_set_from_set (SW_ITEM_VIEW (item_view), set);
+  sw_item_view_set_from_set (SW_ITEM_VIEW (item_view), priv->set);
 
   /* Save the results of this set to the cache */
   sw_cache_save (service,
                  priv->query,
                  priv->params,
-                 set);
+                 priv->set);
 
-  sw_set_unref (set);
+  sw_set_unref (priv->set);
+  priv->set = NULL;
 }
 
 static void
@@ -331,10 +347,12 @@ _got_friends_status_cb (RestProxyCall *call,
                         gpointer       userdata)
 {
   SwSinaItemView *item_view = SW_SINA_ITEM_VIEW (weak_object);
-  SwSet *set = (SwSet *)userdata;
+  SwSinaItemViewPrivate *priv = GET_PRIVATE (item_view);
   RestXmlNode *root;
   SwService *service;
 
+  sw_call_list_remove (priv->calls, call);
+
   if (error) {
     g_message ("Error: %s", error->message);
     return;
@@ -343,17 +361,38 @@ _got_friends_status_cb (RestProxyCall *call,
   service = sw_item_view_get_service (SW_ITEM_VIEW (item_view));
 
   root = xml_node_from_call (call, "sina");
-  _populate_set_from_node (service, set, root);
+  _populate_set_from_node (service, priv->set, root);
   rest_xml_node_unref (root);
 
-  g_object_unref (call);
+  _get_user_status_updates (item_view);
+}
+
+/*
+ * Make @call for the refresh in progress, calling @callback when it is done.
+ */
+static void
+_make_call (SwSinaItemView             *item_view,
+            RestProxyCall              *call,
+            RestProxyCallAsyncCallback  callback)
+{
+  SwSinaItemViewPrivate *priv = GET_PRIVATE (item_view);
+  SwService *service;
+
+  sw_call_list_add (priv->calls, call);
 
-  _get_user_status_updates (item_view, set);
+  service = sw_item_view_get_service (SW_ITEM_VIEW (item_view));
+  sw_request_governor_call_async (service,
+                                  SW_REQUEST_PRIORITY_REFRESH,
+                                  call,
+                                  callback,
+                                  (GObject*)item_view,
+                                  NULL,
+                                  NULL);
+  g_object_unref (call);
 }
 
 static void
-_get_user_status_updates (SwSinaItemView *item_view,
-                          SwSet          *set)
+_get_user_status_updates (SwSinaItemView *item_view)
 {
   SwSinaItemViewPrivate *priv = GET_PRIVATE (item_view);
   RestProxyCall *call;
@@ -363,12 +402,12 @@ _get_user_status_updates (SwSinaItemView *item_view,
   rest_proxy_call_add_params(call,
                              "count", "10",
                              NULL);
-  rest_proxy_call_async (call, _got_user_status_cb, (GObject*)item_view, set, NULL);
+
+  _make_call (item_view, call, _got_user_status_cb);
 }
 
 static void
-_get_friends_status_updates (SwSinaItemView *item_view,
-                             SwSet          *set)
+_get_friends_status_updates (SwSinaItemView *item_view)
 {
   SwSinaItemViewPrivate *priv = GET_PRIVATE (item_view);
   RestProxyCall *call;
@@ -378,21 +417,28 @@ _get_friends_status_updates (SwSinaItemView *item_view,
   rest_proxy_call_add_params(call,
                              "count", "10",
                              NULL);
-  rest_proxy_call_async (call, _got_friends_status_cb, (GObject*)item_view, set, NULL);
+
+  _make_call (item_view, call, _got_friends_status_cb);
 }
 
 static void
 _get_status_updates (SwSinaItemView *item_view)
 {
   SwSinaItemViewPrivate *priv = GET_PRIVATE (item_view);
-  SwSet *set;
 
-  set = sw_item_set_new ();
+  /*
+   * Start again rather than queueing another refresh behind one that hasn't
+   * finished, which may still be waiting for the rate limit.
+   */
+  sw_call_list_cancel_all (priv->calls);
+  if (priv->set)
+    sw_set_unref (priv->set);
+  priv->set = sw_item_set_new ();
 
   if (g_str_equal (priv->query, "own"))
-    _get_user_status_updates (item_view, set);
+    _get_user_status_updates (item_view);
   else if (g_str_equal (priv->query, "feed"))
-    _get_friends_status_updates (item_view, set);
+    _get_friends_status_updates (item_view);
   else
     g_error (G_STRLOC ": Unexpected query '%s'", priv->query);
 }
@@ -401,9 +447,15 @@ static gboolean
 _update_timeout_cb (gpointer data)
 {
   SwSinaItemView *item_view = SW_SINA_ITEM_VIEW (data);
+  SwSinaItemViewPrivate *priv = GET_PRIVATE (item_view);
+  guint interval;
 
   _get_status_updates (item_view);
 
+  /* Refresh more or less often depending on how much is changing */
+  interval = sw_item_view_get_refresh_interval (SW_ITEM_VIEW (item_view));
+  sw_poll_scheduler_set_interval (priv->timeout_id, interval);
+
   return TRUE;
 }
 
@@ -411,19 +463,10 @@ static void
 _load_from_cache (SwSinaItemView *item_view)
 {
   SwSinaItemViewPrivate *priv = GET_PRIVATE (item_view);
-  SwSet *set;
-
-  set = sw_cache_load (sw_item_view_get_service (SW_ITEM_VIEW (item_view)),
-                       priv->query,
-                       priv->params,
-                       sw_item_set_new);
 
-  if (set)
-  {
-    sw_item_view_set_from_set (SW_ITEM_VIEW (item_view),
-                               set);
-    sw_set_unref (set);
-  }
+  sw_item_view_load_from_cache (SW_ITEM_VIEW (item_view),
+                                priv->query,
+                                priv->params);
 }
 
 static void
@@ -435,7 +478,8 @@ sina_item_view_start (SwItemView *item_view)
   {
     g_warning (G_STRLOC ": View already started.");
   } else {
-    priv->timeout_id = g_timeout_add_seconds (UPDATE_TIMEOUT,
+    priv->timeout_id = sw_poll_scheduler_add (sw_item_view_get_service (item_view),
+                                              UPDATE_TIMEOUT,
                                               (GSourceFunc)_update_timeout_cb,
                                               item_view);
     _load_from_cache ((SwSinaItemView *)item_view);
@@ -452,7 +496,7 @@ sina_item_view_stop (SwItemView *item_view)
   {
     g_warning (G_STRLOC ": View not running");
   } else {
-    g_source_remove (priv->timeout_id);
+    sw_poll_scheduler_remove (priv->timeout_id);
     priv->timeout_id = 0;
   }
 }
@@ -496,18 +540,20 @@ _service_capabilities_changed_cb (SwService    *service,
 
   if (sw_service_has_cap (caps, CREDENTIALS_VALID))
   {
-    sina_item_view_refresh (item_view);
-
     if (!priv->timeout_id)
     {
-      priv->timeout_id = g_timeout_add_seconds (UPDATE_TIMEOUT,
+      priv->timeout_id = sw_poll_scheduler_add (sw_item_view_get_service (item_view),
+                                                UPDATE_TIMEOUT,
                                                 (GSourceFunc)_update_timeout_cb,
                                                 item_view);
     }
+
+    /* Take turns with the other views that can refresh now */
+    sw_poll_scheduler_poll_soon (priv->timeout_id);
   } else {
     if (priv->timeout_id)
     {
-      g_source_remove (priv->timeout_id);
+      sw_poll_scheduler_remove (priv->timeout_id);
       priv->timeout_id = 0;
     }
   }
@@ -517,6 +563,9 @@ static void
 sw_sina_item_view_constructed (GObject *object)
 {
   SwItemView *item_view = SW_ITEM_VIEW (object);
+  SwSinaItemViewPrivate *priv = GET_PRIVATE (object);
+
+  sw_item_view_set_max_items_from_params (item_view, priv->params);
 
   g_signal_connect (sw_item_view_get_service (item_view),
                     "item-hidden",
@@ -581,5 +630,7 @@ sw_sina_item_view_class_init (SwSinaItemViewClass *klass)
 static void
 sw_sina_item_view_init (SwSinaItemView *self)
 {
-  /* Initialize private variables */
+  SwSinaItemViewPrivate *priv = GET_PRIVATE (self);
+
+  priv->calls = sw_call_list_new ();
 }
@@ -34,6 +34,9 @@
 #include <libsocialweb/sw-web.h>
 #include <libsocialweb/sw-debug.h>
 #include <libsocialweb/sw-client-monitor.h>
+#include <libsocialweb/sw-view-multiplexer.h>
+#include <libsocialweb/sw-request-governor.h>
+#include <libsocialweb/sw-poll-scheduler.h>
 #include <libsocialweb-keyfob/sw-keyfob.h>
 #include <libsocialweb-keystore/sw-keystore.h>
 
@@ -69,6 +72,12 @@ G_DEFINE_TYPE_WITH_CODE (SwServiceSina,
 #define GET_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((o), SW_TYPE_SERVICE_SINA, SwServiceSinaPrivate))
 
+/*
+ * Fewest seconds between polls of any one view. Sina allows 150 requests an
+ * hour, shared by every view and the user lookups.
+ */
+#define MIN_POLL_INTERVAL (3 * 60)
+
 struct _SwServiceSinaPrivate {
   gboolean inited;
   RestProxy *proxy;
@@ -367,7 +376,10 @@ sw_service_sina_initable (GInitable    *initable,
   }
   priv->proxy = oauth_proxy_new (key, secret, "http://api.t.sina.com.cn/", FALSE);
 
-  sw_online_add_notify (online_notify, sina);
+  sw_poll_scheduler_set_min_interval ((SwService *)sina, MIN_POLL_INTERVAL);
+
+  sw_online_add_notify_full (online_notify, sina,
+                             SW_ONLINE_PRIORITY_INTERACTIVE);
 
   refresh_credentials (sina);
 
@@ -423,17 +435,18 @@ _sina_query_open_view (SwQueryIface          *self,
     return;
   }
 
-  item_view = g_object_new (SW_TYPE_SINA_ITEM_VIEW,
-                            "proxy", priv->proxy,
-                            "service", self,
-                            "query", query,
-                            "params", params,
-                            NULL);
+  item_view = (SwItemView *)sw_view_multiplexer_open (SW_SERVICE (self),
+                                                      query,
+                                                      params,
+                                                      dbus_g_method_get_sender (context),
+                                                      SW_TYPE_SINA_ITEM_VIEW,
+                                                      "proxy", priv->proxy,
+                                                      "service", self,
+                                                      "query", query,
+                                                      "params", params,
+                                                      NULL);
 
   object_path = sw_item_view_get_object_path (item_view);
-  /* Ensure the object gets disposed when the client goes away */
-  sw_client_monitor_add (dbus_g_method_get_sender (context),
-                         (GObject *)item_view);
   sw_query_iface_return_from_open_view (context,
                                         object_path);
 }
@@ -524,7 +537,13 @@ _sina_status_update_update_status (SwStatusUpdateIface   *self,
                               "status", msg,
                               NULL);
 
-  rest_proxy_call_async (call, _update_status_cb, (GObject *)self, NULL, NULL);
+  sw_request_governor_call_async (SW_SERVICE (self),
+                                  SW_REQUEST_PRIORITY_INTERACTIVE,
+                                  call,
+                                  _update_status_cb,
+                                  (GObject *)self,
+                                  NULL,
+                                  NULL);
   sw_status_update_iface_return_from_update_status (context);
 }
 
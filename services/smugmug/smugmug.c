@@ -917,7 +917,8 @@ sw_service_smugmug_initable (GInitable     *initable,
 
   priv->auth_proxy = oauth_proxy_new (priv->api_key, priv->api_secret,
                                       OAUTH_URL, FALSE);
-  sw_online_add_notify (online_notify, self);
+  sw_online_add_notify_full (online_notify, self,
+                             SW_ONLINE_PRIORITY_BACKGROUND);
   refresh_credentials (self);
 
   return TRUE;
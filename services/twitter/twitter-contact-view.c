@@ -34,6 +34,8 @@
 #include <libsocialweb/sw-debug.h>
 #include <libsocialweb/sw-contact.h>
 #include <libsocialweb/sw-cache.h>
+#include <libsocialweb/sw-poll-scheduler.h>
+#include <libsocialweb/sw-request-governor.h>
 #include <libsocialweb/sw-call-list.h>
 #include <libsocialweb/sw-utils.h>
 
@@ -152,7 +154,7 @@ sw_twitter_contact_view_dispose (GObject *object)
 
   if (priv->timeout_id)
   {
-    g_source_remove (priv->timeout_id);
+    sw_poll_scheduler_remove (priv->timeout_id);
     priv->timeout_id = 0;
   }
 
@@ -285,7 +287,9 @@ _got_contacts_updates_cb (RestProxyCall *call,
   sw_call_list_remove (priv->calls, call);
 
   if (error) {
-    g_warning (G_STRLOC ": Error getting contacts: %s", error->message);
+    /* A newer lookup of the same ids replaced this one while it was waiting */
+    if (!g_error_matches (error, REST_PROXY_ERROR, REST_PROXY_ERROR_CANCELLED))
+      g_warning (G_STRLOC ": Error getting contacts: %s", error->message);
     return;
   }
 
@@ -379,11 +383,14 @@ _got_ids_cb (RestProxyCall *call,
                                   "user_id", ids,
                                   NULL);
 
-      rest_proxy_call_async (call,
-                             _got_contacts_updates_cb,
-                             (GObject *)contact_view,
-                             NULL,
-                             NULL);
+      /* Finish a refresh once it has started */
+      sw_request_governor_call_async (service,
+                                      SW_REQUEST_PRIORITY_REFRESH,
+                                      call,
+                                      _got_contacts_updates_cb,
+                                      (GObject *)contact_view,
+                                      NULL,
+                                      NULL);
       i = 0;
       g_free (ids);
       ids = NULL;
@@ -411,20 +418,24 @@ _get_ids (SwTwitterContactView *contact_view)
     g_error (G_STRLOC ": Unexpected query '%s", priv->query);
   }
 
-  sw_call_list_cancel_all (priv->calls);
-  sw_set_empty (priv->set);
-
   service = sw_contact_view_get_service (SW_CONTACT_VIEW (contact_view));
   username = sw_service_twitter_get_username (SW_SERVICE_TWITTER (service));
   rest_proxy_call_add_params (call,
                               "screen_name", username,
                               NULL);
 
-  rest_proxy_call_async (call,
-                         _got_ids_cb,
-                         (GObject*)contact_view,
-                         NULL,
-                         NULL);
+  /* Contacts change slowly, so skip this refresh if we are near the limit */
+  if (sw_request_governor_call_async (service,
+                                      SW_REQUEST_PRIORITY_BACKGROUND,
+                                      call,
+                                      _got_ids_cb,
+                                      (GObject*)contact_view,
+                                      NULL,
+                                      NULL))
+  {
+    sw_call_list_cancel_all (priv->calls);
+    sw_set_empty (priv->set);
+  }
 
   g_object_unref (call);
 }
@@ -433,9 +444,15 @@ static gboolean
 _update_timeout_cb (gpointer data)
 {
   SwTwitterContactView *contact_view = SW_TWITTER_CONTACT_VIEW (data);
+  SwTwitterContactViewPrivate *priv = GET_PRIVATE (contact_view);
+  guint interval;
 
   _get_ids (contact_view);
 
+  /* Refresh more or less often depending on how much is changing */
+  interval = sw_contact_view_get_refresh_interval (SW_CONTACT_VIEW (contact_view));
+  sw_poll_scheduler_set_interval (priv->timeout_id, interval);
+
   return TRUE;
 }
 
@@ -468,7 +485,8 @@ twitter_contact_view_start (SwContactView *contact_view)
     g_warning (G_STRLOC ": View already started.");
   } else {
     SW_DEBUG (TWITTER, G_STRLOC ": Setting up the timeout");
-    priv->timeout_id = g_timeout_add_seconds (UPDATE_TIMEOUT,
+    priv->timeout_id = sw_poll_scheduler_add (sw_contact_view_get_service (contact_view),
+                                              UPDATE_TIMEOUT,
                                               (GSourceFunc)_update_timeout_cb,
                                               contact_view);
 
@@ -486,7 +504,7 @@ twitter_contact_view_stop (SwContactView *contact_view)
   {
     g_warning (G_STRLOC ": View not running");
   } else {
-    g_source_remove (priv->timeout_id);
+    sw_poll_scheduler_remove (priv->timeout_id);
     priv->timeout_id = 0;
   }
 }
@@ -522,17 +540,20 @@ _service_capabilities_changed_cb (SwService    *service,
 
   if (sw_service_has_cap (caps, CREDENTIALS_VALID))
   {
-    twitter_contact_view_refresh (contact_view);
     if (!priv->timeout_id)
     {
-      priv->timeout_id = g_timeout_add_seconds (UPDATE_TIMEOUT,
+      priv->timeout_id = sw_poll_scheduler_add (sw_contact_view_get_service (contact_view),
+                                                UPDATE_TIMEOUT,
                                                 (GSourceFunc)_update_timeout_cb,
                                                 contact_view);
     }
+
+    /* Take turns with the other views that can refresh now */
+    sw_poll_scheduler_poll_soon (priv->timeout_id);
   } else {
     if (priv->timeout_id)
     {
-      g_source_remove (priv->timeout_id);
+      sw_poll_scheduler_remove (priv->timeout_id);
       priv->timeout_id = 0;
     }
   }
@@ -137,14 +137,6 @@ sw_twitter_item_stream_finalize (GObject *object)
   G_OBJECT_CLASS (sw_twitter_item_stream_parent_class)->finalize (object);
 }
 
-static char *
-_make_date (const char *s)
-{
-  struct tm tm;
-  strptime (s, "%a %b %d %T %z %Y", &tm);
-  return sw_time_t_to_string (timegm (&tm));
-}
-
 static SwItem *
 _create_item_from_node (JsonNode *node)
 {
@@ -179,9 +171,8 @@ _create_item_from_node (JsonNode *node)
                json_object_get_string_member (root_o, "text"));
 
 
-  sw_item_take (item,
-                "date",
-                _make_date (json_object_get_string_member (root_o, "created_at")));
+  sw_item_set_date (item,
+                    sw_time_t_from_string (json_object_get_string_member (root_o, "created_at")));
 
   if (json_object_has_member (user_o, "profile_image_url"))
   {
@@ -32,6 +32,8 @@
 #include <libsocialweb/sw-debug.h>
 #include <libsocialweb/sw-item.h>
 #include <libsocialweb/sw-cache.h>
+#include <libsocialweb/sw-poll-scheduler.h>
+#include <libsocialweb/sw-request-governor.h>
 #include <libsocialweb/sw-utils.h>
 
 #include "twitter-item-view.h"
@@ -137,7 +139,7 @@ sw_twitter_item_view_dispose (GObject *object)
 
   if (priv->timeout_id)
   {
-    g_source_remove (priv->timeout_id);
+    sw_poll_scheduler_remove (priv->timeout_id);
     priv->timeout_id = 0;
   }
 
@@ -166,14 +168,6 @@ sw_twitter_item_view_finalize (GObject *object)
   G_OBJECT_CLASS (sw_twitter_item_view_parent_class)->finalize (object);
 }
 
-static char *
-_make_date (const char *s)
-{
-  struct tm tm;
-  strptime (s, "%a %b %d %T %z %Y", &tm);
-  return sw_time_t_to_string (timegm (&tm));
-}
-
 /*
  * Remove trailing and leading whitespace and hyphens in an attempt to clean up
  * twitpic tweets.
@@ -260,7 +254,7 @@ _make_item (SwTwitterItemView *item_view,
   g_match_info_free (match_info);
 
   date = rest_xml_node_find (node, "created_at")->content;
-  sw_item_take (item, "date", _make_date (date));
+  sw_item_set_date (item, sw_time_t_from_string (date));
 
   n = rest_xml_node_find (u_node, "location");
   if (n && n->content)
@@ -361,7 +355,9 @@ _got_status_updates_cb (RestProxyCall *call,
   SwService *service;
 
   if (error) {
-    g_warning (G_STRLOC ": Error getting Tweets: %s", error->message);
+    /* A newer refresh replaced this one while it was waiting */
+    if (!g_error_matches (error, REST_PROXY_ERROR, REST_PROXY_ERROR_CANCELLED))
+      g_warning (G_STRLOC ": Error getting Tweets: %s", error->message);
     return;
   }
 
@@ -423,7 +419,9 @@ _got_trending_topic_updates_cb (RestProxyCall *call,
   GError *error = NULL;
 
   if (error_in) {
-    g_warning (G_STRLOC ": Error getting trending topic data: %s", error_in->message);
+    if (!g_error_matches (error_in, REST_PROXY_ERROR,
+                          REST_PROXY_ERROR_CANCELLED))
+      g_warning (G_STRLOC ": Error getting trending topic data: %s", error_in->message);
     return;
   }
 
@@ -466,7 +464,7 @@ _got_trending_topic_updates_cb (RestProxyCall *call,
 
         trend_o = json_array_get_object_element (trends_a, i);
 
-        sw_item_take (item, "date", sw_time_t_to_string (time(NULL)));
+        sw_item_set_date (item, time (NULL));
         sw_item_put (item, "id", json_object_get_string_member (trend_o,
                                                                 "name"));
         sw_item_put (item, "content", json_object_get_string_member (trend_o,
@@ -498,7 +496,9 @@ _get_status_updates (SwTwitterItemView *item_view)
 {
   SwTwitterItemViewPrivate *priv = GET_PRIVATE (item_view);
   RestProxyCall *call;
+  SwService *service;
 
+  service = sw_item_view_get_service (SW_ITEM_VIEW (item_view));
   call = rest_proxy_new_call (priv->proxy);
 
   if (g_str_equal (priv->query, "own"))
@@ -515,17 +515,21 @@ _get_status_updates (SwTwitterItemView *item_view)
 
   if (g_str_equal (priv->query, "x-twitter-trending-topics"))
   {
-    rest_proxy_call_async (call,
-                           _got_trending_topic_updates_cb,
-                           (GObject*)item_view,
-                           NULL,
-                           NULL);
+    sw_request_governor_call_async (service,
+                                    SW_REQUEST_PRIORITY_REFRESH,
+                                    call,
+                                    _got_trending_topic_updates_cb,
+                                    (GObject*)item_view,
+                                    NULL,
+                                    NULL);
   } else {
-    rest_proxy_call_async (call,
-                           _got_status_updates_cb,
-                           (GObject*)item_view,
-                           NULL,
-                           NULL);
+    sw_request_governor_call_async (service,
+                                    SW_REQUEST_PRIORITY_REFRESH,
+                                    call,
+                                    _got_status_updates_cb,
+                                    (GObject*)item_view,
+                                    NULL,
+                                    NULL);
   }
   g_object_unref (call);
 }
@@ -534,9 +538,15 @@ static gboolean
 _update_timeout_cb (gpointer data)
 {
   SwTwitterItemView *item_view = SW_TWITTER_ITEM_VIEW (data);
+  SwTwitterItemViewPrivate *priv = GET_PRIVATE (item_view);
+  guint interval;
 
   _get_status_updates (item_view);
 
+  /* Refresh more or less often depending on how much is changing */
+  interval = sw_item_view_get_refresh_interval (SW_ITEM_VIEW (item_view));
+  sw_poll_scheduler_set_interval (priv->timeout_id, interval);
+
   return TRUE;
 }
 
@@ -544,19 +554,10 @@ static void
 _load_from_cache (SwTwitterItemView *item_view)
 {
   SwTwitterItemViewPrivate *priv = GET_PRIVATE (item_view);
-  SwSet *set;
-
-  set = sw_cache_load (sw_item_view_get_service (SW_ITEM_VIEW (item_view)),
-                       priv->query,
-                       priv->params,
-                       sw_item_set_new);
 
-  if (set)
-  {
-    sw_item_view_set_from_set (SW_ITEM_VIEW (item_view),
-                               set);
-    sw_set_unref (set);
-  }
+  sw_item_view_load_from_cache (SW_ITEM_VIEW (item_view),
+                                priv->query,
+                                priv->params);
 }
 
 static void
@@ -569,7 +570,8 @@ twitter_item_view_start (SwItemView *item_view)
     g_warning (G_STRLOC ": View already started.");
   } else {
     SW_DEBUG (TWITTER, G_STRLOC ": Setting up the timeout");
-    priv->timeout_id = g_timeout_add_seconds (UPDATE_TIMEOUT,
+    priv->timeout_id = sw_poll_scheduler_add (sw_item_view_get_service (item_view),
+                                              UPDATE_TIMEOUT,
                                               (GSourceFunc)_update_timeout_cb,
                                               item_view);
 
@@ -587,7 +589,7 @@ twitter_item_view_stop (SwItemView *item_view)
   {
     g_warning (G_STRLOC ": View not running");
   } else {
-    g_source_remove (priv->timeout_id);
+    sw_poll_scheduler_remove (priv->timeout_id);
     priv->timeout_id = 0;
   }
 }
@@ -631,17 +633,20 @@ _service_capabilities_changed_cb (SwService    *service,
 
   if (sw_service_has_cap (caps, CREDENTIALS_VALID))
   {
-    twitter_item_view_refresh (item_view);
     if (!priv->timeout_id)
     {
-      priv->timeout_id = g_timeout_add_seconds (UPDATE_TIMEOUT,
+      priv->timeout_id = sw_poll_scheduler_add (sw_item_view_get_service (item_view),
+                                                UPDATE_TIMEOUT,
                                                 (GSourceFunc)_update_timeout_cb,
                                                 item_view);
     }
+
+    /* Take turns with the other views that can refresh now */
+    sw_poll_scheduler_poll_soon (priv->timeout_id);
   } else {
     if (priv->timeout_id)
     {
-      g_source_remove (priv->timeout_id);
+      sw_poll_scheduler_remove (priv->timeout_id);
       priv->timeout_id = 0;
     }
   }
@@ -651,6 +656,9 @@ static void
 sw_twitter_item_view_constructed (GObject *object)
 {
   SwItemView *item_view = SW_ITEM_VIEW (object);
+  SwTwitterItemViewPrivate *priv = GET_PRIVATE (object);
+
+  sw_item_view_set_max_items_from_params (item_view, priv->params);
 
   g_signal_connect (sw_item_view_get_service (item_view),
                     "item-hidden",
@@ -35,6 +35,9 @@
 #include <libsocialweb-keyfob/sw-keyfob.h>
 #include <libsocialweb-keystore/sw-keystore.h>
 #include <libsocialweb/sw-client-monitor.h>
+#include <libsocialweb/sw-view-multiplexer.h>
+#include <libsocialweb/sw-request-governor.h>
+#include <libsocialweb/sw-poll-scheduler.h>
 
 #include <rest/oauth-proxy.h>
 #include <rest/oauth-proxy-call.h>
@@ -82,6 +85,12 @@ G_DEFINE_TYPE_WITH_CODE (SwServiceTwitter,
 #define GET_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((o), SW_TYPE_SERVICE_TWITTER, SwServiceTwitterPrivate))
 
+/*
+ * Fewest seconds between polls of any one view. The timelines only allow a
+ * request a minute, and the views share it.
+ */
+#define MIN_POLL_INTERVAL (2 * 60)
+
 struct _SwServiceTwitterPrivate {
   gboolean inited;
   enum {
@@ -522,7 +531,10 @@ sw_service_twitter_initable (GInitable    *initable,
   sw_keystore_get_key_secret ("twitter", &key, &secret);
   priv->proxy = oauth_proxy_new (key, secret, "https://api.twitter.com/", FALSE);
 
-  sw_online_add_notify (online_notify, twitter);
+  sw_poll_scheduler_set_min_interval ((SwService *)twitter, MIN_POLL_INTERVAL);
+
+  sw_online_add_notify_full (online_notify, twitter,
+                             SW_ONLINE_PRIORITY_INTERACTIVE);
 
   refresh_credentials (twitter);
 
@@ -598,16 +610,17 @@ _twitter_query_open_view (SwQueryIface          *self,
                          (GObject *)item_stream);
   } else {
     SwItemView *item_view;
-    item_view = g_object_new (SW_TYPE_TWITTER_ITEM_VIEW,
-                              "proxy", priv->proxy,
-                              "service", self,
-                              "query", query,
-                              "params", params,
-                              NULL);
+    item_view = (SwItemView *)sw_view_multiplexer_open (SW_SERVICE (self),
+                                                        query,
+                                                        params,
+                                                        dbus_g_method_get_sender (context),
+                                                        SW_TYPE_TWITTER_ITEM_VIEW,
+                                                        "proxy", priv->proxy,
+                                                        "service", self,
+                                                        "query", query,
+                                                        "params", params,
+                                                        NULL);
     object_path = sw_item_view_get_object_path (item_view);
-    /* Ensure the object gets disposed when the client goes away */
-    sw_client_monitor_add (dbus_g_method_get_sender (context),
-                          (GObject *)item_view);
   }
 
   sw_query_iface_return_from_open_view (context,
@@ -770,7 +783,13 @@ _twitter_status_update_update_status (SwStatusUpdateIface   *self,
     }
   }
 
-  rest_proxy_call_async (call, _update_status_cb, (GObject *)self, NULL, NULL);
+  sw_request_governor_call_async (SW_SERVICE (self),
+                                  SW_REQUEST_PRIORITY_INTERACTIVE,
+                                  call,
+                                  _update_status_cb,
+                                  (GObject *)self,
+                                  NULL,
+                                  NULL);
   sw_status_update_iface_return_from_update_status (context);
 }
 
@@ -834,7 +853,13 @@ on_upload_cb (RestProxyCall *call,
   rest_proxy_call_set_method (call, "POST");
   rest_proxy_call_set_function (call, "1/statuses/update.xml");
   rest_proxy_call_add_param (call, "status", tweet);
-  rest_proxy_call_async (call, on_upload_tweet_cb, (GObject *)twitter, NULL, NULL);
+  sw_request_governor_call_async (SW_SERVICE (twitter),
+                                  SW_REQUEST_PRIORITY_INTERACTIVE,
+                                  call,
+                                  on_upload_tweet_cb,
+                                  (GObject *)twitter,
+                                  NULL,
+                                  NULL);
 
   percent = (gdouble) uploaded / (gdouble) total * 100;
   sw_photo_upload_iface_emit_photo_upload_progress (twitter, opid, percent,
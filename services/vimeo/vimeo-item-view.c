@@ -29,6 +29,7 @@
 #include <libsocialweb/sw-debug.h>
 #include <libsocialweb/sw-item.h>
 #include <libsocialweb/sw-cache.h>
+#include <libsocialweb/sw-poll-scheduler.h>
 #include <libsocialweb/sw-call-list.h>
 
 #include <glib/gi18n.h>
@@ -131,7 +132,7 @@ sw_vimeo_item_view_dispose (GObject *object)
 
   if (priv->timeout_id)
   {
-    g_source_remove (priv->timeout_id);
+    sw_poll_scheduler_remove (priv->timeout_id);
     priv->timeout_id = 0;
   }
 
@@ -216,14 +217,6 @@ _update_if_done (SwVimeoItemView *item_view)
   }
 }
 
-static char *
-make_date (const char *s)
-{
-  struct tm tm;
-  strptime (s, "%Y-%m-%d %T", &tm);
-  return sw_time_t_to_string (timegm (&tm));
-}
-
 static SwItem *
 make_item (SwVimeoItemView *item_view,
            SwService        *service,
@@ -239,7 +232,8 @@ make_item (SwVimeoItemView *item_view,
   sw_item_put (item, "title", rest_xml_node_find (video_n, "title")->content);
   sw_item_put (item, "author", rest_xml_node_find (video_n, "user_name")->content);
 
-  sw_item_take (item, "date", make_date (rest_xml_node_find (video_n, "upload_date")->content));
+  sw_item_set_date (item,
+                    sw_time_t_from_string (rest_xml_node_find (video_n, "upload_date")->content));
 
   sw_item_request_image_fetch (item, FALSE, "thumbnail", rest_xml_node_find (video_n, "thumbnail_medium")->content);
   sw_item_request_image_fetch (item, FALSE, "authoricon", rest_xml_node_find (video_n, "user_portrait_medium")->content);
@@ -330,9 +324,15 @@ static gboolean
 _update_timeout_cb (gpointer data)
 {
   SwVimeoItemView *item_view = SW_VIMEO_ITEM_VIEW (data);
+  SwVimeoItemViewPrivate *priv = GET_PRIVATE (item_view);
+  guint interval;
 
   _get_status_updates (item_view);
 
+  /* Refresh more or less often depending on how much is changing */
+  interval = sw_item_view_get_refresh_interval (SW_ITEM_VIEW (item_view));
+  sw_poll_scheduler_set_interval (priv->timeout_id, interval);
+
   return TRUE;
 }
 
@@ -340,19 +340,10 @@ static void
 _load_from_cache (SwVimeoItemView *item_view)
 {
   SwVimeoItemViewPrivate *priv = GET_PRIVATE (item_view);
-  SwSet *set;
 
-  set = sw_cache_load (sw_item_view_get_service (SW_ITEM_VIEW (item_view)),
-                       priv->query,
-                       priv->params,
-                       sw_item_set_new);
-
-  if (set)
-  {
-    sw_item_view_set_from_set (SW_ITEM_VIEW (item_view),
-                               set);
-    sw_set_unref (set);
-  }
+  sw_item_view_load_from_cache (SW_ITEM_VIEW (item_view),
+                                priv->query,
+                                priv->params);
 }
 
 static void
@@ -365,7 +356,8 @@ vimeo_item_view_start (SwItemView *item_view)
     g_warning (G_STRLOC ": View already started.");
   } else {
     SW_DEBUG (VIMEO, G_STRLOC ": Setting up the timeout");
-    priv->timeout_id = g_timeout_add_seconds (UPDATE_TIMEOUT,
+    priv->timeout_id = sw_poll_scheduler_add (sw_item_view_get_service (item_view),
+                                              UPDATE_TIMEOUT,
                                               (GSourceFunc)_update_timeout_cb,
                                               item_view);
 
@@ -383,7 +375,7 @@ vimeo_item_view_stop (SwItemView *item_view)
   {
     g_warning (G_STRLOC ": View not running");
   } else {
-    g_source_remove (priv->timeout_id);
+    sw_poll_scheduler_remove (priv->timeout_id);
     priv->timeout_id = 0;
   }
 }
@@ -422,6 +414,9 @@ static void
 sw_vimeo_item_view_constructed (GObject *object)
 {
   SwItemView *item_view = SW_ITEM_VIEW (object);
+  SwVimeoItemViewPrivate *priv = GET_PRIVATE (object);
+
+  sw_item_view_set_max_items_from_params (item_view, priv->params);
 
   g_signal_connect (sw_item_view_get_service (item_view),
                     "item-hidden",
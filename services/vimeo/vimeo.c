@@ -31,6 +31,7 @@
 #include <libsocialweb/sw-call-list.h>
 #include <libsocialweb/sw-debug.h>
 #include <libsocialweb/sw-client-monitor.h>
+#include <libsocialweb/sw-view-multiplexer.h>
 #include <libsocialweb/sw-online.h>
 #include <libsocialweb-keyfob/sw-keyfob.h>
 #include <libsocialweb-keystore/sw-keystore.h>
@@ -317,17 +318,16 @@ _vimeo_query_open_view (SwQueryIface          *self,
     return;
   }
 
-  item_view = g_object_new (SW_TYPE_VIMEO_ITEM_VIEW,
-                            "proxy", priv->simple_proxy,
-                            "service", self,
-                            "query", query,
-                            "params", params,
-                            NULL);
-
-  /* Ensure the object gets disposed when the client goes away */
-  sw_client_monitor_add (dbus_g_method_get_sender (context),
-                         (GObject *)item_view);
-
+  item_view = (SwItemView *)sw_view_multiplexer_open (SW_SERVICE (self),
+                                                      query,
+                                                      params,
+                                                      dbus_g_method_get_sender (context),
+                                                      SW_TYPE_VIMEO_ITEM_VIEW,
+                                                      "proxy", priv->simple_proxy,
+                                                      "service", self,
+                                                      "query", query,
+                                                      "params", params,
+                                                      NULL);
 
   object_path = sw_item_view_get_object_path (item_view);
   sw_query_iface_return_from_open_view (context,
@@ -387,7 +387,8 @@ sw_service_vimeo_initable (GInitable     *initable,
   priv->proxy = oauth_proxy_new (api_key, api_secret, "http://vimeo.com/", FALSE);
   priv->simple_proxy = rest_proxy_new ("http://vimeo.com/api/v2/%s/", TRUE);
 
-  sw_online_add_notify (online_notify, self);
+  sw_online_add_notify_full (online_notify, self,
+                             SW_ONLINE_PRIORITY_BACKGROUND);
   refresh_credentials (self);
 
   return TRUE;
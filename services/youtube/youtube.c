@@ -36,6 +36,7 @@
 #include <libsocialweb-keyfob/sw-keyfob.h>
 #include <libsocialweb-keystore/sw-keystore.h>
 #include <libsocialweb/sw-client-monitor.h>
+#include <libsocialweb/sw-view-multiplexer.h>
 
 #include <rest-extras/youtube-proxy.h>
 #include <rest/rest-proxy.h>
@@ -395,7 +396,8 @@ sw_service_youtube_initable (GInitable    *initable,
   priv->developer_key = (char *)key;
   priv->credentials = OFFLINE;
 
-  sw_online_add_notify (online_notify, youtube);
+  sw_online_add_notify_full (online_notify, youtube,
+                             SW_ONLINE_PRIORITY_BACKGROUND);
 
   refresh_credentials (youtube);
 
@@ -449,18 +451,17 @@ _youtube_query_open_view (SwQueryIface          *self,
     return;
   }
 
-  item_view = g_object_new (SW_TYPE_YOUTUBE_ITEM_VIEW,
-                            "proxy", priv->proxy,
-                            "developer_key", priv->developer_key,
-                            "service", self,
-                            "query", query,
-                            "params", params,
-                            NULL);
-
-  /* Ensure the object gets disposed when the client goes away */
-  sw_client_monitor_add (dbus_g_method_get_sender (context),
-                         (GObject *)item_view);
-
+  item_view = (SwItemView *)sw_view_multiplexer_open (SW_SERVICE (self),
+                                                      query,
+                                                      params,
+                                                      dbus_g_method_get_sender (context),
+                                                      SW_TYPE_YOUTUBE_ITEM_VIEW,
+                                                      "proxy", priv->proxy,
+                                                      "developer_key", priv->developer_key,
+                                                      "service", self,
+                                                      "query", query,
+                                                      "params", params,
+                                                      NULL);
 
   object_path = sw_item_view_get_object_path (item_view);
   sw_query_iface_return_from_open_view (context,
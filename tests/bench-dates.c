@@ -0,0 +1,103 @@
+/*
+ * libsocialweb - social data store
+ * Copyright (C) 2010 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <glib-object.h>
+#include <libsoup/soup.h>
+#include <libsocialweb/sw-utils.h>
+
+/*
+ * Compare sw_time_t_parse() with the libsoup date parser on the formats that
+ * the services and the cache use.
+ */
+
+static const char *dates[] = {
+  "Sun, 06 Nov 1994 08:49:37 GMT",
+  "Sun, 6 Nov 1994 09:49:37 +0100",
+  "Wed Aug 27 13:08:45 +0000 2008",
+  "Friday, 13 Aug 2010 12:00:00 GMT",
+  "2010-08-13T12:00:00Z",
+  "2010-08-13 12:00:00",
+};
+
+int
+main (int argc, char **argv)
+{
+  GTimer *timer;
+  guint i, j, iterations = 100000;
+  double soup_time, fast_time;
+  time_t t, total = 0;
+
+  if (argc > 1)
+    iterations = atoi (argv[1]);
+
+  g_type_init ();
+
+  for (j = 0; j < G_N_ELEMENTS (dates); j++) {
+    SoupDate *date;
+    time_t soup_t = 0;
+
+    date = soup_date_new_from_string (dates[j]);
+    if (date) {
+      soup_t = soup_date_to_time_t (date);
+      soup_date_free (date);
+    }
+
+    if (!sw_time_t_parse (dates[j], &t))
+      t = -1;
+
+    g_print ("%-34s soup %ld fast %ld%s\n", dates[j],
+             (long)soup_t, (long)t, soup_t == t ? "" : " MISMATCH");
+  }
+
+  timer = g_timer_new ();
+
+  for (i = 0; i < iterations; i++) {
+    for (j = 0; j < G_N_ELEMENTS (dates); j++) {
+      SoupDate *date;
+
+      date = soup_date_new_from_string (dates[j]);
+      if (date) {
+        total += soup_date_to_time_t (date);
+        soup_date_free (date);
+      }
+    }
+  }
+
+  soup_time = g_timer_elapsed (timer, NULL);
+  g_timer_start (timer);
+
+  for (i = 0; i < iterations; i++) {
+    for (j = 0; j < G_N_ELEMENTS (dates); j++) {
+      if (sw_time_t_parse (dates[j], &t))
+        total += t;
+    }
+  }
+
+  fast_time = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  iterations *= G_N_ELEMENTS (dates);
+  g_print ("soup: %.3fs (%.0f ns/date)\n",
+           soup_time, soup_time * 1e9 / iterations);
+  g_print ("fast: %.3fs (%.0f ns/date)\n",
+           fast_time, fast_time * 1e9 / iterations);
+  g_print ("checksum %ld\n", (long)total);
+
+  return 0;
+}